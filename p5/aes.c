@@ -6,6 +6,9 @@
 */
 
 #include "aes.h"
+#include "aesTable.h"
+#include "aesNi.h"
+#include "aesSlice.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -275,80 +278,56 @@ void unShiftRows( byte square[ BLOCK_ROWS ][ BLOCK_COLS ] )
 
 void mixColumns( byte square[ BLOCK_ROWS ][ BLOCK_COLS ] )
 {
-  // Matrix by which each column of square is multiplied.
-  static const byte mixMatrix[ BLOCK_ROWS ][ BLOCK_COLS ] = {
-    { 0x02, 0x03, 0x01, 0x01 },
-    { 0x01, 0x02, 0x03, 0x01 },
-    { 0x01, 0x01, 0x02, 0x03 },
-    { 0x03, 0x01, 0x01, 0x02 }
-  };
-
-  // Make a copy of the square
-  byte square_copy[BLOCK_ROWS][BLOCK_COLS];
-  memcpy(square_copy, square, BLOCK_ROWS * BLOCK_COLS);
-
-  // These nested for loops iterate 
-  // through the square for assignment
-  for (int row = 0; row < BLOCK_ROWS; row++) {
-    for (int col = 0; col < BLOCK_COLS; col++) {
-      byte result = 0;
-
-      // This loop calculates the values
-      for (int i = 0; i < BLOCK_COLS; i++) {
-        byte matrix_val = mixMatrix[col][i];
-        byte square_val = square_copy[i][row];
-        byte product = fieldMul(matrix_val, square_val);
-
-        result = fieldAdd(result, product);
-      }
-
-      square[col][row] = result;
-    }
+  // Each column is multiplied by the matrix
+  //   02 03 01 01
+  //   01 02 03 01
+  //   01 01 02 03
+  //   03 01 01 02
+  for (int col = 0; col < BLOCK_COLS; col++) {
+    byte a0 = square[0][col];
+    byte a1 = square[1][col];
+    byte a2 = square[2][col];
+    byte a3 = square[3][col];
+
+    square[0][col] = fieldMul2(a0) ^ fieldMul3(a1) ^ a2 ^ a3;
+    square[1][col] = a0 ^ fieldMul2(a1) ^ fieldMul3(a2) ^ a3;
+    square[2][col] = a0 ^ a1 ^ fieldMul2(a2) ^ fieldMul3(a3);
+    square[3][col] = fieldMul3(a0) ^ a1 ^ a2 ^ fieldMul2(a3);
   }
 }
 
 void unMixColumns( byte square[ BLOCK_ROWS ][ BLOCK_COLS ] )
 {
-  // Matrix by which each column of square is multiplied.
-  static const byte invMixMatrix[ BLOCK_ROWS ][ BLOCK_COLS ] = {
-    { 0x0E, 0x0B, 0x0D, 0x09 },
-    { 0x09, 0x0E, 0x0B, 0x0D },
-    { 0x0D, 0x09, 0x0E, 0x0B },
-    { 0x0B, 0x0D, 0x09, 0x0E }
-  };
-
-  // Make a copy of the square
-  byte square_copy[BLOCK_ROWS][BLOCK_COLS];
-  memcpy(square_copy, square, BLOCK_ROWS * BLOCK_COLS);
-
-  // These nested for loops iterate 
-  // through the square for assignment
-  for (int row = 0; row < BLOCK_ROWS; row++) {
-    for (int col = 0; col < BLOCK_COLS; col++) {
-      byte result = 0;
-
-      // This loop calculates the values
-      for (int i = 0; i < BLOCK_COLS; i++) {
-        byte matrix_val = invMixMatrix[col][i];
-        byte square_val = square_copy[i][row];
-        byte product = fieldMul(matrix_val, square_val);
-
-        result = fieldAdd(result, product);
-      }
-
-      square[col][row] = result;
-    }
+  // Each column is multiplied by the inverse matrix
+  //   0E 0B 0D 09
+  //   09 0E 0B 0D
+  //   0D 09 0E 0B
+  //   0B 0D 09 0E
+  for (int col = 0; col < BLOCK_COLS; col++) {
+    byte a0 = square[0][col];
+    byte a1 = square[1][col];
+    byte a2 = square[2][col];
+    byte a3 = square[3][col];
+
+    square[0][col] = fieldMul14(a0) ^ fieldMul11(a1) ^ fieldMul13(a2) ^ fieldMul9(a3);
+    square[1][col] = fieldMul9(a0) ^ fieldMul14(a1) ^ fieldMul11(a2) ^ fieldMul13(a3);
+    square[2][col] = fieldMul13(a0) ^ fieldMul9(a1) ^ fieldMul14(a2) ^ fieldMul11(a3);
+    square[3][col] = fieldMul11(a0) ^ fieldMul13(a1) ^ fieldMul9(a2) ^ fieldMul14(a3);
   }
 }
 
-void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
+/**
+ * Runs the initial addSubkey and the 10 rounds of encryption on one block,
+ * using subkeys that have already been generated.
+ * 
+ * @param data the block to encrypt in place
+ * @param subkey the subkeys for each round
+*/
+static void encryptRounds( byte data[ BLOCK_SIZE ], byte const subkey[ ROUNDS + 1 ][ BLOCK_SIZE ] )
 {
-  byte subkey[ROUNDS + 1][BLOCK_SIZE];
   byte square[BLOCK_ROWS][BLOCK_COLS];
 
-  // Preliminary steps
-  generateSubkeys(subkey, key);
-  addSubkey(data, key);
+  addSubkey(data, subkey[0]);
 
   for (int i = 1; i <= ROUNDS; i++) {
 
@@ -375,14 +354,17 @@ void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
   }
 }
 
-void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
+/**
+ * Runs the 10 rounds of inverse operations and the final addSubkey on one block,
+ * using subkeys that have already been generated.
+ * 
+ * @param data the block to decrypt in place
+ * @param subkey the subkeys for each round
+*/
+static void decryptRounds( byte data[ BLOCK_SIZE ], byte const subkey[ ROUNDS + 1 ][ BLOCK_SIZE ] )
 {
-  byte subkey[ROUNDS + 1][BLOCK_SIZE];
   byte square[BLOCK_ROWS][BLOCK_COLS];
 
-  // Preliminary steps
-  generateSubkeys(subkey, key);
-
   for (int i = ROUNDS; i >= 1; i--) {
 
     addSubkey(data, subkey[i]);
@@ -407,5 +389,200 @@ void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
     }
   }
 
-  addSubkey(data, key);
+  addSubkey(data, subkey[0]);
+}
+
+/**
+ * Encrypts blocks one at a time with the reference implementation.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+static void referenceEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for (size_t i = 0; i < nblocks; i++) {
+    byte *block = out + i * BLOCK_SIZE;
+
+    if (block != in + i * BLOCK_SIZE) {
+      memcpy(block, in + i * BLOCK_SIZE, BLOCK_SIZE);
+    }
+
+    encryptRounds(block, ctx->subkey);
+  }
+}
+
+/**
+ * Decrypts blocks one at a time with the reference implementation.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+static void referenceDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  for (size_t i = 0; i < nblocks; i++) {
+    byte *block = out + i * BLOCK_SIZE;
+
+    if (block != in + i * BLOCK_SIZE) {
+      memcpy(block, in + i * BLOCK_SIZE, BLOCK_SIZE);
+    }
+
+    decryptRounds(block, ctx->subkey);
+  }
+}
+
+/** Bulk encryption or decryption routine provided by a backend. */
+typedef void (*BlockFunction)( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/** Everything needed to run one backend. */
+typedef struct {
+  /** Name reported to the user. */
+  char const *name;
+
+  /** Reports whether the backend can run on this machine, or NULL if it always can. */
+  bool (*supported)( void );
+
+  /** Encrypts a run of blocks. */
+  BlockFunction encrypt;
+
+  /** Decrypts a run of blocks. */
+  BlockFunction decrypt;
+} BackendInfo;
+
+/** All the backends, indexed by AesBackend. */
+static const BackendInfo backends[ BACKEND_COUNT ] = {
+  { "reference", NULL, referenceEncryptBlocks, referenceDecryptBlocks },
+  { "table", NULL, tableEncryptBlocks, tableDecryptBlocks },
+  { "aesni", niSupported, niEncryptBlocks, niDecryptBlocks },
+  { "bitslice", NULL, sliceEncryptBlocks, sliceDecryptBlocks }
+};
+
+/**
+ * Backends to try when choosing one automatically. Without AES-NI, the
+ * constant-time bitsliced backend is preferred over the faster tables,
+ * whose memory accesses depend on the key and data.
+*/
+static const AesBackend preference[] = { BACKEND_AESNI, BACKEND_BITSLICE, BACKEND_TABLE, BACKEND_REFERENCE };
+
+/**
+ * Backend used by aesEncryptBlocks() and aesDecryptBlocks(),
+ * or BACKEND_COUNT until one has been chosen.
+*/
+static AesBackend activeBackend = BACKEND_COUNT;
+
+bool aesBackendSupported( AesBackend backend )
+{
+  if (backend < 0 || backend >= BACKEND_COUNT) {
+    return false;
+  }
+
+  return backends[backend].supported == NULL || backends[backend].supported();
+}
+
+AesBackend aesBestBackend( void )
+{
+  for (int i = 0; i < sizeof(preference) / sizeof(preference[0]); i++) {
+    if (aesBackendSupported(preference[i])) {
+      return preference[i];
+    }
+  }
+
+  return BACKEND_REFERENCE;
+}
+
+bool aesBackendFromName( char const *name, AesBackend *backend )
+{
+  for (int i = 0; i < BACKEND_COUNT; i++) {
+    if (strcmp(name, backends[i].name) == 0) {
+      *backend = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool aesSetBackend( AesBackend backend )
+{
+  if (!aesBackendSupported(backend)) {
+    return false;
+  }
+
+  activeBackend = backend;
+  return true;
+}
+
+AesBackend aesGetBackend( void )
+{
+  // Pick the fastest backend the first time one is needed
+  if (activeBackend == BACKEND_COUNT) {
+    activeBackend = aesBestBackend();
+  }
+
+  return activeBackend;
+}
+
+char const *aesBackendName( AesBackend backend )
+{
+  if (backend < 0 || backend >= BACKEND_COUNT) {
+    return "unknown";
+  }
+
+  return backends[backend].name;
+}
+
+void aesInit( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  if (niSupported()) {
+    // The hardware key schedule fills in both sets of subkeys
+    niExpandKey(ctx, key);
+  }
+  else {
+    generateSubkeys(ctx->subkey, key);
+
+    // Decryption subkeys run in reverse, and the middle ones need
+    // unMixColumns so they can be added right after the mixing step
+    for (int r = 0; r <= ROUNDS; r++) {
+      memcpy(ctx->invSubkey[r], ctx->subkey[ROUNDS - r], BLOCK_SIZE);
+
+      if (r != 0 && r != ROUNDS) {
+        byte square[BLOCK_ROWS][BLOCK_COLS];
+        blockToSquare(square, ctx->invSubkey[r]);
+        unMixColumns(square);
+        squareToBlock(ctx->invSubkey[r], square);
+      }
+    }
+  }
+
+  // Every backend's key form is filled in, so switching backends
+  // never invalidates a context
+  tableExpandKey(ctx);
+  sliceExpandKey(ctx);
+}
+
+void aesEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  backends[aesGetBackend()].encrypt(ctx, in, out, nblocks);
+}
+
+void aesDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  backends[aesGetBackend()].decrypt(ctx, in, out, nblocks);
+}
+
+void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
+{
+  AesContext ctx;
+  aesInit(&ctx, key);
+  aesEncryptBlocks(&ctx, data, data, 1);
+}
+
+void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] )
+{
+  AesContext ctx;
+  aesInit(&ctx, key);
+  aesDecryptBlocks(&ctx, data, data, 1);
 }
@@ -9,6 +9,9 @@
 #ifndef _AES_H_
 #define _AES_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "field.h"
 
 /** Number of bytes in an AES key or an AES block. */
@@ -53,6 +56,47 @@
 /** Max index value of the 2D square array */
 #define MAX_SQUARE_IDX 3
 
+/** Number of blocks the bitsliced backend processes together. */
+#define SLICE_BLOCKS 8
+
+/** Number of 64-bit words in one bit plane of the bitsliced backend. */
+#define SLICE_WORDS 2
+
+/** Implementations of the AES rounds that can be selected at runtime. */
+typedef enum {
+  /** Byte-wise implementation built from the individual AES steps. */
+  BACKEND_REFERENCE,
+  /** 32-bit lookup tables combining substBox, shiftRows and mixColumns. */
+  BACKEND_TABLE,
+  /** AES-NI instructions, processing 8 blocks at a time. */
+  BACKEND_AESNI,
+  /** Constant-time bitsliced rounds, processing 8 blocks at a time. */
+  BACKEND_BITSLICE,
+  /** Number of backends, not a backend itself. */
+  BACKEND_COUNT
+} AesBackend;
+
+/**
+ * Expanded form of a single AES key. Building one of these runs the key schedule
+ * once, so it can be reused for every block encrypted or decrypted under that key.
+*/
+typedef struct {
+  /** Subkeys for each round, as produced by generateSubkeys(). */
+  byte subkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+
+  /** Subkeys for the equivalent inverse cipher, in the order decryption uses them. */
+  byte invSubkey[ ROUNDS + 1 ][ BLOCK_SIZE ];
+
+  /** Subkeys as big-endian words, for the table backend. */
+  uint32_t encWords[ ROUNDS + 1 ][ WORD_SIZE ];
+
+  /** Inverse cipher subkeys as big-endian words, for the table backend. */
+  uint32_t decWords[ ROUNDS + 1 ][ WORD_SIZE ];
+
+  /** Subkeys spread across bit planes, for the bitsliced backend. */
+  uint64_t sliceKeys[ ROUNDS + 1 ][ SLICE_WORDS ][ BBITS ];
+} AesContext;
+
 /**
  * Computes the g function used in generating the subkeys from the original, 16-byte key
  * 
@@ -141,4 +185,81 @@ void encryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] );
 */
 void decryptBlock( byte data[ BLOCK_SIZE ], byte key[ BLOCK_SIZE ] );
 
+/**
+ * Fills in the given context with the expanded form of key.
+ * 
+ * @param ctx the context to fill in
+ * @param key the 16-byte key to expand
+*/
+void aesInit( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * Encrypts nblocks consecutive 16-byte blocks using an already expanded key.
+ * The input and output arrays may be the same array, for in-place encryption.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void aesEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Decrypts nblocks consecutive 16-byte blocks using an already expanded key.
+ * The input and output arrays may be the same array, for in-place decryption.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void aesDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Chooses the backend used by aesEncryptBlocks() and aesDecryptBlocks().
+ * 
+ * @param backend the backend to use
+ * @return true if the backend is available on this machine and was selected
+*/
+bool aesSetBackend( AesBackend backend );
+
+/**
+ * Returns the backend currently used by aesEncryptBlocks() and aesDecryptBlocks().
+ * 
+ * @return the active backend
+*/
+AesBackend aesGetBackend( void );
+
+/**
+ * Reports whether the given backend can run on this machine.
+ * 
+ * @param backend the backend to check
+ * @return true if the backend is available
+*/
+bool aesBackendSupported( AesBackend backend );
+
+/**
+ * Returns the fastest backend that can run on this machine.
+ * 
+ * @return the best available backend
+*/
+AesBackend aesBestBackend( void );
+
+/**
+ * Looks up a backend by the name reported by aesBackendName().
+ * 
+ * @param name the name to look up
+ * @param backend filled in with the matching backend
+ * @return true if a backend with the given name exists
+*/
+bool aesBackendFromName( char const *name, AesBackend *backend );
+
+/**
+ * Returns a short, human-readable name for the given backend.
+ * 
+ * @param backend the backend to name
+ * @return the name of the backend
+*/
+char const *aesBackendName( AesBackend backend );
+
 #endif
@@ -0,0 +1,111 @@
+/**
+ * @file aesBench.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Throughput benchmark for the AES backends. Encrypts and decrypts
+ * a buffer with every backend this machine supports and reports
+ * the speed of each one.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "aes.h"
+
+/** Default size of the buffer to encrypt, in bytes. */
+#define DEFAULT_SIZE ( 16 * 1024 * 1024 )
+
+/** Number of times each measurement is repeated. */
+#define REPEATS 5
+
+/** Bytes in a megabyte, for reporting. */
+#define MEGABYTE 1e6
+
+/**
+ * Returns the current time in seconds.
+ * 
+ * @return a monotonic time value
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Measures the best throughput of a bulk routine over several runs.
+ * 
+ * @param fn the routine to measure
+ * @param ctx the expanded key to use
+ * @param data the buffer to process in place
+ * @param nblocks number of blocks in the buffer
+ * @return throughput in megabytes per second
+*/
+static double measure( void (*fn)( AesContext const *, byte const *, byte *, size_t ),
+                       AesContext const *ctx, byte *data, size_t nblocks )
+{
+  double best = 0;
+
+  for (int i = 0; i < REPEATS; i++) {
+    double start = now();
+    fn(ctx, data, data, nblocks);
+    double elapsed = now() - start;
+
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return nblocks * BLOCK_SIZE / best / MEGABYTE;
+}
+
+/**
+ * Entry point of program. An optional argument gives the
+ * size of the buffer to encrypt, in bytes.
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main( int argc, char const *argv[] )
+{
+  size_t size = DEFAULT_SIZE;
+  if (argc > 1) {
+    size = strtoull(argv[1], NULL, 10);
+  }
+
+  size_t nblocks = size / BLOCK_SIZE;
+  if (nblocks == 0) {
+    fprintf(stderr, "usage: aesBench [bytes]\n");
+    return EXIT_FAILURE;
+  }
+
+  byte *data = malloc(nblocks * BLOCK_SIZE);
+  for (size_t i = 0; i < nblocks * BLOCK_SIZE; i++) {
+    data[i] = i * 7 + 3;
+  }
+
+  byte key[BLOCK_SIZE] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                           0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+  AesContext ctx;
+  aesInit(&ctx, key);
+
+  printf("%-10s %14s %14s\n", "backend", "encrypt MB/s", "decrypt MB/s");
+
+  for (int b = 0; b < BACKEND_COUNT; b++) {
+    if (!aesSetBackend(b)) {
+      continue;
+    }
+
+    double enc = measure(aesEncryptBlocks, &ctx, data, nblocks);
+    double dec = measure(aesDecryptBlocks, &ctx, data, nblocks);
+    printf("%-10s %14.1f %14.1f\n", aesBackendName(b), enc, dec);
+  }
+
+  free(data);
+  return EXIT_SUCCESS;
+}
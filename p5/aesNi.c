@@ -0,0 +1,345 @@
+/**
+ * @file aesNi.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * AES backend built on the AESENC, AESDEC and AESKEYGENASSIST instructions.
+ * Each instruction has a latency of several cycles but can start every cycle,
+ * so blocks are processed 8 at a time to keep the pipeline full. The functions
+ * are compiled for AES-NI with target attributes, so the rest of the program
+ * still runs on processors without it.
+ */
+
+#include "aesNi.h"
+#include <stdlib.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+/** Number of blocks processed together in the main loop. */
+#define NI_LANES 8
+
+/** Marks a function as using the AES-NI instruction set. */
+#define NI_TARGET __attribute__(( target( "aes,sse2" ) ))
+
+bool niSupported( void )
+{
+  // -1 until the processor has been checked
+  static int supported = -1;
+
+  if (supported < 0) {
+    unsigned int eax, ebx, ecx, edx;
+    supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
+  }
+
+  return supported;
+}
+
+/**
+ * Computes the next subkey from the previous one and the output of AESKEYGENASSIST.
+ * 
+ * @param key the previous subkey
+ * @param assist AESKEYGENASSIST applied to the previous subkey
+ * @return the next subkey
+*/
+NI_TARGET static __m128i expandStep( __m128i key, __m128i assist )
+{
+  // Only the g function of the last word is needed
+  assist = _mm_shuffle_epi32(assist, 0xFF);
+
+  // Running XOR of the words, like getNewWord() in the reference schedule
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+
+  return _mm_xor_si128(key, assist);
+}
+
+/** Computes subkey r from subkey r - 1, with the round constant rcon. */
+#define EXPAND( k, r, rcon ) \
+  ( k[ r ] = expandStep( k[ ( r ) - 1 ], _mm_aeskeygenassist_si128( k[ ( r ) - 1 ], rcon ) ) )
+
+/** Advances each of the first n schedules in k to subkey r, storing it in subkeys. */
+#define EXPAND_KEYS( k, subkeys, n, r, rcon ) \
+  for (int j = 0; j < ( n ); j++) { \
+    k[ j ] = expandStep( k[ j ], _mm_aeskeygenassist_si128( k[ j ], rcon ) ); \
+    _mm_storeu_si128( (__m128i *) subkeys[ j ][ r ], k[ j ] ); \
+  }
+
+NI_TARGET void niExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  __m128i k[ROUNDS + 1];
+
+  // The round constant has to be an immediate value, so the schedule is unrolled
+  k[0] = _mm_loadu_si128((__m128i const *) key);
+  EXPAND(k, 1, 0x01);
+  EXPAND(k, 2, 0x02);
+  EXPAND(k, 3, 0x04);
+  EXPAND(k, 4, 0x08);
+  EXPAND(k, 5, 0x10);
+  EXPAND(k, 6, 0x20);
+  EXPAND(k, 7, 0x40);
+  EXPAND(k, 8, 0x80);
+  EXPAND(k, 9, 0x1B);
+  EXPAND(k, 10, 0x36);
+
+  for (int r = 0; r <= ROUNDS; r++) {
+    _mm_storeu_si128((__m128i *) ctx->subkey[r], k[r]);
+
+    // AESDEC expects the middle subkeys with unMixColumns already applied
+    __m128i inverse = k[ROUNDS - r];
+    if (r != 0 && r != ROUNDS) {
+      inverse = _mm_aesimc_si128(inverse);
+    }
+    _mm_storeu_si128((__m128i *) ctx->invSubkey[r], inverse);
+  }
+}
+
+NI_TARGET void niEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m128i k[ROUNDS + 1];
+  for (int r = 0; r <= ROUNDS; r++) {
+    k[r] = _mm_loadu_si128((__m128i const *) ctx->subkey[r]);
+  }
+
+  size_t i = 0;
+
+  // Interleave 8 independent blocks, one round at a time
+  for (; i + NI_LANES <= nblocks; i += NI_LANES) {
+    __m128i const *src = (__m128i const *) (in + i * BLOCK_SIZE);
+    __m128i b[NI_LANES];
+
+    for (int j = 0; j < NI_LANES; j++) {
+      b[j] = _mm_xor_si128(_mm_loadu_si128(src + j), k[0]);
+    }
+
+    for (int r = 1; r < ROUNDS; r++) {
+      for (int j = 0; j < NI_LANES; j++) {
+        b[j] = _mm_aesenc_si128(b[j], k[r]);
+      }
+    }
+
+    for (int j = 0; j < NI_LANES; j++) {
+      b[j] = _mm_aesenclast_si128(b[j], k[ROUNDS]);
+      _mm_storeu_si128((__m128i *) (out + (i + j) * BLOCK_SIZE), b[j]);
+    }
+  }
+
+  // Leftover blocks, one at a time
+  for (; i < nblocks; i++) {
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((__m128i const *) (in + i * BLOCK_SIZE)), k[0]);
+
+    for (int r = 1; r < ROUNDS; r++) {
+      b = _mm_aesenc_si128(b, k[r]);
+    }
+
+    _mm_storeu_si128((__m128i *) (out + i * BLOCK_SIZE), _mm_aesenclast_si128(b, k[ROUNDS]));
+  }
+}
+
+NI_TARGET void niDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  __m128i k[ROUNDS + 1];
+  for (int r = 0; r <= ROUNDS; r++) {
+    k[r] = _mm_loadu_si128((__m128i const *) ctx->invSubkey[r]);
+  }
+
+  size_t i = 0;
+
+  // Interleave 8 independent blocks, one round at a time
+  for (; i + NI_LANES <= nblocks; i += NI_LANES) {
+    __m128i const *src = (__m128i const *) (in + i * BLOCK_SIZE);
+    __m128i b[NI_LANES];
+
+    for (int j = 0; j < NI_LANES; j++) {
+      b[j] = _mm_xor_si128(_mm_loadu_si128(src + j), k[0]);
+    }
+
+    for (int r = 1; r < ROUNDS; r++) {
+      for (int j = 0; j < NI_LANES; j++) {
+        b[j] = _mm_aesdec_si128(b[j], k[r]);
+      }
+    }
+
+    for (int j = 0; j < NI_LANES; j++) {
+      b[j] = _mm_aesdeclast_si128(b[j], k[ROUNDS]);
+      _mm_storeu_si128((__m128i *) (out + (i + j) * BLOCK_SIZE), b[j]);
+    }
+  }
+
+  // Leftover blocks, one at a time
+  for (; i < nblocks; i++) {
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((__m128i const *) (in + i * BLOCK_SIZE)), k[0]);
+
+    for (int r = 1; r < ROUNDS; r++) {
+      b = _mm_aesdec_si128(b, k[r]);
+    }
+
+    _mm_storeu_si128((__m128i *) (out + i * BLOCK_SIZE), _mm_aesdeclast_si128(b, k[ROUNDS]));
+  }
+}
+
+NI_TARGET void niExpandKeys( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *const keys[],
+                             int nkeys )
+{
+  __m128i k[NI_MAX_KEYS];
+
+  for (int j = 0; j < nkeys; j++) {
+    k[j] = _mm_loadu_si128((__m128i const *) keys[j]);
+    _mm_storeu_si128((__m128i *) subkeys[j][0], k[j]);
+  }
+
+  // One round of every schedule at a time, so the schedules overlap
+  EXPAND_KEYS(k, subkeys, nkeys, 1, 0x01);
+  EXPAND_KEYS(k, subkeys, nkeys, 2, 0x02);
+  EXPAND_KEYS(k, subkeys, nkeys, 3, 0x04);
+  EXPAND_KEYS(k, subkeys, nkeys, 4, 0x08);
+  EXPAND_KEYS(k, subkeys, nkeys, 5, 0x10);
+  EXPAND_KEYS(k, subkeys, nkeys, 6, 0x20);
+  EXPAND_KEYS(k, subkeys, nkeys, 7, 0x40);
+  EXPAND_KEYS(k, subkeys, nkeys, 8, 0x80);
+  EXPAND_KEYS(k, subkeys, nkeys, 9, 0x1B);
+  EXPAND_KEYS(k, subkeys, nkeys, 10, 0x36);
+}
+
+NI_TARGET void niEncryptLanes( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *lane,
+                               byte const *in, byte *out, size_t nblocks )
+{
+  size_t i = 0;
+
+  // Interleave 8 independent blocks, one round at a time, each with its own subkeys
+  for (; i + NI_LANES <= nblocks; i += NI_LANES) {
+    __m128i const *src = (__m128i const *) (in + i * BLOCK_SIZE);
+    __m128i const *k[NI_LANES];
+    __m128i b[NI_LANES];
+
+    for (int j = 0; j < NI_LANES; j++) {
+      k[j] = (__m128i const *) subkeys[lane[i + j]];
+      b[j] = _mm_xor_si128(_mm_loadu_si128(src + j), _mm_loadu_si128(k[j]));
+    }
+
+    for (int r = 1; r < ROUNDS; r++) {
+      for (int j = 0; j < NI_LANES; j++) {
+        b[j] = _mm_aesenc_si128(b[j], _mm_loadu_si128(k[j] + r));
+      }
+    }
+
+    for (int j = 0; j < NI_LANES; j++) {
+      b[j] = _mm_aesenclast_si128(b[j], _mm_loadu_si128(k[j] + ROUNDS));
+      _mm_storeu_si128((__m128i *) (out + (i + j) * BLOCK_SIZE), b[j]);
+    }
+  }
+
+  // Leftover blocks, one at a time
+  for (; i < nblocks; i++) {
+    __m128i const *k = (__m128i const *) subkeys[lane[i]];
+    __m128i b = _mm_xor_si128(_mm_loadu_si128((__m128i const *) (in + i * BLOCK_SIZE)),
+                              _mm_loadu_si128(k));
+
+    for (int r = 1; r < ROUNDS; r++) {
+      b = _mm_aesenc_si128(b, _mm_loadu_si128(k + r));
+    }
+
+    b = _mm_aesenclast_si128(b, _mm_loadu_si128(k + ROUNDS));
+    _mm_storeu_si128((__m128i *) (out + i * BLOCK_SIZE), b);
+  }
+}
+
+/**
+ * Advances the key schedule of each of the first n lanes to round r, and
+ * runs that round on the lane's block with the new subkey.
+*/
+#define DM_ROUND( k, b, n, rcon, op ) \
+  for (int j = 0; j < ( n ); j++) { \
+    k[ j ] = expandStep( k[ j ], _mm_aeskeygenassist_si128( k[ j ], rcon ) ); \
+    b[ j ] = op( b[ j ], k[ j ] ); \
+  }
+
+NI_TARGET void niDaviesMeyer( byte chains[][ BLOCK_SIZE ], byte const *const msgs[], int nlanes,
+                              size_t nblocks )
+{
+  __m128i h[NI_MAX_KEYS];
+  for (int j = 0; j < nlanes; j++) {
+    h[j] = _mm_loadu_si128((__m128i const *) chains[j]);
+  }
+
+  for (size_t i = 0; i < nblocks; i++) {
+    __m128i k[NI_MAX_KEYS];
+    __m128i b[NI_MAX_KEYS];
+
+    for (int j = 0; j < nlanes; j++) {
+      k[j] = _mm_loadu_si128((__m128i const *) (msgs[j] + i * BLOCK_SIZE));
+      b[j] = _mm_xor_si128(h[j], k[j]);
+    }
+
+    // Each subkey is used as soon as it's made, so none of them are stored
+    DM_ROUND(k, b, nlanes, 0x01, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x02, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x04, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x08, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x10, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x20, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x40, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x80, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x1B, _mm_aesenc_si128);
+    DM_ROUND(k, b, nlanes, 0x36, _mm_aesenclast_si128);
+
+    for (int j = 0; j < nlanes; j++) {
+      h[j] = _mm_xor_si128(b[j], h[j]);
+    }
+  }
+
+  for (int j = 0; j < nlanes; j++) {
+    _mm_storeu_si128((__m128i *) chains[j], h[j]);
+  }
+}
+
+#else
+
+bool niSupported( void )
+{
+  return false;
+}
+
+// The remaining functions are never selected on processors without AES-NI.
+
+void niExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] )
+{
+  abort();
+}
+
+void niEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  abort();
+}
+
+void niDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  abort();
+}
+
+void niExpandKeys( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *const keys[],
+                   int nkeys )
+{
+  abort();
+}
+
+void niEncryptLanes( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *lane,
+                     byte const *in, byte *out, size_t nblocks )
+{
+  abort();
+}
+
+void niDaviesMeyer( byte chains[][ BLOCK_SIZE ], byte const *const msgs[], int nlanes,
+                    size_t nblocks )
+{
+  abort();
+}
+
+#endif
+
+bool niSelected( void )
+{
+  return aesGetBackend() == BACKEND_AESNI;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file aesNi.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for the AES-NI backend, which uses the
+ * processor's AES instructions when they are available.
+ */
+
+#ifndef _AES_NI_H_
+#define _AES_NI_H_
+
+#include "aes.h"
+
+/**
+ * Reports whether this processor supports the AES-NI instructions.
+ * 
+ * @return true if the AES-NI backend can be used
+*/
+bool niSupported( void );
+
+/**
+ * Reports whether AES-NI is the selected backend. The interleaved paths
+ * have their own copy of the AES-NI rounds, so they only stand in for that
+ * backend, and check this rather than niSupported().
+ * 
+ * @return true if the AES-NI backend is selected
+*/
+bool niSelected( void );
+
+/**
+ * Fills in the subkeys and inverse cipher subkeys of the given context
+ * using the hardware key schedule. Only call this if niSupported() is true.
+ * 
+ * @param ctx the context to fill in
+ * @param key the 16-byte key to expand
+*/
+void niExpandKey( AesContext *ctx, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * Encrypts a run of blocks using the AES-NI instructions.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void niEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Decrypts a run of blocks using the AES-NI instructions.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void niDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/** Largest number of keys niExpandKeys() expands together. */
+#define NI_MAX_KEYS 8
+
+/**
+ * Runs the key schedules of several keys at once, interleaved so each
+ * AESKEYGENASSIST overlaps the others. Only the encryption subkeys are
+ * produced. Only call this if niSupported() is true.
+ * 
+ * @param subkeys filled in with the subkeys of each key
+ * @param keys the 16-byte keys to expand
+ * @param nkeys number of keys, at most NI_MAX_KEYS
+*/
+void niExpandKeys( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *const keys[],
+                   int nkeys );
+
+/**
+ * Encrypts a run of blocks, each under its own choice of key, with 8 blocks
+ * interleaved at a time as in niEncryptBlocks(). Only call this if
+ * niSupported() is true.
+ * 
+ * @param subkeys the subkeys of every key, from niExpandKeys()
+ * @param lane for each block, the index in subkeys of the key to encrypt it with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in, which may be the same as in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void niEncryptLanes( byte subkeys[][ ROUNDS + 1 ][ BLOCK_SIZE ], byte const *lane,
+                     byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Runs the Davies-Meyer compression function over several independent chains
+ * at once: each message block is the key, so the chain becomes its own
+ * encryption under that block, xored with itself. The key schedule of each
+ * block is run in registers one round ahead of the rounds that use it, and
+ * the chains are interleaved so the schedules and rounds overlap. Only call
+ * this if niSupported() is true.
+ * 
+ * @param chains the chain value of each lane, updated in place
+ * @param msgs for each lane, the message blocks to fold in
+ * @param nlanes number of lanes, at most NI_MAX_KEYS
+ * @param nblocks number of 16-byte blocks in each lane's message
+*/
+void niDaviesMeyer( byte chains[][ BLOCK_SIZE ], byte const *const msgs[], int nlanes,
+                    size_t nblocks );
+
+#endif
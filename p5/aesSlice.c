@@ -0,0 +1,542 @@
+/**
+ * @file aesSlice.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Bitsliced AES backend. Eight blocks are transposed into eight bit planes,
+ * where plane b holds bit b of every byte of every block. Each step of AES
+ * then becomes a fixed sequence of AND, XOR and shift operations on whole
+ * planes, so no memory access depends on the data or the key. The sBox is
+ * computed as a boolean circuit instead of a table lookup.
+ *
+ * A plane is stored as two 64-bit words. Byte p of a plane (counting from the
+ * low byte of the first word) belongs to byte position p of the blocks, and
+ * bit k of that byte belongs to block k.
+ */
+
+#include "aesSlice.h"
+#include <string.h>
+
+/** Number of byte positions held by each word of a plane. */
+#define WORD_POSITIONS 8
+
+/** Plane bits set in the inverse sBox constant 0x05. */
+#define INV_SBOX_CONSTANT 0x05
+
+/**
+ * Transposes an 8 x 8 matrix of bits held in a 64-bit word, so bit
+ * (8 * r + c) trades places with bit (8 * c + r).
+ * 
+ * @param x the matrix to transpose
+ * @return the transposed matrix
+*/
+static uint64_t transpose8( uint64_t x )
+{
+  uint64_t t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+
+  return x;
+}
+
+/**
+ * Converts 8 blocks into bit planes.
+ * 
+ * @param q the planes to fill, indexed by word and then by bit
+ * @param in the 8 consecutive blocks to convert
+*/
+static void pack( uint64_t q[ SLICE_WORDS ][ BBITS ], byte const *in )
+{
+  memset(q, 0, sizeof(uint64_t) * SLICE_WORDS * BBITS);
+
+  for (int p = 0; p < BLOCK_SIZE; p++) {
+    // Byte k of x is byte p of block k
+    uint64_t x = 0;
+    for (int k = 0; k < SLICE_BLOCKS; k++) {
+      x |= (uint64_t) in[k * BLOCK_SIZE + p] << (k * BBITS);
+    }
+
+    // Now byte b of x holds bit b of byte p of every block
+    x = transpose8(x);
+
+    int shift = (p % WORD_POSITIONS) * BBITS;
+    for (int b = 0; b < BBITS; b++) {
+      q[p / WORD_POSITIONS][b] |= ((x >> (b * BBITS)) & 0xFF) << shift;
+    }
+  }
+}
+
+/**
+ * Converts bit planes back into 8 blocks.
+ * 
+ * @param out the 8 consecutive blocks to fill
+ * @param q the planes to convert
+*/
+static void unpack( byte *out, uint64_t const q[ SLICE_WORDS ][ BBITS ] )
+{
+  for (int p = 0; p < BLOCK_SIZE; p++) {
+    int shift = (p % WORD_POSITIONS) * BBITS;
+
+    // Byte b of x is byte p of plane b
+    uint64_t x = 0;
+    for (int b = 0; b < BBITS; b++) {
+      x |= ((q[p / WORD_POSITIONS][b] >> shift) & 0xFF) << (b * BBITS);
+    }
+
+    x = transpose8(x);
+
+    for (int k = 0; k < SLICE_BLOCKS; k++) {
+      out[k * BLOCK_SIZE + p] = x >> (k * BBITS);
+    }
+  }
+}
+
+/**
+ * Applies the sBox to every byte held in one word of each plane, using
+ * the 115-gate circuit of Boyar and Peralta.
+ * 
+ * @param q one word from each of the 8 planes
+*/
+static void sliceSubBytes( uint64_t q[ BBITS ] )
+{
+  // The circuit numbers bits from the most significant end
+  uint64_t x0 = q[7], x1 = q[6], x2 = q[5], x3 = q[4];
+  uint64_t x4 = q[3], x5 = q[2], x6 = q[1], x7 = q[0];
+
+  // Top linear transformation
+  uint64_t y14 = x3 ^ x5;
+  uint64_t y13 = x0 ^ x6;
+  uint64_t y9 = x0 ^ x3;
+  uint64_t y8 = x0 ^ x5;
+  uint64_t t0 = x1 ^ x2;
+  uint64_t y1 = t0 ^ x7;
+  uint64_t y4 = y1 ^ x3;
+  uint64_t y12 = y13 ^ y14;
+  uint64_t y2 = y1 ^ x0;
+  uint64_t y5 = y1 ^ x6;
+  uint64_t y3 = y5 ^ y8;
+  uint64_t t1 = x4 ^ y12;
+  uint64_t y15 = t1 ^ x5;
+  uint64_t y20 = t1 ^ x1;
+  uint64_t y6 = y15 ^ x7;
+  uint64_t y10 = y15 ^ t0;
+  uint64_t y11 = y20 ^ y9;
+  uint64_t y7 = x7 ^ y11;
+  uint64_t y17 = y10 ^ y11;
+  uint64_t y19 = y10 ^ y8;
+  uint64_t y16 = t0 ^ y11;
+  uint64_t y21 = y13 ^ y16;
+  uint64_t y18 = x0 ^ y16;
+
+  // Non-linear section, which does the inversion in the field
+  uint64_t t2 = y12 & y15;
+  uint64_t t3 = y3 & y6;
+  uint64_t t4 = t3 ^ t2;
+  uint64_t t5 = y4 & x7;
+  uint64_t t6 = t5 ^ t2;
+  uint64_t t7 = y13 & y16;
+  uint64_t t8 = y5 & y1;
+  uint64_t t9 = t8 ^ t7;
+  uint64_t t10 = y2 & y7;
+  uint64_t t11 = t10 ^ t7;
+  uint64_t t12 = y9 & y11;
+  uint64_t t13 = y14 & y17;
+  uint64_t t14 = t13 ^ t12;
+  uint64_t t15 = y8 & y10;
+  uint64_t t16 = t15 ^ t12;
+  uint64_t t17 = t4 ^ t14;
+  uint64_t t18 = t6 ^ t16;
+  uint64_t t19 = t9 ^ t14;
+  uint64_t t20 = t11 ^ t16;
+  uint64_t t21 = t17 ^ y20;
+  uint64_t t22 = t18 ^ y19;
+  uint64_t t23 = t19 ^ y21;
+  uint64_t t24 = t20 ^ y18;
+  uint64_t t25 = t21 ^ t22;
+  uint64_t t26 = t21 & t23;
+  uint64_t t27 = t24 ^ t26;
+  uint64_t t28 = t25 & t27;
+  uint64_t t29 = t28 ^ t22;
+  uint64_t t30 = t23 ^ t24;
+  uint64_t t31 = t22 ^ t26;
+  uint64_t t32 = t31 & t30;
+  uint64_t t33 = t32 ^ t24;
+  uint64_t t34 = t23 ^ t33;
+  uint64_t t35 = t27 ^ t33;
+  uint64_t t36 = t24 & t35;
+  uint64_t t37 = t36 ^ t34;
+  uint64_t t38 = t27 ^ t36;
+  uint64_t t39 = t29 & t38;
+  uint64_t t40 = t25 ^ t39;
+  uint64_t t41 = t40 ^ t37;
+  uint64_t t42 = t29 ^ t33;
+  uint64_t t43 = t29 ^ t40;
+  uint64_t t44 = t33 ^ t37;
+  uint64_t t45 = t42 ^ t41;
+  uint64_t z0 = t44 & y15;
+  uint64_t z1 = t37 & y6;
+  uint64_t z2 = t33 & x7;
+  uint64_t z3 = t43 & y16;
+  uint64_t z4 = t40 & y1;
+  uint64_t z5 = t29 & y7;
+  uint64_t z6 = t42 & y11;
+  uint64_t z7 = t45 & y17;
+  uint64_t z8 = t41 & y10;
+  uint64_t z9 = t44 & y12;
+  uint64_t z10 = t37 & y3;
+  uint64_t z11 = t33 & y4;
+  uint64_t z12 = t43 & y13;
+  uint64_t z13 = t40 & y5;
+  uint64_t z14 = t29 & y2;
+  uint64_t z15 = t42 & y9;
+  uint64_t z16 = t45 & y14;
+  uint64_t z17 = t41 & y8;
+
+  // Bottom linear transformation, including the affine step
+  uint64_t t46 = z15 ^ z16;
+  uint64_t t47 = z10 ^ z11;
+  uint64_t t48 = z5 ^ z13;
+  uint64_t t49 = z9 ^ z10;
+  uint64_t t50 = z2 ^ z12;
+  uint64_t t51 = z2 ^ z5;
+  uint64_t t52 = z7 ^ z8;
+  uint64_t t53 = z0 ^ z3;
+  uint64_t t54 = z6 ^ z7;
+  uint64_t t55 = z16 ^ z17;
+  uint64_t t56 = z12 ^ t48;
+  uint64_t t57 = t50 ^ t53;
+  uint64_t t58 = z4 ^ t46;
+  uint64_t t59 = z3 ^ t54;
+  uint64_t t60 = t46 ^ t57;
+  uint64_t t61 = z14 ^ t57;
+  uint64_t t62 = t52 ^ t58;
+  uint64_t t63 = t49 ^ t58;
+  uint64_t t64 = z4 ^ t59;
+  uint64_t t65 = t61 ^ t62;
+  uint64_t t66 = z1 ^ t63;
+  uint64_t s0 = t59 ^ t63;
+  uint64_t s6 = t56 ^ ~t62;
+  uint64_t s7 = t48 ^ ~t60;
+  uint64_t t67 = t64 ^ t65;
+  uint64_t s3 = t53 ^ t66;
+  uint64_t s4 = t51 ^ t66;
+  uint64_t s5 = t47 ^ t65;
+  uint64_t s1 = t64 ^ ~s3;
+  uint64_t s2 = t55 ^ ~t67;
+
+  q[7] = s0;
+  q[6] = s1;
+  q[5] = s2;
+  q[4] = s3;
+  q[3] = s4;
+  q[2] = s5;
+  q[1] = s6;
+  q[0] = s7;
+}
+
+/**
+ * Applies the inverse of the sBox's affine step, including its constant.
+ * 
+ * @param x one word from each of the 8 planes
+*/
+static void sliceInvAffine( uint64_t x[ BBITS ] )
+{
+  uint64_t s[BBITS];
+  memcpy(s, x, sizeof(s));
+
+  for (int i = 0; i < BBITS; i++) {
+    x[i] = s[(i + 2) % BBITS] ^ s[(i + 5) % BBITS] ^ s[(i + 7) % BBITS];
+
+    if (INV_SBOX_CONSTANT & (1 << i)) {
+      x[i] = ~x[i];
+    }
+  }
+}
+
+/**
+ * Applies the inverse sBox to every byte held in one word of each plane.
+ * Undoing the affine step on both sides of the forward circuit leaves
+ * just the inversion, and undoing it once more gives the inverse sBox.
+ * 
+ * @param x one word from each of the 8 planes
+*/
+static void sliceInvSubBytes( uint64_t x[ BBITS ] )
+{
+  sliceInvAffine(x);
+  sliceSubBytes(x);
+  sliceInvAffine(x);
+}
+
+/**
+ * Rotates a plane, taken as a 128-bit value, right by 32 bits, which
+ * moves every byte four positions (one column) lower.
+ * 
+ * @param lo word holding positions 0 - 7
+ * @param hi word holding positions 8 - 15
+*/
+static void rotateColumn( uint64_t *lo, uint64_t *hi )
+{
+  uint64_t l = *lo;
+  uint64_t h = *hi;
+
+  *lo = (l >> 32) | (h << 32);
+  *hi = (h >> 32) | (l << 32);
+}
+
+/** Plane bytes that belong to each row of the square. */
+static const uint64_t rowMask[ BLOCK_ROWS ] = {
+  0x000000FF000000FFULL, 0x0000FF000000FF00ULL,
+  0x00FF000000FF0000ULL, 0xFF000000FF000000ULL
+};
+
+/**
+ * Performs shiftRows (or unShiftRows) on every plane. Row r moves r columns,
+ * which is a rotation of the bytes in that row by 32 * r bits.
+ * 
+ * @param q the planes to shift
+ * @param inverse true to shift rows to the right instead of the left
+*/
+static void sliceShiftRows( uint64_t q[ SLICE_WORDS ][ BBITS ], bool inverse )
+{
+  for (int b = 0; b < BBITS; b++) {
+    uint64_t lo = q[0][b] & rowMask[0];
+    uint64_t hi = q[1][b] & rowMask[0];
+
+    for (int r = 1; r < BLOCK_ROWS; r++) {
+      uint64_t rlo = q[0][b] & rowMask[r];
+      uint64_t rhi = q[1][b] & rowMask[r];
+
+      // Moving left by r columns is the same as moving right by 4 - r
+      int turns = inverse ? BLOCK_COLS - r : r;
+      for (int t = 0; t < turns; t++) {
+        rotateColumn(&rlo, &rhi);
+      }
+
+      lo |= rlo;
+      hi |= rhi;
+    }
+
+    q[0][b] = lo;
+    q[1][b] = hi;
+  }
+}
+
+/**
+ * Moves every byte of a plane word down n rows within its column.
+ * 
+ * @param x the word to rotate
+ * @param n number of rows, from 1 to 3
+ * @return the rotated word
+*/
+static uint64_t rotateRows( uint64_t x, int n )
+{
+  int bits = n * BBITS;
+  uint64_t keep = (0xFFFFFFFFULL >> bits) * 0x0000000100000001ULL;
+
+  return ((x >> bits) & keep) | ((x << (32 - bits)) & ~keep);
+}
+
+/**
+ * Multiplies every byte held in one word of each plane by 2 (xtime).
+ * 
+ * @param x one word from each of the 8 planes
+*/
+static void sliceTimes2( uint64_t x[ BBITS ] )
+{
+  uint64_t top = x[7];
+
+  x[7] = x[6];
+  x[6] = x[5];
+  x[5] = x[4];
+  x[4] = x[3] ^ top;
+  x[3] = x[2] ^ top;
+  x[2] = x[1];
+  x[1] = x[0] ^ top;
+  x[0] = top;
+}
+
+/**
+ * Performs mixColumns on the bytes held in one word of each plane.
+ * Each output byte is 2 a(r) + 3 a(r+1) + a(r+2) + a(r+3), computed
+ * as 2 (a(r) + a(r+1)) + a(r+1) + a(r+2) + a(r+3).
+ * 
+ * @param x one word from each of the 8 planes
+*/
+static void sliceMixColumns( uint64_t x[ BBITS ] )
+{
+  uint64_t t[BBITS];
+  uint64_t rest[BBITS];
+
+  for (int i = 0; i < BBITS; i++) {
+    uint64_t r1 = rotateRows(x[i], 1);
+    t[i] = x[i] ^ r1;
+    rest[i] = r1 ^ rotateRows(x[i], 2) ^ rotateRows(x[i], 3);
+  }
+
+  sliceTimes2(t);
+
+  for (int i = 0; i < BBITS; i++) {
+    x[i] = t[i] ^ rest[i];
+  }
+}
+
+/**
+ * Performs unMixColumns on the bytes held in one word of each plane.
+ * The inverse matrix factors into the mixColumns matrix times one with
+ * 5 and 4 in its first row, so this adds 4 (a(r) + a(r+2)) first.
+ * 
+ * @param x one word from each of the 8 planes
+*/
+static void sliceUnMixColumns( uint64_t x[ BBITS ] )
+{
+  uint64_t t[BBITS];
+
+  for (int i = 0; i < BBITS; i++) {
+    t[i] = x[i] ^ rotateRows(x[i], 2);
+  }
+
+  sliceTimes2(t);
+  sliceTimes2(t);
+
+  for (int i = 0; i < BBITS; i++) {
+    x[i] ^= t[i];
+  }
+
+  sliceMixColumns(x);
+}
+
+/**
+ * Adds a bitsliced subkey to the planes.
+ * 
+ * @param q the planes to add to
+ * @param key the subkey to add
+*/
+static void sliceAddSubkey( uint64_t q[ SLICE_WORDS ][ BBITS ], uint64_t const key[ SLICE_WORDS ][ BBITS ] )
+{
+  for (int w = 0; w < SLICE_WORDS; w++) {
+    for (int b = 0; b < BBITS; b++) {
+      q[w][b] ^= key[w][b];
+    }
+  }
+}
+
+void sliceExpandKey( AesContext *ctx )
+{
+  // Every block uses the same key, so each bit of a subkey byte
+  // becomes an all-zero or all-one byte in its plane
+  for (int r = 0; r <= ROUNDS; r++) {
+    memset(ctx->sliceKeys[r], 0, sizeof(ctx->sliceKeys[r]));
+
+    for (int p = 0; p < BLOCK_SIZE; p++) {
+      int shift = (p % WORD_POSITIONS) * BBITS;
+
+      for (int b = 0; b < BBITS; b++) {
+        uint64_t bit = (ctx->subkey[r][p] >> b) & 1;
+        ctx->sliceKeys[r][p / WORD_POSITIONS][b] |= (bit * 0xFF) << shift;
+      }
+    }
+  }
+}
+
+/**
+ * Encrypts exactly 8 blocks.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+*/
+static void encryptEight( AesContext const *ctx, byte const *in, byte *out )
+{
+  uint64_t q[SLICE_WORDS][BBITS];
+
+  pack(q, in);
+  sliceAddSubkey(q, ctx->sliceKeys[0]);
+
+  for (int r = 1; r <= ROUNDS; r++) {
+    sliceSubBytes(q[0]);
+    sliceSubBytes(q[1]);
+    sliceShiftRows(q, false);
+
+    if (r != ROUNDS) {
+      sliceMixColumns(q[0]);
+      sliceMixColumns(q[1]);
+    }
+
+    sliceAddSubkey(q, ctx->sliceKeys[r]);
+  }
+
+  unpack(out, q);
+}
+
+/**
+ * Decrypts exactly 8 blocks.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+*/
+static void decryptEight( AesContext const *ctx, byte const *in, byte *out )
+{
+  uint64_t q[SLICE_WORDS][BBITS];
+
+  pack(q, in);
+
+  for (int r = ROUNDS; r >= 1; r--) {
+    sliceAddSubkey(q, ctx->sliceKeys[r]);
+
+    if (r != ROUNDS) {
+      sliceUnMixColumns(q[0]);
+      sliceUnMixColumns(q[1]);
+    }
+
+    sliceShiftRows(q, true);
+    sliceInvSubBytes(q[0]);
+    sliceInvSubBytes(q[1]);
+  }
+
+  sliceAddSubkey(q, ctx->sliceKeys[0]);
+  unpack(out, q);
+}
+
+/**
+ * Runs the given 8-block routine over a run of blocks, padding
+ * the last group out to 8 blocks if needed.
+ * 
+ * @param ctx the expanded key
+ * @param in the input blocks
+ * @param out the array to store the output blocks in
+ * @param nblocks number of 16-byte blocks in the input
+ * @param eight routine that processes exactly 8 blocks
+*/
+static void sliceBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks,
+                         void (*eight)( AesContext const *, byte const *, byte * ) )
+{
+  size_t i = 0;
+
+  for (; i + SLICE_BLOCKS <= nblocks; i += SLICE_BLOCKS) {
+    eight(ctx, in + i * BLOCK_SIZE, out + i * BLOCK_SIZE);
+  }
+
+  if (i < nblocks) {
+    byte partial[SLICE_BLOCKS * BLOCK_SIZE] = { 0 };
+    size_t len = (nblocks - i) * BLOCK_SIZE;
+
+    memcpy(partial, in + i * BLOCK_SIZE, len);
+    eight(ctx, partial, partial);
+    memcpy(out + i * BLOCK_SIZE, partial, len);
+  }
+}
+
+void sliceEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  sliceBlocks(ctx, in, out, nblocks, encryptEight);
+}
+
+void sliceDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks )
+{
+  sliceBlocks(ctx, in, out, nblocks, decryptEight);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file aesSlice.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for the bitsliced AES backend, which runs in
+ * constant time by computing every step with bitwise operations only.
+ */
+
+#ifndef _AES_SLICE_H_
+#define _AES_SLICE_H_
+
+#include "aes.h"
+
+/**
+ * Fills in the bitsliced subkeys used by this backend, based on
+ * the byte subkeys already stored in the context.
+ * 
+ * @param ctx the context to fill in
+*/
+void sliceExpandKey( AesContext *ctx );
+
+/**
+ * Encrypts a run of blocks using the bitsliced backend.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void sliceEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Decrypts a run of blocks using the bitsliced backend.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void sliceDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file aesTable.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for the table-driven AES backend, which combines
+ * substBox, shiftRows and mixColumns into 32-bit table lookups.
+ */
+
+#ifndef _AES_TABLE_H_
+#define _AES_TABLE_H_
+
+#include "aes.h"
+
+/**
+ * Fills in the word-sized subkeys used by the table backend, based on
+ * the byte subkeys already stored in the context.
+ * 
+ * @param ctx the context to fill in
+*/
+void tableExpandKey( AesContext *ctx );
+
+/**
+ * Encrypts a run of blocks using the table backend.
+ * 
+ * @param ctx the expanded key to encrypt with
+ * @param in the blocks to encrypt
+ * @param out the array to store the encrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void tableEncryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+/**
+ * Decrypts a run of blocks using the table backend and the equivalent inverse cipher.
+ * 
+ * @param ctx the expanded key to decrypt with
+ * @param in the blocks to decrypt
+ * @param out the array to store the decrypted blocks in
+ * @param nblocks number of 16-byte blocks in the input
+*/
+void tableDecryptBlocks( AesContext const *ctx, byte const *in, byte *out, size_t nblocks );
+
+#endif
@@ -11,7 +11,7 @@
 #include "aes.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 38
+#define EXPECTED_TOTAL 42
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -320,6 +320,94 @@ int main()
     TestCase( memcmp( data, expected, BLOCK_SIZE ) == 0 );
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // Make sure every backend matches the reference implementation.
+  
+  {
+    // FIPS-197 example key and plaintext, repeated over several blocks.
+    byte key[ BLOCK_SIZE ] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+    byte plain[ BLOCK_SIZE * 9 ];
+    for ( int i = 0; i < sizeof( plain ); i++ )
+      plain[ i ] = ( i * 0x11 ) ^ ( i / BLOCK_SIZE );
+
+    AesContext ctx;
+    aesInit( &ctx, key );
+
+    // Get the expected results from the reference backend.
+    byte cipher[ sizeof( plain ) ];
+    aesSetBackend( BACKEND_REFERENCE );
+    aesEncryptBlocks( &ctx, plain, cipher, sizeof( plain ) / BLOCK_SIZE );
+
+    bool encryptMatch = true;
+    bool decryptMatch = true;
+    for ( int b = 0; b < BACKEND_COUNT; b++ ) {
+      if ( !aesSetBackend( b ) )
+        continue;
+
+      byte data[ sizeof( plain ) ];
+      aesEncryptBlocks( &ctx, plain, data, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( data, cipher, sizeof( data ) ) != 0 )
+        encryptMatch = false;
+
+      aesDecryptBlocks( &ctx, data, data, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( data, plain, sizeof( data ) ) != 0 )
+        decryptMatch = false;
+    }
+
+    TestCase( encryptMatch );
+    TestCase( decryptMatch );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Cross-check the bitsliced backend against encryptBlock() and
+  // decryptBlock() for many keys, with a run of blocks that isn't a
+  // multiple of what it processes together.
+  
+  {
+    unsigned int seed = 1;
+    bool encryptMatch = true;
+    bool decryptMatch = true;
+
+    for ( int k = 0; k < 64; k++ ) {
+      byte key[ BLOCK_SIZE ];
+      byte plain[ BLOCK_SIZE * 19 ];
+      for ( int i = 0; i < BLOCK_SIZE; i++ ) {
+        seed = seed * 1103515245 + 12345;
+        key[ i ] = seed >> 16;
+      }
+      for ( int i = 0; i < sizeof( plain ); i++ ) {
+        seed = seed * 1103515245 + 12345;
+        plain[ i ] = seed >> 16;
+      }
+
+      // Expected results, one block at a time from the reference code.
+      byte expected[ sizeof( plain ) ];
+      memcpy( expected, plain, sizeof( plain ) );
+      aesSetBackend( BACKEND_REFERENCE );
+      for ( int b = 0; b < sizeof( plain ) / BLOCK_SIZE; b++ )
+        encryptBlock( expected + b * BLOCK_SIZE, key );
+
+      AesContext ctx;
+      aesInit( &ctx, key );
+      aesSetBackend( BACKEND_BITSLICE );
+
+      byte data[ sizeof( plain ) ];
+      aesEncryptBlocks( &ctx, plain, data, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( data, expected, sizeof( data ) ) != 0 )
+        encryptMatch = false;
+
+      aesDecryptBlocks( &ctx, data, data, sizeof( plain ) / BLOCK_SIZE );
+      if ( memcmp( data, plain, sizeof( data ) ) != 0 )
+        decryptMatch = false;
+    }
+
+    TestCase( encryptMatch );
+    TestCase( decryptMatch );
+  }
+
 #ifdef DISABLE_TESTS
 
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
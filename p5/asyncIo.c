@@ -0,0 +1,560 @@
+/**
+ * @file asyncIo.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Background reads and writes on a fixed set of buffers. With io_uring, each
+ * request is put on the submission ring and the kernel carries it out while
+ * the program keeps working; the buffers are registered once, so the kernel
+ * doesn't pin and map them again for every request. Without io_uring, a
+ * helper thread takes the requests in order and makes ordinary blocking
+ * pread() and pwrite() calls, which still lets the transfers overlap the work.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "asyncIo.h"
+
+#if defined( __linux__ ) && defined( __NR_io_uring_setup )
+#include <linux/io_uring.h>
+#define HAVE_URING
+#endif
+
+/** Alignment of the buffers, a page, so they suit any kind of file. */
+#define BUFFER_ALIGN 4096
+
+/** A read or write on one of the buffers. */
+typedef struct {
+  /** The file to transfer to or from. */
+  int fd;
+
+  /** True for a write, false for a read. */
+  bool write;
+
+  /** Where in the file the transfer starts. */
+  uint64_t offset;
+
+  /** Number of bytes to transfer. */
+  size_t len;
+
+  /** True from when the request is made until asyncWait() collects it. */
+  bool busy;
+
+  /** True once the transfer has finished. */
+  bool done;
+
+  /** Bytes transferred so far, or -1 after an error. */
+  ssize_t result;
+} Request;
+
+#ifdef HAVE_URING
+
+/** The parts of an io_uring instance shared with the kernel. */
+typedef struct {
+  /** File descriptor for the ring. */
+  int fd;
+
+  /** Mapping of the submission ring. */
+  void *sqRing;
+
+  /** Size of the submission ring mapping. */
+  size_t sqRingSize;
+
+  /** Mapping of the completion ring, which may be the same as the submission ring. */
+  void *cqRing;
+
+  /** Size of the completion ring mapping. */
+  size_t cqRingSize;
+
+  /** Array of submission queue entries. */
+  struct io_uring_sqe *sqes;
+
+  /** Size of the submission queue entry mapping. */
+  size_t sqesSize;
+
+  /** Fields of the submission ring. */
+  unsigned *sqTail, *sqMask, *sqArray;
+
+  /** Fields of the completion ring. */
+  unsigned *cqHead, *cqTail, *cqMask;
+
+  /** Array of completion queue entries. */
+  struct io_uring_cqe *cqes;
+
+  /** True if the buffers were registered, so requests can use them by index. */
+  bool fixed;
+} Uring;
+
+#endif
+
+/** Representation of a set of buffers for background I/O. */
+struct AsyncIoStruct {
+  /** The buffers. */
+  byte **buffers;
+
+  /** Number of buffers. */
+  int count;
+
+  /** The request on each buffer. */
+  Request *requests;
+
+  /** True if requests go through io_uring, false for the helper thread. */
+  bool uring;
+
+#ifdef HAVE_URING
+  /** The ring, if uring is true. */
+  Uring ring;
+#endif
+
+  /** The helper thread, if uring is false. */
+  pthread_t thread;
+
+  /** Protects the requests and the queue, for the helper thread. */
+  pthread_mutex_t lock;
+
+  /** Signalled when a request is queued or finished, or the thread should stop. */
+  pthread_cond_t changed;
+
+  /** Buffers with requests waiting for the helper thread, oldest first. */
+  int *queue;
+
+  /** Position of the oldest request in the queue. */
+  int queueHead;
+
+  /** Number of requests in the queue. */
+  int queueLength;
+
+  /** True when the helper thread should exit. */
+  bool stop;
+};
+
+/**
+ * Carries out whatever part of a request hasn't been done yet with blocking
+ * pread() or pwrite() calls, stopping early only at the end of a file.
+ *
+ * @param req the request to finish
+ * @param buffer the buffer it transfers to or from
+*/
+static void finishRequest( Request *req, byte *buffer )
+{
+  while (req->result >= 0 && (size_t) req->result < req->len) {
+    size_t done = req->result;
+    ssize_t n;
+    if (req->write) {
+      n = pwrite(req->fd, buffer + done, req->len - done, req->offset + done);
+    }
+    else {
+      n = pread(req->fd, buffer + done, req->len - done, req->offset + done);
+    }
+
+    if (n < 0 && errno != EINTR) {
+      req->result = -1;
+    }
+    else if (n == 0) {
+      break;
+    }
+    else if (n > 0) {
+      req->result += n;
+    }
+  }
+}
+
+#ifdef HAVE_URING
+
+/**
+ * Sets up an io_uring instance and maps its rings.
+ *
+ * @param ring the ring to set up
+ * @param entries number of submission queue entries to ask for
+ * @return true if it worked
+*/
+static bool setupRing( Uring *ring, unsigned entries )
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) {
+    return false;
+  }
+
+  ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  // Newer kernels put both rings in one mapping
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && ring->cqRingSize > ring->sqRingSize) {
+    ring->sqRingSize = ring->cqRingSize;
+  }
+
+  ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQ_RING);
+  ring->cqRing = single ? ring->sqRing
+                        : mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+
+  if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+    close(ring->fd);
+    return false;
+  }
+
+  byte *sq = ring->sqRing;
+  ring->sqTail = (unsigned *) ( sq + params.sq_off.tail );
+  ring->sqMask = (unsigned *) ( sq + params.sq_off.ring_mask );
+  ring->sqArray = (unsigned *) ( sq + params.sq_off.array );
+
+  byte *cq = ring->cqRing;
+  ring->cqHead = (unsigned *) ( cq + params.cq_off.head );
+  ring->cqTail = (unsigned *) ( cq + params.cq_off.tail );
+  ring->cqMask = (unsigned *) ( cq + params.cq_off.ring_mask );
+  ring->cqes = (struct io_uring_cqe *) ( cq + params.cq_off.cqes );
+
+  return true;
+}
+
+bool uringSupported( void )
+{
+  // -1 until the kernel has been checked
+  static int supported = -1;
+
+  if (supported < 0) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, 1, &params);
+    supported = fd >= 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  return supported;
+}
+
+/**
+ * Sets up io to send its requests through io_uring, registering its buffers.
+ *
+ * @param io the set of buffers
+ * @param size bytes in each buffer
+ * @return true if it worked
+*/
+static bool startRing( AsyncIo *io, size_t size )
+{
+  if (!uringSupported() || !setupRing(&io->ring, io->count)) {
+    return false;
+  }
+
+  // Registration pins the buffers, which can go over the locked memory limit
+  struct iovec *iov = malloc(io->count * sizeof(struct iovec));
+  for (int i = 0; i < io->count; i++) {
+    iov[i].iov_base = io->buffers[i];
+    iov[i].iov_len = size;
+  }
+
+  io->ring.fixed = syscall(__NR_io_uring_register, io->ring.fd, IORING_REGISTER_BUFFERS,
+                           iov, io->count) == 0;
+  free(iov);
+  return true;
+}
+
+/**
+ * Puts a request on the submission ring and tells the kernel about it.
+ *
+ * @param io the set of buffers
+ * @param slot the buffer the request is for
+*/
+static void submitRing( AsyncIo *io, int slot )
+{
+  Uring *ring = &io->ring;
+  Request *req = &io->requests[slot];
+
+  // Only this thread moves the tail, so it can be read without a barrier
+  unsigned tail = *ring->sqTail;
+  unsigned index = tail & *ring->sqMask;
+
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  if (ring->fixed) {
+    sqe->opcode = req->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->buf_index = slot;
+  }
+  else {
+    sqe->opcode = req->write ? IORING_OP_WRITE : IORING_OP_READ;
+  }
+  sqe->fd = req->fd;
+  sqe->off = req->offset;
+  sqe->addr = (uintptr_t) io->buffers[slot];
+  sqe->len = req->len;
+  sqe->user_data = slot;
+
+  ring->sqArray[index] = index;
+  __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+  while (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0) {
+    if (errno != EINTR && errno != EAGAIN) {
+      fprintf(stderr, "Can't submit I/O request\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/**
+ * Takes completions off the ring until the request on the given buffer is done.
+ *
+ * @param io the set of buffers
+ * @param slot the buffer to wait for
+*/
+static void waitRing( AsyncIo *io, int slot )
+{
+  Uring *ring = &io->ring;
+
+  while (!io->requests[slot].done) {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+      syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+      continue;
+    }
+
+    // A failed request gets another try with a blocking call, which reports the real error
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+    Request *req = &io->requests[cqe->user_data];
+    req->result = cqe->res < 0 ? 0 : cqe->res;
+    req->done = true;
+
+    __atomic_store_n(ring->cqHead, head + 1, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * Unmaps the rings and closes the ring, which also unregisters the buffers.
+ *
+ * @param ring the ring to close
+*/
+static void closeRing( Uring *ring )
+{
+  munmap(ring->sqes, ring->sqesSize);
+  if (ring->cqRing != ring->sqRing) {
+    munmap(ring->cqRing, ring->cqRingSize);
+  }
+  munmap(ring->sqRing, ring->sqRingSize);
+  close(ring->fd);
+}
+
+#else
+
+bool uringSupported( void )
+{
+  return false;
+}
+
+// These are never selected on systems without io_uring.
+
+static bool startRing( AsyncIo *io, size_t size )
+{
+  return false;
+}
+
+static void submitRing( AsyncIo *io, int slot )
+{
+  abort();
+}
+
+static void waitRing( AsyncIo *io, int slot )
+{
+  abort();
+}
+
+#endif
+
+/**
+ * Main function for the helper thread. It carries out the queued requests
+ * in order until it's told to stop.
+ *
+ * @param arg the set of buffers it works for
+ * @return always NULL
+*/
+static void *helperMain( void *arg )
+{
+  AsyncIo *io = arg;
+
+  pthread_mutex_lock(&io->lock);
+
+  while (true) {
+    while (!io->stop && io->queueLength == 0) {
+      pthread_cond_wait(&io->changed, &io->lock);
+    }
+
+    if (io->queueLength == 0) {
+      break;
+    }
+
+    int slot = io->queue[io->queueHead];
+    io->queueHead = ( io->queueHead + 1 ) % io->count;
+    io->queueLength--;
+
+    pthread_mutex_unlock(&io->lock);
+    finishRequest(&io->requests[slot], io->buffers[slot]);
+    pthread_mutex_lock(&io->lock);
+
+    io->requests[slot].done = true;
+    pthread_cond_broadcast(&io->changed);
+  }
+
+  pthread_mutex_unlock(&io->lock);
+  return NULL;
+}
+
+AsyncIo *makeAsyncIo( int count, size_t size, bool useThreads )
+{
+  AsyncIo *io = malloc(sizeof(AsyncIo));
+  io->count = count;
+  io->buffers = malloc(count * sizeof(byte *));
+  io->requests = calloc(count, sizeof(Request));
+
+  for (int i = 0; i < count; i++) {
+    void *buffer;
+    if (posix_memalign(&buffer, BUFFER_ALIGN, size) != 0) {
+      fprintf(stderr, "Can't allocate I/O buffers\n");
+      exit(EXIT_FAILURE);
+    }
+    io->buffers[i] = buffer;
+  }
+
+  io->uring = !useThreads && startRing(io, size);
+
+  if (!io->uring) {
+    io->queue = malloc(count * sizeof(int));
+    io->queueHead = io->queueLength = 0;
+    io->stop = false;
+    pthread_mutex_init(&io->lock, NULL);
+    pthread_cond_init(&io->changed, NULL);
+
+    if (pthread_create(&io->thread, NULL, helperMain, io) != 0) {
+      fprintf(stderr, "Can't create I/O thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return io;
+}
+
+byte *asyncBuffer( AsyncIo const *io, int slot )
+{
+  return io->buffers[slot];
+}
+
+char const *asyncName( AsyncIo const *io )
+{
+  return io->uring ? "io_uring" : "threads";
+}
+
+/**
+ * Starts a request on one of the buffers.
+ *
+ * @param io the set of buffers
+ * @param slot the buffer to use
+ * @param write true for a write, false for a read
+ * @param fd the file to transfer to or from
+ * @param offset where in the file to start
+ * @param len number of bytes to transfer
+*/
+static void submitRequest( AsyncIo *io, int slot, bool write, int fd, uint64_t offset, size_t len )
+{
+  Request *req = &io->requests[slot];
+  req->fd = fd;
+  req->write = write;
+  req->offset = offset;
+  req->len = len;
+  req->busy = true;
+  req->done = false;
+  req->result = 0;
+
+  if (io->uring) {
+    submitRing(io, slot);
+    return;
+  }
+
+  pthread_mutex_lock(&io->lock);
+  io->queue[( io->queueHead + io->queueLength ) % io->count] = slot;
+  io->queueLength++;
+  pthread_cond_broadcast(&io->changed);
+  pthread_mutex_unlock(&io->lock);
+}
+
+void asyncRead( AsyncIo *io, int slot, int fd, uint64_t offset, size_t len )
+{
+  submitRequest(io, slot, false, fd, offset, len);
+}
+
+void asyncWrite( AsyncIo *io, int slot, int fd, uint64_t offset, size_t len )
+{
+  submitRequest(io, slot, true, fd, offset, len);
+}
+
+ssize_t asyncWait( AsyncIo *io, int slot )
+{
+  Request *req = &io->requests[slot];
+
+  if (io->uring) {
+    waitRing(io, slot);
+  }
+  else {
+    pthread_mutex_lock(&io->lock);
+    while (!req->done) {
+      pthread_cond_wait(&io->changed, &io->lock);
+    }
+    pthread_mutex_unlock(&io->lock);
+  }
+
+  // The kernel can stop partway through a request, so finish the rest here
+  finishRequest(req, io->buffers[slot]);
+  req->busy = false;
+  return req->result;
+}
+
+void freeAsyncIo( AsyncIo *io )
+{
+  for (int i = 0; i < io->count; i++) {
+    if (io->requests[i].busy) {
+      asyncWait(io, i);
+    }
+  }
+
+  if (io->uring) {
+#ifdef HAVE_URING
+    closeRing(&io->ring);
+#endif
+  }
+  else {
+    pthread_mutex_lock(&io->lock);
+    io->stop = true;
+    pthread_cond_broadcast(&io->changed);
+    pthread_mutex_unlock(&io->lock);
+
+    pthread_join(io->thread, NULL);
+    pthread_mutex_destroy(&io->lock);
+    pthread_cond_destroy(&io->changed);
+    free(io->queue);
+  }
+
+  for (int i = 0; i < io->count; i++) {
+    free(io->buffers[i]);
+  }
+  free(io->buffers);
+  free(io->requests);
+  free(io);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file asyncIo.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for reading and writing files in the background,
+ * so the program can work on one buffer while others are being transferred.
+ * Requests go through io_uring where the kernel supports it, and through a
+ * helper thread making ordinary pread() and pwrite() calls everywhere else.
+ */
+
+#ifndef _ASYNC_IO_H_
+#define _ASYNC_IO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "field.h"
+
+/** Incomplete type for a set of buffers and the requests in flight on them. */
+typedef struct AsyncIoStruct AsyncIo;
+
+/**
+ * Reports whether io_uring can be used on this machine. Kernels can be
+ * too old for it, or have it turned off.
+ *
+ * @return true if io_uring is available
+*/
+bool uringSupported( void );
+
+/**
+ * Makes a dynamically allocated set of buffers for background I/O, with
+ * space for one request in flight on each buffer. With io_uring, the buffers
+ * are registered with the kernel up front, so it doesn't have to map them
+ * again for every request.
+ *
+ * @param count number of buffers
+ * @param size bytes in each buffer
+ * @param useThreads true to use the helper thread even if io_uring is available
+ * @return a pointer to the new set of buffers
+*/
+AsyncIo *makeAsyncIo( int count, size_t size, bool useThreads );
+
+/**
+ * Returns one of the buffers.
+ *
+ * @param io the set of buffers
+ * @param slot which buffer to return
+ * @return the buffer
+*/
+byte *asyncBuffer( AsyncIo const *io, int slot );
+
+/**
+ * Returns the name of the method io is using to transfer data.
+ *
+ * @param io the set of buffers
+ * @return "io_uring" or "threads"
+*/
+char const *asyncName( AsyncIo const *io );
+
+/**
+ * Starts reading into the start of one of the buffers. The buffer
+ * must not have another request in flight.
+ *
+ * @param io the set of buffers
+ * @param slot which buffer to read into
+ * @param fd the file to read from
+ * @param offset where in the file to start reading
+ * @param len number of bytes to read, at most the size of the buffer
+*/
+void asyncRead( AsyncIo *io, int slot, int fd, uint64_t offset, size_t len );
+
+/**
+ * Starts writing from the start of one of the buffers. The buffer
+ * must not have another request in flight.
+ *
+ * @param io the set of buffers
+ * @param slot which buffer to write from
+ * @param fd the file to write to
+ * @param offset where in the file to start writing
+ * @param len number of bytes to write, at most the size of the buffer
+*/
+void asyncWrite( AsyncIo *io, int slot, int fd, uint64_t offset, size_t len );
+
+/**
+ * Waits for the request on one of the buffers to finish. A request the
+ * kernel only partly completes is finished off here, so the result is
+ * short only at the end of a file.
+ *
+ * @param io the set of buffers
+ * @param slot which buffer to wait for
+ * @return number of bytes transferred, or -1 if the request failed
+*/
+ssize_t asyncWait( AsyncIo *io, int slot );
+
+/**
+ * Waits for any requests still in flight, then frees io and its buffers.
+ *
+ * @param io the set of buffers to free
+*/
+void freeAsyncIo( AsyncIo *io );
+
+#endif
@@ -0,0 +1,375 @@
+/**
+ * @file batch.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Encrypts or decrypts every file listed in a manifest. Small files don't
+ * have enough blocks to keep several threads busy, so instead of splitting
+ * each file across the threads, whole files are handed out to them, and
+ * each thread works through its files with a buffer of its own.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "io.h"
+#include "compress.h"
+#include "cipher.h"
+#include "stream.h"
+#include "pool.h"
+
+/** Characters that separate the fields of a manifest line */
+#define SEPARATORS " \t\r\n"
+
+/** Number of entries to make room for at first */
+#define INITIAL_ENTRIES 16
+
+/** One file listed in the manifest. */
+typedef struct {
+  /** Name of the key file. */
+  char *keyFile;
+
+  /** Name of the input file. */
+  char *inputFile;
+
+  /** Name of the output file. */
+  char *outputFile;
+
+  /** The expanded key, shared with every other entry that has the same key file. */
+  AesContext const *ctx;
+} BatchEntry;
+
+/** State shared by the threads working through a batch. */
+typedef struct {
+  /** Mode of operation. */
+  Mode mode;
+
+  /** True to encrypt the files, false to decrypt them. */
+  bool encrypt;
+
+  /** The files to process. */
+  BatchEntry *entries;
+
+  /** Number of entries. */
+  size_t count;
+
+  /** One reusable buffer for each thread. */
+  StreamBuffer *buffers;
+
+  /** Protects the fields below. */
+  pthread_mutex_t lock;
+
+  /** Next entry to hand out. */
+  size_t next;
+
+  /** Bytes read from the files processed so far. */
+  uint64_t bytes;
+
+  /** Number of files that couldn't be processed. */
+  size_t failures;
+} BatchJob;
+
+/**
+ * Returns the current time, in seconds.
+ *
+ * @return seconds since an arbitrary starting point
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Reads the manifest with the given name. Terminates the program if it can't
+ * be read or a line doesn't have exactly three fields.
+ *
+ * @param filename name of the manifest
+ * @param count filled in with the number of entries
+ * @return a dynamically allocated array of entries, without their keys
+*/
+static BatchEntry *readManifest( char const *filename, size_t *count )
+{
+  FILE *fp = openFile(filename, "r");
+
+  size_t capacity = INITIAL_ENTRIES;
+  BatchEntry *entries = malloc(capacity * sizeof(BatchEntry));
+  *count = 0;
+
+  char *line = NULL;
+  size_t linecap = 0;
+  int lineno = 0;
+
+  while (getline(&line, &linecap, fp) != -1) {
+    lineno++;
+
+    char *fields[4];
+    int nfields = 0;
+    for (char *tok = strtok(line, SEPARATORS); tok && nfields < 4; tok = strtok(NULL, SEPARATORS)) {
+      fields[nfields++] = tok;
+    }
+
+    // Skip blank lines and comments
+    if (nfields == 0 || fields[0][0] == '#') {
+      continue;
+    }
+
+    if (nfields != 3) {
+      fprintf(stderr, "Bad manifest line %d: %s\n", lineno, filename);
+      exit(EXIT_FAILURE);
+    }
+
+    if (*count == capacity) {
+      capacity *= 2;
+      entries = realloc(entries, capacity * sizeof(BatchEntry));
+    }
+
+    BatchEntry *entry = &entries[(*count)++];
+    entry->keyFile = strdup(fields[0]);
+    entry->inputFile = strdup(fields[1]);
+    entry->outputFile = strdup(fields[2]);
+    entry->ctx = NULL;
+  }
+
+  free(line);
+  fclose(fp);
+  return entries;
+}
+
+/**
+ * Compares two entries by the name of their key file, for qsort().
+ *
+ * @param a pointer to the first entry pointer
+ * @param b pointer to the second entry pointer
+ * @return negative, zero or positive as the first key file sorts before, with or after the second
+*/
+static int compareKeys( void const *a, void const *b )
+{
+  BatchEntry const *x = *(BatchEntry const *const *) a;
+  BatchEntry const *y = *(BatchEntry const *const *) b;
+  return strcmp(x->keyFile, y->keyFile);
+}
+
+/**
+ * Reads and expands each distinct key file once, pointing every entry at its
+ * expanded key. Terminates the program if a key file can't be read or isn't
+ * exactly 16 bytes.
+ *
+ * @param entries the entries of the batch
+ * @param count number of entries
+ * @return a dynamically allocated array of the expanded keys
+*/
+static AesContext *loadKeys( BatchEntry *entries, size_t count )
+{
+  // Sort the entries by key file, so each key's entries are next to each other
+  BatchEntry **sorted = malloc(count * sizeof(BatchEntry *));
+  for (size_t i = 0; i < count; i++) {
+    sorted[i] = &entries[i];
+  }
+  qsort(sorted, count, sizeof(BatchEntry *), compareKeys);
+
+  AesContext *keys = malloc(count * sizeof(AesContext));
+  size_t nkeys = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    if (i == 0 || strcmp(sorted[i]->keyFile, sorted[i - 1]->keyFile) != 0) {
+      size_t keysize;
+      byte *key = readBinaryFile(sorted[i]->keyFile, &keysize);
+      if (keysize != BLOCK_SIZE) {
+        fprintf(stderr, "Bad key file: %s\n", sorted[i]->keyFile);
+        exit(EXIT_FAILURE);
+      }
+
+      aesInit(&keys[nkeys++], key);
+      free(key);
+    }
+
+    sorted[i]->ctx = &keys[nkeys - 1];
+  }
+
+  free(sorted);
+  return keys;
+}
+
+/**
+ * Encrypts or decrypts the file for one entry, reporting anything that goes wrong.
+ *
+ * @param job the batch the entry belongs to
+ * @param entry the entry to process
+ * @param pool the single-thread pool for the cipher
+ * @param buffer the buffer to work in
+ * @param bytes filled in with the size of the input file
+ * @return true if the file was processed
+*/
+static bool processEntry( BatchJob const *job, BatchEntry const *entry, ThreadPool *pool,
+                          StreamBuffer const *buffer, uint64_t *bytes )
+{
+  FILE *input = fopen(entry->inputFile, "rb");
+  if (!input) {
+    fprintf(stderr, "Can't open file: %s\n", entry->inputFile);
+    return false;
+  }
+
+  // Refused as in encrypt and decrypt, rather than replacing the input with its own output
+  if (sameFile(input, entry->outputFile)) {
+    fprintf(stderr, "Input and output are the same file: %s\n", entry->outputFile);
+    fclose(input);
+    return false;
+  }
+
+  // Expanding a compressed file ends the program at the first bad frame,
+  // which would take the rest of the batch with it
+  byte flags = 0;
+  if (!job->encrypt && !readFormatHeader(&input, &flags)) {
+    fprintf(stderr, "Unsupported file format: %s\n", entry->inputFile);
+    fclose(input);
+    return false;
+  }
+  if (flags & FORMAT_COMPRESSED) {
+    fprintf(stderr, "Can't decrypt compressed file in a batch: %s\n", entry->inputFile);
+    fclose(input);
+    return false;
+  }
+
+  // The output only replaces an existing file once it's complete
+  Replacement output;
+  if (!openReplacement(&output, entry->outputFile)) {
+    fprintf(stderr, "Can't open file: %s\n", entry->outputFile);
+    fclose(input);
+    return false;
+  }
+
+  if (!fileSize(input, bytes)) {
+    *bytes = 0;
+  }
+
+  Cipher cipher;
+  initCipherExpanded(&cipher, job->mode, entry->ctx, pool);
+
+  DecryptResult result = DECRYPT_OK;
+  if (job->encrypt) {
+    encryptStreamBuffered(&cipher, input, output.fp, buffer);
+  }
+  else {
+    result = decryptStreamBuffered(&cipher, input, output.fp, buffer);
+  }
+
+  fclose(input);
+
+  if (result == DECRYPT_BAD_LENGTH) {
+    fprintf(stderr, "Bad ciphertext file length: %s\n", entry->inputFile);
+  }
+  else if (result == DECRYPT_BAD_TAG) {
+    fprintf(stderr, "Authentication failed: %s\n", entry->inputFile);
+  }
+
+  // Don't leave partial plaintext behind for a file that didn't decrypt
+  if (result != DECRYPT_OK) {
+    discardReplacement(&output);
+    return false;
+  }
+
+  if (!commitReplacement(&output)) {
+    fprintf(stderr, "Can't write file: %s\n", entry->outputFile);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Task for one of the threads working through a batch. It takes entries
+ * one at a time until there are none left, so a thread that gets small
+ * files takes more of them.
+ *
+ * @param arg the BatchJob
+ * @param index which thread this is, choosing its buffer
+*/
+static void batchTask( void *arg, size_t index )
+{
+  BatchJob *job = arg;
+
+  // Each file stays on this thread, so the cipher doesn't need any others
+  ThreadPool *pool = makePool(1);
+
+  while (true) {
+    pthread_mutex_lock(&job->lock);
+    size_t i = job->next++;
+    pthread_mutex_unlock(&job->lock);
+
+    if (i >= job->count) {
+      break;
+    }
+
+    uint64_t bytes;
+    bool ok = processEntry(job, &job->entries[i], pool, &job->buffers[index], &bytes);
+
+    pthread_mutex_lock(&job->lock);
+    if (ok) {
+      job->bytes += bytes;
+    }
+    else {
+      job->failures++;
+    }
+    pthread_mutex_unlock(&job->lock);
+  }
+
+  freePool(pool);
+}
+
+int runBatch( Options const *opts, bool encrypt )
+{
+  BatchJob job;
+  job.mode = opts->mode;
+  job.encrypt = encrypt;
+  job.entries = readManifest(opts->batchFile, &job.count);
+  job.next = 0;
+  job.bytes = 0;
+  job.failures = 0;
+  pthread_mutex_init(&job.lock, NULL);
+
+  AesContext *keys = loadKeys(job.entries, job.count);
+
+  // No point in more threads than files
+  size_t threads = opts->threads;
+  if (threads > job.count) {
+    threads = job.count;
+  }
+
+  job.buffers = malloc(threads * sizeof(StreamBuffer));
+  for (size_t i = 0; i < threads; i++) {
+    initStreamBuffer(&job.buffers[i], CHUNK_SIZE);
+  }
+
+  double start = now();
+  ThreadPool *pool = makePool(threads);
+  runPool(pool, batchTask, &job, threads);
+  freePool(pool);
+  double elapsed = now() - start;
+
+  printf("Batch: %zu files, %.1f MB in %.3f s (%.1f MB/s)\n", job.count - job.failures,
+         job.bytes / 1e6, elapsed, elapsed > 0 ? job.bytes / 1e6 / elapsed : 0.0);
+  if (job.failures > 0) {
+    printf("Failed: %zu of %zu files\n", job.failures, job.count);
+  }
+
+  for (size_t i = 0; i < threads; i++) {
+    freeStreamBuffer(&job.buffers[i]);
+  }
+  for (size_t i = 0; i < job.count; i++) {
+    free(job.entries[i].keyFile);
+    free(job.entries[i].inputFile);
+    free(job.entries[i].outputFile);
+  }
+  free(job.buffers);
+  free(job.entries);
+  free(keys);
+  pthread_mutex_destroy(&job.lock);
+
+  return job.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
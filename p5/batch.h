@@ -0,0 +1,31 @@
+/**
+ * @file batch.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting or decrypting a whole list
+ * of files in one run, several files at a time
+ */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdbool.h>
+#include "options.h"
+
+/**
+ * Processes every file listed in the manifest named by opts->batchFile. Each
+ * line of the manifest holds a key file, an input file and an output file,
+ * separated by whitespace; blank lines and lines starting with # are skipped.
+ * Each distinct key file is read and expanded once, up front, and up to
+ * opts->threads files are processed at a time, each on a single thread with
+ * a buffer that's reused from one file to the next. A file that can't be
+ * processed is reported and skipped, and a throughput summary is printed
+ * at the end. Terminates the program if the manifest or a key is invalid.
+ * 
+ * @param opts the command-line settings
+ * @param encrypt true to encrypt the files, false to decrypt them
+ * @return EXIT_SUCCESS if every file was processed, or EXIT_FAILURE
+*/
+int runBatch( Options const *opts, bool encrypt );
+
+#endif
@@ -0,0 +1,871 @@
+/**
+ * @file benchmark.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Benchmark suite for the field and AES primitives, the field buffer
+ * operations, the authenticated modes sealing and opening a buffer in memory, and
+ * whole-file encryption and decryption. Every case is warmed up, then repeated, and
+ * the median and 99th percentile of the repeats are reported as JSON on
+ * standard output, so results can be saved and compared over time.
+ * Progress goes to standard error.
+ *
+ * Each sample runs the case enough times to take at least MIN_SAMPLE_TIME,
+ * so timer overhead doesn't swamp the small primitives. Cycles come from
+ * the time-stamp counter, which ticks at a fixed rate rather than with
+ * the core clock, so they're comparable between runs on the same machine
+ * but not exact core cycles.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "field.h"
+#include "fieldVec.h"
+#include "aes.h"
+#include "cipher.h"
+#include "cbc.h"
+#include "stream.h"
+#include "pool.h"
+#include "io.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+/** True if cycles can be counted on this machine. */
+#define HAVE_CYCLES 1
+#else
+#define HAVE_CYCLES 0
+#endif
+
+/** Default size of the largest file to encrypt, in bytes. */
+#define DEFAULT_MAX_SIZE ( 1024ULL * 1024 * 1024 )
+
+/** Largest buffer encrypted in memory, in bytes. */
+#define MAX_BULK_SIZE ( 16 * 1024 * 1024 )
+
+/** Smallest size measured, in bytes. */
+#define MIN_SIZE 16
+
+/** Factor between consecutive sizes. */
+#define SIZE_STEP 16
+
+/** Shortest time one sample may take, in seconds. */
+#define MIN_SAMPLE_TIME 1e-4
+
+/** Most samples taken of one case. */
+#define MAX_SAMPLES 31
+
+/** Fewest samples taken of one case, however long they take. */
+#define MIN_SAMPLES 3
+
+/** Once this many seconds have gone into samples, stop at MIN_SAMPLES. */
+#define CASE_BUDGET 0.25
+
+/** Sizes expected to take longer than this many seconds per run are skipped. */
+#define MAX_RUN_TIME 2.0
+
+/** Bytes in a megabyte, for reporting. */
+#define MEGABYTE 1e6
+
+/** Files used for the whole-file cases. */
+#define PLAIN_FILE "bench-plain.dat"
+#define CIPHER_FILE "bench-cipher.dat"
+#define OUTPUT_FILE "bench-output.dat"
+
+/** Work to measure: runs the case reps times. */
+typedef void (*BenchFunction)( void *arg, size_t reps );
+
+/** Description of one case, as reported in the results. */
+typedef struct {
+  /** Name of the operation. */
+  char const *op;
+
+  /** Backend used, or NULL if the operation doesn't depend on one. */
+  char const *backend;
+
+  /** Mode of operation, or NULL if the operation doesn't use one. */
+  char const *mode;
+
+  /** Bytes processed by one run. */
+  size_t bytes;
+} BenchCase;
+
+/** Key used for everything, long enough for the modes that take a second key. */
+static byte const benchKey[ MAX_KEY_SIZE ] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C,
+  0x60, 0x3D, 0xEB, 0x10, 0x15, 0xCA, 0x71, 0xBE,
+  0x2B, 0x73, 0xAE, 0xF0, 0x85, 0x7D, 0x77, 0x81 };
+
+/** Nonce used by the in-memory cases, long enough for any mode. */
+static byte const benchNonce[ NONCE_SIZE ] = {
+  0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+  0xDE, 0xCA, 0xF8, 0x88, 0x00, 0x00, 0x00, 0x00 };
+
+/** Ways of encrypting and authenticating a buffer, compared by benchSeals(). */
+typedef enum {
+  /** OCB, one pass. */
+  SEAL_OCB,
+  /** GCM, CTR plus a GHASH of the ciphertext. */
+  SEAL_GCM,
+  /** CTR, then a CBC-MAC of the ciphertext under a second key. */
+  SEAL_CTR_MAC,
+  /** Number of ways, not a way itself. */
+  SEAL_COUNT
+} Seal;
+
+/** Names of the ways of sealing, indexed by Seal. */
+static char const *sealNames[] = { "ocb", "gcm", "ctr+mac" };
+
+/** Names of the modes, indexed by Mode. */
+static char const *modeNames[] = { "ecb", "ctr", "gcm", "cbc", "ocb", "xts" };
+
+/** Results are written to keep the compiler from optimizing the work away. */
+static volatile byte sink;
+
+/** False until the first result has been printed, for the commas between them. */
+static bool printedResult = false;
+
+/**
+ * Returns the current time in seconds.
+ *
+ * @return a monotonic time value
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the current value of the cycle counter.
+ *
+ * @return the cycle count, or 0 if there's no counter
+*/
+static double cycles( void )
+{
+#if HAVE_CYCLES
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Compares two doubles, for qsort().
+ *
+ * @param a pointer to the first value
+ * @param b pointer to the second value
+ * @return negative, zero or positive as a is less than, equal to or greater than b
+*/
+static int compareDoubles( void const *a, void const *b )
+{
+  double x = *(double const *) a;
+  double y = *(double const *) b;
+  return ( x > y ) - ( x < y );
+}
+
+/**
+ * Returns the given percentile of a sorted array, using the nearest rank.
+ *
+ * @param values the sorted values
+ * @param n number of values
+ * @param percent the percentile to find
+ * @return the value at that percentile
+*/
+static double percentile( double const *values, int n, int percent )
+{
+  int rank = ( percent * n + 99 ) / 100;
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Returns the size to measure after the given one: SIZE_STEP times larger,
+ * but never past the largest size, which is always measured itself.
+ *
+ * @param size the size just measured
+ * @param maxSize the largest size to measure
+ * @return the next size, or 0 if that was the last one
+*/
+static uint64_t nextSize( uint64_t size, uint64_t maxSize )
+{
+  if (size >= maxSize) {
+    return 0;
+  }
+  return size * SIZE_STEP < maxSize ? size * SIZE_STEP : maxSize;
+}
+
+/**
+ * Prints one string field of a result, or null if there's no value.
+ *
+ * @param name the name of the field
+ * @param value the value of the field, or NULL
+*/
+static void printString( char const *name, char const *value )
+{
+  if (value) {
+    printf("\"%s\": \"%s\", ", name, value);
+  }
+  else {
+    printf("\"%s\": null, ", name);
+  }
+}
+
+/**
+ * Warms up, samples and reports one case.
+ *
+ * @param info description of the case
+ * @param fn the work to measure
+ * @param arg passed to fn
+ * @return the median time of one run, in seconds
+*/
+static double runCase( BenchCase const *info, BenchFunction fn, void *arg )
+{
+  fprintf(stderr, "%-16s %-10s %-4s %12zu\n", info->op, info->backend ? info->backend : "",
+          info->mode ? info->mode : "", info->bytes);
+
+  // Find how many runs make a long enough sample, which also warms up caches and branch predictors
+  size_t reps = 1;
+  for (;;) {
+    double start = now();
+    fn(arg, reps);
+    if (now() - start >= MIN_SAMPLE_TIME) {
+      break;
+    }
+    reps *= 2;
+  }
+  fn(arg, reps);
+
+  double seconds[MAX_SAMPLES];
+  double counts[MAX_SAMPLES];
+  double total = 0;
+  int n = 0;
+
+  while (n < MAX_SAMPLES && (n < MIN_SAMPLES || total < CASE_BUDGET)) {
+    double start = now();
+    double startCycles = cycles();
+    fn(arg, reps);
+    counts[n] = ( cycles() - startCycles ) / reps;
+    seconds[n] = ( now() - start ) / reps;
+    total += seconds[n] * reps;
+    n++;
+  }
+
+  qsort(seconds, n, sizeof(double), compareDoubles);
+  qsort(counts, n, sizeof(double), compareDoubles);
+
+  double median = percentile(seconds, n, 50);
+  double tail = percentile(seconds, n, 99);
+
+  printf("%s\n    {", printedResult ? "," : "");
+  printedResult = true;
+  printf("\"op\": \"%s\", ", info->op);
+  printString("backend", info->backend);
+  printString("mode", info->mode);
+  printf("\"bytes\": %zu, \"samples\": %d, \"runs_per_sample\": %zu, ", info->bytes, n, reps);
+  printf("\"median_ns\": %.2f, \"p99_ns\": %.2f, ", median * 1e9, tail * 1e9);
+  if (HAVE_CYCLES) {
+    printf("\"median_cycles_per_byte\": %.3f, \"p99_cycles_per_byte\": %.3f, ",
+           percentile(counts, n, 50) / info->bytes, percentile(counts, n, 99) / info->bytes);
+  }
+  else {
+    printf("\"median_cycles_per_byte\": null, \"p99_cycles_per_byte\": null, ");
+  }
+  printf("\"median_mb_per_s\": %.2f, \"p99_mb_per_s\": %.2f}",
+         info->bytes / median / MEGABYTE, info->bytes / tail / MEGABYTE);
+  fflush(stdout);
+
+  return median;
+}
+
+/**
+ * Reports whether a case of the given size is expected to take too long,
+ * judging by the speed of the previous size.
+ *
+ * @param info description of the case
+ * @param rate bytes per second measured for the previous size, or 0 if none
+ * @return true if the case should be skipped
+*/
+static bool tooSlow( BenchCase const *info, double rate )
+{
+  if (rate > 0 && info->bytes / rate > MAX_RUN_TIME) {
+    fprintf(stderr, "%-16s %-10s %-4s %12zu skipped\n", info->op, info->backend ? info->backend : "",
+            info->mode ? info->mode : "", info->bytes);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Multiplies a run of field elements.
+ *
+ * @param arg unused
+ * @param reps number of products
+*/
+static void benchFieldMul( void *arg, size_t reps )
+{
+  byte a = 0x57, b = 0x83, acc = 0;
+  for (size_t i = 0; i < reps; i++) {
+    acc ^= fieldMul(a, b);
+    a += 0x1D;
+    b ^= acc;
+  }
+  sink = acc;
+}
+
+/**
+ * Mixes the columns of a square over and over.
+ *
+ * @param arg unused
+ * @param reps number of times to mix
+*/
+static void benchMixColumns( void *arg, size_t reps )
+{
+  byte square[BLOCK_ROWS][BLOCK_COLS];
+  blockToSquare(square, benchKey);
+  for (size_t i = 0; i < reps; i++) {
+    mixColumns(square);
+  }
+  sink = square[0][0];
+}
+
+/**
+ * Runs the key schedule over and over.
+ *
+ * @param arg unused
+ * @param reps number of keys to expand
+*/
+static void benchGenerateSubkeys( void *arg, size_t reps )
+{
+  byte subkey[ROUNDS + 1][BLOCK_SIZE];
+  byte key[BLOCK_SIZE];
+  memcpy(key, benchKey, BLOCK_SIZE);
+  for (size_t i = 0; i < reps; i++) {
+    generateSubkeys(subkey, key);
+    key[0] ^= subkey[ROUNDS][0];
+  }
+  sink = key[0];
+}
+
+/**
+ * Encrypts one block at a time with encryptBlock(), which expands the key every time.
+ *
+ * @param arg unused
+ * @param reps number of blocks
+*/
+static void benchEncryptBlock( void *arg, size_t reps )
+{
+  byte data[BLOCK_SIZE] = { 0 };
+  byte key[BLOCK_SIZE];
+  memcpy(key, benchKey, BLOCK_SIZE);
+  for (size_t i = 0; i < reps; i++) {
+    encryptBlock(data, key);
+  }
+  sink = data[0];
+}
+
+/**
+ * Decrypts one block at a time with decryptBlock(), which expands the key every time.
+ *
+ * @param arg unused
+ * @param reps number of blocks
+*/
+static void benchDecryptBlock( void *arg, size_t reps )
+{
+  byte data[BLOCK_SIZE] = { 0 };
+  byte key[BLOCK_SIZE];
+  memcpy(key, benchKey, BLOCK_SIZE);
+  for (size_t i = 0; i < reps; i++) {
+    decryptBlock(data, key);
+  }
+  sink = data[0];
+}
+
+/** A buffer to multiply by a constant, or add into another, with one version of the operation. */
+typedef struct {
+  /** Version of fieldMulVec() to run, or NULL to loop over fieldMul(), or to add. */
+  void (*mul)( byte *dst, byte const *src, byte c, size_t len );
+
+  /** Version of fieldAddVec() to run, or NULL to multiply. */
+  void (*add)( byte *dst, byte const *src, size_t len );
+
+  /** The bytes to multiply or add. */
+  byte const *src;
+
+  /** Where the results go. */
+  byte *dst;
+
+  /** Number of bytes. */
+  size_t len;
+} VecJob;
+
+/**
+ * Multiplies a buffer by a constant, or adds it into another.
+ *
+ * @param arg the VecJob to run
+ * @param reps number of times to process the buffer
+*/
+static void benchVec( void *arg, size_t reps )
+{
+  VecJob *job = arg;
+  for (size_t i = 0; i < reps; i++) {
+    if (job->add) {
+      job->add(job->dst, job->src, job->len);
+    }
+    else if (job->mul) {
+      job->mul(job->dst, job->src, 0x8E, job->len);
+    }
+    else {
+      // What callers had to do before the buffer operations
+      for (size_t j = 0; j < job->len; j++) {
+        job->dst[j] = fieldMul(job->src[j], 0x8E);
+      }
+    }
+  }
+  sink = job->dst[0];
+}
+
+/** A buffer to encrypt or decrypt in memory with an expanded key. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** The buffer, processed in place. */
+  byte *data;
+
+  /** Number of blocks in the buffer. */
+  size_t nblocks;
+} BulkJob;
+
+/**
+ * Encrypts a buffer in memory.
+ *
+ * @param arg the BulkJob to run
+ * @param reps number of times to encrypt the buffer
+*/
+static void benchEncryptBlocks( void *arg, size_t reps )
+{
+  BulkJob *job = arg;
+  for (size_t i = 0; i < reps; i++) {
+    aesEncryptBlocks(job->ctx, job->data, job->data, job->nblocks);
+  }
+}
+
+/**
+ * Decrypts a buffer in memory.
+ *
+ * @param arg the BulkJob to run
+ * @param reps number of times to decrypt the buffer
+*/
+static void benchDecryptBlocks( void *arg, size_t reps )
+{
+  BulkJob *job = arg;
+  for (size_t i = 0; i < reps; i++) {
+    aesDecryptBlocks(job->ctx, job->data, job->data, job->nblocks);
+  }
+}
+
+/** Bytes of ciphertext the CBC-MAC takes through cbcEncrypt() at a time. */
+#define MAC_STEP 4096
+
+/** A buffer to encrypt and authenticate in memory. */
+typedef struct {
+  /** How to seal it. */
+  Seal seal;
+
+  /** Threads to spread the work across. */
+  ThreadPool *pool;
+
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** The expanded MAC key, for CTR+MAC. */
+  AesContext const *macKey;
+
+  /** Buffer encrypted in place. */
+  byte *data;
+
+  /** Number of bytes in the buffer, a multiple of BLOCK_SIZE. */
+  size_t len;
+} SealJob;
+
+/**
+ * Encrypts a buffer in place and computes its tag, starting a new stream each time.
+ *
+ * @param arg the SealJob to run
+ * @param reps number of times to seal the buffer
+*/
+static void benchSeal( void *arg, size_t reps )
+{
+  SealJob *job = arg;
+  byte tag[BLOCK_SIZE];
+
+  for (size_t i = 0; i < reps; i++) {
+    if (job->seal == SEAL_OCB) {
+      Ocb ocb;
+      ocbInit(&ocb, job->ctx, benchNonce);
+      ocbEncrypt(&ocb, job->pool, job->data, job->data, job->len);
+      ocbTag(&ocb, tag);
+    }
+    else if (job->seal == SEAL_GCM) {
+      Gcm gcm;
+      gcmInit(&gcm, job->ctx, benchNonce);
+      gcmEncrypt(&gcm, job->pool, job->data, job->data, job->len);
+      gcmTag(&gcm, tag);
+    }
+    else {
+      // The MAC chains through every block, so it runs on this thread
+      // while the CTR pass before it can use the pool
+      ctrCryptParallel(job->pool, job->ctx, benchNonce, 0, job->data, job->data, job->len);
+
+      byte scratch[MAC_STEP];
+      memset(tag, 0, BLOCK_SIZE);
+      for (size_t off = 0; off < job->len; off += MAC_STEP) {
+        size_t n = job->len - off < MAC_STEP ? job->len - off : MAC_STEP;
+        cbcEncrypt(job->macKey, tag, job->data + off, scratch, n);
+      }
+    }
+  }
+}
+
+/**
+ * Checks the tag of a buffer and decrypts it in place, the way the tools do
+ * before any plaintext is released, starting a new stream each time. The
+ * buffer isn't real ciphertext, so the tag never matches, but all the work
+ * is done anyway.
+ *
+ * @param arg the SealJob to run
+ * @param reps number of times to open the buffer
+*/
+static void benchOpen( void *arg, size_t reps )
+{
+  SealJob *job = arg;
+  byte tag[BLOCK_SIZE] = { 0 };
+
+  for (size_t i = 0; i < reps; i++) {
+    bool authentic;
+    if (job->seal == SEAL_OCB) {
+      // One pass, keeping the plaintext the checksum is made from
+      Ocb ocb;
+      ocbInit(&ocb, job->ctx, benchNonce);
+      ocbAuthenticate(&ocb, job->pool, job->data, job->data, job->len);
+      authentic = ocbCheckTag(&ocb, tag);
+    }
+    else if (job->seal == SEAL_GCM) {
+      Gcm gcm;
+      gcmInit(&gcm, job->ctx, benchNonce);
+      gcmAuthenticate(&gcm, job->pool, job->data, job->len);
+      gcmDecrypt(&gcm, job->pool, 0, job->data, job->data, job->len);
+      authentic = gcmCheckTag(&gcm, tag);
+    }
+    else {
+      byte mac[BLOCK_SIZE] = { 0 };
+      byte scratch[MAC_STEP];
+      for (size_t off = 0; off < job->len; off += MAC_STEP) {
+        size_t n = job->len - off < MAC_STEP ? job->len - off : MAC_STEP;
+        cbcEncrypt(job->macKey, mac, job->data + off, scratch, n);
+      }
+      authentic = memcmp(mac, tag, BLOCK_SIZE) == 0;
+      ctrCryptParallel(job->pool, job->ctx, benchNonce, 0, job->data, job->data, job->len);
+    }
+    sink = authentic;
+  }
+}
+
+/** A whole file to encrypt or decrypt, the same way the tools do. */
+typedef struct {
+  /** Mode of operation. */
+  Mode mode;
+
+  /** Threads to spread the work across. */
+  ThreadPool *pool;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+
+  /** Name of the file to read. */
+  char const *input;
+
+  /** Name of the file to write. */
+  char const *output;
+} FileJob;
+
+/**
+ * Encrypts or decrypts a whole file, including expanding the key.
+ *
+ * @param arg the FileJob to run
+ * @param reps number of times to process the file
+*/
+static void benchFile( void *arg, size_t reps )
+{
+  FileJob *job = arg;
+  for (size_t i = 0; i < reps; i++) {
+    // Start from a new output file, since truncating one that still has
+    // dirty pages makes some file systems flush them on close
+    remove(job->output);
+    FILE *in = openFile(job->input, "rb");
+    FILE *out = openFile(job->output, "wb");
+
+    Cipher cipher;
+    initCipher(&cipher, job->mode, benchKey, job->pool);
+    if (job->encrypt) {
+      encryptStream(&cipher, in, out);
+    }
+    else if (decryptStream(&cipher, in, out) != DECRYPT_OK) {
+      fprintf(stderr, "Benchmark ciphertext didn't decrypt\n");
+      exit(EXIT_FAILURE);
+    }
+
+    fclose(in);
+    fclose(out);
+  }
+}
+
+/**
+ * Writes a plaintext file of the given size.
+ *
+ * @param size number of bytes to write
+*/
+static void makePlainFile( uint64_t size )
+{
+  static byte pattern[1024 * 1024];
+  for (size_t i = 0; i < sizeof(pattern); i++) {
+    pattern[i] = i * 7 + ( i >> 11 );
+  }
+
+  FILE *fp = openFile(PLAIN_FILE, "wb");
+  while (size > 0) {
+    size_t n = size < sizeof(pattern) ? size : sizeof(pattern);
+    writeChunk(fp, pattern, n);
+    size -= n;
+  }
+  fclose(fp);
+}
+
+/**
+ * Measures the primitives that don't depend on the backend.
+*/
+static void benchPrimitives( void )
+{
+  BenchCase mul = { "fieldMul", NULL, NULL, 1 };
+  runCase(&mul, benchFieldMul, NULL);
+
+  BenchCase mix = { "mixColumns", NULL, NULL, BLOCK_SIZE };
+  runCase(&mix, benchMixColumns, NULL);
+
+  BenchCase keys = { "generateSubkeys", NULL, NULL, BLOCK_SIZE };
+  runCase(&keys, benchGenerateSubkeys, NULL);
+}
+
+/**
+ * Measures every version of the field buffer operations, including a plain
+ * loop over fieldMul() to compare them with, from MIN_SIZE up to MAX_BULK_SIZE.
+ * The version is reported as the backend.
+ *
+ * @param maxSize the largest size to measure
+*/
+static void benchVectors( uint64_t maxSize )
+{
+  size_t limit = maxSize < MAX_BULK_SIZE ? maxSize : MAX_BULK_SIZE;
+  byte *src = malloc(limit);
+  byte *dst = malloc(limit);
+  for (size_t i = 0; i < limit; i++) {
+    src[i] = i * 7 + ( i >> 11 );
+  }
+
+  VecJob versions[] = {
+    { NULL, NULL }, { fieldMulVecScalar, NULL }, { fieldMulVecSsse3, NULL },
+    { fieldMulVecAvx2, NULL }, { NULL, fieldAddVecScalar }, { NULL, fieldAddVecAvx2 } };
+  char const *names[] = { "loop", "scalar", "ssse3", "avx2", "scalar", "avx2" };
+  bool usable[] = { true, true, ssse3Supported(), avx2Supported(), true, avx2Supported() };
+  int count = sizeof(versions) / sizeof(versions[0]);
+
+  for (size_t size = MIN_SIZE; size != 0; size = nextSize(size, limit)) {
+    for (int v = 0; v < count; v++) {
+      if (usable[v]) {
+        VecJob job = versions[v];
+        job.src = src;
+        job.dst = dst;
+        job.len = size;
+
+        BenchCase info = { job.add ? "fieldAddVec" : "fieldMulVec", names[v], NULL, size };
+        runCase(&info, benchVec, &job);
+      }
+    }
+  }
+
+  free(src);
+  free(dst);
+}
+
+/**
+ * Measures the block functions with the given backend, from one block up to MAX_BULK_SIZE.
+ *
+ * @param backend the backend to measure
+ * @param maxSize the largest size to measure
+*/
+static void benchBlocks( AesBackend backend, uint64_t maxSize )
+{
+  char const *name = aesBackendName(backend);
+
+  BenchCase enc = { "encryptBlock", name, NULL, BLOCK_SIZE };
+  runCase(&enc, benchEncryptBlock, NULL);
+
+  BenchCase dec = { "decryptBlock", name, NULL, BLOCK_SIZE };
+  runCase(&dec, benchDecryptBlock, NULL);
+
+  AesContext ctx;
+  aesInit(&ctx, benchKey);
+  size_t limit = maxSize < MAX_BULK_SIZE ? maxSize : MAX_BULK_SIZE;
+  byte *data = calloc(limit, 1);
+  double encRate = 0, decRate = 0;
+
+  for (size_t size = MIN_SIZE; size != 0; size = nextSize(size, limit)) {
+    BulkJob job = { &ctx, data, size / BLOCK_SIZE };
+
+    BenchCase bulkEnc = { "encryptBlocks", name, NULL, size };
+    if (!tooSlow(&bulkEnc, encRate)) {
+      encRate = size / runCase(&bulkEnc, benchEncryptBlocks, &job);
+    }
+
+    BenchCase bulkDec = { "decryptBlocks", name, NULL, size };
+    if (!tooSlow(&bulkDec, decRate)) {
+      decRate = size / runCase(&bulkDec, benchDecryptBlocks, &job);
+    }
+  }
+
+  free(data);
+}
+
+/**
+ * Measures OCB against the two-pass ways of authenticating, GCM and CTR
+ * followed by a CBC-MAC, sealing and then opening a buffer in memory from
+ * MIN_SIZE up to MAX_BULK_SIZE with the current backend. The way of sealing is reported
+ * as the mode.
+ *
+ * @param backend the current backend
+ * @param pool threads to spread the work across
+ * @param maxSize the largest size to measure
+*/
+static void benchSeals( AesBackend backend, ThreadPool *pool, uint64_t maxSize )
+{
+  static byte const macKey[ BLOCK_SIZE ] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
+
+  AesContext ctx, mac;
+  aesInit(&ctx, benchKey);
+  aesInit(&mac, macKey);
+  size_t limit = maxSize < MAX_BULK_SIZE ? maxSize : MAX_BULK_SIZE;
+  byte *data = calloc(limit, 1);
+
+  for (size_t size = MIN_SIZE; size != 0; size = nextSize(size, limit)) {
+    for (int s = 0; s < SEAL_COUNT; s++) {
+      SealJob job = { s, pool, &ctx, &mac, data, size - size % BLOCK_SIZE };
+      BenchCase info = { "sealBuffer", aesBackendName(backend), sealNames[s], job.len };
+      runCase(&info, benchSeal, &job);
+
+      BenchCase open = { "openBuffer", aesBackendName(backend), sealNames[s], job.len };
+      runCase(&open, benchOpen, &job);
+    }
+  }
+
+  free(data);
+}
+
+/**
+ * Measures whole-file encryption and decryption of the plaintext file
+ * with every backend and mode.
+ *
+ * @param size size of the plaintext file
+ * @param pool threads to spread the work across
+ * @param encRates bytes per second of the previous size, by backend and mode, updated
+ * @param decRates the same, for decryption
+*/
+static void benchFiles( uint64_t size, ThreadPool *pool,
+                        double encRates[][ MODE_COUNT ], double decRates[][ MODE_COUNT ] )
+{
+  for (int b = 0; b < BACKEND_COUNT; b++) {
+    if (!aesSetBackend(b)) {
+      continue;
+    }
+
+    for (int m = 0; m < MODE_COUNT; m++) {
+      BenchCase enc = { "encryptFile", aesBackendName(b), modeNames[m], size };
+      BenchCase dec = { "decryptFile", aesBackendName(b), modeNames[m], size };
+
+      // Decryption needs the ciphertext the encryption case leaves behind
+      if (tooSlow(&enc, encRates[b][m])) {
+        continue;
+      }
+      FileJob encJob = { m, pool, true, PLAIN_FILE, CIPHER_FILE };
+      encRates[b][m] = size / runCase(&enc, benchFile, &encJob);
+
+      if (!tooSlow(&dec, decRates[b][m])) {
+        FileJob decJob = { m, pool, false, CIPHER_FILE, OUTPUT_FILE };
+        decRates[b][m] = size / runCase(&dec, benchFile, &decJob);
+      }
+    }
+  }
+}
+
+/**
+ * Entry point of program. An optional argument gives the size of the
+ * largest file to encrypt, in bytes.
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main( int argc, char const *argv[] )
+{
+  uint64_t maxSize = DEFAULT_MAX_SIZE;
+  if (argc > 1) {
+    maxSize = strtoull(argv[1], NULL, 10);
+  }
+
+  if (argc > 2 || maxSize < MIN_SIZE) {
+    fprintf(stderr, "usage: benchmark [max-bytes]\n");
+    return EXIT_FAILURE;
+  }
+
+  ThreadPool *pool = makePool(processorCount());
+  AesBackend best = aesBestBackend();
+
+  printf("{\n  \"threads\": %d,\n  \"best_backend\": \"%s\",\n", poolThreads(pool),
+         aesBackendName(best));
+  printf("  \"cycle_counter\": %s,\n  \"results\": [", HAVE_CYCLES ? "\"tsc\"" : "null");
+
+  benchPrimitives();
+  benchVectors(maxSize);
+
+  for (int b = 0; b < BACKEND_COUNT; b++) {
+    if (aesSetBackend(b)) {
+      benchBlocks(b, maxSize);
+    }
+  }
+
+  aesSetBackend(best);
+  benchSeals(best, pool, maxSize);
+
+  double encRates[BACKEND_COUNT][MODE_COUNT] = { { 0 } };
+  double decRates[BACKEND_COUNT][MODE_COUNT] = { { 0 } };
+
+  for (uint64_t size = MIN_SIZE; size != 0; size = nextSize(size, maxSize)) {
+    makePlainFile(size);
+    benchFiles(size, pool, encRates, decRates);
+  }
+
+  printf("\n  ]\n}\n");
+
+  remove(PLAIN_FILE);
+  remove(CIPHER_FILE);
+  remove(OUTPUT_FILE);
+  freePool(pool);
+
+  return EXIT_SUCCESS;
+}
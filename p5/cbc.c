@@ -0,0 +1,117 @@
+/**
+ * @file cbc.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Cipher block chaining mode. Encryption is a chain, but decryption only
+ * needs each ciphertext block and the one before it, which are all in the
+ * input. So the blocks are decrypted together in batches, letting the
+ * backend interleave them, and slices of the input go to different threads.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cbc.h"
+#include "io.h"
+
+/** Number of blocks handed to the AES backend at once when decrypting. */
+#define BATCH_BLOCKS 64
+
+/** Size of each slice handed to a thread, in bytes. A multiple of BLOCK_SIZE. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+void makeCbcIv( byte iv[ CBC_IV_SIZE ] )
+{
+  randomBytes(iv, CBC_IV_SIZE);
+}
+
+void cbcEncrypt( AesContext const *ctx, byte chain[ BLOCK_SIZE ],
+                 byte const *in, byte *out, size_t len )
+{
+  for (size_t off = 0; off < len; off += BLOCK_SIZE) {
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+      chain[i] ^= in[off + i];
+    }
+    aesEncryptBlocks(ctx, chain, chain, 1);
+    memcpy(out + off, chain, BLOCK_SIZE);
+  }
+}
+
+void cbcDecrypt( AesContext const *ctx, byte const chain[ BLOCK_SIZE ],
+                 byte const *in, byte *out, size_t len )
+{
+  // The ciphertext is copied a batch at a time, since decrypting in
+  // place would overwrite the blocks the chaining still needs
+  byte saved[BATCH_BLOCKS * BLOCK_SIZE];
+  byte prev[BLOCK_SIZE];
+  memcpy(prev, chain, BLOCK_SIZE);
+
+  for (size_t off = 0; off < len; off += BATCH_BLOCKS * BLOCK_SIZE) {
+    size_t n = len - off < sizeof(saved) ? len - off : sizeof(saved);
+    memcpy(saved, in + off, n);
+    aesDecryptBlocks(ctx, saved, out + off, n / BLOCK_SIZE);
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+      out[off + i] ^= prev[i];
+    }
+    for (size_t i = BLOCK_SIZE; i < n; i++) {
+      out[off + i] ^= saved[i - BLOCK_SIZE];
+    }
+
+    memcpy(prev, saved + n - BLOCK_SIZE, BLOCK_SIZE);
+  }
+}
+
+/** Everything a thread needs to process its slices of a CBC job. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** Ciphertext block before each slice, saved before any thread starts. */
+  byte (*chains)[ BLOCK_SIZE ];
+
+  /** Blocks to decrypt. */
+  byte const *in;
+
+  /** Where to store the results. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+} CbcJob;
+
+/**
+ * Decrypts one slice of a CBC job.
+ * 
+ * @param arg the CbcJob being worked on
+ * @param index number of the slice to process
+*/
+static void cbcSlice( void *arg, size_t index )
+{
+  CbcJob *job = arg;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+
+  cbcDecrypt(job->ctx, job->chains[index], job->in + start, job->out + start, len);
+}
+
+void cbcDecryptParallel( ThreadPool *pool, AesContext const *ctx, byte chain[ BLOCK_SIZE ],
+                         byte const *in, byte *out, size_t len )
+{
+  if (len == 0) {
+    return;
+  }
+
+  // When decrypting in place, a slice's last block is gone by the time
+  // the next slice might need it, so every chain is copied up front
+  size_t nslices = (len + SLICE_SIZE - 1) / SLICE_SIZE;
+  CbcJob job = { ctx, malloc(nslices * BLOCK_SIZE), in, out, len };
+  memcpy(job.chains[0], chain, BLOCK_SIZE);
+  for (size_t i = 1; i < nslices; i++) {
+    memcpy(job.chains[i], in + i * SLICE_SIZE - BLOCK_SIZE, BLOCK_SIZE);
+  }
+  memcpy(chain, in + len - BLOCK_SIZE, BLOCK_SIZE);
+
+  runPool(pool, cbcSlice, &job, nslices);
+  free(job.chains);
+}
@@ -0,0 +1,70 @@
+/**
+ * @file cbc.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for cipher block chaining (CBC) mode, where each
+ * plaintext block is XORed with the previous ciphertext block, or with
+ * a random IV for the first block, before it's encrypted.
+ */
+
+#ifndef _CBC_H_
+#define _CBC_H_
+
+#include <stddef.h>
+#include "aes.h"
+#include "pool.h"
+
+/** Number of bytes in the IV header at the start of a CBC file. */
+#define CBC_IV_SIZE BLOCK_SIZE
+
+/**
+ * Fills in a new random IV.
+ * 
+ * @param iv the IV to fill
+*/
+void makeCbcIv( byte iv[ CBC_IV_SIZE ] );
+
+/**
+ * Encrypts part of a stream. Every block depends on the one before it,
+ * so this always runs one block at a time on the calling thread.
+ * 
+ * @param ctx the expanded key
+ * @param chain the last ciphertext block so far, or the IV at the start of
+ *              the stream; updated to the last block encrypted
+ * @param in the blocks to encrypt
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to encrypt, a multiple of BLOCK_SIZE
+*/
+void cbcEncrypt( AesContext const *ctx, byte chain[ BLOCK_SIZE ],
+                 byte const *in, byte *out, size_t len );
+
+/**
+ * Decrypts part of a stream. Every ciphertext block is already known, so
+ * the blocks are decrypted in batches and the chaining is undone afterward.
+ * 
+ * @param ctx the expanded key
+ * @param chain the ciphertext block before in[ 0 ], or the IV at the start of the stream
+ * @param in the blocks to decrypt
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to decrypt, a multiple of BLOCK_SIZE
+*/
+void cbcDecrypt( AesContext const *ctx, byte const chain[ BLOCK_SIZE ],
+                 byte const *in, byte *out, size_t len );
+
+/**
+ * Like cbcDecrypt(), but splits the work into large slices that run in
+ * parallel on the given pool, each starting from the last ciphertext block
+ * of the slice before it.
+ * 
+ * @param pool the pool to run on
+ * @param ctx the expanded key
+ * @param chain the ciphertext block before in[ 0 ], or the IV at the start of
+ *              the stream; updated to the last block of the input
+ * @param in the blocks to decrypt
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to decrypt, a multiple of BLOCK_SIZE
+*/
+void cbcDecryptParallel( ThreadPool *pool, AesContext const *ctx, byte chain[ BLOCK_SIZE ],
+                         byte const *in, byte *out, size_t len );
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file checksum.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Main component of the checksum program. Prints the Davies-Meyer checksum
+ * of each file, followed by its name, in the same form as encrypt --checksum,
+ * so a file can be checked against the checksum taken when it was encrypted.
+ * With no files, or a file named -, standard input is read.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "io.h"
+#include "aes.h"
+#include "dmHash.h"
+#include "pool.h"
+#include "stream.h"
+#include "options.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: checksum [-j <threads>] [--backend=<name>] [file...]"
+
+/** Prefix of the option that selects a backend */
+#define BACKEND_OPTION "--backend="
+
+/** Name that stands for standard input */
+#define STDIN_NAME "-"
+
+/**
+ * Prints the checksum of one file, reading it a chunk at a time.
+ *
+ * @param name name of the file, or STDIN_NAME
+ * @param pool threads to spread the work across
+ * @param data room for one chunk
+ * @param size number of bytes in a chunk
+*/
+static void checksumFile( char const *name, ThreadPool *pool, byte *data, size_t size )
+{
+  bool isStdin = strcmp(name, STDIN_NAME) == 0;
+  FILE *fp = isStdin ? stdin : openFile(name, "rb");
+
+  DmHash hash;
+  dmHashInit(&hash);
+
+  size_t n;
+  do {
+    n = readChunk(fp, data, size);
+    dmHashUpdate(&hash, pool, data, n);
+  } while (n == size);
+
+  if (!isStdin) {
+    fclose(fp);
+  }
+
+  byte digest[DM_HASH_SIZE];
+  dmHashFinish(&hash, digest);
+  printDigest(stdout, digest);
+  printf("  %s\n", name);
+}
+
+/**
+ * Starts the program
+ *
+ * @param argc number of command-line arguments
+ * @param argv list of command-line arguments
+ * @return program's exit status
+*/
+int main( int argc, char const *argv[] )
+{
+  int threads = processorCount();
+  char const **files = malloc(argc * sizeof(char const *));
+  int nfiles = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = parseThreads(argv[++i]);
+    }
+    else if (strncmp(argv[i], BACKEND_OPTION, strlen(BACKEND_OPTION)) == 0) {
+      selectAesBackend(argv[i] + strlen(BACKEND_OPTION));
+    }
+    else if (argv[i][0] == '-' && strcmp(argv[i], STDIN_NAME) != 0) {
+      usageError(USAGE);
+    }
+    else {
+      files[nfiles++] = argv[i];
+    }
+  }
+
+  if (nfiles == 0) {
+    files[nfiles++] = STDIN_NAME;
+  }
+
+  ThreadPool *pool = makePool(threads);
+  size_t size = (size_t) CHUNK_SIZE * threads;
+  byte *data = malloc(size);
+
+  for (int i = 0; i < nfiles; i++) {
+    checksumFile(files[i], pool, data, size);
+  }
+
+  free(data);
+  freePool(pool);
+  free(files);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file cipher.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Applies a mode of operation to a stream, one chunk at a time,
+ * keeping track of where each chunk falls within the stream.
+ */
+
+#include <string.h>
+
+#include "cipher.h"
+#include "ecb.h"
+#include "cbc.h"
+
+/** Size of each slice handed to a thread by transcryptChunk(), in bytes. */
+#define TRANSCRYPT_SLICE ( 256 * 1024 )
+
+/** Bytes each thread takes through both ciphers at a time, small enough to stay in L1. */
+#define TRANSCRYPT_STEP 4096
+
+void initCipher( Cipher *cipher, Mode mode, byte const *key, ThreadPool *pool )
+{
+  cipher->mode = mode;
+  aesInit(&cipher->ctx, key);
+  cipher->pool = pool;
+  cipher->kernel = NULL;
+  cipher->position = 0;
+  cipher->checksum = NULL;
+
+  // The tweak key follows the data key
+  if (mode == MODE_XTS) {
+    xtsInit(&cipher->xts, &cipher->ctx, key + BLOCK_SIZE, XTS_SECTOR_SIZE);
+  }
+}
+
+void initCipherExpanded( Cipher *cipher, Mode mode, AesContext const *ctx, ThreadPool *pool )
+{
+  cipher->mode = mode;
+  cipher->ctx = *ctx;
+  cipher->pool = pool;
+  cipher->kernel = NULL;
+  cipher->position = 0;
+  cipher->checksum = NULL;
+}
+
+bool useKernel( Cipher *cipher )
+{
+  if (cipher->mode != MODE_ECB && cipher->mode != MODE_CTR) {
+    return false;
+  }
+
+  // The first subkey is the key itself
+  cipher->kernel = makeKernelAes(cipher->mode == MODE_CTR, cipher->ctx.subkey[0]);
+  return cipher->kernel != NULL;
+}
+
+void releaseCipher( Cipher *cipher )
+{
+  if (cipher->kernel) {
+    freeKernelAes(cipher->kernel);
+    cipher->kernel = NULL;
+  }
+}
+
+void setSectorSize( Cipher *cipher, size_t sectorSize )
+{
+  if (cipher->mode == MODE_XTS) {
+    cipher->xts.sectorSize = sectorSize;
+  }
+}
+
+size_t keySize( Mode mode )
+{
+  return mode == MODE_XTS ? XTS_KEY_SIZE : BLOCK_SIZE;
+}
+
+size_t headerSize( Mode mode )
+{
+  switch (mode) {
+  case MODE_CTR:
+    return NONCE_SIZE;
+  case MODE_GCM:
+    return GCM_IV_SIZE;
+  case MODE_CBC:
+    return CBC_IV_SIZE;
+  case MODE_OCB:
+    return OCB_NONCE_SIZE;
+  default:
+    return 0;
+  }
+}
+
+bool modePadded( Mode mode )
+{
+  return mode == MODE_ECB || mode == MODE_CBC;
+}
+
+size_t trailerSize( Mode mode )
+{
+  switch (mode) {
+  case MODE_GCM:
+    return GCM_TAG_SIZE;
+  case MODE_OCB:
+    return OCB_TAG_SIZE;
+  default:
+    return 0;
+  }
+}
+
+void makeHeader( Cipher *cipher, byte *header )
+{
+  if (cipher->mode == MODE_CTR) {
+    makeNonce(header);
+  }
+  else if (cipher->mode == MODE_GCM) {
+    makeIv(header);
+  }
+  else if (cipher->mode == MODE_CBC) {
+    makeCbcIv(header);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    makeOcbNonce(header);
+  }
+
+  readHeader(cipher, header);
+}
+
+void readHeader( Cipher *cipher, byte const *header )
+{
+  if (cipher->mode == MODE_CTR) {
+    memcpy(cipher->nonce, header, NONCE_SIZE);
+  }
+  else if (cipher->mode == MODE_GCM) {
+    gcmInit(&cipher->gcm, &cipher->ctx, header);
+  }
+  else if (cipher->mode == MODE_CBC) {
+    memcpy(cipher->chain, header, CBC_IV_SIZE);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    ocbInit(&cipher->ocb, &cipher->ctx, header);
+  }
+}
+
+void encryptChunk( Cipher *cipher, byte const *in, byte *out, size_t len )
+{
+  if (cipher->kernel) {
+    kernelCrypt(cipher->kernel, true, cipher->nonce, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_CTR) {
+    ctrCryptParallel(cipher->pool, &cipher->ctx, cipher->nonce, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_GCM) {
+    gcmEncrypt(&cipher->gcm, cipher->pool, in, out, len);
+  }
+  else if (cipher->mode == MODE_CBC) {
+    // Each block needs the one before it, so this stays on one thread
+    cbcEncrypt(&cipher->ctx, cipher->chain, in, out, len);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    ocbEncrypt(&cipher->ocb, cipher->pool, in, out, len);
+  }
+  else if (cipher->mode == MODE_XTS) {
+    xtsEncrypt(&cipher->xts, cipher->pool, cipher->position, in, out, len);
+  }
+  else {
+    ecbEncryptParallel(cipher->pool, &cipher->ctx, in, out, len);
+  }
+
+  cipher->position += len;
+}
+
+void checksumChunk( Cipher *cipher, byte const *data, size_t len )
+{
+  if (cipher->checksum) {
+    dmHashUpdate(cipher->checksum, cipher->pool, data, len);
+  }
+}
+
+void authenticateChunk( Cipher *cipher, byte const *in, size_t len )
+{
+  if (cipher->mode == MODE_GCM) {
+    gcmAuthenticate(&cipher->gcm, cipher->pool, in, len);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    ocbAuthenticate(&cipher->ocb, cipher->pool, in, NULL, len);
+  }
+}
+
+void decryptChunk( Cipher *cipher, byte const *in, byte *out, size_t len )
+{
+  if (cipher->kernel) {
+    kernelCrypt(cipher->kernel, false, cipher->nonce, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_CTR) {
+    ctrCryptParallel(cipher->pool, &cipher->ctx, cipher->nonce, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_GCM) {
+    gcmDecrypt(&cipher->gcm, cipher->pool, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_CBC) {
+    cbcDecryptParallel(cipher->pool, &cipher->ctx, cipher->chain, in, out, len);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    ocbDecrypt(&cipher->ocb, cipher->pool, cipher->position, in, out, len);
+  }
+  else if (cipher->mode == MODE_XTS) {
+    xtsDecrypt(&cipher->xts, cipher->pool, cipher->position, in, out, len);
+  }
+  else {
+    ecbDecryptParallel(cipher->pool, &cipher->ctx, in, out, len);
+  }
+
+  cipher->position += len;
+}
+
+void openChunk( Cipher *cipher, byte const *in, byte *out, size_t len )
+{
+  if (cipher->mode == MODE_OCB) {
+    ocbAuthenticate(&cipher->ocb, cipher->pool, in, out, len);
+    cipher->position += len;
+  }
+  else {
+    authenticateChunk(cipher, in, len);
+    decryptChunk(cipher, in, out, len);
+  }
+}
+
+/** Everything a thread needs to process its slices of a fused transcrypt. */
+typedef struct {
+  /** The stream being decrypted. */
+  Cipher const *from;
+
+  /** The stream being encrypted. */
+  Cipher const *to;
+
+  /** The chunk, processed in place. */
+  byte *data;
+
+  /** Total number of bytes to process. */
+  size_t len;
+} TranscryptJob;
+
+/**
+ * Processes one slice of a fused transcrypt, one step at a time.
+ * 
+ * @param arg the TranscryptJob being worked on
+ * @param index number of the slice to process
+*/
+static void transcryptSlice( void *arg, size_t index )
+{
+  TranscryptJob *job = arg;
+  Cipher const *from = job->from;
+  Cipher const *to = job->to;
+  size_t start = index * TRANSCRYPT_SLICE;
+  size_t end = job->len - start < TRANSCRYPT_SLICE ? job->len : start + TRANSCRYPT_SLICE;
+
+  for (size_t off = start; off < end; off += TRANSCRYPT_STEP) {
+    size_t len = end - off < TRANSCRYPT_STEP ? end - off : TRANSCRYPT_STEP;
+    byte *piece = job->data + off;
+
+    if (from->mode == MODE_CTR) {
+      ctrCrypt(&from->ctx, from->nonce, from->position + off, piece, piece, len);
+      ctrCrypt(&to->ctx, to->nonce, to->position + off, piece, piece, len);
+    }
+    else {
+      aesDecryptBlocks(&from->ctx, piece, piece, len / BLOCK_SIZE);
+      aesEncryptBlocks(&to->ctx, piece, piece, len / BLOCK_SIZE);
+    }
+  }
+}
+
+void transcryptChunk( Cipher *from, Cipher *to, byte *data, size_t len )
+{
+  if ((from->mode == MODE_ECB || from->mode == MODE_CTR) && !from->kernel && !to->kernel) {
+    TranscryptJob job = { from, to, data, len };
+    runPool(from->pool, transcryptSlice, &job, (len + TRANSCRYPT_SLICE - 1) / TRANSCRYPT_SLICE);
+    from->position += len;
+    to->position += len;
+  }
+  else {
+    // CBC encryption and the GCM hash both run in order, and the kernel
+    // takes whole requests, so there's nothing to fuse
+    decryptChunk(from, data, data, len);
+    encryptChunk(to, data, data, len);
+  }
+}
+
+void makeTrailer( Cipher *cipher, byte *trailer )
+{
+  if (cipher->mode == MODE_GCM) {
+    gcmTag(&cipher->gcm, trailer);
+  }
+  else if (cipher->mode == MODE_OCB) {
+    ocbTag(&cipher->ocb, trailer);
+  }
+}
+
+bool checkTrailer( Cipher const *cipher, byte const *trailer )
+{
+  if (cipher->mode == MODE_GCM) {
+    return gcmCheckTag(&cipher->gcm, trailer);
+  }
+  if (cipher->mode == MODE_OCB) {
+    return ocbCheckTag(&cipher->ocb, trailer);
+  }
+
+  return true;
+}
@@ -0,0 +1,294 @@
+/**
+ * @file cipher.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting or decrypting a stream of data
+ * one chunk at a time, in any of the supported modes of operation
+ */
+
+#ifndef _CIPHER_H_
+#define _CIPHER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aes.h"
+#include "ctr.h"
+#include "gcm.h"
+#include "ocb.h"
+#include "xts.h"
+#include "dmHash.h"
+#include "kernelAes.h"
+#include "pool.h"
+
+/** Largest key any mode takes. */
+#define MAX_KEY_SIZE XTS_KEY_SIZE
+
+/** Largest header any mode writes before the ciphertext. */
+#define MAX_HEADER_SIZE NONCE_SIZE
+
+/** Largest trailer any mode writes after the ciphertext. */
+#define MAX_TRAILER_SIZE GCM_TAG_SIZE
+
+/** Block cipher modes of operation. */
+typedef enum {
+  /** Each block encrypted on its own, with zero padding at the end. */
+  MODE_ECB,
+  /** Counter mode, with a nonce header and no padding. */
+  MODE_CTR,
+  /** Galois/Counter Mode, with an IV header and an authentication tag at the end. */
+  MODE_GCM,
+  /** Cipher block chaining, with an IV header and zero padding at the end. */
+  MODE_CBC,
+  /** Offset codebook mode, with a nonce header and an authentication tag at the end. */
+  MODE_OCB,
+  /** XTS, sector by sector with a tweak key, with no header, padding or trailer. */
+  MODE_XTS,
+  /** Number of modes, not a mode itself. */
+  MODE_COUNT
+} Mode;
+
+/** Outcomes of decrypting a file. */
+typedef enum {
+  /** The file was decrypted. */
+  DECRYPT_OK,
+  /** The file can't be valid ciphertext because of its length. */
+  DECRYPT_BAD_LENGTH,
+  /** The authentication tag didn't match, so nothing was decrypted. */
+  DECRYPT_BAD_TAG,
+  /** The file isn't laid out the way its format requires. */
+  DECRYPT_BAD_FORMAT
+} DecryptResult;
+
+/** State of one stream being encrypted or decrypted. */
+typedef struct {
+  /** Mode of operation. */
+  Mode mode;
+
+  /** The expanded key. */
+  AesContext ctx;
+
+  /** Initial counter block, for CTR mode. */
+  byte nonce[ NONCE_SIZE ];
+
+  /** Counter and hash state, for GCM mode. */
+  Gcm gcm;
+
+  /** Offsets and checksum, for OCB mode. */
+  Ocb ocb;
+
+  /** Tweak key and sector size, for XTS mode. */
+  Xts xts;
+
+  /** Last ciphertext block so far, or the IV at the start, for CBC mode. */
+  byte chain[ BLOCK_SIZE ];
+
+  /** Threads to spread the work across. */
+  ThreadPool *pool;
+
+  /** The key loaded into the kernel, if the kernel does the work, or NULL. */
+  KernelAes *kernel;
+
+  /** Number of bytes processed so far. */
+  uint64_t position;
+
+  /** Checksum of the plaintext, or NULL if none is being kept. */
+  DmHash *checksum;
+} Cipher;
+
+/**
+ * Sets up a cipher for a new stream. Before the first chunk is processed,
+ * makeHeader() or readHeader() must be called to start the stream.
+ * 
+ * @param cipher the cipher to set up
+ * @param mode the mode of operation
+ * @param key the keySize() bytes of the key
+ * @param pool threads to spread the work across
+*/
+void initCipher( Cipher *cipher, Mode mode, byte const *key, ThreadPool *pool );
+
+/**
+ * Sets up a cipher for a new stream with a key that has already been
+ * expanded, so a key shared by many streams only has to be expanded once.
+ * This can't be used in XTS mode, which has a second key.
+ * 
+ * @param cipher the cipher to set up
+ * @param mode the mode of operation
+ * @param ctx the expanded key, which is copied
+ * @param pool threads to spread the work across
+*/
+void initCipherExpanded( Cipher *cipher, Mode mode, AesContext const *ctx, ThreadPool *pool );
+
+/**
+ * Hands the work of an ECB or CTR cipher to the kernel's crypto API, which
+ * runs each chunk on the calling thread instead of the pool.
+ * 
+ * @param cipher the cipher, just after it was set up
+ * @return true if the kernel took the key, false if it can't do this mode here
+*/
+bool useKernel( Cipher *cipher );
+
+/**
+ * Releases anything the cipher holds besides its own memory, such as a key
+ * loaded into the kernel.
+ * 
+ * @param cipher the cipher to release
+*/
+void releaseCipher( Cipher *cipher );
+
+/**
+ * Sets the number of bytes in each sector of an XTS image, which must be
+ * a multiple of BLOCK_SIZE. Does nothing in other modes.
+ * 
+ * @param cipher the cipher, just after it was set up
+ * @param sectorSize number of bytes in each sector
+*/
+void setSectorSize( Cipher *cipher, size_t sectorSize );
+
+/**
+ * Returns the number of bytes in a key for the given mode.
+ * 
+ * @param mode the mode of operation
+ * @return size of the key, in bytes
+*/
+size_t keySize( Mode mode );
+
+/**
+ * Returns the number of header bytes written before the ciphertext in the given mode.
+ * 
+ * @param mode the mode of operation
+ * @return size of the header, in bytes
+*/
+size_t headerSize( Mode mode );
+
+/**
+ * Reports whether the given mode pads the plaintext with zeros to a whole
+ * number of blocks. Decryption trims trailing zeros off again, so the
+ * ciphertext of these modes must be a multiple of BLOCK_SIZE.
+ * 
+ * @param mode the mode of operation
+ * @return true if the mode works on whole blocks only
+*/
+bool modePadded( Mode mode );
+
+/**
+ * Returns the number of trailer bytes written after the ciphertext in the given mode.
+ * Only modes with a trailer authenticate the ciphertext.
+ * 
+ * @param mode the mode of operation
+ * @return size of the trailer, in bytes
+*/
+size_t trailerSize( Mode mode );
+
+/**
+ * Starts a stream to encrypt, choosing a new random nonce or IV
+ * if the mode needs one and filling in the header that holds it.
+ * 
+ * @param cipher the state of the stream
+ * @param header filled in with headerSize() bytes of header
+*/
+void makeHeader( Cipher *cipher, byte *header );
+
+/**
+ * Starts a stream to decrypt, using the nonce or IV from its header.
+ * 
+ * @param cipher the state of the stream
+ * @param header the headerSize() bytes at the start of the ciphertext
+*/
+void readHeader( Cipher *cipher, byte const *header );
+
+/**
+ * Encrypts the next chunk of the stream. Every chunk but the last must be
+ * a multiple of BLOCK_SIZE, or of the sector size in XTS mode, and in padded
+ * modes the last one must be padded to a multiple of BLOCK_SIZE as well.
+ * 
+ * @param cipher the state of the stream
+ * @param in the chunk to encrypt
+ * @param out where to store the result, which may be the same as in
+ * @param len number of bytes in the chunk
+*/
+void encryptChunk( Cipher *cipher, byte const *in, byte *out, size_t len );
+
+/**
+ * Adds plaintext to the cipher's checksum, if it's keeping one. The callers
+ * of encryptChunk() pass each chunk here first, leaving out any padding,
+ * so the checksum covers exactly the bytes of the input file.
+ * 
+ * @param cipher the state of the stream
+ * @param data the plaintext
+ * @param len number of bytes of plaintext
+*/
+void checksumChunk( Cipher *cipher, byte const *data, size_t len );
+
+/**
+ * Adds the next chunk of ciphertext to its authentication, without
+ * decrypting it, with the same restrictions on its length as encryptChunk().
+ * Does nothing in modes without a trailer.
+ * 
+ * @param cipher the state of the stream
+ * @param in the chunk of ciphertext
+ * @param len number of bytes in the chunk
+*/
+void authenticateChunk( Cipher *cipher, byte const *in, size_t len );
+
+/**
+ * Decrypts the next chunk of the stream, with the same restrictions
+ * on its length as encryptChunk(). In modes with a trailer, this doesn't
+ * authenticate anything, so it should only be used after the whole ciphertext
+ * has gone through authenticateChunk() and checkTrailer().
+ * 
+ * @param cipher the state of the stream
+ * @param in the chunk to decrypt
+ * @param out where to store the result, which may be the same as in
+ * @param len number of bytes in the chunk
+*/
+void decryptChunk( Cipher *cipher, byte const *in, byte *out, size_t len );
+
+/**
+ * Adds the next chunk of ciphertext to its authentication and decrypts it,
+ * like authenticateChunk() then decryptChunk(). In OCB mode both come from
+ * one pass of the block cipher, since the checksum is over the plaintext.
+ * The plaintext mustn't be released until checkTrailer() has passed.
+ * 
+ * @param cipher the state of the stream
+ * @param in the chunk of ciphertext
+ * @param out where to store the plaintext, which may be the same as in
+ * @param len number of bytes in the chunk
+*/
+void openChunk( Cipher *cipher, byte const *in, byte *out, size_t len );
+
+/**
+ * Decrypts the next chunk of one stream and encrypts it as the next chunk of
+ * another, in place, so the plaintext only ever exists in memory. Both ciphers
+ * must use the same mode. In ECB and CTR mode, unless the kernel does the work,
+ * each thread takes both ciphers through a small piece of its slice at a time
+ * while the piece is still in cache; otherwise decryptChunk() and then
+ * encryptChunk() run on the whole chunk. The same restrictions on len apply as for encryptChunk(), and
+ * in modes with a trailer, from must already have been authenticated.
+ * 
+ * @param from the state of the stream being decrypted
+ * @param to the state of the stream being encrypted
+ * @param data the chunk, replaced by its new ciphertext
+ * @param len number of bytes in the chunk
+*/
+void transcryptChunk( Cipher *from, Cipher *to, byte *data, size_t len );
+
+/**
+ * Finishes a stream that was encrypted, filling in the trailer that goes after
+ * the ciphertext. Does nothing in modes without a trailer.
+ * 
+ * @param cipher the state of the stream
+ * @param trailer filled in with trailerSize() bytes of trailer
+*/
+void makeTrailer( Cipher *cipher, byte *trailer );
+
+/**
+ * Checks the trailer of a stream whose ciphertext has all gone through
+ * authenticateChunk(). Always succeeds in modes without a trailer.
+ * 
+ * @param cipher the state of the stream
+ * @param trailer the trailerSize() bytes at the end of the ciphertext
+ * @return true if the ciphertext is authentic
+*/
+bool checkTrailer( Cipher const *cipher, byte const *trailer );
+
+#endif
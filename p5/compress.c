@@ -0,0 +1,653 @@
+/**
+ * @file compress.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * The compressed stream, wrapped in stdio streams with fopencookie(). Each
+ * frame starts with a type byte, then its size before and after compression,
+ * four bytes each and big-endian, then its data. The end marker is a lone
+ * type byte. It isn't zero, so stripping the zero padding of ECB and CBC
+ * mode can't eat into the stream.
+ *
+ * The compressor works a batch of frames at a time, one per thread, and
+ * packs them into one buffer that reads are served from. The expander keeps
+ * what's been written until it holds whole frames, then expands them up to
+ * a batch at a time and writes them out in order.
+ *
+ * The format header is the magic, a version byte, a flags byte, then zeros.
+ * Ciphertext without one can only be told apart by reading its first bytes,
+ * so they're handed back to be read again, by rewinding a regular file or
+ * through another stream for a pipe.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "compress.h"
+#include "lz.h"
+#include "io.h"
+
+/** Number of bytes of the magic at the start of the stream header. */
+#define MAGIC_SIZE 4
+
+/** Number of bytes of the magic at the start of the format header. */
+#define FORMAT_MAGIC_SIZE 8
+
+/** Number of bytes in a frame size or data size. */
+#define SIZE_BYTES 4
+
+/** Number of bytes before the data of a frame: the type, then the two sizes. */
+#define FRAME_HEADER_SIZE ( 1 + 2 * SIZE_BYTES )
+
+/** Most bytes a frame of COMPRESS_FRAME_SIZE can take up, when it's stored as it is. */
+#define SLOT_SIZE ( FRAME_HEADER_SIZE + COMPRESS_FRAME_SIZE )
+
+/** Type of a frame compressed with lz.h. */
+#define FRAME_LZ 'Z'
+
+/** Type of a frame stored as it is, because it wouldn't shrink. */
+#define FRAME_RAW 'R'
+
+/** Type byte that marks the end of the stream. */
+#define FRAME_END 'E'
+
+/**
+ * Stores a size big-endian in SIZE_BYTES bytes.
+ *
+ * @param p where to store it
+ * @param size the size to store
+*/
+static void putSize( byte *p, size_t size )
+{
+  for (int i = 0; i < SIZE_BYTES; i++) {
+    p[i] = size >> ( ( SIZE_BYTES - 1 - i ) * BBITS );
+  }
+}
+
+/**
+ * Reads a size stored by putSize().
+ *
+ * @param p where to read it from
+ * @return the size
+*/
+static size_t getSize( byte const *p )
+{
+  size_t size = 0;
+  for (int i = 0; i < SIZE_BYTES; i++) {
+    size = ( size << BBITS ) | p[i];
+  }
+  return size;
+}
+
+/** State of a stream opened by openCompressor(). */
+typedef struct {
+  /** The plaintext. */
+  FILE *in;
+
+  /** The pool to compress on. */
+  ThreadPool *pool;
+
+  /** Checksum of the plaintext, or NULL. */
+  DmHash *checksum;
+
+  /** Number of frames in a batch. */
+  size_t frames;
+
+  /** Plaintext of the current batch. */
+  byte *raw;
+
+  /** Number of bytes in raw. */
+  size_t rawLen;
+
+  /** The stream header, then a slot for each frame of the batch and the end marker. */
+  byte *packed;
+
+  /** Number of bytes each frame of the batch took up in its slot. */
+  size_t *lens;
+
+  /** Number of bytes of packed ready to be read. */
+  size_t len;
+
+  /** Number of bytes of packed already read. */
+  size_t pos;
+
+  /** True once the stream header has been read. */
+  bool started;
+
+  /** True once the last batch has been packed. */
+  bool ended;
+} Compressor;
+
+/**
+ * Compresses one frame of the current batch into its slot.
+ *
+ * @param arg the Compressor
+ * @param index number of the frame in the batch
+*/
+static void packFrame( void *arg, size_t index )
+{
+  Compressor *c = arg;
+  byte const *raw = c->raw + index * COMPRESS_FRAME_SIZE;
+  size_t rawLen = c->rawLen - index * COMPRESS_FRAME_SIZE;
+  if (rawLen > COMPRESS_FRAME_SIZE) {
+    rawLen = COMPRESS_FRAME_SIZE;
+  }
+  byte *slot = c->packed + COMPRESS_HEADER_SIZE + index * SLOT_SIZE;
+
+  // Only keep the compressed frame if it's smaller
+  size_t stored = lzCompress(raw, rawLen, slot + FRAME_HEADER_SIZE, rawLen - 1);
+  if (stored == 0) {
+    memcpy(slot + FRAME_HEADER_SIZE, raw, rawLen);
+    stored = rawLen;
+    slot[0] = FRAME_RAW;
+  }
+  else {
+    slot[0] = FRAME_LZ;
+  }
+
+  putSize(slot + 1, rawLen);
+  putSize(slot + 1 + SIZE_BYTES, stored);
+  c->lens[index] = FRAME_HEADER_SIZE + stored;
+}
+
+/**
+ * Reads and compresses the next batch, and packs it for reading.
+ *
+ * @param c the Compressor
+*/
+static void fillCompressor( Compressor *c )
+{
+  size_t capacity = c->frames * COMPRESS_FRAME_SIZE;
+  c->rawLen = readChunk(c->in, c->raw, capacity);
+  if (c->checksum) {
+    dmHashUpdate(c->checksum, c->pool, c->raw, c->rawLen);
+  }
+
+  size_t count = ( c->rawLen + COMPRESS_FRAME_SIZE - 1 ) / COMPRESS_FRAME_SIZE;
+  runPool(c->pool, packFrame, c, count);
+
+  // Close up the gaps the frames left in their slots
+  byte *end = c->packed + COMPRESS_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++) {
+    memmove(end, c->packed + COMPRESS_HEADER_SIZE + i * SLOT_SIZE, c->lens[i]);
+    end += c->lens[i];
+  }
+
+  if (c->rawLen < capacity) {
+    *end++ = FRAME_END;
+    c->ended = true;
+  }
+
+  // The stream header stays at the front, but is only read the first time
+  c->pos = c->started ? COMPRESS_HEADER_SIZE : 0;
+  c->started = true;
+  c->len = end - c->packed;
+}
+
+/**
+ * Reads from a stream opened by openCompressor().
+ *
+ * @param cookie the Compressor
+ * @param buf where to store the bytes
+ * @param size number of bytes wanted
+ * @return number of bytes read, 0 at the end of the stream
+*/
+static ssize_t readCompressor( void *cookie, char *buf, size_t size )
+{
+  Compressor *c = cookie;
+  size_t done = 0;
+
+  while (done < size) {
+    if (c->pos == c->len) {
+      if (c->ended) {
+        break;
+      }
+      fillCompressor(c);
+    }
+
+    size_t n = c->len - c->pos < size - done ? c->len - c->pos : size - done;
+    memcpy(buf + done, c->packed + c->pos, n);
+    c->pos += n;
+    done += n;
+  }
+
+  return done;
+}
+
+/**
+ * Frees a stream opened by openCompressor().
+ *
+ * @param cookie the Compressor
+ * @return 0
+*/
+static int closeCompressor( void *cookie )
+{
+  Compressor *c = cookie;
+  free(c->raw);
+  free(c->packed);
+  free(c->lens);
+  free(c);
+  return 0;
+}
+
+FILE *openCompressor( FILE *in, ThreadPool *pool, DmHash *checksum )
+{
+  Compressor *c = malloc(sizeof(Compressor));
+  c->in = in;
+  c->pool = pool;
+  c->checksum = checksum;
+  c->frames = poolThreads(pool);
+  c->raw = malloc(c->frames * COMPRESS_FRAME_SIZE);
+  c->rawLen = 0;
+  c->packed = malloc(COMPRESS_HEADER_SIZE + c->frames * SLOT_SIZE + 1);
+  c->lens = malloc(c->frames * sizeof(size_t));
+  c->len = c->pos = 0;
+  c->started = c->ended = false;
+
+  memcpy(c->packed, COMPRESS_MAGIC, MAGIC_SIZE);
+  putSize(c->packed + MAGIC_SIZE, COMPRESS_FRAME_SIZE);
+
+  cookie_io_functions_t funcs = { readCompressor, NULL, NULL, closeCompressor };
+  FILE *fp = fopencookie(c, "r", funcs);
+  if (!fp) {
+    fprintf(stderr, "Can't open compressor\n");
+    exit(EXIT_FAILURE);
+  }
+
+  return fp;
+}
+
+/** What a stream opened by openDecompressor() has found out about its plaintext. */
+typedef enum {
+  /** The stream header hasn't all been written yet. */
+  STREAM_HEADER,
+
+  /** The end marker hasn't been seen yet. */
+  STREAM_FRAMES,
+
+  /** The end marker has been seen. */
+  STREAM_ENDED
+} StreamState;
+
+/** State of a stream opened by openDecompressor(). */
+typedef struct {
+  /** Where the plaintext goes. */
+  FILE *out;
+
+  /** The pool to expand on. */
+  ThreadPool *pool;
+
+  /** Name of the file being decrypted. */
+  char const *name;
+
+  /** Set once the decryption has failed, so nothing more is checked. */
+  bool const *failed;
+
+  /** What's been found out about the plaintext. */
+  StreamState state;
+
+  /** The stream header, while it's being written. */
+  byte head[ COMPRESS_HEADER_SIZE ];
+
+  /** Number of bytes in head. */
+  size_t headLen;
+
+  /** Largest number of bytes a frame can expand to, from the stream header. */
+  size_t frameSize;
+
+  /** Most frames expanded at a time. */
+  size_t frames;
+
+  /** Written bytes that aren't whole frames yet, or haven't been expanded. */
+  byte *in;
+
+  /** Number of bytes in in. */
+  size_t inLen;
+
+  /** Number of bytes there's room for in in. */
+  size_t inCap;
+
+  /** The frames of the current batch, pointing into in. */
+  byte const **batch;
+
+  /** Where each frame of the current batch expands to. */
+  byte *plain;
+
+  /** Whether each frame of the current batch turned out to be invalid. */
+  bool *bad;
+} Decompressor;
+
+/**
+ * Prints an error for invalid compressed data and terminates the program.
+ *
+ * @param d the Decompressor, for the file name
+*/
+static void badData( Decompressor const *d )
+{
+  fprintf(stderr, "Bad compressed data: %s\n", d->name);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Expands one frame of the current batch.
+ *
+ * @param arg the Decompressor
+ * @param index number of the frame in the batch
+*/
+static void expandFrame( void *arg, size_t index )
+{
+  Decompressor *d = arg;
+  byte const *frame = d->batch[index];
+  size_t rawLen = getSize(frame + 1);
+  size_t stored = getSize(frame + 1 + SIZE_BYTES);
+  byte *plain = d->plain + index * d->frameSize;
+
+  if (frame[0] == FRAME_RAW) {
+    memcpy(plain, frame + FRAME_HEADER_SIZE, rawLen);
+    d->bad[index] = false;
+  }
+  else {
+    d->bad[index] = !lzDecompress(frame + FRAME_HEADER_SIZE, stored, plain, rawLen);
+  }
+}
+
+/**
+ * Checks the frame at the given place, terminating the program if it's invalid.
+ *
+ * @param d the Decompressor
+ * @param frame the frame
+ * @param avail number of bytes written from the frame on
+ * @return number of bytes in the frame, or 0 if it hasn't all been written yet
+*/
+static size_t frameLength( Decompressor const *d, byte const *frame, size_t avail )
+{
+  if (avail == 0) {
+    return 0;
+  }
+  if (frame[0] == FRAME_END) {
+    return 1;
+  }
+  if (frame[0] != FRAME_LZ && frame[0] != FRAME_RAW) {
+    badData(d);
+  }
+  if (avail < FRAME_HEADER_SIZE) {
+    return 0;
+  }
+
+  // A frame is only compressed if that made it smaller
+  size_t rawLen = getSize(frame + 1);
+  size_t stored = getSize(frame + 1 + SIZE_BYTES);
+  if (rawLen == 0 || rawLen > d->frameSize
+      || ( frame[0] == FRAME_RAW ? stored != rawLen : stored >= rawLen )) {
+    badData(d);
+  }
+
+  return avail - FRAME_HEADER_SIZE < stored ? 0 : FRAME_HEADER_SIZE + stored;
+}
+
+/**
+ * Expands and writes every whole frame written so far, a batch at a time.
+ *
+ * @param d the Decompressor
+*/
+static void expandFrames( Decompressor *d )
+{
+  size_t off = 0;
+
+  while (d->state == STREAM_FRAMES) {
+    size_t count = 0;
+    size_t len;
+    while (count < d->frames && ( len = frameLength(d, d->in + off, d->inLen - off) ) > 0) {
+      if (d->in[off] == FRAME_END) {
+        d->state = STREAM_ENDED;
+        off += len;
+        break;
+      }
+      d->batch[count++] = d->in + off;
+      off += len;
+    }
+
+    if (count == 0) {
+      break;
+    }
+
+    runPool(d->pool, expandFrame, d, count);
+    for (size_t i = 0; i < count; i++) {
+      if (d->bad[i]) {
+        badData(d);
+      }
+      writeChunk(d->out, d->plain + i * d->frameSize, getSize(d->batch[i] + 1));
+    }
+  }
+
+  // Nothing can follow the end marker
+  if (d->state == STREAM_ENDED && off != d->inLen) {
+    badData(d);
+  }
+
+  memmove(d->in, d->in + off, d->inLen - off);
+  d->inLen -= off;
+}
+
+/**
+ * Checks the stream header and gets ready to expand the frames after it.
+ *
+ * @param d the Decompressor, with head full
+*/
+static void startDecompressor( Decompressor *d )
+{
+  if (memcmp(d->head, COMPRESS_MAGIC, MAGIC_SIZE) != 0) {
+    badData(d);
+  }
+
+  d->frameSize = getSize(d->head + MAGIC_SIZE);
+  if (d->frameSize == 0 || d->frameSize > COMPRESS_MAX_FRAME) {
+    badData(d);
+  }
+
+  d->state = STREAM_FRAMES;
+  d->frames = poolThreads(d->pool);
+  d->inCap = FRAME_HEADER_SIZE + d->frameSize;
+  d->in = malloc(d->inCap);
+  d->batch = malloc(d->frames * sizeof(byte const *));
+  d->plain = malloc(d->frames * d->frameSize);
+  d->bad = malloc(d->frames * sizeof(bool));
+}
+
+/**
+ * Writes to a stream opened by openDecompressor().
+ *
+ * @param cookie the Decompressor
+ * @param buf the bytes to write
+ * @param size number of bytes to write
+ * @return size, since anything that goes wrong terminates the program
+*/
+static ssize_t writeDecompressor( void *cookie, char const *buf, size_t size )
+{
+  Decompressor *d = cookie;
+  byte const *data = (byte const *) buf;
+  size_t left = size;
+
+  // What's left of a failed decryption is only being flushed out of the way
+  if (*d->failed) {
+    return size;
+  }
+
+  if (d->state == STREAM_HEADER) {
+    size_t n = COMPRESS_HEADER_SIZE - d->headLen < left ? COMPRESS_HEADER_SIZE - d->headLen : left;
+    memcpy(d->head + d->headLen, data, n);
+    d->headLen += n;
+    data += n;
+    left -= n;
+
+    if (d->headLen < COMPRESS_HEADER_SIZE) {
+      return size;
+    }
+    startDecompressor(d);
+  }
+
+  if (d->state == STREAM_ENDED) {
+    if (left > 0) {
+      badData(d);
+    }
+    return size;
+  }
+
+  if (d->inLen + left > d->inCap) {
+    while (d->inLen + left > d->inCap) {
+      d->inCap *= 2;
+    }
+    d->in = realloc(d->in, d->inCap);
+  }
+  memcpy(d->in + d->inLen, data, left);
+  d->inLen += left;
+
+  expandFrames(d);
+  return size;
+}
+
+/**
+ * Finishes and frees a stream opened by openDecompressor(), terminating the
+ * program if the compressed stream was cut short and the decryption didn't fail.
+ *
+ * @param cookie the Decompressor
+ * @return 0
+*/
+static int closeDecompressor( void *cookie )
+{
+  Decompressor *d = cookie;
+
+  if (!*d->failed && d->state != STREAM_ENDED) {
+    badData(d);
+  }
+
+  free(d->in);
+  free(d->batch);
+  free(d->plain);
+  free(d->bad);
+  free(d);
+  return 0;
+}
+
+FILE *openDecompressor( FILE *out, ThreadPool *pool, char const *name, bool const *failed )
+{
+  Decompressor *d = malloc(sizeof(Decompressor));
+  d->out = out;
+  d->pool = pool;
+  d->name = name;
+  d->failed = failed;
+  d->state = STREAM_HEADER;
+  d->headLen = 0;
+  d->in = NULL;
+  d->inLen = 0;
+  d->batch = NULL;
+  d->plain = NULL;
+  d->bad = NULL;
+
+  cookie_io_functions_t funcs = { NULL, writeDecompressor, NULL, closeDecompressor };
+  FILE *fp = fopencookie(d, "w", funcs);
+  if (!fp) {
+    fprintf(stderr, "Can't open decompressor\n");
+    exit(EXIT_FAILURE);
+  }
+
+  return fp;
+}
+
+void writeFormatHeader( FILE *out, byte flags )
+{
+  byte header[ FORMAT_HEADER_SIZE ] = { 0 };
+  memcpy(header, FORMAT_MAGIC, FORMAT_MAGIC_SIZE);
+  header[ FORMAT_MAGIC_SIZE ] = FORMAT_VERSION;
+  header[ FORMAT_MAGIC_SIZE + 1 ] = flags;
+  writeChunk(out, header, FORMAT_HEADER_SIZE);
+}
+
+/** State of a stream that reads some bytes already taken from a pipe, then the rest of it. */
+typedef struct {
+  /** The bytes already taken. */
+  byte head[ FORMAT_HEADER_SIZE ];
+
+  /** Number of bytes in head. */
+  size_t len;
+
+  /** Number of bytes of head already read. */
+  size_t pos;
+
+  /** The rest of the pipe. */
+  FILE *rest;
+} Unread;
+
+/**
+ * Reads from a stream opened by readFormatHeader() for a pipe without a header.
+ *
+ * @param cookie the Unread
+ * @param buf where to store the bytes
+ * @param size most bytes to read
+ * @return number of bytes read, 0 at the end of the pipe
+*/
+static ssize_t readUnread( void *cookie, char *buf, size_t size )
+{
+  Unread *u = cookie;
+  if (u->pos < u->len) {
+    size_t n = u->len - u->pos < size ? u->len - u->pos : size;
+    memcpy(buf, u->head + u->pos, n);
+    u->pos += n;
+    return n;
+  }
+
+  return fread(buf, 1, size, u->rest);
+}
+
+/**
+ * Closes a stream opened by readFormatHeader(), along with the pipe under it.
+ *
+ * @param cookie the Unread
+ * @return the result of closing the pipe
+*/
+static int closeUnread( void *cookie )
+{
+  Unread *u = cookie;
+  int status = fclose(u->rest);
+  free(u);
+  return status;
+}
+
+bool readFormatHeader( FILE **in, byte *flags )
+{
+  byte header[ FORMAT_HEADER_SIZE ];
+  size_t n = readChunk(*in, header, FORMAT_HEADER_SIZE);
+
+  if (n == FORMAT_HEADER_SIZE && memcmp(header, FORMAT_MAGIC, FORMAT_MAGIC_SIZE) == 0) {
+    *flags = header[ FORMAT_MAGIC_SIZE + 1 ];
+    for (size_t i = FORMAT_MAGIC_SIZE + 2; i < FORMAT_HEADER_SIZE; i++) {
+      if (header[i] != 0) {
+        return false;
+      }
+    }
+    return header[ FORMAT_MAGIC_SIZE ] == FORMAT_VERSION && ( *flags & ~FORMAT_COMPRESSED ) == 0;
+  }
+
+  // No header, so the ciphertext starts over from its first byte
+  *flags = 0;
+  uint64_t size;
+  if (fileSize(*in, &size)) {
+    rewind(*in);
+    return true;
+  }
+
+  Unread *u = malloc(sizeof(Unread));
+  memcpy(u->head, header, n);
+  u->len = n;
+  u->pos = 0;
+  u->rest = *in;
+
+  cookie_io_functions_t funcs = { readUnread, NULL, NULL, closeUnread };
+  *in = fopencookie(u, "r", funcs);
+  if (!*in) {
+    fprintf(stderr, "Can't open input file\n");
+    exit(EXIT_FAILURE);
+  }
+  return true;
+}
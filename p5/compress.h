@@ -0,0 +1,103 @@
+/**
+ * @file compress.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for compressing plaintext on its way into the cipher
+ * and expanding it on its way out. The compressed stream starts with a header
+ * holding COMPRESS_MAGIC and the frame size, then the input split into frames
+ * of that many bytes, each compressed with lz.h on its own so the frames can
+ * be spread across threads, then an end marker. Each frame records whether
+ * it's compressed, and its size before and after, so a frame that wouldn't
+ * shrink is stored as it is.
+ *
+ * Both directions are wrapped in FILE streams, so the stream functions can
+ * read compressed plaintext and write expanded plaintext without knowing
+ * anything about it.
+ *
+ * Ciphertext of compressed plaintext starts with a format header, ahead of
+ * the header of the mode, with FORMAT_COMPRESSED set in its flags. Only that
+ * flag marks the plaintext as compressed, so a file whose plaintext happens
+ * to start with COMPRESS_MAGIC still decrypts to exactly that plaintext.
+ */
+
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "field.h"
+#include "pool.h"
+#include "dmHash.h"
+
+/** Bytes that start a compressed stream. */
+#define COMPRESS_MAGIC "P5LZ"
+
+/** Number of bytes in the header of a compressed stream: the magic, then the frame size. */
+#define COMPRESS_HEADER_SIZE 8
+
+/** Number of input bytes in each frame. Only the last frame can be shorter. */
+#define COMPRESS_FRAME_SIZE ( 1024 * 1024 )
+
+/** Largest frame size accepted when expanding, which bounds the memory a stream can ask for. */
+#define COMPRESS_MAX_FRAME ( 16 * 1024 * 1024 )
+
+/** Bytes that start the format header. */
+#define FORMAT_MAGIC "P5FORMAT"
+
+/** Version of the format header, which follows the magic. */
+#define FORMAT_VERSION 1
+
+/** Number of bytes in the format header: the magic, the version, the flags, then zeros. */
+#define FORMAT_HEADER_SIZE 16
+
+/** Flag set in the format header when the plaintext was compressed before encryption. */
+#define FORMAT_COMPRESSED 0x01
+
+/**
+ * Opens a stream that reads the compressed form of in. Each time it runs
+ * dry, it reads one frame per thread of the pool and compresses them in
+ * parallel. Closing it doesn't close in.
+ *
+ * @param in the plaintext to read
+ * @param pool the pool to compress on
+ * @param checksum checksum to add the plaintext to as it's read, or NULL
+ * @return the compressed stream
+*/
+FILE *openCompressor( FILE *in, ThreadPool *pool, DmHash *checksum );
+
+/**
+ * Opens a stream that expands the compressed stream written to it into out,
+ * up to one frame per thread of the pool at a time. Anything invalid or
+ * missing from it terminates the program once it's found, which can be as
+ * late as when the stream is closed, unless failed has been set by then.
+ * Closing it doesn't close out.
+ *
+ * @param out where to write the plaintext
+ * @param pool the pool to expand on
+ * @param name name of the file being decrypted, for error messages
+ * @param failed set to true before closing the stream when the decryption
+ *               failed, so whatever was written to it is dropped unchecked
+ * @return the stream to write to
+*/
+FILE *openDecompressor( FILE *out, ThreadPool *pool, char const *name, bool const *failed );
+
+/**
+ * Writes the format header with the given flags.
+ *
+ * @param out where to write it
+ * @param flags the flags, such as FORMAT_COMPRESSED
+*/
+void writeFormatHeader( FILE *out, byte flags );
+
+/**
+ * Reads the format header from the start of some ciphertext, if it has one.
+ * Ciphertext without one is left to be read from its start, through a new
+ * stream that replaces in if in is a pipe, which can't be rewound.
+ *
+ * @param in the ciphertext, at its start
+ * @param flags filled in with the flags of the header, or 0 if there isn't one
+ * @return false if the header has a version or flags this program doesn't know
+*/
+bool readFormatHeader( FILE **in, byte *flags );
+
+#endif
@@ -0,0 +1,684 @@
+/**
+ * @file container.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Reads and writes the chunked container format. Chunks are written as they
+ * are encrypted and the index goes at the end, so a container can be written
+ * to a pipe. Reading one starts from the footer, which says where the index
+ * is, and the index says where each chunk is. An incremental update walks
+ * the new plaintext chunk by chunk and compares each chunk's hash with the
+ * manifest, seeking over the chunks that are the same instead of writing them,
+ * as long as the nonce and tag in the container are still the ones the
+ * manifest recorded.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "container.h"
+#include "gcm.h"
+#include "io.h"
+
+/** Magic number at the start of a container, which also gives the version */
+#define CONTAINER_MAGIC "P5C1"
+
+/** Magic number at the very end of a container */
+#define FOOTER_MAGIC "P5CX"
+
+/** Number of bytes in each magic number */
+#define MAGIC_SIZE 4
+
+/** Number of bytes in the chunk size in the header */
+#define CHUNK_SIZE_SIZE 4
+
+/** Number of bytes of random nonce at the start of each chunk */
+#define CHUNK_NONCE_SIZE 8
+
+/** Number of bytes each chunk takes up in addition to its plaintext */
+#define CHUNK_OVERHEAD ( CHUNK_NONCE_SIZE + GCM_TAG_SIZE )
+
+/** Number of bytes in the header: the magic and the chunk size */
+#define HEADER_SIZE ( MAGIC_SIZE + CHUNK_SIZE_SIZE )
+
+/** Number of bytes in each index entry: the offset and two lengths */
+#define ENTRY_SIZE 16
+
+/** Number of bytes in the footer: the chunk count, the magic and four reserved bytes */
+#define FOOTER_SIZE 16
+
+/** Bit set in the chunk number of the IV for the last chunk */
+#define LAST_CHUNK 0x80000000u
+
+/** Magic number at the start of a hash manifest, which also gives the version */
+#define HASH_MAGIC "P5H2"
+
+/** Number of bytes in a hash manifest header: the magic, the chunk size and the chunk count */
+#define HASH_HEADER_SIZE 16
+
+/** Number of bytes in each chunk hash */
+#define HASH_SIZE BLOCK_SIZE
+
+/** Number of bytes in each manifest record: the hash, then the chunk's nonce and tag */
+#define RECORD_SIZE ( HASH_SIZE + CHUNK_OVERHEAD )
+
+/** Number of independent chains in a chunk hash, so the block cipher calls can overlap */
+#define HASH_LANES 8
+
+/** Encrypted under the container key to make the key for the chunk hashes */
+static byte const hashLabel[ BLOCK_SIZE ] = "p5 chunk hashes";
+
+/** Where one chunk is and how big it is. */
+typedef struct {
+  /** Offset of the chunk in the container. */
+  uint64_t offset;
+
+  /** Number of plaintext bytes in the chunk. */
+  uint32_t plainLen;
+
+  /** Number of bytes the chunk takes up in the container, with its nonce and tag. */
+  uint32_t storedLen;
+} IndexEntry;
+
+/** Chunk hashes, from a manifest or for one. */
+typedef struct {
+  /** Hash key, derived from the container key. */
+  AesContext key;
+
+  /** Record of each chunk, one after another. */
+  byte *records;
+
+  /** Number of chunks. */
+  uint64_t count;
+
+  /** Room in records, in chunks. */
+  uint64_t capacity;
+} HashList;
+
+/**
+ * Stores a number big-endian, like the lengths in GCM.
+ *
+ * @param data where to store it
+ * @param value the number to store
+ * @param size number of bytes to store it in
+*/
+static void putNumber( byte *data, uint64_t value, int size )
+{
+  for (int i = size - 1; i >= 0; i--) {
+    data[i] = value;
+    value >>= BBITS;
+  }
+}
+
+/**
+ * Loads a big-endian number.
+ *
+ * @param data where it's stored
+ * @param size number of bytes it's stored in
+ * @return the number
+*/
+static uint64_t getNumber( byte const *data, int size )
+{
+  uint64_t value = 0;
+  for (int i = 0; i < size; i++) {
+    value = value << BBITS | data[i];
+  }
+  return value;
+}
+
+/**
+ * Makes the IV for one chunk.
+ *
+ * @param iv filled in with the IV
+ * @param nonce the chunk's nonce
+ * @param index which chunk it is
+ * @param last true if it's the last chunk
+*/
+static void chunkIv( byte iv[ GCM_IV_SIZE ], byte const nonce[ CHUNK_NONCE_SIZE ],
+                     uint64_t index, bool last )
+{
+  memcpy(iv, nonce, CHUNK_NONCE_SIZE);
+  putNumber(iv + CHUNK_NONCE_SIZE, index | ( last ? LAST_CHUNK : 0 ),
+            GCM_IV_SIZE - CHUNK_NONCE_SIZE);
+}
+
+/**
+ * Encrypts one chunk in place under a new nonce. The plaintext starts
+ * CHUNK_NONCE_SIZE bytes into the buffer, and the nonce and tag are filled
+ * in around it, so the whole buffer can then be written out as it is.
+ *
+ * @param ctx the expanded key
+ * @param pool threads to spread the work across
+ * @param buffer the chunk, with room for the nonce before it and the tag after it
+ * @param len number of plaintext bytes
+ * @param index which chunk it is
+ * @param last true if it's the last chunk
+*/
+static void sealChunk( AesContext const *ctx, ThreadPool *pool, byte *buffer, size_t len,
+                       uint64_t index, bool last )
+{
+  byte *data = buffer + CHUNK_NONCE_SIZE;
+  randomBytes(buffer, CHUNK_NONCE_SIZE);
+
+  byte iv[GCM_IV_SIZE];
+  chunkIv(iv, buffer, index, last);
+
+  Gcm gcm;
+  gcmInit(&gcm, ctx, iv);
+  gcmEncrypt(&gcm, pool, data, data, len);
+  gcmTag(&gcm, data + len);
+}
+
+/**
+ * Folds one block into a chain: the chain value is masked with the block,
+ * encrypted, and masked with the block again, like the Matyas-Meyer-Oseas
+ * compression function but with a fixed secret key instead of one taken
+ * from the chain.
+ *
+ * @param key the hash key
+ * @param chain the chain value to update
+ * @param block the block to fold in
+*/
+static void compressBlock( AesContext const *key, byte chain[ HASH_SIZE ],
+                           byte const block[ BLOCK_SIZE ] )
+{
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    chain[i] ^= block[i];
+  }
+  aesEncryptBlocks(key, chain, chain, 1);
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    chain[i] ^= block[i];
+  }
+}
+
+/**
+ * Hashes one chunk of plaintext. Block j goes into chain j % HASH_LANES,
+ * and all the chains are encrypted with one call, so the backend can work
+ * on them together. The chains and the length are folded into one value at
+ * the end. Every chain starts from the chunk number, so the same plaintext
+ * in two places hashes differently.
+ *
+ * @param key the hash key
+ * @param index which chunk it is
+ * @param data the plaintext
+ * @param len number of bytes of plaintext
+ * @param hash filled in with the hash
+*/
+static void hashChunk( AesContext const *key, uint64_t index, byte const *data, size_t len,
+                       byte hash[ HASH_SIZE ] )
+{
+  byte chains[HASH_LANES * BLOCK_SIZE] = { 0 };
+  for (int lane = 0; lane < HASH_LANES; lane++) {
+    putNumber(chains + lane * BLOCK_SIZE, index, 8);
+    chains[lane * BLOCK_SIZE + 8] = lane;
+  }
+
+  byte group[HASH_LANES * BLOCK_SIZE];
+  for (size_t off = 0; off < len; off += sizeof(group)) {
+    // The end of the chunk is padded with zeros to a whole group
+    size_t n = len - off < sizeof(group) ? len - off : sizeof(group);
+    memcpy(group, data + off, n);
+    memset(group + n, 0x00, sizeof(group) - n);
+
+    for (int i = 0; i < sizeof(group); i++) {
+      chains[i] ^= group[i];
+    }
+    aesEncryptBlocks(key, chains, chains, HASH_LANES);
+    for (int i = 0; i < sizeof(group); i++) {
+      chains[i] ^= group[i];
+    }
+  }
+
+  memset(hash, 0x00, HASH_SIZE);
+  for (int lane = 0; lane < HASH_LANES; lane++) {
+    compressBlock(key, hash, chains + lane * BLOCK_SIZE);
+  }
+
+  // The length keeps zeros at the end from hashing the same as no zeros
+  byte length[BLOCK_SIZE] = { 0 };
+  putNumber(length, len, 8);
+  compressBlock(key, hash, length);
+}
+
+/**
+ * Sets up an empty list of hashes, deriving the hash key from the container key.
+ *
+ * @param list the list to set up
+ * @param ctx the container key
+*/
+static void initHashList( HashList *list, AesContext const *ctx )
+{
+  byte key[BLOCK_SIZE];
+  aesEncryptBlocks(ctx, hashLabel, key, 1);
+  aesInit(&list->key, key);
+
+  list->capacity = 1;
+  list->records = malloc(list->capacity * RECORD_SIZE);
+  list->count = 0;
+}
+
+/**
+ * Adds a record to the end of a list.
+ *
+ * @param list the list to add to
+ * @param hash the chunk's hash
+ * @param nonce the chunk's nonce
+ * @param tag the chunk's tag
+*/
+static void addRecord( HashList *list, byte const hash[ HASH_SIZE ],
+                       byte const nonce[ CHUNK_NONCE_SIZE ], byte const tag[ GCM_TAG_SIZE ] )
+{
+  if (list->count == list->capacity) {
+    list->capacity *= 2;
+    list->records = realloc(list->records, list->capacity * RECORD_SIZE);
+  }
+
+  byte *record = list->records + list->count * RECORD_SIZE;
+  memcpy(record, hash, HASH_SIZE);
+  memcpy(record + HASH_SIZE, nonce, CHUNK_NONCE_SIZE);
+  memcpy(record + HASH_SIZE + CHUNK_NONCE_SIZE, tag, GCM_TAG_SIZE);
+  list->count++;
+}
+
+/**
+ * Checks whether a chunk in the container still has the nonce and tag a
+ * manifest recorded for it, so the manifest can't vouch for a chunk that
+ * was written by something else since, like a plain container run.
+ *
+ * @param out the container
+ * @param offset where the chunk starts
+ * @param len number of plaintext bytes in the chunk
+ * @param seal the nonce and tag from the manifest
+ * @param buffer filled in with the chunk's nonce, with room for its tag after len bytes of plaintext
+ * @return true if both match
+*/
+static bool sealMatches( FILE *out, uint64_t offset, size_t len,
+                         byte const seal[ CHUNK_OVERHEAD ], byte *buffer )
+{
+  byte *tag = buffer + CHUNK_NONCE_SIZE + len;
+  return fseeko(out, offset, SEEK_SET) == 0 &&
+         readChunk(out, buffer, CHUNK_NONCE_SIZE) == CHUNK_NONCE_SIZE &&
+         fseeko(out, offset + CHUNK_NONCE_SIZE + len, SEEK_SET) == 0 &&
+         readChunk(out, tag, GCM_TAG_SIZE) == GCM_TAG_SIZE &&
+         memcmp(buffer, seal, CHUNK_NONCE_SIZE) == 0 &&
+         memcmp(tag, seal + CHUNK_NONCE_SIZE, GCM_TAG_SIZE) == 0;
+}
+
+/**
+ * Writes the chunks of a container, then its index and footer, starting at
+ * the current position of out. Unchanged chunks of an old container are
+ * skipped over instead of being written again.
+ *
+ * @param ctx the expanded key
+ * @param pool threads to spread the work across
+ * @param chunkSize plaintext bytes per chunk
+ * @param in the plaintext to read
+ * @param out where to write the chunks, just past the header
+ * @param hashes if not NULL, filled in with the record of every chunk
+ * @param old the records of the old container's chunks, or NULL if there's nothing to keep
+ * @return number of chunks written
+*/
+static uint64_t writeChunks( AesContext const *ctx, ThreadPool *pool, size_t chunkSize,
+                             FILE *in, FILE *out, HashList *hashes, HashList const *old )
+{
+  byte *cur = malloc(chunkSize + CHUNK_OVERHEAD);
+  byte *next = malloc(chunkSize + CHUNK_OVERHEAD);
+
+  size_t capacity = 1;
+  IndexEntry *entries = malloc(capacity * sizeof(IndexEntry));
+  uint64_t count = 0;
+  uint64_t offset = HEADER_SIZE;
+  uint64_t written = 0;
+
+  // Reading one chunk ahead tells us which one is last. An empty file
+  // still gets one empty chunk, so its tag marks where the end is.
+  size_t n = readChunk(in, cur + CHUNK_NONCE_SIZE, chunkSize);
+  bool last = false;
+
+  while (!last) {
+    size_t after = n == chunkSize ? readChunk(in, next + CHUNK_NONCE_SIZE, chunkSize) : 0;
+    last = after == 0;
+
+    if (count == LAST_CHUNK) {
+      fprintf(stderr, "Too many chunks for a container\n");
+      exit(EXIT_FAILURE);
+    }
+
+    // A chunk can stay if its plaintext and whether it's last are the same
+    // as before, and it's still the chunk the manifest was written for
+    bool keep = false;
+    byte hash[HASH_SIZE];
+    if (hashes) {
+      hashChunk(&hashes->key, count, cur + CHUNK_NONCE_SIZE, n, hash);
+
+      byte const *record = old && count < old->count ? old->records + count * RECORD_SIZE : NULL;
+      keep = record && last == ( count == old->count - 1 ) &&
+             memcmp(hash, record, HASH_SIZE) == 0 &&
+             sealMatches(out, offset, n, record + HASH_SIZE, cur);
+      if (old && fseeko(out, keep ? offset + n + CHUNK_OVERHEAD : offset, SEEK_SET) != 0) {
+        fprintf(stderr, "Can't write container\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    // A kept chunk's nonce and tag were read back into the buffer, so the
+    // record comes from the buffer either way
+    if (!keep) {
+      sealChunk(ctx, pool, cur, n, count, last);
+      writeChunk(out, cur, n + CHUNK_OVERHEAD);
+      written++;
+    }
+    if (hashes) {
+      addRecord(hashes, hash, cur, cur + CHUNK_NONCE_SIZE + n);
+    }
+
+    if (count == capacity) {
+      capacity *= 2;
+      entries = realloc(entries, capacity * sizeof(IndexEntry));
+    }
+    entries[count].offset = offset;
+    entries[count].plainLen = n;
+    entries[count].storedLen = n + CHUNK_OVERHEAD;
+    offset += n + CHUNK_OVERHEAD;
+    count++;
+
+    byte *t = cur;
+    cur = next;
+    next = t;
+    n = after;
+  }
+
+  for (uint64_t i = 0; i < count; i++) {
+    byte entry[ENTRY_SIZE];
+    putNumber(entry, entries[i].offset, 8);
+    putNumber(entry + 8, entries[i].plainLen, 4);
+    putNumber(entry + 12, entries[i].storedLen, 4);
+    writeChunk(out, entry, ENTRY_SIZE);
+  }
+
+  byte footer[FOOTER_SIZE] = { 0 };
+  putNumber(footer, count, 8);
+  memcpy(footer + 8, FOOTER_MAGIC, MAGIC_SIZE);
+  writeChunk(out, footer, FOOTER_SIZE);
+
+  free(entries);
+  free(cur);
+  free(next);
+  return written;
+}
+
+/**
+ * Writes the header of a container at the current position of out.
+ *
+ * @param out where to write the header
+ * @param chunkSize plaintext bytes per chunk
+*/
+static void writeHeader( FILE *out, size_t chunkSize )
+{
+  byte header[HEADER_SIZE];
+  memcpy(header, CONTAINER_MAGIC, MAGIC_SIZE);
+  putNumber(header + MAGIC_SIZE, chunkSize, CHUNK_SIZE_SIZE);
+  writeChunk(out, header, HEADER_SIZE);
+}
+
+void encryptContainer( AesContext const *ctx, ThreadPool *pool, size_t chunkSize,
+                       FILE *in, FILE *out )
+{
+  writeHeader(out, chunkSize);
+  writeChunks(ctx, pool, chunkSize, in, out, NULL, NULL);
+}
+
+/**
+ * Reads the header, footer and index of a container and checks that
+ * they describe chunks that fit in the file.
+ *
+ * @param in the container
+ * @param chunkSize filled in with the chunk size
+ * @param count filled in with the number of chunks
+ * @return the dynamically allocated index, or NULL if the container isn't valid
+*/
+static IndexEntry *readIndex( FILE *in, size_t *chunkSize, uint64_t *count )
+{
+  uint64_t size;
+  byte header[HEADER_SIZE];
+  byte footer[FOOTER_SIZE];
+
+  if (!fileSize(in, &size) || size < HEADER_SIZE + FOOTER_SIZE ||
+      fseeko(in, 0, SEEK_SET) != 0 ||
+      readChunk(in, header, HEADER_SIZE) != HEADER_SIZE ||
+      memcmp(header, CONTAINER_MAGIC, MAGIC_SIZE) != 0 ||
+      fseeko(in, size - FOOTER_SIZE, SEEK_SET) != 0 ||
+      readChunk(in, footer, FOOTER_SIZE) != FOOTER_SIZE ||
+      memcmp(footer + 8, FOOTER_MAGIC, MAGIC_SIZE) != 0) {
+    return NULL;
+  }
+
+  *chunkSize = getNumber(header + MAGIC_SIZE, CHUNK_SIZE_SIZE);
+  *count = getNumber(footer, 8);
+
+  // The index sits just before the footer
+  uint64_t room = size - HEADER_SIZE - FOOTER_SIZE;
+  if (*chunkSize == 0 || *chunkSize > CONTAINER_MAX_CHUNK || *count == 0 ||
+      *count > LAST_CHUNK || *count > room / ENTRY_SIZE) {
+    return NULL;
+  }
+  uint64_t indexStart = size - FOOTER_SIZE - *count * ENTRY_SIZE;
+
+  byte *data = malloc(*count * ENTRY_SIZE);
+  if (fseeko(in, indexStart, SEEK_SET) != 0 ||
+      readChunk(in, data, *count * ENTRY_SIZE) != *count * ENTRY_SIZE) {
+    free(data);
+    return NULL;
+  }
+
+  IndexEntry *entries = malloc(*count * sizeof(IndexEntry));
+  bool valid = true;
+  for (uint64_t i = 0; i < *count; i++) {
+    byte const *entry = data + i * ENTRY_SIZE;
+    entries[i].offset = getNumber(entry, 8);
+    entries[i].plainLen = getNumber(entry + 8, 4);
+    entries[i].storedLen = getNumber(entry + 12, 4);
+
+    valid = valid && entries[i].plainLen <= *chunkSize &&
+            entries[i].storedLen == entries[i].plainLen + CHUNK_OVERHEAD &&
+            entries[i].offset >= HEADER_SIZE && entries[i].offset <= indexStart &&
+            entries[i].storedLen <= indexStart - entries[i].offset;
+  }
+
+  free(data);
+  if (!valid) {
+    free(entries);
+    return NULL;
+  }
+
+  return entries;
+}
+
+/**
+ * Returns the name of the hash manifest for a container.
+ *
+ * @param outputFile name of the container
+ * @return the dynamically allocated name
+*/
+static char *manifestName( char const *outputFile )
+{
+  char *name = malloc(strlen(outputFile) + strlen(HASH_SUFFIX) + 1);
+  strcpy(name, outputFile);
+  strcat(name, HASH_SUFFIX);
+  return name;
+}
+
+/**
+ * Reads a hash manifest into a list that's already been set up.
+ *
+ * @param name name of the manifest
+ * @param list the list to fill in
+ * @param chunkSize filled in with the chunk size the hashes are for
+ * @return false if there's no manifest or it isn't valid
+*/
+static bool readManifest( char const *name, HashList *list, size_t *chunkSize )
+{
+  FILE *fp = fopen(name, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  byte header[HASH_HEADER_SIZE];
+  uint64_t size;
+  bool valid = fileSize(fp, &size) &&
+               readChunk(fp, header, HASH_HEADER_SIZE) == HASH_HEADER_SIZE &&
+               memcmp(header, HASH_MAGIC, MAGIC_SIZE) == 0;
+
+  uint64_t count = valid ? getNumber(header + 8, 8) : 0;
+  valid = valid && count > 0 && count <= ( size - HASH_HEADER_SIZE ) / RECORD_SIZE;
+
+  for (uint64_t i = 0; valid && i < count; i++) {
+    byte record[RECORD_SIZE];
+    valid = readChunk(fp, record, RECORD_SIZE) == RECORD_SIZE;
+    addRecord(list, record, record + HASH_SIZE, record + HASH_SIZE + CHUNK_NONCE_SIZE);
+  }
+
+  if (valid) {
+    *chunkSize = getNumber(header + MAGIC_SIZE, CHUNK_SIZE_SIZE);
+  }
+  fclose(fp);
+  return valid;
+}
+
+/**
+ * Writes a hash manifest, replacing any that was there.
+ *
+ * @param name name of the manifest
+ * @param list the hashes to write
+ * @param chunkSize the chunk size the hashes are for
+*/
+static void writeManifest( char const *name, HashList const *list, size_t chunkSize )
+{
+  FILE *fp = openFile(name, "wb");
+
+  byte header[HASH_HEADER_SIZE];
+  memcpy(header, HASH_MAGIC, MAGIC_SIZE);
+  putNumber(header + MAGIC_SIZE, chunkSize, CHUNK_SIZE_SIZE);
+  putNumber(header + 8, list->count, 8);
+  writeChunk(fp, header, HASH_HEADER_SIZE);
+  writeChunk(fp, list->records, list->count * RECORD_SIZE);
+
+  fclose(fp);
+}
+
+void removeManifest( char const *outputFile )
+{
+  char *name = manifestName(outputFile);
+  remove(name);
+  free(name);
+}
+
+uint64_t updateContainer( AesContext const *ctx, ThreadPool *pool, size_t chunkSize,
+                          FILE *in, char const *outputFile )
+{
+  char *name = manifestName(outputFile);
+  HashList old, hashes;
+  initHashList(&old, ctx);
+  initHashList(&hashes, ctx);
+
+  // The old chunks can only be kept if the container and its manifest agree
+  size_t oldSize;
+  bool incremental = readManifest(name, &old, &oldSize);
+  FILE *out = incremental ? fopen(outputFile, "r+b") : NULL;
+
+  if (out) {
+    size_t size;
+    uint64_t count;
+    IndexEntry *entries = readIndex(out, &size, &count);
+    incremental = entries && size == oldSize && count == old.count;
+    free(entries);
+
+    if (incremental) {
+      chunkSize = size;
+    }
+    else {
+      fclose(out);
+      out = NULL;
+    }
+  }
+
+  if (!out) {
+    out = openFile(outputFile, "wb");
+  }
+
+  fseeko(out, 0, SEEK_SET);
+  writeHeader(out, chunkSize);
+  uint64_t written = writeChunks(ctx, pool, chunkSize, in, out, &hashes,
+                                 incremental ? &old : NULL);
+
+  // A container that got shorter still has the old end after the new footer
+  if (fflush(out) != 0 || ftruncate(fileno(out), ftello(out)) != 0) {
+    fprintf(stderr, "Can't write file: %s\n", outputFile);
+    exit(EXIT_FAILURE);
+  }
+  fclose(out);
+
+  writeManifest(name, &hashes, chunkSize);
+
+  free(old.records);
+  free(hashes.records);
+  free(name);
+  return written;
+}
+
+DecryptResult decryptContainer( AesContext const *ctx, ThreadPool *pool, FILE *in, FILE *out,
+                                uint64_t offset, uint64_t len )
+{
+  size_t chunkSize;
+  uint64_t count;
+  IndexEntry *entries = readIndex(in, &chunkSize, &count);
+  if (!entries) {
+    return DECRYPT_BAD_FORMAT;
+  }
+
+  uint64_t end = len > UINT64_MAX - offset ? UINT64_MAX : offset + len;
+  byte *buffer = malloc(chunkSize + CHUNK_OVERHEAD);
+  byte *data = buffer + CHUNK_NONCE_SIZE;
+  DecryptResult result = DECRYPT_OK;
+
+  // Walk the index to find the chunks that overlap the range
+  uint64_t start = 0;
+  for (uint64_t i = 0; i < count && start < end; i++) {
+    IndexEntry const *entry = &entries[i];
+    uint64_t stop = start + entry->plainLen;
+
+    if (stop > offset || ( i == count - 1 && entry->plainLen == 0 )) {
+      if (fseeko(in, entry->offset, SEEK_SET) != 0 ||
+          readChunk(in, buffer, entry->storedLen) != entry->storedLen) {
+        result = DECRYPT_BAD_FORMAT;
+        break;
+      }
+
+      byte iv[GCM_IV_SIZE];
+      chunkIv(iv, buffer, i, i == count - 1);
+
+      Gcm gcm;
+      gcmInit(&gcm, ctx, iv);
+      gcmAuthenticate(&gcm, pool, data, entry->plainLen);
+      if (!gcmCheckTag(&gcm, data + entry->plainLen)) {
+        result = DECRYPT_BAD_TAG;
+        break;
+      }
+
+      // Only the part of the chunk inside the range is written
+      size_t from = offset > start ? offset - start : 0;
+      size_t to = end < stop ? end - start : entry->plainLen;
+      size_t first = from - from % BLOCK_SIZE;
+      gcmDecrypt(&gcm, pool, first, data + first, data + first, to - first);
+      writeChunk(out, data + from, to - from);
+    }
+
+    start = stop;
+  }
+
+  free(buffer);
+  free(entries);
+  return result;
+}
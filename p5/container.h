@@ -0,0 +1,110 @@
+/**
+ * @file container.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for the chunked container format, where a file is
+ * cut into fixed-size chunks that are encrypted and authenticated on their
+ * own, so any range of the plaintext can be decrypted without the rest.
+ *
+ * A container is a header, the chunks, then an index and a footer:
+ *
+ *   header   "P5C1" and the chunk size
+ *   chunk i  an 8-byte random nonce, the chunk encrypted with GCM, then its 16-byte tag
+ *   index    for each chunk, its offset, plaintext length and stored length
+ *   footer   the number of chunks and "P5CX"
+ *
+ * Numbers are big-endian. Chunk i uses its nonce followed by i as its IV,
+ * with the top bit of i set on the last chunk, so chunks can't be moved
+ * around and the file can't be cut short at a chunk boundary without
+ * failing authentication. Every chunk but the last is full, so a chunk's
+ * offset only depends on its number, and a chunk can be encrypted again
+ * in place under a new nonce.
+ *
+ * An incremental container also has a hash manifest next to it, in a file
+ * with HASH_SUFFIX added to its name:
+ *
+ *   "P5H2", the chunk size, the number of chunks, then for each chunk a
+ *   16-byte hash of its plaintext, its nonce and its tag
+ *
+ * The hashes are keyed with a key derived from the container's key, so
+ * they say nothing about the plaintext to anyone without it. The nonce and
+ * tag tie each hash to the chunk it was made for, so a manifest left over
+ * from before the container was written some other way matches nothing.
+ */
+
+#ifndef _CONTAINER_H_
+#define _CONTAINER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "cipher.h"
+
+/** Default number of plaintext bytes in each chunk. */
+#define CONTAINER_CHUNK_SIZE ( 1024 * 1024 )
+
+/** Largest chunk size a container can use. */
+#define CONTAINER_MAX_CHUNK ( 64 * 1024 * 1024 )
+
+/** Added to the name of a container to get the name of its hash manifest. */
+#define HASH_SUFFIX ".hashes"
+
+/** Range length meaning everything from the offset to the end. */
+#define RANGE_TO_END UINT64_MAX
+
+/**
+ * Encrypts everything read from in into a container written to out.
+ * Neither file has to be seekable.
+ *
+ * @param ctx the expanded key
+ * @param pool threads to spread the work across
+ * @param chunkSize plaintext bytes per chunk, a multiple of BLOCK_SIZE up to CONTAINER_MAX_CHUNK
+ * @param in the plaintext to read
+ * @param out where to write the container
+*/
+void encryptContainer( AesContext const *ctx, ThreadPool *pool, size_t chunkSize,
+                       FILE *in, FILE *out );
+
+/**
+ * Removes the hash manifest of a container, if it has one, for when the
+ * container has been written without it.
+ *
+ * @param outputFile name of the container
+*/
+void removeManifest( char const *outputFile );
+
+/**
+ * Brings a container up to date with the plaintext read from in. Chunks whose
+ * hash matches the one in the container's hash manifest, and whose nonce and
+ * tag are still the ones the manifest recorded, are left alone, and
+ * only the chunks that changed are encrypted and written again, in place.
+ * If the container or its manifest is missing or doesn't match, the whole
+ * container is written from scratch. The manifest is updated either way.
+ * Terminates the program if the container can't be written.
+ *
+ * @param ctx the expanded key
+ * @param pool threads to spread the work across
+ * @param chunkSize plaintext bytes per chunk, for a container written from scratch
+ * @param in the plaintext to read, which doesn't have to be seekable
+ * @param outputFile name of the container
+ * @return number of chunks that were written
+*/
+uint64_t updateContainer( AesContext const *ctx, ThreadPool *pool, size_t chunkSize,
+                          FILE *in, char const *outputFile );
+
+/**
+ * Decrypts part of a container, reading and authenticating only the chunks
+ * that overlap it. Each chunk is authenticated before any of its plaintext
+ * is written. A range that runs past the end of the plaintext stops there.
+ *
+ * @param ctx the expanded key
+ * @param pool threads to spread the work across
+ * @param in the container, which must be a regular file
+ * @param out where to write the plaintext of the range
+ * @param offset where the range starts in the plaintext
+ * @param len length of the range, or RANGE_TO_END
+ * @return DECRYPT_OK, or what's wrong with the container
+*/
+DecryptResult decryptContainer( AesContext const *ctx, ThreadPool *pool, FILE *in, FILE *out,
+                                uint64_t offset, uint64_t len );
+
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file ctr.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Counter mode. The keystream for any position can be computed directly
+ * from the nonce, so a stream can be split into slices that are handled
+ * independently by different threads.
+ */
+
+#include <string.h>
+
+#include "ctr.h"
+#include "io.h"
+
+/** Number of keystream blocks generated per call into the AES backend. */
+#define BATCH_BLOCKS 64
+
+/** Size of each slice handed to a thread, in bytes. A multiple of BLOCK_SIZE. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+/** Offset of the block counter within the nonce. */
+#define COUNTER_START 8
+
+void makeNonce( byte nonce[ NONCE_SIZE ] )
+{
+  randomBytes(nonce, COUNTER_START);
+  memset(nonce + COUNTER_START, 0, NONCE_SIZE - COUNTER_START);
+}
+
+void counterBlock( byte block[ BLOCK_SIZE ], byte const nonce[ NONCE_SIZE ], uint64_t index )
+{
+  unsigned int carry = 0;
+
+  // 128-bit big-endian addition of index to the nonce
+  for (int i = BLOCK_SIZE - 1; i >= 0; i--) {
+    unsigned int sum = nonce[i] + (index & 0xFF) + carry;
+    block[i] = sum;
+    carry = sum >> BBITS;
+    index >>= BBITS;
+  }
+}
+
+void ctrCrypt( AesContext const *ctx, byte const nonce[ NONCE_SIZE ], uint64_t offset,
+               byte const *in, byte *out, size_t len )
+{
+  byte stream[BATCH_BLOCKS * BLOCK_SIZE];
+  uint64_t index = offset / BLOCK_SIZE;
+  size_t skip = offset % BLOCK_SIZE;
+  size_t done = 0;
+
+  while (done < len) {
+    // Enough counter blocks to cover the rest of the input, up to a batch
+    size_t nblocks = (skip + len - done + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (nblocks > BATCH_BLOCKS) {
+      nblocks = BATCH_BLOCKS;
+    }
+
+    for (size_t b = 0; b < nblocks; b++) {
+      counterBlock(stream + b * BLOCK_SIZE, nonce, index + b);
+    }
+    aesEncryptBlocks(ctx, stream, stream, nblocks);
+
+    size_t count = nblocks * BLOCK_SIZE - skip;
+    if (count > len - done) {
+      count = len - done;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      out[done + i] = in[done + i] ^ stream[skip + i];
+    }
+
+    done += count;
+    index += nblocks;
+    skip = 0;
+  }
+}
+
+/** Everything a thread needs to process its slices of a CTR stream. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** Initial counter block of the stream. */
+  byte const *nonce;
+
+  /** Stream position of the first input byte. */
+  uint64_t offset;
+
+  /** Bytes to process. */
+  byte const *in;
+
+  /** Where to store the results. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+} CtrJob;
+
+/**
+ * Processes one slice of a CTR job.
+ * 
+ * @param arg the CtrJob being worked on
+ * @param index number of the slice to process
+*/
+static void ctrSlice( void *arg, size_t index )
+{
+  CtrJob *job = arg;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+
+  ctrCrypt(job->ctx, job->nonce, job->offset + start, job->in + start, job->out + start, len);
+}
+
+void ctrCryptParallel( ThreadPool *pool, AesContext const *ctx, byte const nonce[ NONCE_SIZE ],
+                       uint64_t offset, byte const *in, byte *out, size_t len )
+{
+  CtrJob job = { ctx, nonce, offset, in, out, len };
+  runPool(pool, ctrSlice, &job, (len + SLICE_SIZE - 1) / SLICE_SIZE);
+}
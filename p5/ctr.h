@@ -0,0 +1,67 @@
+/**
+ * @file ctr.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for counter (CTR) mode, which turns AES into a
+ * stream cipher by encrypting successive counter values.
+ */
+
+#ifndef _CTR_H_
+#define _CTR_H_
+
+#include <stdint.h>
+#include "aes.h"
+#include "pool.h"
+
+/** Number of bytes in the nonce header at the start of a CTR file. */
+#define NONCE_SIZE BLOCK_SIZE
+
+/**
+ * Fills in a new initial counter block: random bytes in the first half
+ * and a zero block counter in the second half.
+ * 
+ * @param nonce the counter block to fill
+*/
+void makeNonce( byte nonce[ NONCE_SIZE ] );
+
+/**
+ * Computes the counter block for the given block number, treating the
+ * nonce as a 128-bit big-endian number.
+ * 
+ * @param block the counter block to fill
+ * @param nonce the initial counter block
+ * @param index number of the block within the stream
+*/
+void counterBlock( byte block[ BLOCK_SIZE ], byte const nonce[ NONCE_SIZE ], uint64_t index );
+
+/**
+ * Encrypts or decrypts (the same operation in CTR mode) part of a stream.
+ * Block i of the stream is combined with the encryption of nonce + i,
+ * treating the counter block as a 128-bit big-endian number.
+ * 
+ * @param ctx the expanded key
+ * @param nonce the initial counter block of the stream
+ * @param offset position of in[ 0 ] within the whole stream, in bytes
+ * @param in the bytes to process
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to process
+*/
+void ctrCrypt( AesContext const *ctx, byte const nonce[ NONCE_SIZE ], uint64_t offset,
+               byte const *in, byte *out, size_t len );
+
+/**
+ * Like ctrCrypt(), but splits the work into large slices that run in parallel
+ * on the given pool. Every thread writes directly into its own slice of out.
+ * 
+ * @param pool the pool to run on
+ * @param ctx the expanded key
+ * @param nonce the initial counter block of the stream
+ * @param offset position of in[ 0 ] within the whole stream, in bytes
+ * @param in the bytes to process
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to process
+*/
+void ctrCryptParallel( ThreadPool *pool, AesContext const *ctx, byte const nonce[ NONCE_SIZE ],
+                       uint64_t offset, byte const *in, byte *out, size_t len );
+
+#endif
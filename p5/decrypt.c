@@ -12,45 +12,83 @@
 
 #include "io.h"
 #include "aes.h"
+#include "options.h"
+#include "cipher.h"
+#include "stream.h"
+#include "mapped.h"
+#include "pipeline.h"
+#include "container.h"
+#include "sector.h"
+#include "pool.h"
+#include "batch.h"
+#include "compress.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: decrypt <key-file> <input-file> <output-file>"
 
-/** Valid number of arguments */
-#define NUM_ARGS 4
+/**
+ * Prints an error for an input file with an invalid length and terminates the program.
+ * 
+ * @param opts the command-line settings, for the file names
+*/
+static void badLength(Options const *opts)
+{
+  fprintf(stderr, "Bad ciphertext file length: %s", opts->inputFile);
+  exit(EXIT_FAILURE);
+}
 
 /**
- * Parses the given command-line arguments
+ * Prints an error for an input file that failed authentication and terminates the program.
  * 
- * @param argc number of arguments
- * @param argv array of char pointers for each argument
+ * @param opts the command-line settings, for the file names
 */
-static void processArgs(int argc, char const *argv[])
+static void badTag(Options const *opts)
 {
-  // Check for valid num of args
-  if (argc != NUM_ARGS) {
-    fprintf(stderr, "usage: decrypt <key-file> <input-file> <output-file>\n");
-    exit(EXIT_FAILURE);
-  }
+  fprintf(stderr, "Authentication failed: %s\n", opts->inputFile);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Prints an error for a container that isn't laid out properly and terminates the program.
+ * 
+ * @param opts the command-line settings, for the file names
+*/
+static void badFormat(Options const *opts)
+{
+  fprintf(stderr, "Bad container file: %s\n", opts->inputFile);
+  exit(EXIT_FAILURE);
 }
 
 /**
  * Checks the sizes of the given key and data inputs.
- * Terminates the program if keysize isn't exactly 16 bytes.
- * Terminates the program if datasize isn't a multiple of 16 bytes.
+ * Terminates the program if keysize isn't exactly 16 bytes, or 32 in XTS mode.
+ * Terminates the program if the input is a regular file whose size can't be
+ * valid: not a multiple of 16 bytes in ECB or CBC mode, ending in a sector
+ * shorter than a block in XTS mode, or too short to hold the header and
+ * trailer in the other modes. Containers and other inputs are
+ * checked as they're read.
  * 
  * @param keysize the size of the key (in bytes)
- * @param datasize the size of the input data (in bytes)
+ * @param input the open input file
+ * @param opts the command-line settings, for the file names
 */
-static void checkSizes(int keysize, int datasize, char const *argv[])
+static void checkSizes(size_t keysize, FILE *input, Options const *opts)
 {
   // Check the key size
-  if (keysize != BLOCK_SIZE) {
-    fprintf(stderr, "Bad key file: %s\n", argv[1]);
+  if (keysize != keySize(opts->mode)) {
+    fprintf(stderr, "Bad key file: %s\n", opts->keyFile);
     exit(EXIT_FAILURE);
   }
 
   // Check the data size
-  if (datasize % BLOCK_SIZE != 0) {
-    fprintf(stderr, "Bad ciphertext file length: %s", argv[2]);
-    exit(EXIT_FAILURE);
+  uint64_t datasize;
+  if (!opts->container && fileSize(input, &datasize)) {
+    size_t extra = headerSize(opts->mode) + trailerSize(opts->mode);
+
+    if (datasize < extra || (modePadded(opts->mode) && datasize % BLOCK_SIZE != 0) ||
+        (opts->mode == MODE_XTS && !xtsLengthValid(datasize, opts->sectorSize))) {
+      badLength(opts);
+    }
   }
 }
 
@@ -63,48 +101,130 @@ static void checkSizes(int keysize, int datasize, char const *argv[])
  */
 int main(int argc, char const *argv[])
 {
-  processArgs(argc, argv);
+  Options opts;
+  parseOptions(argc, argv, USAGE, &opts);
+  reportOptions(&opts);
+
+  // Only encrypt updates a container or an image in place, or takes a
+  // checksum; the checksum program checks the plaintext that comes out.
+  // Compressed plaintext is marked in the format header, so it isn't asked for
+  if (opts.incremental || opts.updating || opts.checksum || opts.compress) {
+    fprintf(stderr, "%s\n", USAGE);
+    exit(EXIT_FAILURE);
+  }
+
+  // Every file of a batch comes from its manifest
+  if (opts.batchFile) {
+    return runBatch(&opts, false);
+  }
 
-  int keysize = 0;
-  int datasize = 0;
+  size_t keysize = 0;
 
-  // Read the key and the data
-  byte *key = readBinaryFile(argv[1], &keysize);
-  byte *data = readBinaryFile(argv[2], &datasize);
+  // Read the key and open the data
+  byte *key = readBinaryFile(opts.keyFile, &keysize);
+  FILE *input = openFile(opts.inputFile, "rb");
+
+  // Opening the output would empty the input before it's been read
+  if (sameFile(input, opts.outputFile)) {
+    fprintf(stderr, "Input and output are the same file: %s\n", opts.outputFile);
+    exit(EXIT_FAILURE);
+  }
 
   // Check the sizes of the key and input data
-  checkSizes(keysize, datasize, argv);
+  checkSizes(keysize, input, &opts);
+
+  // Containers and XTS images have their own layout, without a format header
+  byte flags = 0;
+  if (!opts.container && opts.mode != MODE_XTS && !readFormatHeader(&input, &flags)) {
+    fprintf(stderr, "Unsupported file format: %s\n", opts.inputFile);
+    exit(EXIT_FAILURE);
+  }
+  bool compressed = flags & FORMAT_COMPRESSED;
+
+  // Expand the key once for the whole file
+  ThreadPool *pool = makePool(opts.threads);
+  Cipher cipher;
+  initCipher(&cipher, opts.mode, key, pool);
+  setSectorSize(&cipher, opts.sectorSize);
+  if (opts.kernel && !useKernel(&cipher)) {
+    fprintf(stderr, "Backend not supported on this machine: kernel\n");
+    exit(EXIT_FAILURE);
+  }
 
-  // Decrypt the data
-  byte data_copy[BLOCK_SIZE];
-  int byte16_sections = datasize / BLOCK_SIZE;
+  uint64_t datasize;
 
-  for (int i = 0; i < byte16_sections; i++) {
-    
-    // Copy 16 bytes of data at a time
-    for (int j = 0; j < BLOCK_SIZE; j++) {
-      data_copy[j] = *(data + (BLOCK_SIZE * i + j));
+  DecryptResult result;
+  if (opts.container) {
+    // Decrypt only the chunks that overlap the range
+    FILE *output = openFile(opts.outputFile, "wb");
+    result = decryptContainer(&cipher.ctx, pool, input, output, opts.rangeOffset, opts.rangeLength);
+    fclose(output);
+  }
+  else if (opts.ranged) {
+    // Decrypt only the sectors that overlap the range
+    FILE *output = openFile(opts.outputFile, "wb");
+    result = decryptSectors(&cipher, input, output, opts.rangeOffset, opts.rangeLength);
+    fclose(output);
+  }
+  else if (opts.inPlace && !compressed && fileSize(input, &datasize)) {
+    // Decrypt straight from the mapped input pages to the mapped output pages
+    result = decryptMapped(&cipher, input, opts.outputFile);
+  }
+  else if (opts.async && !compressed && fileSize(input, &datasize)) {
+    // Decrypt with the next read and the last write running in the background
+    result = decryptPipelined(&cipher, input, opts.outputFile, opts.asyncThreads);
+  }
+  else {
+    // Decrypt the input one chunk at a time into the output file. The output
+    // is written under another name, so an input that fails, even one only
+    // found to be forged at its end, leaves an old output alone.
+    Replacement output;
+    if (!openReplacement(&output, opts.outputFile)) {
+      fprintf(stderr, "Can't open file: %s\n", opts.outputFile);
+      exit(EXIT_FAILURE);
     }
 
-    decryptBlock(data_copy, key);
+    // Compressed plaintext is expanded on the way, but only once it's known
+    // to be authentic, so the expander never sees forged frames
+    if (compressed) {
+      bool failed = false;
+      FILE *expanded = openDecompressor(output.fp, pool, opts.inputFile, &failed);
+      result = decryptStreamSpooled(&cipher, input, expanded, opts.outputFile);
+
+      // Closing checks the end of a compressed stream, which only means
+      // anything if the decryption got there
+      failed = result != DECRYPT_OK;
+      fclose(expanded);
+    }
+    else {
+      result = decryptStream(&cipher, input, output.fp);
+    }
 
-    // Re-copy the decrypted 16 bytes
-    for (int j = 0; j < BLOCK_SIZE; j++) {
-      *(data + (BLOCK_SIZE * i + j)) = data_copy[j];
+    if (result == DECRYPT_OK) {
+      if (!commitReplacement(&output)) {
+        fprintf(stderr, "Can't write file: %s\n", opts.outputFile);
+        exit(EXIT_FAILURE);
+      }
+    }
+    else {
+      discardReplacement(&output);
     }
   }
 
-  // Remove the padding at the end
-  // and update the size
-  while (*(data + datasize - 1) == 0x00) {
-    datasize -= 1;
+  if (result == DECRYPT_BAD_LENGTH) {
+    badLength(&opts);
+  }
+  if (result == DECRYPT_BAD_TAG) {
+    badTag(&opts);
+  }
+  if (result == DECRYPT_BAD_FORMAT) {
+    badFormat(&opts);
   }
 
-  // Write the encryption to the given output file
-  writeBinaryFile(argv[3], data, datasize);
-
+  fclose(input);
+  releaseCipher(&cipher);
+  freePool(pool);
   free(key);
-  free(data);
 
   return EXIT_SUCCESS;
 }
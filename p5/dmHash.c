@@ -0,0 +1,249 @@
+/**
+ * @file dmHash.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * The Davies-Meyer checksum. Leaf i starts from a chain value holding i,
+ * and folds in its blocks, then a block holding the last partial block
+ * padded with 0x80 and zeros, then a block holding its length. The root
+ * starts from a chain value marked as the root, folds in the leaf digests
+ * in order, then a block holding the total length and the leaf count.
+ *
+ * Each thread takes a group of leaves and runs their chains side by side.
+ * With AES-NI, the key schedules run in registers alongside the rounds;
+ * with any other backend, each block goes through generateSubkeys() and
+ * the table rounds.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dmHash.h"
+#include "aesNi.h"
+#include "aesTable.h"
+
+/** Number of leaves a thread hashes side by side. */
+#define DM_LANES NI_MAX_KEYS
+
+/** Byte of the initial chain value that says whether it's a leaf or the root. */
+#define NODE_TYPE 8
+
+/** Marks the initial chain value of a leaf. */
+#define LEAF_NODE 0x00
+
+/** Marks the initial chain value of the root. */
+#define ROOT_NODE 0x01
+
+/** Marks the end of the message in the padding block. */
+#define PAD_MARKER 0x80
+
+/** Number of blocks folded in after the last whole block of a leaf: the padding and the length. */
+#define LEAF_TRAILER 2
+
+/**
+ * Stores a number big-endian in the first 8 bytes of a block.
+ *
+ * @param block the block to store into
+ * @param value the number to store
+*/
+static void putCount( byte *block, uint64_t value )
+{
+  for (int i = 0; i < (int) sizeof(uint64_t); i++) {
+    block[i] = value >> ( ( sizeof(uint64_t) - 1 - i ) * BBITS );
+  }
+}
+
+/**
+ * Folds message blocks into several chains, each with its own message.
+ *
+ * @param chains the chain value of each lane
+ * @param msgs the message of each lane
+ * @param nlanes number of lanes, at most DM_LANES
+ * @param nblocks number of blocks in each message
+*/
+static void compressLanes( byte chains[][ BLOCK_SIZE ], byte const *const msgs[], int nlanes,
+                           size_t nblocks )
+{
+  if (niSelected()) {
+    niDaviesMeyer(chains, msgs, nlanes, nblocks);
+    return;
+  }
+
+  // Only the encryption subkeys are needed, so the rest stay zero
+  AesContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  byte work[BLOCK_SIZE];
+
+  for (int j = 0; j < nlanes; j++) {
+    for (size_t b = 0; b < nblocks; b++) {
+      generateSubkeys(ctx.subkey, msgs[j] + b * BLOCK_SIZE);
+      tableExpandKey(&ctx);
+      tableEncryptBlocks(&ctx, chains[j], work, 1);
+      for (int i = 0; i < BLOCK_SIZE; i++) {
+        chains[j][i] ^= work[i];
+      }
+    }
+  }
+}
+
+/**
+ * Hashes a group of leaves of the same length, side by side.
+ *
+ * @param data the first leaf, with the others right after it
+ * @param len number of bytes in each leaf
+ * @param first number of the first leaf
+ * @param count number of leaves, at most DM_LANES
+ * @param digests filled in with the digest of each leaf
+*/
+static void hashLeaves( byte const *data, size_t len, uint64_t first, int count, byte *digests )
+{
+  byte chains[DM_LANES][BLOCK_SIZE];
+  byte trailers[DM_LANES][LEAF_TRAILER * BLOCK_SIZE];
+  byte const *msgs[DM_LANES] = { NULL };
+  size_t whole = len / BLOCK_SIZE;
+  size_t tail = len % BLOCK_SIZE;
+
+  for (int j = 0; j < count; j++) {
+    memset(chains[j], 0, BLOCK_SIZE);
+    putCount(chains[j], first + j);
+    chains[j][NODE_TYPE] = LEAF_NODE;
+    msgs[j] = data + j * len;
+  }
+  compressLanes(chains, msgs, count, whole);
+
+  // The padding keeps a leaf from hashing the same as one with a zero byte added
+  for (int j = 0; j < count; j++) {
+    memset(trailers[j], 0, sizeof(trailers[j]));
+    memcpy(trailers[j], msgs[j] + whole * BLOCK_SIZE, tail);
+    trailers[j][tail] = PAD_MARKER;
+    putCount(trailers[j] + BLOCK_SIZE, len);
+    msgs[j] = trailers[j];
+  }
+  compressLanes(chains, msgs, count, LEAF_TRAILER);
+
+  memcpy(digests, chains, count * BLOCK_SIZE);
+}
+
+/** Everything a thread needs to hash its groups of leaves. */
+typedef struct {
+  /** The leaves, all full. */
+  byte const *data;
+
+  /** Number of leaves. */
+  size_t count;
+
+  /** Number of the first leaf in the whole input. */
+  uint64_t first;
+
+  /** Where to store the digest of each leaf. */
+  byte *digests;
+} LeafJob;
+
+/**
+ * Hashes one group of leaves of a LeafJob.
+ *
+ * @param arg the LeafJob being worked on
+ * @param index number of the group to hash
+*/
+static void leafGroup( void *arg, size_t index )
+{
+  LeafJob *job = arg;
+  size_t start = index * DM_LANES;
+  size_t count = job->count - start < DM_LANES ? job->count - start : DM_LANES;
+
+  hashLeaves(job->data + start * DM_LEAF_SIZE, DM_LEAF_SIZE, job->first + start, count,
+             job->digests + start * DM_HASH_SIZE);
+}
+
+/**
+ * Folds leaf digests into the root, in order.
+ *
+ * @param hash the checksum to fold them into
+ * @param digests the digests
+ * @param count number of digests
+*/
+static void foldLeaves( DmHash *hash, byte const *digests, size_t count )
+{
+  byte const *msgs[1] = { digests };
+  compressLanes(&hash->chain, msgs, 1, count);
+  hash->leaves += count;
+}
+
+void dmHashInit( DmHash *hash )
+{
+  memset(hash->chain, 0, DM_HASH_SIZE);
+  hash->chain[NODE_TYPE] = ROOT_NODE;
+  hash->leaves = 0;
+  hash->length = 0;
+  hash->pending = malloc(DM_LEAF_SIZE);
+  hash->pendingLen = 0;
+  hash->capacity = 1;
+  hash->digests = malloc(hash->capacity * DM_HASH_SIZE);
+}
+
+void dmHashUpdate( DmHash *hash, ThreadPool *pool, byte const *data, size_t len )
+{
+  hash->length += len;
+
+  // Finish off a leaf started by an earlier update first
+  if (hash->pendingLen > 0) {
+    size_t n = DM_LEAF_SIZE - hash->pendingLen < len ? DM_LEAF_SIZE - hash->pendingLen : len;
+    memcpy(hash->pending + hash->pendingLen, data, n);
+    hash->pendingLen += n;
+    data += n;
+    len -= n;
+
+    if (hash->pendingLen < DM_LEAF_SIZE) {
+      return;
+    }
+
+    byte digest[DM_HASH_SIZE];
+    hashLeaves(hash->pending, DM_LEAF_SIZE, hash->leaves, 1, digest);
+    foldLeaves(hash, digest, 1);
+    hash->pendingLen = 0;
+  }
+
+  size_t count = len / DM_LEAF_SIZE;
+  if (count > 0) {
+    if (count > hash->capacity) {
+      hash->capacity = count;
+      hash->digests = realloc(hash->digests, hash->capacity * DM_HASH_SIZE);
+    }
+
+    LeafJob job = { data, count, hash->leaves, hash->digests };
+    runPool(pool, leafGroup, &job, ( count + DM_LANES - 1 ) / DM_LANES);
+    foldLeaves(hash, hash->digests, count);
+  }
+
+  // Whatever is left starts the next leaf
+  hash->pendingLen = len - count * DM_LEAF_SIZE;
+  memcpy(hash->pending, data + count * DM_LEAF_SIZE, hash->pendingLen);
+}
+
+void dmHashFinish( DmHash *hash, byte digest[ DM_HASH_SIZE ] )
+{
+  // A partial last leaf still has to be hashed, and an empty input is one empty leaf
+  if (hash->pendingLen > 0 || hash->leaves == 0) {
+    byte leaf[DM_HASH_SIZE];
+    hashLeaves(hash->pending, hash->pendingLen, hash->leaves, 1, leaf);
+    foldLeaves(hash, leaf, 1);
+  }
+
+  byte length[BLOCK_SIZE];
+  putCount(length, hash->length);
+  putCount(length + sizeof(uint64_t), hash->leaves);
+  byte const *msgs[1] = { length };
+  compressLanes(&hash->chain, msgs, 1, 1);
+
+  memcpy(digest, hash->chain, DM_HASH_SIZE);
+
+  free(hash->pending);
+  free(hash->digests);
+  hash->pending = hash->digests = NULL;
+}
+
+void printDigest( FILE *fp, byte const digest[ DM_HASH_SIZE ] )
+{
+  for (int i = 0; i < DM_HASH_SIZE; i++) {
+    fprintf(fp, "%02x", digest[i]);
+  }
+}
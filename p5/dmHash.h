@@ -0,0 +1,89 @@
+/**
+ * @file dmHash.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for a 128-bit checksum built on AES with the
+ * Davies-Meyer construction, where each message block is the key that
+ * encrypts the chain value. The input is split into fixed-size leaves that
+ * are hashed independently, so they can be spread across threads, and the
+ * leaf digests are hashed in order to get the checksum. The leaf size
+ * doesn't depend on the number of threads, so neither does the checksum.
+ *
+ * The checksum is meant for catching corruption, not tampering: with a
+ * 128-bit chain, collisions can be found with about 2^64 work.
+ */
+
+#ifndef _DM_HASH_H_
+#define _DM_HASH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "aes.h"
+#include "pool.h"
+
+/** Number of bytes in a checksum. */
+#define DM_HASH_SIZE BLOCK_SIZE
+
+/** Number of bytes in each leaf. Only the last leaf can be shorter. */
+#define DM_LEAF_SIZE ( 16 * 1024 )
+
+/** State of a checksum in progress. */
+typedef struct {
+  /** Chain value of the root, with every finished leaf folded in. */
+  byte chain[ DM_HASH_SIZE ];
+
+  /** Number of leaves folded into the root. */
+  uint64_t leaves;
+
+  /** Number of bytes hashed so far. */
+  uint64_t length;
+
+  /** The start of a leaf that isn't full yet. */
+  byte *pending;
+
+  /** Number of bytes in pending. */
+  size_t pendingLen;
+
+  /** Room for the digests of the leaves in one update. */
+  byte *digests;
+
+  /** Number of digests there's room for. */
+  size_t capacity;
+} DmHash;
+
+/**
+ * Starts a new checksum.
+ *
+ * @param hash the state to set up
+*/
+void dmHashInit( DmHash *hash );
+
+/**
+ * Adds bytes to a checksum. The whole leaves among them are hashed in
+ * parallel on the pool. Bytes can be added in pieces of any size, and the
+ * checksum is the same as if they were added all at once.
+ *
+ * @param hash the checksum to add to
+ * @param pool the pool to run on
+ * @param data the bytes to add
+ * @param len number of bytes to add
+*/
+void dmHashUpdate( DmHash *hash, ThreadPool *pool, byte const *data, size_t len );
+
+/**
+ * Finishes a checksum and frees the memory of its state.
+ *
+ * @param hash the checksum to finish
+ * @param digest filled in with the checksum
+*/
+void dmHashFinish( DmHash *hash, byte digest[ DM_HASH_SIZE ] );
+
+/**
+ * Prints a checksum as hexadecimal digits.
+ *
+ * @param fp the file to print to
+ * @param digest the checksum to print
+*/
+void printDigest( FILE *fp, byte const digest[ DM_HASH_SIZE ] );
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file drbg.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for a deterministic random bit generator built on
+ * AES in counter mode (CTR_DRBG from NIST SP 800-90A, with AES-128 and no
+ * derivation function). Given a seed, it produces a stream of bytes that
+ * can't be told apart from random without knowing the seed.
+ */
+
+#ifndef _DRBG_H_
+#define _DRBG_H_
+
+#include <stdint.h>
+#include "aes.h"
+
+/** Number of bytes of seed material: a new key, then a new counter block. */
+#define DRBG_SEED_SIZE ( 2 * BLOCK_SIZE )
+
+/** Most bytes produced under one key before the key is replaced. */
+#define DRBG_MAX_REQUEST ( 64 * 1024 )
+
+/** State of one generator. */
+typedef struct {
+  /** The expanded current key. */
+  AesContext ctx;
+
+  /** The current counter block, a 128-bit big-endian number. */
+  byte v[ BLOCK_SIZE ];
+
+  /** Number of bytes generated since the generator was last seeded. */
+  uint64_t sinceReseed;
+} Drbg;
+
+/**
+ * Sets up a generator from the given seed.
+ *
+ * @param drbg the generator to set up
+ * @param seed the seed material, which should come from a true random source
+*/
+void drbgInit( Drbg *drbg, byte const seed[ DRBG_SEED_SIZE ] );
+
+/**
+ * Mixes new seed material into a generator, so bytes generated after it
+ * can't be worked out from the state before it.
+ *
+ * @param drbg the generator to reseed
+ * @param seed the new seed material
+*/
+void drbgReseed( Drbg *drbg, byte const seed[ DRBG_SEED_SIZE ] );
+
+/**
+ * Generates random bytes. The key is replaced after every DRBG_MAX_REQUEST
+ * bytes and at the end of the call, so the output up to now can't be
+ * worked out from the state that's left behind.
+ *
+ * @param drbg the generator to use
+ * @param out the array to fill
+ * @param len number of bytes to generate
+*/
+void drbgGenerate( Drbg *drbg, byte *out, size_t len );
+
+#endif
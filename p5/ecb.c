@@ -0,0 +1,65 @@
+/**
+ * @file ecb.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Electronic codebook mode on a thread pool. The blocks are split into
+ * large slices, and each thread hands its slices to the AES backend in
+ * one call, so the backend can interleave as many blocks as it likes.
+ */
+
+#include "ecb.h"
+
+/** Size of each slice handed to a thread, in bytes. A multiple of BLOCK_SIZE. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+/** Everything a thread needs to process its slices of an ECB job. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+
+  /** Blocks to process. */
+  byte const *in;
+
+  /** Where to store the results. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+} EcbJob;
+
+/**
+ * Processes one slice of an ECB job.
+ * 
+ * @param arg the EcbJob being worked on
+ * @param index number of the slice to process
+*/
+static void ecbSlice( void *arg, size_t index )
+{
+  EcbJob *job = arg;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+
+  if (job->encrypt) {
+    aesEncryptBlocks(job->ctx, job->in + start, job->out + start, len / BLOCK_SIZE);
+  }
+  else {
+    aesDecryptBlocks(job->ctx, job->in + start, job->out + start, len / BLOCK_SIZE);
+  }
+}
+
+void ecbEncryptParallel( ThreadPool *pool, AesContext const *ctx,
+                         byte const *in, byte *out, size_t len )
+{
+  EcbJob job = { ctx, true, in, out, len };
+  runPool(pool, ecbSlice, &job, (len + SLICE_SIZE - 1) / SLICE_SIZE);
+}
+
+void ecbDecryptParallel( ThreadPool *pool, AesContext const *ctx,
+                         byte const *in, byte *out, size_t len )
+{
+  EcbJob job = { ctx, false, in, out, len };
+  runPool(pool, ecbSlice, &job, (len + SLICE_SIZE - 1) / SLICE_SIZE);
+}
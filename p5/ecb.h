@@ -0,0 +1,41 @@
+/**
+ * @file ecb.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for electronic codebook (ECB) mode spread across
+ * threads. Every block is encrypted on its own, so any split of the
+ * blocks between threads gives the same result.
+ */
+
+#ifndef _ECB_H_
+#define _ECB_H_
+
+#include <stddef.h>
+#include "aes.h"
+#include "pool.h"
+
+/**
+ * Encrypts whole blocks, with large slices running in parallel on the given pool.
+ * 
+ * @param pool the pool to run on
+ * @param ctx the expanded key
+ * @param in the blocks to encrypt
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to encrypt, a multiple of BLOCK_SIZE
+*/
+void ecbEncryptParallel( ThreadPool *pool, AesContext const *ctx,
+                         byte const *in, byte *out, size_t len );
+
+/**
+ * Decrypts whole blocks, with large slices running in parallel on the given pool.
+ * 
+ * @param pool the pool to run on
+ * @param ctx the expanded key
+ * @param in the blocks to decrypt
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to decrypt, a multiple of BLOCK_SIZE
+*/
+void ecbDecryptParallel( ThreadPool *pool, AesContext const *ctx,
+                         byte const *in, byte *out, size_t len );
+
+#endif
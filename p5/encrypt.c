@@ -9,65 +9,38 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
 
 #include "io.h"
 #include "aes.h"
-
-/** Valid number of arguments */
-#define NUM_ARGS 4
-
-/**
- * Parses the given command-line arguments
- * 
- * @param argc number of arguments
- * @param argv array of char pointers for each argument
-*/
-static void processArgs(int argc, char const *argv[])
-{
-  // Check for valid num of args
-  if (argc != NUM_ARGS) {
-    fprintf(stderr, "usage: encrypt <key-file> <input-file> <output-file>\n");
-    exit(EXIT_FAILURE);
-  }
-}
+#include "options.h"
+#include "cipher.h"
+#include "stream.h"
+#include "mapped.h"
+#include "pipeline.h"
+#include "container.h"
+#include "sector.h"
+#include "pool.h"
+#include "batch.h"
+#include "dmHash.h"
+#include "compress.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: encrypt <key-file> <input-file> <output-file>"
 
 /**
- * Checks the sizes of the given key and data inputs.
- * Terminates the program if keysize isn't exactly 16 bytes.
- * Terminates the program if datasize isn't a multiple of 16 bytes.
+ * Checks the size of the given key.
+ * Terminates the program if keysize isn't exactly 16 bytes, or 32 in XTS mode.
  * 
  * @param keysize the size of the key (in bytes)
- * @param datasize the size of the input data (in bytes)
+ * @param opts the command-line settings, for the file names
 */
-static void checkSizes(int keysize, int *datasize, byte *data, char const *argv[])
+static void checkKeySize(size_t keysize, Options const *opts)
 {
-  // Check the key size
-  if (keysize != BLOCK_SIZE) {
-    fprintf(stderr, "Bad key file: %s\n", argv[1]);
+  if (keysize != keySize(opts->mode)) {
+    fprintf(stderr, "Bad key file: %s\n", opts->keyFile);
     exit(EXIT_FAILURE);
   }
-
-  // Check the data size
-  if ((*datasize) % BLOCK_SIZE != 0) {
-    // Add padding at the end
-    int remainder = (*datasize) % BLOCK_SIZE;
-    int padding = BLOCK_SIZE - remainder;
-    // Calculate the new size
-    size_t new_size = (*datasize) + padding;
-    // Reallocate memory
-    data = realloc(data, new_size);
-
-    // Pad the data
-    for (int i = (*datasize); i < new_size; i++) {
-      *(data + i) = 0x00;
-    }
-
-    // Update data size
-    *datasize = new_size;
-
-    // fprintf(stderr, "Bad plaintext file length: %s", argv[2]);
-    // exit(EXIT_FAILURE);
-  }
 }
 
 /**
@@ -79,42 +52,137 @@ static void checkSizes(int keysize, int *datasize, byte *data, char const *argv[
  */
 int main(int argc, char const *argv[])
 {
-  processArgs(argc, argv);
+  Options opts;
+  parseOptions(argc, argv, USAGE, &opts);
+  reportOptions(&opts);
 
-  int keysize = 0;
-  int datasize = 0;
+  // Every file of a batch comes from its manifest
+  if (opts.batchFile) {
+    return runBatch(&opts, true);
+  }
 
-  // Read the key and the data
-  byte *key = readBinaryFile(argv[1], &keysize);
-  byte *data = readBinaryFile(argv[2], &datasize);
+  // Ranges only make sense for decryption
+  if (opts.ranged) {
+    fprintf(stderr, "%s\n", USAGE);
+    exit(EXIT_FAILURE);
+  }
 
-  // Check the sizes of the key and input data
-  checkSizes(keysize, &datasize, data, argv);
+  size_t keysize = 0;
 
-  // Encrypt the data
-  byte data_copy[BLOCK_SIZE];
-  int byte16_sections = datasize / BLOCK_SIZE;
+  // Read the key and open the data
+  byte *key = readBinaryFile(opts.keyFile, &keysize);
+  FILE *input = openFile(opts.inputFile, "rb");
 
-  for (int i = 0; i < byte16_sections; i++) {
-    
-    // Copy 16 bytes of data at a time
-    for (int j = 0; j < BLOCK_SIZE; j++) {
-      data_copy[j] = *(data + (BLOCK_SIZE * i + j));
-    }
+  // Check the size of the key
+  checkKeySize(keysize, &opts);
 
-    encryptBlock(data_copy, key);
+  // Opening the output would empty the input before it's been read
+  if (sameFile(input, opts.outputFile)) {
+    fprintf(stderr, "Input and output are the same file: %s\n", opts.outputFile);
+    exit(EXIT_FAILURE);
+  }
 
-    // Re-copy the encrypted 16 bytes
-    for (int j = 0; j < BLOCK_SIZE; j++) {
-      *(data + (BLOCK_SIZE * i + j)) = data_copy[j];
+  // An XTS image can't end in a sector shorter than a block. A regular file
+  // shows that before anything is written, and anything else is caught at its end.
+  uint64_t datasize;
+  if (opts.mode == MODE_XTS && !opts.updating && fileSize(input, &datasize) &&
+      !xtsLengthValid(datasize, opts.sectorSize)) {
+    fprintf(stderr, "Last sector would be shorter than a block: %s\n", opts.inputFile);
+    exit(EXIT_FAILURE);
+  }
+
+  // Expand the key once for the whole file
+  ThreadPool *pool = makePool(opts.threads);
+  Cipher cipher;
+  initCipher(&cipher, opts.mode, key, pool);
+  setSectorSize(&cipher, opts.sectorSize);
+  if (opts.kernel && !useKernel(&cipher)) {
+    fprintf(stderr, "Backend not supported on this machine: kernel\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Take the checksum of the plaintext on its way through the cipher
+  DmHash sum;
+  if (opts.checksum) {
+    dmHashInit(&sum);
+    cipher.checksum = &sum;
+  }
+
+  if (opts.incremental) {
+    // Write only the chunks that changed since the last run
+    uint64_t written = updateContainer(&cipher.ctx, pool, opts.chunkSize, input, opts.outputFile);
+    if (opts.verbose) {
+      fprintf(stderr, "Chunks written: %" PRIu64 "\n", written);
+    }
+  }
+  else if (opts.updating) {
+    // Encrypt only the sectors of the image the input lands in
+    SectorResult result = updateSectors(&cipher, input, opts.outputFile, opts.updateOffset);
+    if (result == SECTORS_PAST_END) {
+      fprintf(stderr, "Offset past the end of the image: %s\n", opts.outputFile);
+      exit(EXIT_FAILURE);
+    }
+    if (result == SECTORS_SHORT) {
+      fprintf(stderr, "Last sector would be shorter than a block: %s\n", opts.outputFile);
+      exit(EXIT_FAILURE);
+    }
+  }
+  else if (opts.container) {
+    // Encrypt each chunk on its own, with an index so it can be found again
+    FILE *output = openFile(opts.outputFile, "wb");
+    encryptContainer(&cipher.ctx, pool, opts.chunkSize, input, output);
+    fclose(output);
+
+    // A manifest from an earlier incremental run no longer describes it
+    removeManifest(opts.outputFile);
+  }
+  else if (opts.inPlace && fileSize(input, &datasize)) {
+    // Encrypt straight from the mapped input pages to the mapped output pages
+    encryptMapped(&cipher, input, opts.outputFile);
+  }
+  else if (opts.async && fileSize(input, &datasize)) {
+    // Encrypt with the next read and the last write running in the background
+    encryptPipelined(&cipher, input, opts.outputFile, opts.asyncThreads);
+  }
+  else if (opts.compress) {
+    // Compress the input a batch of frames at a time on its way into the cipher,
+    // after a format header that tells decrypt to expand it again. The checksum
+    // is of the plaintext, so it's taken before compression
+    FILE *output = openFile(opts.outputFile, "wb");
+    writeFormatHeader(output, FORMAT_COMPRESSED);
+    FILE *compressed = openCompressor(input, pool, cipher.checksum);
+    cipher.checksum = NULL;
+    encryptStream(&cipher, compressed, output);
+    fclose(compressed);
+    fclose(output);
+  }
+  else {
+    // Encrypt the input one chunk at a time into the output file, which only
+    // replaces an earlier one if the whole input makes it through
+    Replacement output;
+    if (!openReplacement(&output, opts.outputFile)) {
+      fprintf(stderr, "Can't open file: %s\n", opts.outputFile);
+      exit(EXIT_FAILURE);
+    }
+    encryptStream(&cipher, input, output.fp);
+    if (!commitReplacement(&output)) {
+      fprintf(stderr, "Can't write file: %s\n", opts.outputFile);
+      exit(EXIT_FAILURE);
     }
   }
 
-  // Write the encryption to the given output file
-  writeBinaryFile(argv[3], data, datasize);
+  // Printed the same way as by the checksum program, so the two can be compared
+  if (opts.checksum) {
+    byte digest[DM_HASH_SIZE];
+    dmHashFinish(&sum, digest);
+    printDigest(stdout, digest);
+    printf("  %s\n", opts.inputFile);
+  }
 
+  fclose(input);
+  releaseCipher(&cipher);
+  freePool(pool);
   free(key);
-  free(data);
 
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,116 @@
+/**
+ * @file erasure.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Reed-Solomon erasure coding with a systematic Cauchy matrix. The k data
+ * shards are stored as they are, and each parity shard is a combination of
+ * them with coefficients from the Cauchy matrix. The k shards that survive
+ * pick out k rows of the whole coding matrix, and the inverse of those rows
+ * turns the survivors back into the data.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "erasure.h"
+
+void parityMatrix( int k, int m, byte *matrix )
+{
+  // The row and column elements are all different, so no sum is zero
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j < k; j++) {
+      matrix[i * k + j] = fieldInv(fieldAdd(k + i, j));
+    }
+  }
+}
+
+/**
+ * Inverts an n x n matrix in place by Gauss-Jordan elimination.
+ *
+ * @param matrix the matrix to invert, one row after another
+ * @param n number of rows and columns
+ * @return false if the matrix can't be inverted, leaving it partly reduced
+*/
+static bool invertMatrix( byte *matrix, int n )
+{
+  byte *inverse = calloc(n * n, 1);
+  for (int i = 0; i < n; i++) {
+    inverse[i * n + i] = 1;
+  }
+
+  for (int col = 0; col < n; col++) {
+    // Find a row with a nonzero pivot and swap it into place
+    int pivot = col;
+    while (pivot < n && matrix[pivot * n + col] == 0) {
+      pivot++;
+    }
+    if (pivot == n) {
+      free(inverse);
+      return false;
+    }
+
+    for (int j = 0; j < n; j++) {
+      byte t = matrix[col * n + j];
+      matrix[col * n + j] = matrix[pivot * n + j];
+      matrix[pivot * n + j] = t;
+
+      t = inverse[col * n + j];
+      inverse[col * n + j] = inverse[pivot * n + j];
+      inverse[pivot * n + j] = t;
+    }
+
+    // Scale the pivot row so the pivot is 1
+    byte scale = fieldInv(matrix[col * n + col]);
+    for (int j = 0; j < n; j++) {
+      matrix[col * n + j] = fieldMul(matrix[col * n + j], scale);
+      inverse[col * n + j] = fieldMul(inverse[col * n + j], scale);
+    }
+
+    // Clear the rest of the column; subtraction is the same as addition
+    for (int i = 0; i < n; i++) {
+      byte factor = matrix[i * n + col];
+      if (i != col && factor != 0) {
+        for (int j = 0; j < n; j++) {
+          matrix[i * n + j] ^= fieldMul(matrix[col * n + j], factor);
+          inverse[i * n + j] ^= fieldMul(inverse[col * n + j], factor);
+        }
+      }
+    }
+  }
+
+  memcpy(matrix, inverse, n * n);
+  free(inverse);
+  return true;
+}
+
+bool recoveryMatrix( int k, int m, int const indices[], byte *matrix )
+{
+  byte *parity = malloc(m * k);
+  parityMatrix(k, m, parity);
+
+  // Each available shard contributes its row of the coding matrix: the
+  // identity on top for the data shards, the parity matrix underneath
+  for (int t = 0; t < k; t++) {
+    if (indices[t] < k) {
+      memset(matrix + t * k, 0, k);
+      matrix[t * k + indices[t]] = 1;
+    }
+    else {
+      memcpy(matrix + t * k, parity + (indices[t] - k) * k, k);
+    }
+  }
+
+  free(parity);
+  return invertMatrix(matrix, k);
+}
+
+void applyMatrix( byte const *matrix, int rows, int cols,
+                  byte const *const in[], byte *const out[], size_t len )
+{
+  for (int r = 0; r < rows; r++) {
+    fieldMulVec(out[r], in[0], matrix[r * cols], len);
+    for (int c = 1; c < cols; c++) {
+      fieldMulAddVec(out[r], in[c], matrix[r * cols + c], len);
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file erasure.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for Reed-Solomon erasure coding over the 8-bit
+ * Galois field used by AES. Data is split into k data shards, and m parity
+ * shards are computed from them, so that any k of the k + m shards are
+ * enough to get the data back.
+ */
+
+#ifndef _ERASURE_H_
+#define _ERASURE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "field.h"
+
+/** Most shards a code can have, data and parity together, since each needs its own field element. */
+#define MAX_SHARDS 256
+
+/**
+ * Fills in the m x k Cauchy matrix that computes the parity shards from
+ * the data shards. Entry (i, j) is the inverse of ( k + i ) + j. Every
+ * square submatrix of a Cauchy matrix can be inverted, which is what lets
+ * any k shards stand in for the data.
+ *
+ * @param k number of data shards
+ * @param m number of parity shards, with k + m at most MAX_SHARDS
+ * @param matrix filled in with the m x k matrix, one row after another
+*/
+void parityMatrix( int k, int m, byte *matrix );
+
+/**
+ * Fills in the k x k matrix that recovers the data shards from the given
+ * k shards. Row j gives data shard j in terms of the shards listed.
+ *
+ * @param k number of data shards
+ * @param m number of parity shards
+ * @param indices the index of each of the k shards available, all different
+ * @param matrix filled in with the k x k matrix, one row after another
+ * @return false if the indices aren't all different, so the data can't be recovered
+*/
+bool recoveryMatrix( int k, int m, int const indices[], byte *matrix );
+
+/**
+ * Multiplies a matrix by a set of equal-length buffers: out[ r ] is the sum
+ * of matrix( r, c ) times in[ c ] for every column c.
+ *
+ * @param matrix the rows x cols matrix, one row after another
+ * @param rows number of rows, and of output buffers
+ * @param cols number of columns, and of input buffers
+ * @param in the input buffers
+ * @param out the output buffers, which must not overlap the input
+ * @param len length of every buffer, in bytes
+*/
+void applyMatrix( byte const *matrix, int rows, int cols,
+                  byte const *const in[], byte *const out[], size_t len );
+
+#endif
@@ -0,0 +1,146 @@
+/**
+  @file erasureTest.c
+  @author Canaan Matias (ctmatias)
+  Unit test program for the erasure coding component.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "erasure.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 5
+
+/** Data shards in the test code. */
+#define K 4
+
+/** Parity shards in the test code. */
+#define M 3
+
+/** Length of each test shard, not a multiple of any register size. */
+#define LEN 301
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+int main()
+{
+  // Shards 0 to K - 1 hold the data, and the rest hold the parity
+  static byte shards[ K + M ][ LEN ];
+  for ( int i = 0; i < K; i++ )
+    for ( int j = 0; j < LEN; j++ )
+      shards[ i ][ j ] = i * 31 + j * 7 + 1;
+
+  byte parity[ M * K ];
+  parityMatrix( K, M, parity );
+
+  byte const *data[ K ];
+  byte *checks[ M ];
+  for ( int i = 0; i < K; i++ )
+    data[ i ] = shards[ i ];
+  for ( int i = 0; i < M; i++ )
+    checks[ i ] = shards[ K + i ];
+  applyMatrix( parity, M, K, data, checks, LEN );
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test parityMatrix() on a small code worked out by hand: entry (i, j)
+  // is the inverse of ( 2 + i ) + j.
+
+  {
+    byte small[ 2 * 2 ];
+    parityMatrix( 2, 2, small );
+    TestCase( small[ 0 ] == fieldInv( 0x02 ) && small[ 1 ] == fieldInv( 0x03 ) &&
+              small[ 2 ] == fieldInv( 0x03 ) && small[ 3 ] == fieldInv( 0x02 ) );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that every choice of K shards out of K + M gets the data back.
+
+  {
+    int failures = 0;
+    int choices = 0;
+    for ( int mask = 0; mask < 1 << ( K + M ); mask++ ) {
+      if ( __builtin_popcount( mask ) != K )
+        continue;
+      choices++;
+
+      int indices[ K ];
+      byte const *in[ K ];
+      int n = 0;
+      for ( int i = 0; i < K + M; i++ )
+        if ( mask & 1 << i ) {
+          indices[ n ] = i;
+          in[ n ] = shards[ i ];
+          n++;
+        }
+
+      byte recovery[ K * K ];
+      static byte rebuilt[ K ][ LEN ];
+      byte *out[ K ];
+      for ( int i = 0; i < K; i++ )
+        out[ i ] = rebuilt[ i ];
+
+      if ( !recoveryMatrix( K, M, indices, recovery ) ) {
+        failures++;
+        continue;
+      }
+      applyMatrix( recovery, K, K, in, out, LEN );
+
+      for ( int i = 0; i < K; i++ )
+        if ( memcmp( rebuilt[ i ], shards[ i ], LEN ) != 0 ) {
+          failures++;
+          break;
+        }
+    }
+
+    // 7 choose 4
+    TestCase( choices == 35 );
+    TestCase( failures == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that the data shards alone give the identity, and that a repeated
+  // shard is rejected.
+
+  {
+    int indices[ K ] = { 0, 1, 2, 3 };
+    byte recovery[ K * K ];
+    recoveryMatrix( K, M, indices, recovery );
+    int wrong = 0;
+    for ( int i = 0; i < K; i++ )
+      for ( int j = 0; j < K; j++ )
+        if ( recovery[ i * K + j ] != ( i == j ) )
+          wrong++;
+    TestCase( wrong == 0 );
+
+    int repeated[ K ] = { 0, 4, 4, 5 };
+    TestCase( !recoveryMatrix( K, M, repeated, recovery ) );
+  }
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
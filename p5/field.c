@@ -7,6 +7,7 @@
  */
 
 #include "field.h"
+#include "fieldTables.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -93,10 +94,75 @@ static byte fieldMulPhase2( unsigned short value )
   return value_copy;
 }
 
-byte fieldMul( byte a, byte b )
+byte fieldMulReference( byte a, byte b )
 {
   // Phase 1: compute a 16-bit result
   unsigned short result = fieldMulPhase1(a, b);
   // Phase 2: compress it to 8-bits
   return fieldMulPhase2(result);
 }
+
+byte fieldMul( byte a, byte b )
+{
+  if (a == 0 || b == 0) {
+    return 0;
+  }
+
+  // Multiplying powers of the generator adds their exponents
+  return fieldExp[fieldLog[a] + fieldLog[b]];
+}
+
+byte fieldInv( byte a )
+{
+  // The powers repeat every 255 steps, so the inverse of g^i is g^(255 - i)
+  return fieldExp[FIELD_SIZE - 1 - fieldLog[a]];
+}
+
+/**
+ * Multiplies by x, reducing if the result overflows 8 bits
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x02
+*/
+static byte xtime( byte a )
+{
+  return (a << 1) ^ ((a >> (BBITS - 1)) * (REDUCER & 0xFF));
+}
+
+byte fieldMul2( byte a )
+{
+  return xtime(a);
+}
+
+byte fieldMul3( byte a )
+{
+  return xtime(a) ^ a;
+}
+
+byte fieldMul9( byte a )
+{
+  // 0x09 = 0x08 + 0x01
+  return xtime(xtime(xtime(a))) ^ a;
+}
+
+byte fieldMul11( byte a )
+{
+  // 0x0B = 0x08 + 0x02 + 0x01
+  byte a2 = xtime(a);
+  return xtime(xtime(a2)) ^ a2 ^ a;
+}
+
+byte fieldMul13( byte a )
+{
+  // 0x0D = 0x08 + 0x04 + 0x01
+  byte a4 = xtime(xtime(a));
+  return xtime(a4) ^ a4 ^ a;
+}
+
+byte fieldMul14( byte a )
+{
+  // 0x0E = 0x08 + 0x04 + 0x02
+  byte a2 = xtime(a);
+  byte a4 = xtime(a2);
+  return xtime(a4) ^ a4 ^ a2;
+}
@@ -9,6 +9,8 @@
 #ifndef _FIELD_H_
 #define _FIELD_H_
 
+#include <stddef.h>
+
 /** Type used for our field, an unsigned byte. */
 typedef unsigned char byte;
 
@@ -40,7 +42,8 @@ byte fieldAdd( byte a, byte b );
 byte fieldSub( byte a, byte b );
 
 /**
- * Performs the multiplication operation in the 8-bit Galois field used by AES
+ * Performs the multiplication operation in the 8-bit Galois field used by AES,
+ * by adding the logs of a and b and looking up the result in the exp table.
  * 
  * @param a the first byte to multiply
  * @param b the second byte to multiply
@@ -48,4 +51,104 @@ byte fieldSub( byte a, byte b );
 */
 byte fieldMul( byte a, byte b );
 
+/**
+ * Finds the multiplicative inverse in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to invert, which must not be zero
+ * @return the byte whose product with a is 0x01
+*/
+byte fieldInv( byte a );
+
+/**
+ * Performs the multiplication operation in the 8-bit Galois field used by AES
+ * the long way: a carry-less multiply followed by a reduction. This is slow,
+ * but it's the definition the faster versions are checked against.
+ * 
+ * @param a the first byte to multiply
+ * @param b the second byte to multiply
+ * @return the product of a and b
+*/
+byte fieldMulReference( byte a, byte b );
+
+/**
+ * Multiplies by 0x02 in the 8-bit Galois field used by AES (the xtime operation).
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x02
+*/
+byte fieldMul2( byte a );
+
+/**
+ * Multiplies by 0x03 in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x03
+*/
+byte fieldMul3( byte a );
+
+/**
+ * Multiplies by 0x09 in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x09
+*/
+byte fieldMul9( byte a );
+
+/**
+ * Multiplies by 0x0B in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x0B
+*/
+byte fieldMul11( byte a );
+
+/**
+ * Multiplies by 0x0D in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x0D
+*/
+byte fieldMul13( byte a );
+
+/**
+ * Multiplies by 0x0E in the 8-bit Galois field used by AES.
+ * 
+ * @param a the byte to multiply
+ * @return a times 0x0E
+*/
+byte fieldMul14( byte a );
+
+/**
+ * Multiplies every byte of a buffer by the same constant in the 8-bit Galois
+ * field used by AES. Uses SIMD shuffles when the processor supports them.
+ * 
+ * @param dst where to store the products, which may be the same as src
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulVec( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Multiplies every byte of a buffer by the same constant and adds the products
+ * into another buffer, in the 8-bit Galois field used by AES. This is the inner
+ * step of multiplying a matrix by a set of buffers.
+ * 
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to multiply, which must not overlap dst
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulAddVec( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Adds one buffer into another in the 8-bit Galois field used by AES,
+ * which is an XOR of the two.
+ * 
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to add
+ * @param len number of bytes
+*/
+void fieldAddVec( byte *dst, byte const *src, size_t len );
+
 #endif
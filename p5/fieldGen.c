@@ -0,0 +1,70 @@
+/**
+ * @file fieldGen.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Generates fieldTables.c, the log and exp tables for the 8-bit Galois
+ * field used by AES. Every nonzero element is a power of the generator
+ * 0x03, so the tables are filled in by multiplying by 0x03 over and over,
+ * which only needs a shift and an XOR.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "field.h"
+#include "fieldTables.h"
+
+/** Number of table entries printed on each line. */
+#define PER_LINE 8
+
+/**
+ * Prints a table as a C array definition.
+ *
+ * @param name name of the array
+ * @param size number of elements, as written in the declaration
+ * @param table the values to print
+ * @param len number of values
+*/
+static void printTable( char const *name, char const *size, byte const *table, int len )
+{
+  printf("\nbyte const %s[ %s ] = {", name, size);
+  for (int i = 0; i < len; i++) {
+    printf("%s%s0x%02X", i > 0 ? "," : "", i % PER_LINE == 0 ? "\n  " : " ", table[i]);
+  }
+  printf(" };\n");
+}
+
+/**
+ * Entry point of program. Writes the tables to standard output.
+ *
+ * @return exit status code
+ */
+int main( void )
+{
+  byte exp[FIELD_EXP_SIZE];
+  byte log[FIELD_SIZE] = { 0 };
+
+  // Walk through the powers of 0x03, which is x + 1
+  byte power = 0x01;
+  for (int i = 0; i < FIELD_SIZE - 1; i++) {
+    exp[i] = exp[i + FIELD_SIZE - 1] = power;
+    log[power] = i;
+
+    byte doubled = (power << 1) ^ (power & 0x80 ? REDUCER & 0xFF : 0);
+    power ^= doubled;
+  }
+
+  printf("/**\n");
+  printf(" * @file fieldTables.c\n");
+  printf(" * @author Canaan Matias (ctmatias)\n");
+  printf(" *\n");
+  printf(" * Log and exp tables for the 8-bit Galois field used by AES.\n");
+  printf(" * Generated by fieldGen; don't edit this file by hand.\n");
+  printf(" */\n\n");
+  printf("#include \"fieldTables.h\"\n");
+
+  printTable("fieldExp", "FIELD_EXP_SIZE", exp, FIELD_EXP_SIZE);
+  printTable("fieldLog", "FIELD_SIZE", log, FIELD_SIZE);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,29 @@
+/**
+ * @file fieldTables.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Declares the log and exp tables for the 8-bit Galois field used by AES,
+ * which are written into fieldTables.c by the fieldGen program.
+ */
+
+#ifndef _FIELD_TABLES_H_
+#define _FIELD_TABLES_H_
+
+#include "field.h"
+
+/** Number of elements in the field. */
+#define FIELD_SIZE 256
+
+/**
+ * Number of entries in the exp table. The powers repeat every 255 steps, and
+ * the table holds two full cycles so the sum of two logs can index it directly.
+ */
+#define FIELD_EXP_SIZE ( 2 * ( FIELD_SIZE - 1 ) )
+
+/** Powers of the generator 0x03: fieldExp[ i ] is 0x03 to the i. */
+extern byte const fieldExp[ FIELD_EXP_SIZE ];
+
+/** Logs base 0x03 of the nonzero elements, the inverse of fieldExp. Entry 0 is unused. */
+extern byte const fieldLog[ FIELD_SIZE ];
+
+#endif
@@ -8,9 +8,10 @@
 #include <stdio.h>
 
 #include "field.h"
+#include "fieldVec.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 10
+#define EXPECTED_TOTAL 23
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -29,6 +30,55 @@ static int passedTests = 0;
   } \
 }
 
+/** Length of the buffers for the vector tests, not a multiple of any register size. */
+#define VEC_LEN 300
+
+/**
+ * Checks a version of fieldMulVec() against fieldMul() for every constant,
+ * starting one byte into the buffer so the loads aren't aligned.
+ *
+ * @param mul the version to check
+ * @return true if every product matches
+*/
+static bool mulVecMatches( void (*mul)( byte *, byte const *, byte, size_t ) )
+{
+  byte src[ VEC_LEN ], dst[ VEC_LEN ];
+  for ( int i = 0; i < VEC_LEN; i++ )
+    src[ i ] = i * 7 + 3;
+
+  for ( int c = 0; c < 256; c++ ) {
+    mul( dst + 1, src + 1, c, VEC_LEN - 1 );
+    for ( int i = 1; i < VEC_LEN; i++ )
+      if ( dst[ i ] != fieldMul( src[ i ], c ) )
+        return false;
+  }
+  return true;
+}
+
+/**
+ * Checks a version of fieldMulAddVec() against fieldMul() and fieldAdd()
+ * for every constant, starting one byte into the buffers.
+ *
+ * @param mulAdd the version to check
+ * @return true if every sum matches
+*/
+static bool mulAddVecMatches( void (*mulAdd)( byte *, byte const *, byte, size_t ) )
+{
+  byte src[ VEC_LEN ], dst[ VEC_LEN ];
+  for ( int i = 0; i < VEC_LEN; i++ )
+    src[ i ] = i * 7 + 3;
+
+  for ( int c = 0; c < 256; c++ ) {
+    for ( int i = 0; i < VEC_LEN; i++ )
+      dst[ i ] = i * 11 + c;
+    mulAdd( dst + 1, src + 1, c, VEC_LEN - 1 );
+    for ( int i = 1; i < VEC_LEN; i++ )
+      if ( dst[ i ] != fieldAdd( ( byte ) ( i * 11 + c ), fieldMul( src[ i ], c ) ) )
+        return false;
+  }
+  return true;
+}
+
 int main()
 {
   // As you finish parts of your implementation, move this directive
@@ -80,6 +130,100 @@ int main()
     TestCase( c == 0xF3 );
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // Test the table-driven fieldMul() against fieldMulReference() on every
+  // pair of inputs.
+
+  {
+    int mismatches = 0;
+    for ( int a = 0; a < 256; a++ )
+      for ( int b = 0; b < 256; b++ )
+        if ( fieldMul( a, b ) != fieldMulReference( a, b ) )
+          mismatches++;
+    TestCase( mismatches == 0 );
+
+    TestCase( fieldMulReference( 0x3B, 0x57 ) == 0x7E );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the multipliers for the mixColumns constants on every input.
+
+  {
+    int mismatches = 0;
+    for ( int a = 0; a < 256; a++ ) {
+      if ( fieldMul2( a ) != fieldMulReference( a, 0x02 ) ||
+           fieldMul3( a ) != fieldMulReference( a, 0x03 ) ||
+           fieldMul9( a ) != fieldMulReference( a, 0x09 ) ||
+           fieldMul11( a ) != fieldMulReference( a, 0x0B ) ||
+           fieldMul13( a ) != fieldMulReference( a, 0x0D ) ||
+           fieldMul14( a ) != fieldMulReference( a, 0x0E ) )
+        mismatches++;
+    }
+    TestCase( mismatches == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test every version of fieldMulVec() against fieldMul(). The SIMD
+  // versions pass trivially on processors that can't run them.
+
+  {
+    TestCase( mulVecMatches( fieldMulVecScalar ) );
+    TestCase( !ssse3Supported() || mulVecMatches( fieldMulVecSsse3 ) );
+    TestCase( !avx2Supported() || mulVecMatches( fieldMulVecAvx2 ) );
+
+    // Multiplying in place
+    byte buf[ VEC_LEN ];
+    for ( int i = 0; i < VEC_LEN; i++ )
+      buf[ i ] = i;
+    fieldMulVec( buf, buf, 0x57, VEC_LEN );
+    int mismatches = 0;
+    for ( int i = 0; i < VEC_LEN; i++ )
+      if ( buf[ i ] != fieldMul( i % 256, 0x57 ) )
+        mismatches++;
+    TestCase( mismatches == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test every version of fieldMulAddVec(), including the shortcuts the
+  // dispatcher takes for 0x00 and 0x01.
+
+  {
+    TestCase( mulAddVecMatches( fieldMulAddVecScalar ) );
+    TestCase( !ssse3Supported() || mulAddVecMatches( fieldMulAddVecSsse3 ) );
+    TestCase( !avx2Supported() || mulAddVecMatches( fieldMulAddVecAvx2 ) );
+    TestCase( mulAddVecMatches( fieldMulAddVec ) );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test fieldInv() on every nonzero element.
+
+  {
+    int mismatches = 0;
+    for ( int a = 1; a < 256; a++ )
+      if ( fieldMul( a, fieldInv( a ) ) != 0x01 )
+        mismatches++;
+    TestCase( mismatches == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test fieldAddVec() and its versions against fieldAdd().
+
+  {
+    byte a[ VEC_LEN ], b[ VEC_LEN ], c[ VEC_LEN ];
+    for ( int i = 0; i < VEC_LEN; i++ ) {
+      a[ i ] = c[ i ] = i * 13;
+      b[ i ] = i * 5 + 1;
+    }
+
+    fieldAddVec( a + 1, b + 1, VEC_LEN - 1 );
+    fieldAddVecScalar( c + 1, b + 1, VEC_LEN - 1 );
+    int mismatches = 0;
+    for ( int i = 1; i < VEC_LEN; i++ )
+      if ( a[ i ] != fieldAdd( ( byte ) ( i * 13 ), b[ i ] ) || c[ i ] != a[ i ] )
+        mismatches++;
+    TestCase( mismatches == 0 && a[ 0 ] == 0 );
+  }
+
 #ifdef DISABLE_TESTS
 
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
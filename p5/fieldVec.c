@@ -0,0 +1,344 @@
+/**
+ * @file fieldVec.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Field operations on whole buffers. Multiplying by a constant is linear,
+ * so the product of a byte splits into the products of its two nibbles,
+ * and each of those comes from a 16-entry table. PSHUFB looks up 16 (or,
+ * with AVX2, 32) nibbles in a table at once, so a buffer is multiplied with
+ * two shuffles and an XOR per register instead of a table lookup per byte.
+ * The SIMD versions are compiled with target attributes, so the rest of the
+ * program still runs on processors without them.
+ */
+
+#include "fieldVec.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Mask for the low nibble of a byte. */
+#define NIBBLE_MASK 0x0F
+
+/** Number of bits in a nibble. */
+#define NIBBLE_BITS 4
+
+void nibbleTables( byte c, byte low[ NIBBLE_VALUES ], byte high[ NIBBLE_VALUES ] )
+{
+  for (int i = 0; i < NIBBLE_VALUES; i++) {
+    low[i] = fieldMul(c, i);
+    high[i] = fieldMul(c, i << NIBBLE_BITS);
+  }
+}
+
+void fieldMulVecScalar( byte *dst, byte const *src, byte c, size_t len )
+{
+  byte low[NIBBLE_VALUES], high[NIBBLE_VALUES];
+  nibbleTables(c, low, high);
+
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = low[src[i] & NIBBLE_MASK] ^ high[src[i] >> NIBBLE_BITS];
+  }
+}
+
+void fieldMulAddVecScalar( byte *dst, byte const *src, byte c, size_t len )
+{
+  byte low[NIBBLE_VALUES], high[NIBBLE_VALUES];
+  nibbleTables(c, low, high);
+
+  for (size_t i = 0; i < len; i++) {
+    dst[i] ^= low[src[i] & NIBBLE_MASK] ^ high[src[i] >> NIBBLE_BITS];
+  }
+}
+
+void fieldAddVecScalar( byte *dst, byte const *src, size_t len )
+{
+  size_t i = 0;
+
+  // A word at a time, through memcpy since the buffers needn't be aligned
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t a, b;
+    memcpy(&a, dst + i, sizeof(a));
+    memcpy(&b, src + i, sizeof(b));
+    a ^= b;
+    memcpy(dst + i, &a, sizeof(a));
+  }
+
+  for (; i < len; i++) {
+    dst[i] ^= src[i];
+  }
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+#include <immintrin.h>
+
+/** Marks a function as using the SSSE3 instruction set. */
+#define SSSE3_TARGET __attribute__(( target( "ssse3,sse2" ) ))
+
+/** Marks a function as using the AVX2 instruction set. */
+#define AVX2_TARGET __attribute__(( target( "avx2" ) ))
+
+/** Makes sure a loop shared by two versions is specialized for each of them. */
+#define ALWAYS_INLINE __attribute__(( always_inline )) inline
+
+/** Number of bytes in an SSE register. */
+#define SSE_BYTES 16
+
+/** Number of bytes in an AVX register. */
+#define AVX_BYTES 32
+
+bool ssse3Supported( void )
+{
+  // -1 until the processor has been checked
+  static int supported = -1;
+
+  if (supported < 0) {
+    __builtin_cpu_init();
+    supported = __builtin_cpu_supports("ssse3") != 0;
+  }
+
+  return supported;
+}
+
+bool avx2Supported( void )
+{
+  // -1 until the processor has been checked
+  static int supported = -1;
+
+  // Also checks that the operating system saves the upper halves of the registers
+  if (supported < 0) {
+    __builtin_cpu_init();
+    supported = __builtin_cpu_supports("avx2") != 0;
+  }
+
+  return supported;
+}
+
+/**
+ * Multiplies 16 bytes by the constant whose nibble tables are given.
+ *
+ * @param x the bytes to multiply
+ * @param low products with each low nibble
+ * @param high products with each high nibble
+ * @param mask NIBBLE_MASK in every byte
+ * @return the products
+*/
+SSSE3_TARGET static inline __m128i mulSsse3( __m128i x, __m128i low, __m128i high, __m128i mask )
+{
+  // There's no byte shift, but the bits a 16-bit shift brings in are masked off
+  __m128i lo = _mm_and_si128(x, mask);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(x, NIBBLE_BITS), mask);
+  return _mm_xor_si128(_mm_shuffle_epi8(low, lo), _mm_shuffle_epi8(high, hi));
+}
+
+/**
+ * Multiplies a buffer by a constant with SSSE3, storing the products or adding them in.
+ *
+ * @param dst where the products go
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+ * @param add true to add the products into dst, false to store them
+*/
+SSSE3_TARGET static ALWAYS_INLINE void mulBufferSsse3( byte *dst, byte const *src, byte c,
+                                                       size_t len, bool add )
+{
+  byte lowTable[NIBBLE_VALUES], highTable[NIBBLE_VALUES];
+  nibbleTables(c, lowTable, highTable);
+
+  __m128i low = _mm_loadu_si128((__m128i const *) lowTable);
+  __m128i high = _mm_loadu_si128((__m128i const *) highTable);
+  __m128i mask = _mm_set1_epi8(NIBBLE_MASK);
+  size_t i = 0;
+
+  // Two registers at a time, so one's shuffles can overlap the other's
+  for (; i + 2 * SSE_BYTES <= len; i += 2 * SSE_BYTES) {
+    __m128i a = mulSsse3(_mm_loadu_si128((__m128i const *) (src + i)), low, high, mask);
+    __m128i b = mulSsse3(_mm_loadu_si128((__m128i const *) (src + i + SSE_BYTES)), low, high, mask);
+    if (add) {
+      a = _mm_xor_si128(a, _mm_loadu_si128((__m128i const *) (dst + i)));
+      b = _mm_xor_si128(b, _mm_loadu_si128((__m128i const *) (dst + i + SSE_BYTES)));
+    }
+    _mm_storeu_si128((__m128i *) (dst + i), a);
+    _mm_storeu_si128((__m128i *) (dst + i + SSE_BYTES), b);
+  }
+
+  for (; i < len; i++) {
+    byte product = lowTable[src[i] & NIBBLE_MASK] ^ highTable[src[i] >> NIBBLE_BITS];
+    dst[i] = add ? dst[i] ^ product : product;
+  }
+}
+
+SSSE3_TARGET void fieldMulVecSsse3( byte *dst, byte const *src, byte c, size_t len )
+{
+  mulBufferSsse3(dst, src, c, len, false);
+}
+
+SSSE3_TARGET void fieldMulAddVecSsse3( byte *dst, byte const *src, byte c, size_t len )
+{
+  mulBufferSsse3(dst, src, c, len, true);
+}
+
+/**
+ * Multiplies 32 bytes by the constant whose nibble tables are given.
+ *
+ * @param x the bytes to multiply
+ * @param low products with each low nibble, in both lanes
+ * @param high products with each high nibble, in both lanes
+ * @param mask NIBBLE_MASK in every byte
+ * @return the products
+*/
+AVX2_TARGET static inline __m256i mulAvx2( __m256i x, __m256i low, __m256i high, __m256i mask )
+{
+  __m256i lo = _mm256_and_si256(x, mask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, NIBBLE_BITS), mask);
+  return _mm256_xor_si256(_mm256_shuffle_epi8(low, lo), _mm256_shuffle_epi8(high, hi));
+}
+
+/**
+ * Multiplies a buffer by a constant with AVX2, storing the products or adding them in.
+ *
+ * @param dst where the products go
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+ * @param add true to add the products into dst, false to store them
+*/
+AVX2_TARGET static ALWAYS_INLINE void mulBufferAvx2( byte *dst, byte const *src, byte c,
+                                                     size_t len, bool add )
+{
+  byte lowTable[NIBBLE_VALUES], highTable[NIBBLE_VALUES];
+  nibbleTables(c, lowTable, highTable);
+
+  // VPSHUFB looks up within each 128-bit lane, so both lanes get the table
+  __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *) lowTable));
+  __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *) highTable));
+  __m256i mask = _mm256_set1_epi8(NIBBLE_MASK);
+  size_t i = 0;
+
+  for (; i + 2 * AVX_BYTES <= len; i += 2 * AVX_BYTES) {
+    __m256i a = mulAvx2(_mm256_loadu_si256((__m256i const *) (src + i)), low, high, mask);
+    __m256i b = mulAvx2(_mm256_loadu_si256((__m256i const *) (src + i + AVX_BYTES)), low, high, mask);
+    if (add) {
+      a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i const *) (dst + i)));
+      b = _mm256_xor_si256(b, _mm256_loadu_si256((__m256i const *) (dst + i + AVX_BYTES)));
+    }
+    _mm256_storeu_si256((__m256i *) (dst + i), a);
+    _mm256_storeu_si256((__m256i *) (dst + i + AVX_BYTES), b);
+  }
+
+  for (; i < len; i++) {
+    byte product = lowTable[src[i] & NIBBLE_MASK] ^ highTable[src[i] >> NIBBLE_BITS];
+    dst[i] = add ? dst[i] ^ product : product;
+  }
+}
+
+AVX2_TARGET void fieldMulVecAvx2( byte *dst, byte const *src, byte c, size_t len )
+{
+  mulBufferAvx2(dst, src, c, len, false);
+}
+
+AVX2_TARGET void fieldMulAddVecAvx2( byte *dst, byte const *src, byte c, size_t len )
+{
+  mulBufferAvx2(dst, src, c, len, true);
+}
+
+AVX2_TARGET void fieldAddVecAvx2( byte *dst, byte const *src, size_t len )
+{
+  size_t i = 0;
+
+  for (; i + 2 * AVX_BYTES <= len; i += 2 * AVX_BYTES) {
+    __m256i a = _mm256_loadu_si256((__m256i const *) (dst + i));
+    __m256i b = _mm256_loadu_si256((__m256i const *) (dst + i + AVX_BYTES));
+    a = _mm256_xor_si256(a, _mm256_loadu_si256((__m256i const *) (src + i)));
+    b = _mm256_xor_si256(b, _mm256_loadu_si256((__m256i const *) (src + i + AVX_BYTES)));
+    _mm256_storeu_si256((__m256i *) (dst + i), a);
+    _mm256_storeu_si256((__m256i *) (dst + i + AVX_BYTES), b);
+  }
+
+  fieldAddVecScalar(dst + i, src + i, len - i);
+}
+
+#else
+
+bool ssse3Supported( void )
+{
+  return false;
+}
+
+bool avx2Supported( void )
+{
+  return false;
+}
+
+// The remaining functions are never selected on processors without SSSE3 or AVX2.
+
+void fieldMulVecSsse3( byte *dst, byte const *src, byte c, size_t len )
+{
+  abort();
+}
+
+void fieldMulAddVecSsse3( byte *dst, byte const *src, byte c, size_t len )
+{
+  abort();
+}
+
+void fieldMulVecAvx2( byte *dst, byte const *src, byte c, size_t len )
+{
+  abort();
+}
+
+void fieldMulAddVecAvx2( byte *dst, byte const *src, byte c, size_t len )
+{
+  abort();
+}
+
+void fieldAddVecAvx2( byte *dst, byte const *src, size_t len )
+{
+  abort();
+}
+
+#endif
+
+void fieldMulVec( byte *dst, byte const *src, byte c, size_t len )
+{
+  if (avx2Supported()) {
+    fieldMulVecAvx2(dst, src, c, len);
+  }
+  else if (ssse3Supported()) {
+    fieldMulVecSsse3(dst, src, c, len);
+  }
+  else {
+    fieldMulVecScalar(dst, src, c, len);
+  }
+}
+
+void fieldMulAddVec( byte *dst, byte const *src, byte c, size_t len )
+{
+  // Coding matrices are full of zeros and ones, which need no multiplying
+  if (c == 0) {
+    return;
+  }
+  if (c == 1) {
+    fieldAddVec(dst, src, len);
+  }
+  else if (avx2Supported()) {
+    fieldMulAddVecAvx2(dst, src, c, len);
+  }
+  else if (ssse3Supported()) {
+    fieldMulAddVecSsse3(dst, src, c, len);
+  }
+  else {
+    fieldMulAddVecScalar(dst, src, c, len);
+  }
+}
+
+void fieldAddVec( byte *dst, byte const *src, size_t len )
+{
+  if (avx2Supported()) {
+    fieldAddVecAvx2(dst, src, len);
+  }
+  else {
+    fieldAddVecScalar(dst, src, len);
+  }
+}
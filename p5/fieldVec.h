@@ -0,0 +1,128 @@
+/**
+ * @file fieldVec.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for each version of the buffer operations
+ * in field.h, so they can be tested and measured separately.
+ * fieldMulVec(), fieldMulAddVec() and fieldAddVec() pick the fastest one that runs here.
+ */
+
+#ifndef _FIELD_VEC_H_
+#define _FIELD_VEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "field.h"
+
+/** Number of entries in each nibble table. */
+#define NIBBLE_VALUES 16
+
+/**
+ * Fills in the products of a constant with every low nibble and every
+ * high nibble. The product of the constant with a byte x is then
+ * low[ x & 0x0F ] ^ high[ x >> 4 ], since multiplication distributes over XOR.
+ *
+ * @param c the constant
+ * @param low filled in with c times 0x00 through 0x0F
+ * @param high filled in with c times 0x00 through 0xF0
+*/
+void nibbleTables( byte c, byte low[ NIBBLE_VALUES ], byte high[ NIBBLE_VALUES ] );
+
+/**
+ * Reports whether this processor supports the SSSE3 instructions.
+ *
+ * @return true if the SSSE3 versions can be used
+*/
+bool ssse3Supported( void );
+
+/**
+ * Reports whether this processor and operating system support the AVX2 instructions.
+ *
+ * @return true if the AVX2 versions can be used
+*/
+bool avx2Supported( void );
+
+/**
+ * Like fieldMulVec(), one byte at a time with the nibble tables.
+ *
+ * @param dst where to store the products, which may be the same as src
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulVecScalar( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldMulAddVec(), one byte at a time with the nibble tables.
+ *
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulAddVecScalar( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldMulVec(), 16 bytes at a time with PSHUFB.
+ * Only call this if ssse3Supported() is true.
+ *
+ * @param dst where to store the products, which may be the same as src
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulVecSsse3( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldMulAddVec(), 16 bytes at a time with PSHUFB.
+ * Only call this if ssse3Supported() is true.
+ *
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulAddVecSsse3( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldMulVec(), 32 bytes at a time with VPSHUFB.
+ * Only call this if avx2Supported() is true.
+ *
+ * @param dst where to store the products, which may be the same as src
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulVecAvx2( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldMulAddVec(), 32 bytes at a time with VPSHUFB.
+ * Only call this if avx2Supported() is true.
+ *
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to multiply
+ * @param c the constant to multiply by
+ * @param len number of bytes
+*/
+void fieldMulAddVecAvx2( byte *dst, byte const *src, byte c, size_t len );
+
+/**
+ * Like fieldAddVec(), a machine word at a time.
+ *
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to add
+ * @param len number of bytes
+*/
+void fieldAddVecScalar( byte *dst, byte const *src, size_t len );
+
+/**
+ * Like fieldAddVec(), 32 bytes at a time.
+ * Only call this if avx2Supported() is true.
+ *
+ * @param dst the bytes to add to, which are replaced by the sums
+ * @param src the bytes to add
+ * @param len number of bytes
+*/
+void fieldAddVecAvx2( byte *dst, byte const *src, size_t len );
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file gcm.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Galois/Counter Mode with a 96-bit IV and no additional data. The data is
+ * encrypted in counter mode starting from the IV followed by a block counter
+ * of 2, and the tag is the GHASH of the ciphertext and its length, masked
+ * with the encryption of counter 1.
+ *
+ * GHASH is a chain, but it's also a polynomial in H, so a slice of n blocks
+ * can be hashed on its own from zero and folded in afterward by multiplying
+ * the running hash by H^n. That lets every thread encrypt and hash its own
+ * slice, leaving only one multiplication per slice to do in order.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gcm.h"
+#include "io.h"
+
+/** Size of each slice handed to a thread, in bytes. A multiple of BLOCK_SIZE. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+/** Offset of the 32-bit block counter within a counter block. */
+#define COUNTER_START GCM_IV_SIZE
+
+void makeIv( byte iv[ GCM_IV_SIZE ] )
+{
+  randomBytes(iv, GCM_IV_SIZE);
+}
+
+void gcmInit( Gcm *gcm, AesContext const *ctx, byte const iv[ GCM_IV_SIZE ] )
+{
+  gcm->ctx = ctx;
+
+  // The hash key is the encryption of the zero block
+  byte h[GHASH_SIZE] = { 0 };
+  aesEncryptBlocks(ctx, h, h, 1);
+  ghashInit(&gcm->key, h);
+  ghashPower(&gcm->key, SLICE_SIZE / BLOCK_SIZE, gcm->sliceStep);
+
+  // Counter 1 masks the tag, and the data starts at counter 2
+  memcpy(gcm->counter, iv, GCM_IV_SIZE);
+  memset(gcm->counter + COUNTER_START, 0, NONCE_SIZE - COUNTER_START);
+  gcm->counter[NONCE_SIZE - 1] = 1;
+  aesEncryptBlocks(ctx, gcm->counter, gcm->mask, 1);
+  gcm->counter[NONCE_SIZE - 1] = 2;
+
+  memset(gcm->hash, 0, GHASH_SIZE);
+  gcm->hashed = 0;
+}
+
+/** Everything a thread needs to process its slices of a GCM job. */
+typedef struct {
+  /** State of the stream. */
+  Gcm const *gcm;
+
+  /** Input bytes. */
+  byte const *in;
+
+  /** Where to store the ciphertext, or NULL to only hash the input. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+
+  /** GHASH of each slice on its own, starting from zero. */
+  byte (*partial)[ GHASH_SIZE ];
+} GcmJob;
+
+/**
+ * Processes one slice of a GCM job: encrypts it, if the job calls for that,
+ * and hashes the ciphertext.
+ *
+ * @param arg the GcmJob being worked on
+ * @param index number of the slice to process
+*/
+static void gcmSlice( void *arg, size_t index )
+{
+  GcmJob *job = arg;
+  Gcm const *gcm = job->gcm;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+  byte const *ciphertext = job->in + start;
+
+  if (job->out) {
+    ctrCrypt(gcm->ctx, gcm->counter, gcm->hashed + start, job->in + start, job->out + start, len);
+    ciphertext = job->out + start;
+  }
+
+  memset(job->partial[index], 0, GHASH_SIZE);
+  ghashUpdate(&gcm->key, job->partial[index], ciphertext, len);
+}
+
+/**
+ * Runs a GCM job on the pool, then folds the hash of each slice into the running hash.
+ *
+ * @param gcm the state of the stream
+ * @param pool the pool to run on
+ * @param in the input bytes
+ * @param out where to store the ciphertext, or NULL to only hash the input
+ * @param len number of bytes to process
+*/
+static void gcmRun( Gcm *gcm, ThreadPool *pool, byte const *in, byte *out, size_t len )
+{
+  if (len > GCM_MAX_SIZE - gcm->hashed) {
+    fprintf(stderr, "Input too large for GCM mode\n");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t nslices = (len + SLICE_SIZE - 1) / SLICE_SIZE;
+  GcmJob job = { gcm, in, out, len, malloc(nslices * GHASH_SIZE) };
+  runPool(pool, gcmSlice, &job, nslices);
+
+  for (size_t i = 0; i < nslices; i++) {
+    size_t n = len - i * SLICE_SIZE < SLICE_SIZE ? len - i * SLICE_SIZE : SLICE_SIZE;
+
+    // A short slice can only come at the end of the stream
+    if (n == SLICE_SIZE) {
+      ghashMul(gcm->hash, gcm->sliceStep);
+    }
+    else {
+      byte step[GHASH_SIZE];
+      ghashPower(&gcm->key, (n + BLOCK_SIZE - 1) / BLOCK_SIZE, step);
+      ghashMul(gcm->hash, step);
+    }
+
+    for (int j = 0; j < GHASH_SIZE; j++) {
+      gcm->hash[j] ^= job.partial[i][j];
+    }
+  }
+
+  free(job.partial);
+  gcm->hashed += len;
+}
+
+void gcmEncrypt( Gcm *gcm, ThreadPool *pool, byte const *in, byte *out, size_t len )
+{
+  gcmRun(gcm, pool, in, out, len);
+}
+
+void gcmAuthenticate( Gcm *gcm, ThreadPool *pool, byte const *in, size_t len )
+{
+  gcmRun(gcm, pool, in, NULL, len);
+}
+
+void gcmDecrypt( Gcm const *gcm, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len )
+{
+  // The counter never gets past 32 bits, so 128-bit counter mode gives the same keystream
+  ctrCryptParallel(pool, gcm->ctx, gcm->counter, offset, in, out, len);
+}
+
+void gcmTag( Gcm const *gcm, byte tag[ GCM_TAG_SIZE ] )
+{
+  // The last block holds the bit lengths of the additional data (none) and the ciphertext
+  byte lengths[GHASH_SIZE] = { 0 };
+  uint64_t bits = gcm->hashed * BBITS;
+  for (int i = GHASH_SIZE - 1; i >= GHASH_SIZE / 2; i--) {
+    lengths[i] = bits;
+    bits >>= BBITS;
+  }
+
+  memcpy(tag, gcm->hash, GHASH_SIZE);
+  ghashUpdate(&gcm->key, tag, lengths, GHASH_SIZE);
+
+  for (int i = 0; i < GCM_TAG_SIZE; i++) {
+    tag[i] ^= gcm->mask[i];
+  }
+}
+
+bool gcmCheckTag( Gcm const *gcm, byte const tag[ GCM_TAG_SIZE ] )
+{
+  byte expected[GCM_TAG_SIZE];
+  gcmTag(gcm, expected);
+
+  // Accumulate the differences rather than stopping at the first one
+  byte diff = 0;
+  for (int i = 0; i < GCM_TAG_SIZE; i++) {
+    diff |= expected[i] ^ tag[i];
+  }
+
+  return diff == 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file gcm.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for Galois/Counter Mode (GCM), which encrypts in
+ * counter mode and authenticates the ciphertext with GHASH in the same pass.
+ */
+
+#ifndef _GCM_H_
+#define _GCM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aes.h"
+#include "ctr.h"
+#include "ghash.h"
+#include "pool.h"
+
+/** Number of bytes in the IV header at the start of a GCM file. */
+#define GCM_IV_SIZE 12
+
+/** Number of bytes in the authentication tag at the end of a GCM file. */
+#define GCM_TAG_SIZE BLOCK_SIZE
+
+/**
+ * Largest number of bytes one IV can protect. The block counter is only
+ * 32 bits, and the first two counter values are used for the tag.
+ */
+#define GCM_MAX_SIZE ( ( ( 1ULL << 32 ) - 2 ) * BLOCK_SIZE )
+
+/** State of one GCM stream. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** GHASH key, derived from the AES key. */
+  GhashKey key;
+
+  /** Counter block for the first block of data. */
+  byte counter[ NONCE_SIZE ];
+
+  /** Keystream block used to mask the tag. */
+  byte mask[ BLOCK_SIZE ];
+
+  /** Running GHASH of the ciphertext. */
+  byte hash[ GHASH_SIZE ];
+
+  /** H raised to the number of blocks in a full slice, for combining slices. */
+  byte sliceStep[ GHASH_SIZE ];
+
+  /** Number of bytes of ciphertext hashed so far. */
+  uint64_t hashed;
+} Gcm;
+
+/**
+ * Fills in a new random IV.
+ *
+ * @param iv the IV to fill
+*/
+void makeIv( byte iv[ GCM_IV_SIZE ] );
+
+/**
+ * Sets up the state for a new stream with the given IV.
+ *
+ * @param gcm the state to set up
+ * @param ctx the expanded key, which must outlive the state
+ * @param iv the IV of the stream
+*/
+void gcmInit( Gcm *gcm, AesContext const *ctx, byte const iv[ GCM_IV_SIZE ] );
+
+/**
+ * Encrypts the next part of the stream and hashes the ciphertext. Every part
+ * but the last must be a multiple of BLOCK_SIZE. The work is split into slices
+ * that run in parallel on the pool, each encrypting and then hashing its own
+ * ciphertext while it's still in cache.
+ *
+ * @param gcm the state of the stream
+ * @param pool the pool to run on
+ * @param in the plaintext
+ * @param out where to store the ciphertext, which may be the same as in
+ * @param len number of bytes to encrypt
+*/
+void gcmEncrypt( Gcm *gcm, ThreadPool *pool, byte const *in, byte *out, size_t len );
+
+/**
+ * Hashes the next part of the ciphertext without decrypting it. Every part
+ * but the last must be a multiple of BLOCK_SIZE.
+ *
+ * @param gcm the state of the stream
+ * @param pool the pool to run on
+ * @param in the ciphertext
+ * @param len number of bytes to hash
+*/
+void gcmAuthenticate( Gcm *gcm, ThreadPool *pool, byte const *in, size_t len );
+
+/**
+ * Decrypts part of the stream without hashing it. This should only be used
+ * once the whole ciphertext has been authenticated.
+ *
+ * @param gcm the state of the stream
+ * @param pool the pool to run on
+ * @param offset position of in[ 0 ] within the stream
+ * @param in the ciphertext
+ * @param out where to store the plaintext, which may be the same as in
+ * @param len number of bytes to decrypt
+*/
+void gcmDecrypt( Gcm const *gcm, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len );
+
+/**
+ * Computes the tag for everything hashed so far.
+ *
+ * @param gcm the state of the stream
+ * @param tag filled in with the tag
+*/
+void gcmTag( Gcm const *gcm, byte tag[ GCM_TAG_SIZE ] );
+
+/**
+ * Compares the given tag with the tag for everything hashed so far,
+ * taking the same time however many bytes match.
+ *
+ * @param gcm the state of the stream
+ * @param tag the tag to check
+ * @return true if the tag is correct
+*/
+bool gcmCheckTag( Gcm const *gcm, byte const tag[ GCM_TAG_SIZE ] );
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file ghash.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Portable parts of GHASH: the reference multiplication, Shoup's 4-bit
+ * table method and the choice between it and carry-less multiplication.
+ * GCM numbers the bits of a block starting from the high bit of the first
+ * byte, so a block is kept as two big-endian halves and "shifting right"
+ * moves toward higher powers of x.
+ */
+
+#include <string.h>
+
+#include "ghash.h"
+
+/** Low byte of the reduction polynomial x^128 + x^7 + x^2 + x + 1, in GCM bit order. */
+#define REDUCE 0xE1
+
+/**
+ * Reads eight bytes as a big-endian number.
+ *
+ * @param src the bytes to read
+ * @return their value
+*/
+static uint64_t load64( byte const *src )
+{
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = value << BBITS | src[i];
+  }
+  return value;
+}
+
+/**
+ * Writes a number as eight big-endian bytes.
+ *
+ * @param dest where to write the bytes
+ * @param value the value to write
+*/
+static void store64( byte *dest, uint64_t value )
+{
+  for (int i = 7; i >= 0; i--) {
+    dest[i] = value;
+    value >>= BBITS;
+  }
+}
+
+void ghashMul( byte x[ GHASH_SIZE ], byte const y[ GHASH_SIZE ] )
+{
+  uint64_t zHigh = 0, zLow = 0;
+  uint64_t vHigh = load64(y), vLow = load64(y + 8);
+
+  for (int i = 0; i < GHASH_SIZE * BBITS; i++) {
+    if (x[i / BBITS] >> (BBITS - 1 - i % BBITS) & 1) {
+      zHigh ^= vHigh;
+      zLow ^= vLow;
+    }
+
+    // Multiply v by x, reducing if the x^127 term overflows
+    uint64_t carry = vLow & 1;
+    vLow = vLow >> 1 | vHigh << 63;
+    vHigh = vHigh >> 1 ^ (carry ? (uint64_t) REDUCE << 56 : 0);
+  }
+
+  store64(x, zHigh);
+  store64(x + 8, zLow);
+}
+
+void ghashInit( GhashKey *key, byte const h[ GHASH_SIZE ] )
+{
+  memcpy(key->h, h, GHASH_SIZE);
+
+  // Entry 8 is H itself, and 4, 2 and 1 are H times x, x^2 and x^3
+  uint64_t high = load64(h), low = load64(h + 8);
+  key->tableHigh[0] = key->tableLow[0] = 0;
+  key->tableHigh[8] = high;
+  key->tableLow[8] = low;
+
+  for (int i = 4; i > 0; i >>= 1) {
+    uint64_t carry = low & 1;
+    low = low >> 1 | high << 63;
+    high = high >> 1 ^ (carry ? (uint64_t) REDUCE << 56 : 0);
+    key->tableHigh[i] = high;
+    key->tableLow[i] = low;
+  }
+
+  // Everything else is a sum of those
+  for (int i = 2; i <= 8; i *= 2) {
+    for (int j = 1; j < i; j++) {
+      key->tableHigh[i + j] = key->tableHigh[i] ^ key->tableHigh[j];
+      key->tableLow[i + j] = key->tableLow[i] ^ key->tableLow[j];
+    }
+  }
+
+  byte power[GHASH_SIZE];
+  memcpy(power, h, GHASH_SIZE);
+  for (int i = 0; i < GHASH_LANES; i++) {
+    if (i > 0) {
+      ghashMul(power, h);
+    }
+    key->powers[i][0] = load64(power);
+    key->powers[i][1] = load64(power + 8);
+  }
+}
+
+void ghashPower( GhashKey const *key, uint64_t n, byte result[ GHASH_SIZE ] )
+{
+  byte square[GHASH_SIZE];
+  memcpy(square, key->h, GHASH_SIZE);
+
+  // The multiplicative identity is the polynomial 1, the first bit of the block
+  memset(result, 0, GHASH_SIZE);
+  result[0] = 0x80;
+
+  while (n > 0) {
+    if (n & 1) {
+      ghashMul(result, square);
+    }
+    n >>= 1;
+    if (n > 0) {
+      ghashMul(square, square);
+    }
+  }
+}
+
+/**
+ * Multiplies the running hash value by H using the 4-bit tables, one nibble at a
+ * time from the end of the block. Each step multiplies by x^4, and the four bits
+ * that fall off the end are folded back in with the reduction table.
+ *
+ * @param key the hash key
+ * @param state the value to multiply, which is replaced by the product
+*/
+static void tableMul( GhashKey const *key, byte state[ GHASH_SIZE ] )
+{
+  // Reduction of each 4-bit value shifted off the end, in the top 16 bits
+  static uint64_t const reduce[16] = {
+    0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+    0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0 };
+
+  int nibble = state[GHASH_SIZE - 1] & 0x0F;
+  uint64_t high = key->tableHigh[nibble];
+  uint64_t low = key->tableLow[nibble];
+
+  for (int i = GHASH_SIZE - 1; i >= 0; i--) {
+    for (int half = (i == GHASH_SIZE - 1); half < 2; half++) {
+      nibble = half ? state[i] >> 4 : state[i] & 0x0F;
+
+      int rem = low & 0x0F;
+      low = low >> 4 | high << 60;
+      high = high >> 4 ^ reduce[rem] << 48;
+
+      high ^= key->tableHigh[nibble];
+      low ^= key->tableLow[nibble];
+    }
+  }
+
+  store64(state, high);
+  store64(state + 8, low);
+}
+
+void ghashTableUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len )
+{
+  while (len > 0) {
+    size_t n = len < GHASH_SIZE ? len : GHASH_SIZE;
+    for (size_t i = 0; i < n; i++) {
+      state[i] ^= data[i];
+    }
+    tableMul(key, state);
+
+    data += n;
+    len -= n;
+  }
+}
+
+void ghashUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len )
+{
+  if (clmulSupported()) {
+    ghashClmulUpdate(key, state, data, len);
+  }
+  else {
+    ghashTableUpdate(key, state, data, len);
+  }
+}
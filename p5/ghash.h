@@ -0,0 +1,104 @@
+/**
+ * @file ghash.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for GHASH, the universal hash used by GCM mode.
+ * GHASH multiplies by a secret value H in GF(2^128), so all the work is
+ * in that multiplication. It uses the processor's carry-less multiply
+ * instruction when there is one, and Shoup's 4-bit tables otherwise.
+ */
+
+#ifndef _GHASH_H_
+#define _GHASH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "field.h"
+
+/** Number of bytes in a GHASH block and in the hash value. */
+#define GHASH_SIZE 16
+
+/** Number of blocks the carry-less multiply version folds together at a time. */
+#define GHASH_LANES 4
+
+/** Precomputed values for hashing with one key. */
+typedef struct {
+  /** The hash key H. */
+  byte h[ GHASH_SIZE ];
+
+  /** Products of H and every 4-bit value, high and low halves, for the table version. */
+  uint64_t tableHigh[ 16 ];
+  uint64_t tableLow[ 16 ];
+
+  /** H, H^2, ... H^GHASH_LANES as high and low halves, for the carry-less multiply version. */
+  uint64_t powers[ GHASH_LANES ][ 2 ];
+} GhashKey;
+
+/**
+ * Precomputes everything needed to hash with the given key.
+ *
+ * @param key the key to fill in
+ * @param h the hash key, the encryption of an all-zero block
+*/
+void ghashInit( GhashKey *key, byte const h[ GHASH_SIZE ] );
+
+/**
+ * Multiplies x by y in GF(2^128), using the bit ordering from the GCM spec.
+ * This is the slow, simple definition, used to check the fast versions
+ * and for the occasional multiplication outside the main loop.
+ *
+ * @param x the value to multiply, which is replaced by the product
+ * @param y the value to multiply it by
+*/
+void ghashMul( byte x[ GHASH_SIZE ], byte const y[ GHASH_SIZE ] );
+
+/**
+ * Computes H^n.
+ *
+ * @param key the hash key
+ * @param n the power to raise H to
+ * @param result filled in with H^n
+*/
+void ghashPower( GhashKey const *key, uint64_t n, byte result[ GHASH_SIZE ] );
+
+/**
+ * Hashes more data into the running hash value, using the fastest version
+ * this processor supports. A final partial block is padded with zeros.
+ *
+ * @param key the hash key
+ * @param state the running hash value
+ * @param data the data to hash
+ * @param len number of bytes of data
+*/
+void ghashUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len );
+
+/**
+ * Like ghashUpdate(), but always uses the 4-bit tables.
+ *
+ * @param key the hash key
+ * @param state the running hash value
+ * @param data the data to hash
+ * @param len number of bytes of data
+*/
+void ghashTableUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len );
+
+/**
+ * Reports whether this processor supports the carry-less multiply instruction.
+ *
+ * @return true if ghashClmulUpdate() can be used
+*/
+bool clmulSupported( void );
+
+/**
+ * Like ghashUpdate(), but always uses carry-less multiplication.
+ * Only call this if clmulSupported() is true.
+ *
+ * @param key the hash key
+ * @param state the running hash value
+ * @param data the data to hash
+ * @param len number of bytes of data
+*/
+void ghashClmulUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len );
+
+#endif
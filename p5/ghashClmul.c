@@ -0,0 +1,167 @@
+/**
+ * @file ghashClmul.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * GHASH built on the PCLMULQDQ carry-less multiply instruction. Blocks are
+ * byte-reversed on load so the GCM bit order lines up with the register's,
+ * which leaves the product shifted by one bit before it's reduced. Four
+ * blocks are multiplied by H^4 ... H^1 and summed before a single reduction,
+ * since both the shift and the reduction are linear. The functions are
+ * compiled for PCLMULQDQ with target attributes, so the rest of the program
+ * still runs on processors without it.
+ */
+
+#include "ghash.h"
+#include <stdlib.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+#include <cpuid.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+/** Marks a function as using the carry-less multiply instruction set. */
+#define CLMUL_TARGET __attribute__(( target( "pclmul,ssse3,sse2" ) ))
+
+bool clmulSupported( void )
+{
+  // -1 until the processor has been checked
+  static int supported = -1;
+
+  if (supported < 0) {
+    unsigned int eax, ebx, ecx, edx;
+    supported = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL);
+  }
+
+  return supported;
+}
+
+/**
+ * Returns the shuffle control that reverses the bytes of a register.
+ *
+ * @return the byte reversal mask
+*/
+CLMUL_TARGET static __m128i reverseMask( void )
+{
+  return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+
+/**
+ * Computes the full 256-bit carry-less product of a and b and adds it to
+ * the running sum in low and high.
+ *
+ * @param a the first value
+ * @param b the second value
+ * @param low the low half of the sum
+ * @param high the high half of the sum
+*/
+CLMUL_TARGET static void mulAdd( __m128i a, __m128i b, __m128i *low, __m128i *high )
+{
+  __m128i lo = _mm_clmulepi64_si128(a, b, 0x00);
+  __m128i hi = _mm_clmulepi64_si128(a, b, 0x11);
+  __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+
+  *low = _mm_xor_si128(*low, _mm_xor_si128(lo, _mm_slli_si128(mid, 8)));
+  *high = _mm_xor_si128(*high, _mm_xor_si128(hi, _mm_srli_si128(mid, 8)));
+}
+
+/**
+ * Shifts a 256-bit product left by one bit to undo the reflection and
+ * reduces it modulo x^128 + x^7 + x^2 + x + 1.
+ *
+ * @param low the low half of the product
+ * @param high the high half of the product
+ * @return the reduced product
+*/
+CLMUL_TARGET static __m128i reduce( __m128i low, __m128i high )
+{
+  // Shift the whole 256-bit value left by one
+  __m128i lowCarry = _mm_srli_epi32(low, 31);
+  __m128i highCarry = _mm_srli_epi32(high, 31);
+  low = _mm_slli_epi32(low, 1);
+  high = _mm_slli_epi32(high, 1);
+  __m128i across = _mm_srli_si128(lowCarry, 12);
+  low = _mm_or_si128(low, _mm_slli_si128(lowCarry, 4));
+  high = _mm_or_si128(high, _mm_slli_si128(highCarry, 4));
+  high = _mm_or_si128(high, across);
+
+  // First phase of the reduction
+  __m128i t = _mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30));
+  t = _mm_xor_si128(t, _mm_slli_epi32(low, 25));
+  __m128i spill = _mm_srli_si128(t, 4);
+  low = _mm_xor_si128(low, _mm_slli_si128(t, 12));
+
+  // Second phase
+  t = _mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2));
+  t = _mm_xor_si128(t, _mm_srli_epi32(low, 7));
+  t = _mm_xor_si128(t, spill);
+  low = _mm_xor_si128(low, t);
+
+  return _mm_xor_si128(high, low);
+}
+
+CLMUL_TARGET void ghashClmulUpdate( GhashKey const *key, byte state[ GHASH_SIZE ],
+                                    byte const *data, size_t len )
+{
+  __m128i const mask = reverseMask();
+  __m128i h[GHASH_LANES];
+  for (int i = 0; i < GHASH_LANES; i++) {
+    h[i] = _mm_set_epi64x(key->powers[i][0], key->powers[i][1]);
+  }
+
+  __m128i y = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *) state), mask);
+
+  // Y' = (Y + X1) H^4 + X2 H^3 + X3 H^2 + X4 H, with one reduction
+  while (len >= GHASH_LANES * GHASH_SIZE) {
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+
+    for (int i = 0; i < GHASH_LANES; i++) {
+      __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *) (data + i * GHASH_SIZE)), mask);
+      if (i == 0) {
+        x = _mm_xor_si128(x, y);
+      }
+      mulAdd(x, h[GHASH_LANES - 1 - i], &low, &high);
+    }
+
+    y = reduce(low, high);
+    data += GHASH_LANES * GHASH_SIZE;
+    len -= GHASH_LANES * GHASH_SIZE;
+  }
+
+  // Whatever's left goes one block at a time, the last one padded with zeros
+  while (len > 0) {
+    byte block[GHASH_SIZE] = { 0 };
+    size_t n = len < GHASH_SIZE ? len : GHASH_SIZE;
+    for (size_t i = 0; i < n; i++) {
+      block[i] = data[i];
+    }
+
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *) block), mask);
+    __m128i low = _mm_setzero_si128();
+    __m128i high = _mm_setzero_si128();
+    mulAdd(_mm_xor_si128(x, y), h[0], &low, &high);
+    y = reduce(low, high);
+
+    data += n;
+    len -= n;
+  }
+
+  _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi8(y, mask));
+}
+
+#else
+
+bool clmulSupported( void )
+{
+  return false;
+}
+
+// Never selected on processors without carry-less multiply.
+
+void ghashClmulUpdate( GhashKey const *key, byte state[ GHASH_SIZE ], byte const *data, size_t len )
+{
+  abort();
+}
+
+#endif
@@ -6,10 +6,21 @@
  * files when the encrypt or decrypt program is done.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "io.h"
 
+#ifdef __linux__
+#include <errno.h>
+#include <sys/random.h>
+#endif
+
 /**
  * Checks whether the given file is valid
  * 
@@ -18,30 +29,32 @@
 static void checkFile( FILE *fp, char const *filename )
 {
   if (!fp) {
-    free(fp);
     fprintf(stderr, "Can't open file: %s\n", filename);
     exit(EXIT_FAILURE);
   }
 }
 
-byte *readBinaryFile( char const *filename, int *size )
+byte *readBinaryFile( char const *filename, size_t *size )
 {
   // Open the input file
   FILE *src = fopen(filename, "rb");
   checkFile(src, filename);
 
-  while (fgetc(src) != EOF) {
-    *size += 1;
-  }
-
-  // Create space to store the data being read
-  byte *data = malloc(*size);
-
-  // Go back to the start of the file
-  rewind(src);
+  // Create space to store the data being read, growing it as needed
+  size_t capacity = MAX_BYTES;
+  byte *data = malloc(capacity);
+  *size = 0;
 
   // Read the file
-  fread(data, sizeof(byte), *size, src);
+  size_t n;
+  while ((n = readChunk(src, data + *size, capacity - *size)) > 0) {
+    *size += n;
+
+    if (*size == capacity) {
+      capacity *= 2;
+      data = realloc(data, capacity);
+    }
+  }
 
   // Close the file
   fclose(src);
@@ -49,14 +62,287 @@ byte *readBinaryFile( char const *filename, int *size )
   return data;
 }
 
-void writeBinaryFile( char const *filename, byte *data, int size )
+void writeBinaryFile( char const *filename, byte *data, size_t size )
 {
   // Open the output file
   FILE *dest = fopen(filename, "wb");
   checkFile(dest, filename);
 
-  fwrite(data, sizeof(byte), size, dest);
+  writeChunk(dest, data, size);
 
   // Close the output file
   fclose(dest);
 }
+
+FILE *openFile( char const *filename, char const *mode )
+{
+  FILE *fp = fopen(filename, mode);
+  checkFile(fp, filename);
+  return fp;
+}
+
+bool fileSize( FILE *fp, uint64_t *size )
+{
+  struct stat info;
+
+  if (fstat(fileno(fp), &info) != 0 || !S_ISREG(info.st_mode)) {
+    return false;
+  }
+
+  *size = info.st_size;
+  return true;
+}
+
+bool sameFile( FILE *fp, char const *filename )
+{
+  struct stat in, out;
+
+  if (fstat(fileno(fp), &in) != 0 || !S_ISREG(in.st_mode) || stat(filename, &out) != 0) {
+    return false;
+  }
+
+  return in.st_dev == out.st_dev && in.st_ino == out.st_ino;
+}
+
+/** Ending mkstemp() fills in to make a temporary name unique. */
+#define TEMP_SUFFIX ".XXXXXX"
+
+/**
+ * Makes a hidden name next to the given file, for mkstemp() to fill in.
+ * 
+ * @param filename the file to put the name next to
+ * @return the name, which the caller frees
+*/
+static char *hiddenTempName( char const *filename )
+{
+  char const *slash = strrchr(filename, '/');
+  int dirLen = slash ? slash + 1 - filename : 0;
+  char *name = malloc(strlen(filename) + 2 + strlen(TEMP_SUFFIX));
+  sprintf(name, "%.*s.%s" TEMP_SUFFIX, dirLen, filename, filename + dirLen);
+  return name;
+}
+
+/** Replacements that are still being written, which are removed if the program exits. */
+static Replacement *pending = NULL;
+
+/** Guards the pending list and the umask, since batch workers open outputs at once. */
+static pthread_mutex_t pendingLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Removes every replacement that was never committed or discarded.
+*/
+static void removePending( void )
+{
+  for (Replacement *r = pending; r; r = r->next) {
+    remove(r->tempName);
+  }
+}
+
+/**
+ * Takes a replacement off the pending list.
+ * 
+ * @param r the replacement to take off
+*/
+static void unlistReplacement( Replacement *r )
+{
+  pthread_mutex_lock(&pendingLock);
+  for (Replacement **p = &pending; *p; p = &( *p )->next) {
+    if (*p == r) {
+      *p = r->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&pendingLock);
+}
+
+FILE *openReplacement( Replacement *r, char const *filename )
+{
+  r->filename = filename;
+  r->tempName = NULL;
+  r->next = NULL;
+
+  struct stat info;
+  bool exists = stat(filename, &info) == 0;
+  if (exists && !S_ISREG(info.st_mode)) {
+    r->fp = fopen(filename, "wb");
+    return r->fp;
+  }
+
+  // A hidden name next to the real one, so the rename stays on one file system
+  r->tempName = hiddenTempName(filename);
+
+  static bool registered = false;
+  pthread_mutex_lock(&pendingLock);
+  int fd = mkstemp(r->tempName);
+  if (fd >= 0) {
+    // mkstemp() makes the file private, so give it the permissions
+    // of the file it replaces, or of a new file
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, exists ? info.st_mode & 07777 : 0666 & ~mask);
+
+    r->next = pending;
+    pending = r;
+    if (!registered) {
+      atexit(removePending);
+      registered = true;
+    }
+  }
+  pthread_mutex_unlock(&pendingLock);
+
+  r->fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  if (!r->fp) {
+    if (fd >= 0) {
+      unlistReplacement(r);
+      remove(r->tempName);
+      close(fd);
+    }
+    free(r->tempName);
+    r->tempName = NULL;
+  }
+  return r->fp;
+}
+
+bool commitReplacement( Replacement *r )
+{
+  bool ok = fclose(r->fp) == 0;
+  if (r->tempName) {
+    ok = ok && rename(r->tempName, r->filename) == 0;
+    if (!ok) {
+      remove(r->tempName);
+    }
+    unlistReplacement(r);
+    free(r->tempName);
+    r->tempName = NULL;
+  }
+  return ok;
+}
+
+void discardReplacement( Replacement *r )
+{
+  fclose(r->fp);
+  if (r->tempName) {
+    remove(r->tempName);
+    unlistReplacement(r);
+    free(r->tempName);
+    r->tempName = NULL;
+  }
+}
+
+FILE *makeSpool( char const *near )
+{
+  // A device or a pipe has no directory of its own to share, so the spool
+  // goes wherever TMPDIR says instead
+  struct stat info;
+  char *name;
+  if (stat(near, &info) == 0 && !S_ISREG(info.st_mode)) {
+    char const *dir = getenv("TMPDIR");
+    dir = dir && *dir ? dir : "/tmp";
+    name = malloc(strlen(dir) + strlen("/spool") + 2 + strlen(TEMP_SUFFIX));
+    sprintf(name, "%s/spool", dir);
+    char *hidden = hiddenTempName(name);
+    free(name);
+    name = hidden;
+  }
+  else {
+    name = hiddenTempName(near);
+  }
+
+  // Removed as soon as it's open, so it's gone however the program ends
+  int fd = mkstemp(name);
+  FILE *spool = NULL;
+  if (fd >= 0) {
+    remove(name);
+    spool = fdopen(fd, "w+b");
+  }
+  free(name);
+
+  if (!spool) {
+    fprintf(stderr, "Can't create temporary file\n");
+    exit(EXIT_FAILURE);
+  }
+  return spool;
+}
+
+size_t readChunk( FILE *fp, byte *data, size_t size )
+{
+  size_t total = 0;
+
+  // fread() can return less than asked for on pipes, so keep going
+  while (total < size) {
+    size_t n = fread(data + total, sizeof(byte), size - total, fp);
+    if (n == 0) {
+      break;
+    }
+    total += n;
+  }
+
+  if (ferror(fp)) {
+    fprintf(stderr, "Can't read file\n");
+    exit(EXIT_FAILURE);
+  }
+
+  return total;
+}
+
+void writeChunk( FILE *fp, byte const *data, size_t size )
+{
+  if (fwrite(data, sizeof(byte), size, fp) != size) {
+    fprintf(stderr, "Can't write file\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void writeTrimmed( TrimWriter *writer, byte const *data, size_t size )
+{
+  // Find the end of the nonzero data
+  size_t end = size;
+  while (end > 0 && data[end - 1] == 0x00) {
+    end--;
+  }
+
+  // All zeros, so just remember them
+  if (end == 0) {
+    writer->zeros += size;
+    return;
+  }
+
+  // Zeros held back earlier turned out not to be at the end
+  byte zeros[MAX_BYTES] = { 0 };
+  while (writer->zeros > 0) {
+    size_t n = writer->zeros < MAX_BYTES ? writer->zeros : MAX_BYTES;
+    writeChunk(writer->fp, zeros, n);
+    writer->zeros -= n;
+  }
+
+  writeChunk(writer->fp, data, end);
+  writer->zeros = size - end;
+}
+
+void randomBytes( byte *data, size_t size )
+{
+#ifdef __linux__
+  // getrandom() needs no file descriptor, but can return fewer bytes than asked for
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = getrandom(data + done, size - done, 0);
+    if (n < 0 && errno != EINTR) {
+      break;
+    }
+    done += n > 0 ? n : 0;
+  }
+  if (done == size) {
+    return;
+  }
+#endif
+
+  FILE *src = fopen("/dev/urandom", "rb");
+  checkFile(src, "/dev/urandom");
+
+  if (fread(data, sizeof(byte), size, src) != size) {
+    fprintf(stderr, "Can't read random bytes\n");
+    exit(EXIT_FAILURE);
+  }
+
+  fclose(src);
+}
@@ -6,6 +6,13 @@
  * and function prototypes for the io component
 */
 
+#ifndef _IO_H_
+#define _IO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 #include "field.h"
 
 /** Max number of bytes to read */
@@ -14,14 +21,46 @@
 /** Number of bytes of each section of data */
 #define DATA_SIZE 16
 
+/**
+ * Writes data to a file while holding back any trailing zero bytes, so zero
+ * padding can be stripped from the end of a stream without knowing in advance
+ * where the end is. Held-back zeros are written as soon as a nonzero byte follows.
+*/
+typedef struct {
+  /** The file to write to. */
+  FILE *fp;
+
+  /** Number of zero bytes written to this writer but not yet to the file. */
+  uint64_t zeros;
+} TrimWriter;
+
+/**
+ * An output file that's written under a temporary name in the same directory
+ * and only renamed over the real one once it's complete, so a run that fails
+ * partway leaves whatever file was there before untouched.
+*/
+typedef struct Replacement {
+  /** The file to write to. */
+  FILE *fp;
+
+  /** Name the file gets once it's complete. */
+  char const *filename;
+
+  /** Name it's written under, or NULL if it's written in place because it isn't a regular file. */
+  char *tempName;
+
+  /** Next replacement still being written, so they can all be removed at exit. */
+  struct Replacement *next;
+} Replacement;
+
 /**
  * Reads the contents of the binary file with the given name
  * 
  * @param filename the file to read from
- * @param size an integer pointer whose value is filled with the total size of the given file
+ * @param size filled in with the total size of the given file
  * @return a pointer to a dynamically allocated array of bytes containing the entire file contents
 */
-byte *readBinaryFile( char const *filename, int *size );
+byte *readBinaryFile( char const *filename, size_t *size );
 
 /**
  * Writes the contents of the given data array (in binary) to the file with the given name
@@ -30,4 +69,113 @@ byte *readBinaryFile( char const *filename, int *size );
  * @param data the data to write
  * @param size number of bytes contained in the data array
 */
-void writeBinaryFile( char const *filename, byte *data, int size );
+void writeBinaryFile( char const *filename, byte *data, size_t size );
+
+/**
+ * Opens the file with the given name in the given mode.
+ * Terminates the program if it can't be opened.
+ * 
+ * @param filename the file to open
+ * @param mode the fopen() mode to open it with
+ * @return the open file
+*/
+FILE *openFile( char const *filename, char const *mode );
+
+/**
+ * Gets the size of an open file, if it's a regular file.
+ * 
+ * @param fp the file to check
+ * @param size filled in with the size of the file, in bytes
+ * @return true if the size is known
+*/
+bool fileSize( FILE *fp, uint64_t *size );
+
+/**
+ * Checks whether the file with the given name is the same regular file as an
+ * open file, even under another name, so the output of a run can't be opened
+ * for writing over the input it's still reading.
+ * 
+ * @param fp the open file
+ * @param filename name of the other file, which may not exist
+ * @return true if both are the same regular file
+*/
+bool sameFile( FILE *fp, char const *filename );
+
+/**
+ * Starts writing a file that will replace the one with the given name. An
+ * existing file that isn't a regular file, like a device or a pipe, is written
+ * directly, since it can't be renamed over. If the program exits before the
+ * replacement is committed or discarded, the temporary file is removed.
+ * 
+ * @param r the replacement to set up
+ * @param filename name of the file to replace, which may not exist yet
+ * @return the file to write to, or NULL if it can't be created
+*/
+FILE *openReplacement( Replacement *r, char const *filename );
+
+/**
+ * Closes a replacement and renames it over the file it replaces.
+ * 
+ * @param r the replacement to finish
+ * @return false if it couldn't be written or renamed, in which case it's removed
+*/
+bool commitReplacement( Replacement *r );
+
+/**
+ * Closes a replacement and removes it, leaving the file it would have replaced alone.
+ * 
+ * @param r the replacement to throw away
+*/
+void discardReplacement( Replacement *r );
+
+/**
+ * Creates an anonymous temporary file to hold data until it's known to be
+ * good. It's made in the same directory as the given file, so it takes space
+ * where the output is going rather than in /tmp, unless that file is a device
+ * or a pipe. Terminates the program if it can't be created.
+ * 
+ * @param near name of the file to put it next to, which may not exist yet
+ * @return the open file, which is deleted when it's closed
+*/
+FILE *makeSpool( char const *near );
+
+/**
+ * Reads up to size bytes, stopping early only at the end of the file.
+ * Terminates the program on a read error.
+ * 
+ * @param fp the file to read from
+ * @param data the array to read into
+ * @param size number of bytes to read
+ * @return number of bytes read, less than size only at the end of the file
+*/
+size_t readChunk( FILE *fp, byte *data, size_t size );
+
+/**
+ * Writes all of the given bytes. Terminates the program on a write error.
+ * 
+ * @param fp the file to write to
+ * @param data the bytes to write
+ * @param size number of bytes to write
+*/
+void writeChunk( FILE *fp, byte const *data, size_t size );
+
+/**
+ * Writes bytes through a TrimWriter, holding back any zeros at the end.
+ * 
+ * @param writer the writer to write through
+ * @param data the bytes to write
+ * @param size number of bytes to write
+*/
+void writeTrimmed( TrimWriter *writer, byte const *data, size_t size );
+
+/**
+ * Fills the given array with random bytes from the operating system, using
+ * getrandom() where there is one and /dev/urandom otherwise.
+ * Terminates the program if they can't be read.
+ * 
+ * @param data the array to fill
+ * @param size number of bytes to fill
+*/
+void randomBytes( byte *data, size_t size );
+
+#endif
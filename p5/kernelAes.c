@@ -0,0 +1,304 @@
+/**
+ * @file kernelAes.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * ECB and CTR mode through the kernel's AF_ALG sockets. Each request sets
+ * the direction and the IV with a control message, then the data goes in
+ * and the result is read back out. Where the kernel allows it, the data is
+ * vmspliced into a pipe and spliced from there into the socket, so the
+ * kernel works on the caller's pages instead of a copy of them. If that
+ * fails, the data is sent with an ordinary sendmsg instead.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernelAes.h"
+#include "ctr.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if_alg.h>
+
+#ifndef SOL_ALG
+/** Socket level of the AF_ALG options, for C libraries that don't define it. */
+#define SOL_ALG 279
+#endif
+
+/** Largest number of bytes in one request, which is what a pipe holds by default. */
+#define KERNEL_REQUEST ( 64 * 1024 )
+
+struct KernelAesStruct {
+  /** Socket bound to the algorithm, which holds the key. */
+  int tfm;
+
+  /** Socket for the requests themselves. */
+  int op;
+
+  /** Pipe the data is spliced through, or -1s if there isn't one. */
+  int pipe[ 2 ];
+
+  /** True for CTR mode, false for ECB mode. */
+  bool counter;
+
+  /** True as long as splicing the data into the socket works. */
+  bool splice;
+};
+
+/**
+ * Prints an error for a request the kernel didn't complete and terminates the program.
+*/
+static void kernelFail( void )
+{
+  fprintf(stderr, "Kernel crypto request failed\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Opens an AF_ALG socket bound to the named skcipher algorithm.
+ *
+ * @param name the kernel's name for the algorithm
+ * @return the socket, or -1 if the kernel doesn't have it
+*/
+static int bindAlgorithm( char const *name )
+{
+  int fd = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct sockaddr_alg sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.salg_family = AF_ALG;
+  strcpy((char *) sa.salg_type, "skcipher");
+  strcpy((char *) sa.salg_name, name);
+
+  if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+bool kernelSupported( void )
+{
+  // -1 until the kernel has been checked
+  static int supported = -1;
+
+  if (supported < 0) {
+    int fd = bindAlgorithm("ecb(aes)");
+    supported = fd >= 0;
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+
+  return supported;
+}
+
+KernelAes *makeKernelAes( bool counter, byte const key[ BLOCK_SIZE ] )
+{
+  int tfm = bindAlgorithm(counter ? "ctr(aes)" : "ecb(aes)");
+  if (tfm < 0) {
+    return NULL;
+  }
+
+  int op = -1;
+  if (setsockopt(tfm, SOL_ALG, ALG_SET_KEY, key, BLOCK_SIZE) != 0
+      || (op = accept4(tfm, NULL, 0, SOCK_CLOEXEC)) < 0) {
+    close(tfm);
+    return NULL;
+  }
+
+  KernelAes *kernel = malloc(sizeof(KernelAes));
+  kernel->tfm = tfm;
+  kernel->op = op;
+  kernel->counter = counter;
+  kernel->splice = pipe2(kernel->pipe, O_CLOEXEC) == 0;
+  if (!kernel->splice) {
+    kernel->pipe[0] = kernel->pipe[1] = -1;
+  }
+
+  return kernel;
+}
+
+/**
+ * Starts a request, setting its direction and IV, along with any data sent with it.
+ *
+ * @param kernel the loaded key
+ * @param encrypt true to encrypt, false to decrypt
+ * @param iv the IV of the request, for CTR mode
+ * @param in the data to send with the request
+ * @param len number of bytes to send, which may be 0
+ * @param flags MSG_MORE if more data will follow
+ * @return true if everything was sent
+*/
+static bool startRequest( KernelAes *kernel, bool encrypt, byte const iv[ BLOCK_SIZE ],
+                          byte const *in, size_t len, int flags )
+{
+  union {
+    struct cmsghdr align;
+    char buf[ CMSG_SPACE( sizeof( uint32_t ) )
+              + CMSG_SPACE( sizeof( struct af_alg_iv ) + BLOCK_SIZE ) ];
+  } control;
+  memset(&control, 0, sizeof(control));
+
+  struct iovec iov = { (void *) in, len };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = len > 0 ? 1 : 0;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = kernel->counter ? sizeof(control.buf) : CMSG_SPACE(sizeof(uint32_t));
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_ALG;
+  cmsg->cmsg_type = ALG_SET_OP;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+  uint32_t op = encrypt ? ALG_OP_ENCRYPT : ALG_OP_DECRYPT;
+  memcpy(CMSG_DATA(cmsg), &op, sizeof(op));
+
+  if (kernel->counter) {
+    cmsg = CMSG_NXTHDR(&msg, cmsg);
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_IV;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + BLOCK_SIZE);
+
+    struct af_alg_iv *algIv = (struct af_alg_iv *) CMSG_DATA(cmsg);
+    algIv->ivlen = BLOCK_SIZE;
+    memcpy(algIv->iv, iv, BLOCK_SIZE);
+  }
+
+  return sendmsg(kernel->op, &msg, flags) == (ssize_t) len;
+}
+
+/**
+ * Moves the data of a started request into the socket through the pipe,
+ * without copying it. The request is ended with the last of the data.
+ *
+ * @param kernel the loaded key
+ * @param in the data to move
+ * @param len number of bytes to move
+ * @return number of bytes moved, which is less than len if vmsplice doesn't work here
+*/
+static size_t spliceData( KernelAes *kernel, byte const *in, size_t len )
+{
+  size_t done = 0;
+
+  while (done < len) {
+    struct iovec iov = { (void *) (in + done), len - done };
+    ssize_t mapped = vmsplice(kernel->pipe[1], &iov, 1, 0);
+    if (mapped <= 0) {
+      break;
+    }
+
+    // Once bytes are in the pipe, they have to make it into the socket
+    while (mapped > 0) {
+      bool last = done + mapped == len;
+      ssize_t moved = splice(kernel->pipe[0], NULL, kernel->op, NULL, mapped,
+                             last ? 0 : SPLICE_F_MORE);
+      if (moved <= 0) {
+        kernelFail();
+      }
+
+      mapped -= moved;
+      done += moved;
+    }
+  }
+
+  return done;
+}
+
+void kernelCrypt( KernelAes *kernel, bool encrypt, byte const nonce[ BLOCK_SIZE ],
+                  uint64_t offset, byte const *in, byte *out, size_t len )
+{
+  byte iv[BLOCK_SIZE];
+
+  for (size_t done = 0; done < len; ) {
+    size_t n = len - done < KERNEL_REQUEST ? len - done : KERNEL_REQUEST;
+
+    if (kernel->counter) {
+      counterBlock(iv, nonce, ( offset + done ) / BLOCK_SIZE);
+    }
+
+    if (kernel->splice) {
+      if (!startRequest(kernel, encrypt, iv, NULL, 0, MSG_MORE)) {
+        kernelFail();
+      }
+
+      // Whatever couldn't be spliced is sent instead, which also ends the request
+      size_t moved = spliceData(kernel, in + done, n);
+      if (moved < n) {
+        kernel->splice = false;
+
+        struct iovec iov = { (void *) (in + done + moved), n - moved };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (sendmsg(kernel->op, &msg, 0) != (ssize_t) ( n - moved )) {
+          kernelFail();
+        }
+      }
+    }
+    else if (!startRequest(kernel, encrypt, iv, in + done, n, 0)) {
+      kernelFail();
+    }
+
+    for (size_t got = 0; got < n; ) {
+      ssize_t r = read(kernel->op, out + done + got, n - got);
+      if (r <= 0) {
+        kernelFail();
+      }
+      got += r;
+    }
+
+    done += n;
+  }
+}
+
+void freeKernelAes( KernelAes *kernel )
+{
+  if (kernel->pipe[0] >= 0) {
+    close(kernel->pipe[0]);
+    close(kernel->pipe[1]);
+  }
+  close(kernel->op);
+  close(kernel->tfm);
+  free(kernel);
+}
+
+#else
+
+bool kernelSupported( void )
+{
+  return false;
+}
+
+KernelAes *makeKernelAes( bool counter, byte const key[ BLOCK_SIZE ] )
+{
+  return NULL;
+}
+
+// The remaining functions are never reached without AF_ALG.
+
+void kernelCrypt( KernelAes *kernel, bool encrypt, byte const nonce[ BLOCK_SIZE ],
+                  uint64_t offset, byte const *in, byte *out, size_t len )
+{
+  abort();
+}
+
+void freeKernelAes( KernelAes *kernel )
+{
+  abort();
+}
+
+#endif
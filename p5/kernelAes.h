@@ -0,0 +1,61 @@
+/**
+ * @file kernelAes.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for running ECB and CTR mode in the Linux kernel's
+ * crypto API, through an AF_ALG socket, so hosts with a crypto driver
+ * that's faster than the user-space backends can use it.
+ */
+
+#ifndef _KERNEL_AES_H_
+#define _KERNEL_AES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aes.h"
+
+/** One key loaded into the kernel, in one mode. */
+typedef struct KernelAesStruct KernelAes;
+
+/**
+ * Reports whether this kernel offers AES through AF_ALG sockets.
+ * The answer is worked out once and remembered.
+ *
+ * @return true if makeKernelAes() can work here
+*/
+bool kernelSupported( void );
+
+/**
+ * Loads a key into the kernel, for ecb(aes) or ctr(aes).
+ *
+ * @param counter true for CTR mode, false for ECB mode
+ * @param key the 16-byte key
+ * @return the loaded key, or NULL if the kernel can't do it
+*/
+KernelAes *makeKernelAes( bool counter, byte const key[ BLOCK_SIZE ] );
+
+/**
+ * Encrypts or decrypts part of a stream in the kernel. In CTR mode, block i of
+ * the stream is combined with the encryption of nonce + i, as in ctrCrypt(),
+ * and encrypting and decrypting are the same. Terminates the program if the
+ * kernel fails part way through.
+ *
+ * @param kernel the loaded key
+ * @param encrypt true to encrypt, false to decrypt
+ * @param nonce the initial counter block, for CTR mode
+ * @param offset position of in[ 0 ] within the whole stream, a multiple of BLOCK_SIZE
+ * @param in the bytes to process
+ * @param out the array to store the result in, which may be the same as in
+ * @param len number of bytes to process, a multiple of BLOCK_SIZE in ECB mode
+*/
+void kernelCrypt( KernelAes *kernel, bool encrypt, byte const nonce[ BLOCK_SIZE ],
+                  uint64_t offset, byte const *in, byte *out, size_t len );
+
+/**
+ * Releases a key loaded into the kernel.
+ *
+ * @param kernel the loaded key
+*/
+void freeKernelAes( KernelAes *kernel );
+
+#endif
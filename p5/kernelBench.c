@@ -0,0 +1,156 @@
+/**
+ * @file kernelBench.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Throughput benchmark for the kernel backend. Encrypts a buffer in ECB
+ * and CTR mode, a chunk at a time, with each user-space backend and then
+ * with the kernel's crypto API, and reports the speed of each at several
+ * chunk sizes. Everything runs on one thread, since the kernel backend
+ * does its work on the calling thread.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "aes.h"
+#include "cipher.h"
+#include "kernelAes.h"
+#include "pool.h"
+
+/** Default size of the buffer to encrypt, in bytes. */
+#define DEFAULT_SIZE ( 64 * 1024 * 1024 )
+
+/** Number of times each measurement is repeated. */
+#define REPEATS 3
+
+/** Bytes in a megabyte, for reporting. */
+#define MEGABYTE 1e6
+
+/** Chunk sizes to measure, in bytes. */
+static size_t const chunkSizes[] = { 4096, 16384, 65536, 262144, 1048576, 4194304 };
+
+/**
+ * Returns the current time in seconds.
+ *
+ * @return a monotonic time value
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Measures the best throughput of encrypting a buffer one chunk at a time.
+ *
+ * @param mode the mode of operation
+ * @param kernel true to have the kernel do the work
+ * @param pool the pool for the cipher
+ * @param data the buffer to encrypt in place
+ * @param size number of bytes in the buffer
+ * @param chunk number of bytes per chunk
+ * @return throughput in megabytes per second, or 0 if the kernel can't do it
+*/
+static double measure( Mode mode, bool kernel, ThreadPool *pool, byte *data, size_t size,
+                       size_t chunk )
+{
+  static byte const key[BLOCK_SIZE] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+                                        0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+  Cipher cipher;
+  initCipher(&cipher, mode, key, pool);
+  if (kernel && !useKernel(&cipher)) {
+    return 0;
+  }
+
+  byte header[MAX_HEADER_SIZE];
+  double best = 0;
+
+  for (int i = 0; i < REPEATS; i++) {
+    makeHeader(&cipher, header);
+    cipher.position = 0;
+
+    double start = now();
+    for (size_t off = 0; off < size; off += chunk) {
+      encryptChunk(&cipher, data + off, data + off, size - off < chunk ? size - off : chunk);
+    }
+    double elapsed = now() - start;
+
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  releaseCipher(&cipher);
+  return size / best / MEGABYTE;
+}
+
+/**
+ * Entry point of program. An optional argument gives the
+ * size of the buffer to encrypt, in bytes.
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main( int argc, char const *argv[] )
+{
+  size_t size = DEFAULT_SIZE;
+  if (argc > 1) {
+    size = strtoull(argv[1], NULL, 10);
+  }
+
+  size -= size % BLOCK_SIZE;
+  if (size == 0) {
+    fprintf(stderr, "usage: kernelBench [bytes]\n");
+    return EXIT_FAILURE;
+  }
+
+  byte *data = malloc(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = i * 7 + 3;
+  }
+
+  ThreadPool *pool = makePool(1);
+  bool kernel = kernelSupported();
+  if (!kernel) {
+    printf("kernel backend not available here, so only user space is measured\n");
+  }
+
+  printf("%-10s %-4s %10s %12s\n", "backend", "mode", "chunk", "MB/s");
+
+  size_t nchunks = sizeof(chunkSizes) / sizeof(chunkSizes[0]);
+  Mode modes[] = { MODE_ECB, MODE_CTR };
+  char const *modeNames[] = { "ecb", "ctr" };
+
+  for (int m = 0; m < 2; m++) {
+    for (size_t c = 0; c < nchunks; c++) {
+      for (int b = 0; b < BACKEND_COUNT; b++) {
+        // The reference backend is too slow to be worth measuring here
+        if (b == BACKEND_REFERENCE || !aesSetBackend(b)) {
+          continue;
+        }
+
+        double rate = measure(modes[m], false, pool, data, size, chunkSizes[c]);
+        printf("%-10s %-4s %10zu %12.1f\n", aesBackendName(b), modeNames[m], chunkSizes[c], rate);
+      }
+
+      if (kernel) {
+        double rate = measure(modes[m], true, pool, data, size, chunkSizes[c]);
+        if (rate > 0) {
+          printf("%-10s %-4s %10zu %12.1f\n", "kernel", modeNames[m], chunkSizes[c], rate);
+        }
+        else {
+          printf("%-10s %-4s %10zu %12s\n", "kernel", modeNames[m], chunkSizes[c], "n/a");
+        }
+      }
+    }
+  }
+
+  freePool(pool);
+  free(data);
+  return EXIT_SUCCESS;
+}
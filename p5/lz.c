@@ -0,0 +1,287 @@
+/**
+ * @file lz.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * The LZ77 block coder. Each sequence starts with a token byte: the high
+ * four bits hold the literal count and the low four bits hold the match
+ * length less LZ_MIN_MATCH. A field of 15 is continued in the bytes that
+ * follow, each added on, until one is less than 255. The literals come next,
+ * then the match offset, two bytes little-endian, then any continuation of
+ * the match length. The last sequence has only literals, and ends the block.
+ *
+ * Matches are found greedily, with a hash table of the last position each
+ * 4-byte string was seen at. On data with no matches, the search skips
+ * further ahead the longer it goes without finding one.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "lz.h"
+
+/** Number of bits in a hash table index. */
+#define HASH_BITS 14
+
+/** Multiplier for hashing 4-byte strings, from Knuth's multiplicative hashing. */
+#define HASH_PRIME 2654435761U
+
+/** Largest value a length field in the token can hold. */
+#define FIELD_MAX 15
+
+/** Continuation byte that says another byte follows. */
+#define MORE 255
+
+/** Number of bits the literal count is shifted by in the token. */
+#define LITERAL_SHIFT 4
+
+/** Number of bytes in a match offset. */
+#define OFFSET_SIZE 2
+
+/** Log2 of the number of misses before the search starts skipping ahead. */
+#define SKIP_SHIFT 6
+
+/**
+ * Reads 4 bytes that may not be aligned.
+ *
+ * @param p where to read from
+ * @return the bytes, in host order
+*/
+static uint32_t read32( byte const *p )
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * Hashes the 4-byte string at p.
+ *
+ * @param p the string
+ * @return index into the hash table
+*/
+static uint32_t hashAt( byte const *p )
+{
+  return ( read32(p) * HASH_PRIME ) >> ( 32 - HASH_BITS );
+}
+
+/**
+ * Measures how far two strings that start with LZ_MIN_MATCH equal bytes
+ * stay equal, comparing a word at a time.
+ *
+ * @param a the earlier string
+ * @param b the later string
+ * @param limit most bytes to compare, the bytes left in the input from b on
+ * @return number of equal bytes
+*/
+static size_t matchLength( byte const *a, byte const *b, size_t limit )
+{
+  size_t n = LZ_MIN_MATCH;
+
+  while (n + sizeof(uint64_t) <= limit) {
+    uint64_t x, y;
+    memcpy(&x, a + n, sizeof(x));
+    memcpy(&y, b + n, sizeof(y));
+    if (x != y) {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      return n + __builtin_ctzll(x ^ y) / BBITS;
+#else
+      break;
+#endif
+    }
+    n += sizeof(uint64_t);
+  }
+
+  while (n < limit && a[n] == b[n]) {
+    n++;
+  }
+  return n;
+}
+
+/**
+ * Stores the continuation of a length field.
+ *
+ * @param op where to store it
+ * @param oend end of the output
+ * @param n what's left of the length after the token field
+ * @return the position after the continuation, or NULL if it wouldn't fit
+*/
+static byte *putLength( byte *op, byte const *oend, size_t n )
+{
+  while (n >= MORE) {
+    if (op == oend) {
+      return NULL;
+    }
+    *op++ = MORE;
+    n -= MORE;
+  }
+
+  if (op == oend) {
+    return NULL;
+  }
+  *op++ = n;
+  return op;
+}
+
+/**
+ * Stores one sequence.
+ *
+ * @param op where to store it
+ * @param oend end of the output
+ * @param lit the literals
+ * @param litLen number of literals
+ * @param offset how far back the match starts, or 0 for the last sequence
+ * @param matchLen number of bytes in the match, at least LZ_MIN_MATCH unless offset is 0
+ * @return the position after the sequence, or NULL if it wouldn't fit
+*/
+static byte *putSequence( byte *op, byte const *oend, byte const *lit, size_t litLen,
+                          size_t offset, size_t matchLen )
+{
+  size_t extra = offset ? matchLen - LZ_MIN_MATCH : 0;
+
+  if (op == oend) {
+    return NULL;
+  }
+  byte *token = op++;
+  *token = ( litLen < FIELD_MAX ? litLen : FIELD_MAX ) << LITERAL_SHIFT;
+  *token |= extra < FIELD_MAX ? extra : FIELD_MAX;
+
+  if (litLen >= FIELD_MAX && ( op = putLength(op, oend, litLen - FIELD_MAX) ) == NULL) {
+    return NULL;
+  }
+
+  if ((size_t) ( oend - op ) < litLen) {
+    return NULL;
+  }
+  memcpy(op, lit, litLen);
+  op += litLen;
+
+  if (offset == 0) {
+    return op;
+  }
+
+  if (oend - op < OFFSET_SIZE) {
+    return NULL;
+  }
+  *op++ = offset;
+  *op++ = offset >> BBITS;
+
+  if (extra >= FIELD_MAX) {
+    op = putLength(op, oend, extra - FIELD_MAX);
+  }
+  return op;
+}
+
+size_t lzCompress( byte const *in, size_t len, byte *out, size_t cap )
+{
+  uint32_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  byte *op = out;
+  byte const *oend = out + cap;
+  size_t anchor = 0;
+  size_t i = 0;
+
+  while (i + LZ_MIN_MATCH <= len) {
+    uint32_t h = hashAt(in + i);
+    size_t cand = table[h];
+    table[h] = i;
+
+    if (cand >= i || i - cand > LZ_MAX_OFFSET || read32(in + cand) != read32(in + i)) {
+      i += 1 + ( ( i - anchor ) >> SKIP_SHIFT );
+      continue;
+    }
+
+    size_t matchLen = matchLength(in + cand, in + i, len - i);
+
+    op = putSequence(op, oend, in + anchor, i - anchor, i - cand, matchLen);
+    if (op == NULL) {
+      return 0;
+    }
+
+    i += matchLen;
+    anchor = i;
+  }
+
+  op = putSequence(op, oend, in + anchor, len - anchor, 0, 0);
+  return op ? op - out : 0;
+}
+
+/**
+ * Reads the continuation of a length field.
+ *
+ * @param ip where to read from, moved past the continuation
+ * @param iend end of the input
+ * @param n the length so far, added on to
+ * @return false if the input ran out first
+*/
+static bool getLength( byte const **ip, byte const *iend, size_t *n )
+{
+  byte b;
+  do {
+    if (*ip == iend) {
+      return false;
+    }
+    b = *( *ip )++;
+    *n += b;
+  } while (b == MORE);
+
+  return true;
+}
+
+bool lzDecompress( byte const *in, size_t len, byte *out, size_t outLen )
+{
+  byte const *ip = in;
+  byte const *iend = in + len;
+  byte *op = out;
+  byte const *oend = out + outLen;
+
+  while (ip < iend) {
+    byte token = *ip++;
+
+    size_t litLen = token >> LITERAL_SHIFT;
+    if (litLen == FIELD_MAX && !getLength(&ip, iend, &litLen)) {
+      return false;
+    }
+    if ((size_t) ( iend - ip ) < litLen || (size_t) ( oend - op ) < litLen) {
+      return false;
+    }
+    memcpy(op, ip, litLen);
+    ip += litLen;
+    op += litLen;
+
+    // Only the last sequence ends right after its literals
+    if (ip == iend) {
+      break;
+    }
+
+    if (iend - ip < OFFSET_SIZE) {
+      return false;
+    }
+    size_t offset = ip[0] | ( ip[1] << BBITS );
+    ip += OFFSET_SIZE;
+
+    size_t matchLen = token & FIELD_MAX;
+    if (matchLen == FIELD_MAX && !getLength(&ip, iend, &matchLen)) {
+      return false;
+    }
+    matchLen += LZ_MIN_MATCH;
+
+    if (offset == 0 || offset > (size_t) ( op - out ) || (size_t) ( oend - op ) < matchLen) {
+      return false;
+    }
+
+    // A match can overlap the bytes it produces, which repeats them
+    byte const *match = op - offset;
+    if (offset >= matchLen) {
+      memcpy(op, match, matchLen);
+      op += matchLen;
+    }
+    else {
+      for (size_t k = 0; k < matchLen; k++) {
+        *op++ = match[k];
+      }
+    }
+  }
+
+  return op == oend;
+}
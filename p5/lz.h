@@ -0,0 +1,47 @@
+/**
+ * @file lz.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for a small LZ77 compressor. A block is coded as a
+ * run of sequences, each a count of literal bytes copied as they are, then
+ * a match that copies earlier output from up to LZ_MAX_OFFSET bytes back.
+ * Blocks are coded on their own, so separate blocks can be coded in parallel.
+ */
+
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "field.h"
+
+/** Shortest match worth coding, in bytes. */
+#define LZ_MIN_MATCH 4
+
+/** Farthest back a match can start, in bytes. */
+#define LZ_MAX_OFFSET 65535
+
+/**
+ * Compresses a block, giving up if the result won't fit.
+ *
+ * @param in the bytes to compress
+ * @param len number of bytes to compress
+ * @param out where to store the compressed block
+ * @param cap number of bytes there's room for in out
+ * @return number of bytes in the compressed block, or 0 if it wouldn't fit in cap
+*/
+size_t lzCompress( byte const *in, size_t len, byte *out, size_t cap );
+
+/**
+ * Decompresses a block, checking that every length and offset in it stays
+ * inside the block, so a damaged block can't read or write out of bounds.
+ *
+ * @param in the compressed block
+ * @param len number of bytes in the compressed block
+ * @param out where to store the decompressed bytes
+ * @param outLen number of bytes the block should decompress to
+ * @return true if the block was valid and decompressed to exactly outLen bytes
+*/
+bool lzDecompress( byte const *in, size_t len, byte *out, size_t outLen );
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * @file mapped.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Encrypts and decrypts through memory mappings. The input is mapped
+ * read-only and the output is mapped read-write after being resized,
+ * so the block loop reads plaintext straight from the page cache and
+ * writes ciphertext straight back to it, with no stdio buffers or
+ * heap copies in between. Authenticated modes are the exception when
+ * decrypting: their plaintext is held back in a temporary file next to
+ * the output until the tag has been checked.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped.h"
+#include "stream.h"
+#include "io.h"
+
+/**
+ * Prints an error about the given file and terminates the program.
+ * 
+ * @param message what went wrong
+ * @param filename the file it went wrong with
+*/
+static void mapError( char const *message, char const *filename )
+{
+  fprintf(stderr, "%s: %s\n", message, filename);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Hints to the kernel that a mapping will be read once, front to back,
+ * and would benefit from huge pages. The hints are only advice, so any
+ * the kernel doesn't support are ignored.
+ * 
+ * @param addr start of the mapping
+ * @param len length of the mapping
+*/
+static void adviseSequential( void *addr, size_t len )
+{
+  madvise(addr, len, MADV_SEQUENTIAL);
+  madvise(addr, len, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  madvise(addr, len, MADV_HUGEPAGE);
+#endif
+}
+
+/**
+ * Maps the whole input file read-only.
+ * 
+ * @param in the input file
+ * @param size size of the input file
+ * @return the mapping, or NULL for an empty file
+*/
+static byte *mapInput( FILE *in, size_t size )
+{
+  if (size == 0) {
+    return NULL;
+  }
+
+  void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "Can't map input file\n");
+    exit(EXIT_FAILURE);
+  }
+
+  adviseSequential(addr, size);
+  return addr;
+}
+
+/**
+ * Creates the output file with the given size and maps it read-write.
+ * The output is checked against the input before it's emptied, since the
+ * input's pages are only a private mapping of the same file.
+ * 
+ * @param in the input file
+ * @param outputFile name of the output file
+ * @param size size to give the output file
+ * @param fd filled in with the open file descriptor
+ * @return the mapping, or NULL if the size is zero
+*/
+static byte *mapOutput( FILE *in, char const *outputFile, size_t size, int *fd )
+{
+  *fd = open(outputFile, O_RDWR | O_CREAT, 0666);
+  if (*fd < 0) {
+    mapError("Can't open file", outputFile);
+  }
+
+  struct stat inInfo, outInfo;
+  if (fstat(fileno(in), &inInfo) == 0 && fstat(*fd, &outInfo) == 0
+      && inInfo.st_dev == outInfo.st_dev && inInfo.st_ino == outInfo.st_ino) {
+    mapError("Input and output are the same file", outputFile);
+  }
+
+  if (ftruncate(*fd, 0) != 0 || ftruncate(*fd, size) != 0) {
+    mapError("Can't write file", outputFile);
+  }
+
+  if (size == 0) {
+    return NULL;
+  }
+
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+  if (addr == MAP_FAILED) {
+    mapError("Can't map file", outputFile);
+  }
+
+  adviseSequential(addr, size);
+  return addr;
+}
+
+/**
+ * Returns the number of bytes to hand to the cipher at a time, so each
+ * thread gets about as much work as with the streaming functions.
+ * 
+ * @param cipher the cipher that will do the work
+ * @return the step size, a multiple of BLOCK_SIZE
+*/
+static size_t stepSize( Cipher const *cipher )
+{
+  return (size_t) CHUNK_SIZE * poolThreads(cipher->pool);
+}
+
+void encryptMapped( Cipher *cipher, FILE *in, char const *outputFile )
+{
+  uint64_t size = 0;
+  fileSize(in, &size);
+
+  // Only whole blocks are encrypted in place; padded modes pad the rest separately
+  size_t header = headerSize(cipher->mode);
+  size_t trailer = trailerSize(cipher->mode);
+  size_t whole = modePadded(cipher->mode) ? size - size % BLOCK_SIZE : size;
+  size_t body = whole == size ? size : whole + BLOCK_SIZE;
+  size_t outSize = header + body + trailer;
+
+  byte *src = mapInput(in, size);
+  int fd;
+  byte *dest = mapOutput(in, outputFile, outSize, &fd);
+
+  makeHeader(cipher, dest);
+
+  size_t step = stepSize(cipher);
+  for (size_t off = 0; off < whole; off += step) {
+    size_t len = whole - off < step ? whole - off : step;
+    checksumChunk(cipher, src + off, len);
+    encryptChunk(cipher, src + off, dest + header + off, len);
+  }
+
+  // Pad and encrypt the last partial block
+  if (whole != size) {
+    byte block[BLOCK_SIZE] = { 0 };
+    memcpy(block, src + whole, size - whole);
+    checksumChunk(cipher, block, size - whole);
+    encryptChunk(cipher, block, dest + header + whole, BLOCK_SIZE);
+  }
+
+  makeTrailer(cipher, dest + header + body);
+
+  if (src) {
+    munmap(src, size);
+  }
+  if (dest) {
+    munmap(dest, outSize);
+  }
+  close(fd);
+}
+
+DecryptResult decryptMapped( Cipher *cipher, FILE *in, char const *outputFile )
+{
+  uint64_t size = 0;
+  fileSize(in, &size);
+
+  size_t header = headerSize(cipher->mode);
+  size_t trailer = trailerSize(cipher->mode);
+  if (size < header + trailer || (modePadded(cipher->mode) && size % BLOCK_SIZE != 0)) {
+    return DECRYPT_BAD_LENGTH;
+  }
+
+  size_t len = size - header - trailer;
+  byte *src = mapInput(in, size);
+  readHeader(cipher, src);
+
+  size_t step = stepSize(cipher);
+  int fd;
+  byte *dest;
+
+  if (trailer > 0) {
+    // Each chunk is copied out of the mapping once, then authenticated and
+    // decrypted from that copy, since the file under a mapping can still
+    // change. The plaintext waits in a temporary file next to the output
+    // until the tag checks out, and only then is the output created.
+    FILE *spool = makeSpool(outputFile);
+    byte *chunk = malloc(step);
+
+    for (size_t off = 0; off < len; off += step) {
+      size_t n = len - off < step ? len - off : step;
+      memcpy(chunk, src + header + off, n);
+      openChunk(cipher, chunk, chunk, n);
+      writeChunk(spool, chunk, n);
+    }
+    free(chunk);
+
+    bool authentic = checkTrailer(cipher, src + header + len);
+    munmap(src, size);
+    src = NULL;
+    if (!authentic) {
+      fclose(spool);
+      return DECRYPT_BAD_TAG;
+    }
+
+    dest = mapOutput(in, outputFile, len, &fd);
+    rewind(spool);
+    if (readChunk(spool, dest, len) != len) {
+      mapError("Can't read file", "temporary file");
+    }
+    fclose(spool);
+  }
+  else {
+    dest = mapOutput(in, outputFile, len, &fd);
+    for (size_t off = 0; off < len; off += step) {
+      size_t n = len - off < step ? len - off : step;
+      decryptChunk(cipher, src + header + off, dest + off, n);
+    }
+  }
+
+  // Remove the padding at the end by shrinking the file
+  size_t end = len;
+  if (modePadded(cipher->mode)) {
+    while (end > 0 && dest[end - 1] == 0x00) {
+      end--;
+    }
+  }
+
+  if (src) {
+    munmap(src, size);
+  }
+  if (dest) {
+    munmap(dest, len);
+  }
+
+  if (end != len && ftruncate(fd, end) != 0) {
+    mapError("Can't write file", outputFile);
+  }
+  close(fd);
+
+  return DECRYPT_OK;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file mapped.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting and decrypting files through
+ * memory mappings, so the cipher reads and writes the file pages directly
+ */
+
+#ifndef _MAPPED_H_
+#define _MAPPED_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "cipher.h"
+
+/**
+ * Encrypts a regular file into the output file, working directly on mapped
+ * pages of both. The output is sized up front to hold the header, padding and trailer.
+ * Terminates the program if the output can't be created or mapped.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the plaintext file, which must be a regular file
+ * @param outputFile name of the file to write the ciphertext to
+*/
+void encryptMapped( Cipher *cipher, FILE *in, char const *outputFile );
+
+/**
+ * Decrypts a regular file into the output file, working directly on mapped
+ * pages of both. In ECB mode, the output is truncated afterward to remove
+ * the zero padding. In modes with a trailer, the output isn't created unless the
+ * whole input is authentic, and the plaintext is decrypted from one read of the
+ * input, held in a temporary file next to the output until then. Terminates the program if the output can't be created
+ * or mapped.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the ciphertext file, which must be a regular file
+ * @param outputFile name of the file to write the plaintext to
+ * @return DECRYPT_OK, or what's wrong with the input
+*/
+DecryptResult decryptMapped( Cipher *cipher, FILE *in, char const *outputFile );
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file mbBench.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Benchmark for the multi-buffer scheduler. Encrypts a large number of
+ * short records, each under its own key, first one record at a time and
+ * then through the scheduler, and reports records per second for a range
+ * of record sizes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "aes.h"
+#include "ctr.h"
+#include "multiBuffer.h"
+
+/** Default number of records encrypted for each size. */
+#define DEFAULT_RECORDS ( 256 * 1024 )
+
+/** Number of times each measurement is repeated. */
+#define REPEATS 3
+
+/** Record sizes to measure, in bytes. */
+static size_t const sizes[] = { 16, 32, 64, 128, 256, 1024 };
+
+/**
+ * Returns the current time in seconds.
+ *
+ * @return a monotonic time value
+*/
+static double now( void )
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Encrypts every record one at a time, expanding each key as it goes.
+ *
+ * @param jobs the records
+ * @param count number of records
+*/
+static void runOneAtATime( MbJob *jobs, size_t count )
+{
+  for (size_t i = 0; i < count; i++) {
+    AesContext ctx;
+    aesInit(&ctx, jobs[i].key);
+    ctrCrypt(&ctx, jobs[i].nonce, 0, jobs[i].data, jobs[i].data, jobs[i].len);
+  }
+}
+
+/**
+ * Encrypts every record through the multi-buffer scheduler.
+ *
+ * @param jobs the records
+ * @param count number of records
+*/
+static void runMultiBuffer( MbJob *jobs, size_t count )
+{
+  MultiBuffer mb;
+  initMultiBuffer(&mb);
+
+  for (size_t i = 0; i < count; i++) {
+    mbSubmit(&mb, &jobs[i]);
+  }
+  mbFlush(&mb);
+}
+
+/**
+ * Measures the best rate of a way of encrypting the records over several runs.
+ *
+ * @param fn the way of encrypting them
+ * @param jobs the records
+ * @param count number of records
+ * @return records per second
+*/
+static double measure( void (*fn)( MbJob *, size_t ), MbJob *jobs, size_t count )
+{
+  double best = 0;
+
+  for (int i = 0; i < REPEATS; i++) {
+    double start = now();
+    fn(jobs, count);
+    double elapsed = now() - start;
+
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  return count / best;
+}
+
+/**
+ * Entry point of program. An optional argument gives the
+ * number of records to encrypt for each size.
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main( int argc, char const *argv[] )
+{
+  size_t count = DEFAULT_RECORDS;
+  if (argc > 1) {
+    count = strtoull(argv[1], NULL, 10);
+  }
+
+  if (count == 0) {
+    fprintf(stderr, "usage: mbBench [records]\n");
+    return EXIT_FAILURE;
+  }
+
+  size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+  size_t largest = sizes[nsizes - 1];
+
+  // Every record gets its own key and nonce
+  byte *keys = malloc(count * BLOCK_SIZE);
+  byte *nonces = malloc(count * NONCE_SIZE);
+  byte *data = malloc(count * largest);
+  MbJob *jobs = malloc(count * sizeof(MbJob));
+
+  for (size_t i = 0; i < count * BLOCK_SIZE; i++) {
+    keys[i] = i * 13 + ( i >> 8 );
+    nonces[i] = i * 7 + 1;
+  }
+  for (size_t i = 0; i < count * largest; i++) {
+    data[i] = i * 31 + 3;
+  }
+
+  printf("AES backend: %s\n", aesBackendName(aesGetBackend()));
+  printf("%-8s %16s %16s %8s\n", "bytes", "single rec/s", "multi rec/s", "speedup");
+
+  for (size_t s = 0; s < nsizes; s++) {
+    for (size_t i = 0; i < count; i++) {
+      jobs[i] = (MbJob) { keys + i * BLOCK_SIZE, nonces + i * NONCE_SIZE,
+                          data + i * sizes[s], sizes[s] };
+    }
+
+    double single = measure(runOneAtATime, jobs, count);
+    double multi = measure(runMultiBuffer, jobs, count);
+    printf("%-8zu %16.0f %16.0f %7.2fx\n", sizes[s], single, multi, multi / single);
+  }
+
+  free(keys);
+  free(nonces);
+  free(data);
+  free(jobs);
+  return EXIT_SUCCESS;
+}
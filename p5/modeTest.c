@@ -0,0 +1,882 @@
+/**
+  @file modeTest.c
+  @author Canaan Matias (ctmatias)
+  Unit test program for the modes of operation, using the
+  published test vectors for each mode.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aes.h"
+#include "ctr.h"
+#include "ecb.h"
+#include "cbc.h"
+#include "gcm.h"
+#include "ocb.h"
+#include "xts.h"
+#include "drbg.h"
+#include "dmHash.h"
+#include "lz.h"
+#include "ghash.h"
+#include "pool.h"
+#include "multiBuffer.h"
+
+/** Number of tests we should have, if they're all turned on. */
+#define EXPECTED_TOTAL 47
+
+/** Total number or tests we tried. */
+static int totalTests = 0;
+
+/** Number of test cases passed. */
+static int passedTests = 0;
+
+/** Macro to check the condition on a test case, keep counts of
+    passed/failed tests and report a message if the test fails. */
+#define TestCase( conditional ) {\
+  totalTests += 1; \
+  if ( conditional ) { \
+    passedTests += 1; \
+  } else { \
+    printf( "**** Failed unit test on line %d of %s\n", __LINE__, __FILE__ );    \
+  } \
+}
+
+/** Key used by the NIST SP 800-38A examples. */
+static byte const nistKey[ BLOCK_SIZE ] = {
+  0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6,
+  0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+/** Plaintext used by the NIST SP 800-38A examples. */
+static byte const nistPlain[ BLOCK_SIZE * 4 ] = {
+  0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+  0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+  0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+  0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+  0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+  0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+  0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+  0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10 };
+
+/** Key used by GCM test case 3 of the GCM spec. */
+static byte const gcmKey[ BLOCK_SIZE ] = {
+  0xFE, 0xFF, 0xE9, 0x92, 0x86, 0x65, 0x73, 0x1C,
+  0x6D, 0x6A, 0x8F, 0x94, 0x67, 0x30, 0x83, 0x08 };
+
+/** IV used by GCM test case 3. */
+static byte const gcmIv[ GCM_IV_SIZE ] = {
+  0xCA, 0xFE, 0xBA, 0xBE, 0xFA, 0xCE, 0xDB, 0xAD,
+  0xDE, 0xCA, 0xF8, 0x88 };
+
+/** Plaintext of GCM test case 3. */
+static byte const gcmPlain[ BLOCK_SIZE * 4 ] = {
+  0xD9, 0x31, 0x32, 0x25, 0xF8, 0x84, 0x06, 0xE5,
+  0xA5, 0x59, 0x09, 0xC5, 0xAF, 0xF5, 0x26, 0x9A,
+  0x86, 0xA7, 0xA9, 0x53, 0x15, 0x34, 0xF7, 0xDA,
+  0x2E, 0x4C, 0x30, 0x3D, 0x8A, 0x31, 0x8A, 0x72,
+  0x1C, 0x3C, 0x0C, 0x95, 0x95, 0x68, 0x09, 0x53,
+  0x2F, 0xCF, 0x0E, 0x24, 0x49, 0xA6, 0xB5, 0x25,
+  0xB1, 0x6A, 0xED, 0xF5, 0xAA, 0x0D, 0xE6, 0x57,
+  0xBA, 0x63, 0x7B, 0x39, 0x1A, 0xAF, 0xD2, 0x55 };
+
+/** Ciphertext of GCM test case 3. */
+static byte const gcmCipher[ BLOCK_SIZE * 4 ] = {
+  0x42, 0x83, 0x1E, 0xC2, 0x21, 0x77, 0x74, 0x24,
+  0x4B, 0x72, 0x21, 0xB7, 0x84, 0xD0, 0xD4, 0x9C,
+  0xE3, 0xAA, 0x21, 0x2F, 0x2C, 0x02, 0xA4, 0xE0,
+  0x35, 0xC1, 0x7E, 0x23, 0x29, 0xAC, 0xA1, 0x2E,
+  0x21, 0xD5, 0x14, 0xB2, 0x54, 0x66, 0x93, 0x1C,
+  0x7D, 0x8F, 0x6A, 0x5A, 0xAC, 0x84, 0xAA, 0x05,
+  0x1B, 0xA3, 0x0B, 0x39, 0x6A, 0x0A, 0xAC, 0x97,
+  0x3D, 0x58, 0xE0, 0x91, 0x47, 0x3F, 0x59, 0x85 };
+
+int main()
+{
+  AesContext ctx;
+  aesInit( &ctx, nistKey );
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test ctrCrypt() with the F.5.1 example, whose counter carries
+  // out of the low 64 bits.
+
+  {
+    byte nonce[ NONCE_SIZE ] = {
+      0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7,
+      0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF };
+
+    byte expected[ BLOCK_SIZE * 4 ] = {
+      0x87, 0x4D, 0x61, 0x91, 0xB6, 0x20, 0xE3, 0x26,
+      0x1B, 0xEF, 0x68, 0x64, 0x99, 0x0D, 0xB6, 0xCE,
+      0x98, 0x06, 0xF6, 0x6B, 0x79, 0x70, 0xFD, 0xFF,
+      0x86, 0x17, 0x18, 0x7B, 0xB9, 0xFF, 0xFD, 0xFF,
+      0x5A, 0xE4, 0xDF, 0x3E, 0xDB, 0xD5, 0xD3, 0x5E,
+      0x5B, 0x4F, 0x09, 0x02, 0x0D, 0xB0, 0x3E, 0xAB,
+      0x1E, 0x03, 0x1D, 0xDA, 0x2F, 0xBE, 0x03, 0xD1,
+      0x79, 0x21, 0x70, 0xA0, 0xF3, 0x00, 0x9C, 0xEE };
+
+    byte data[ sizeof( nistPlain ) ];
+    ctrCrypt( &ctx, nonce, 0, nistPlain, data, sizeof( data ) );
+    TestCase( memcmp( data, expected, sizeof( data ) ) == 0 );
+
+    // Starting part way into the stream should give the same bytes.
+    ctrCrypt( &ctx, nonce, 21, nistPlain + 21, data + 21, 30 );
+    TestCase( memcmp( data + 21, expected + 21, 30 ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test ctrCryptParallel() against ctrCrypt() on a buffer with many
+  // slices and a partial block at the end.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 7;
+    byte *plain = malloc( len );
+    byte *serial = malloc( len );
+    byte *parallel = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      plain[ i ] = i * 31 + ( i >> 9 );
+
+    byte nonce[ NONCE_SIZE ] = { 0x01, 0x02, 0x03 };
+    ctrCrypt( &ctx, nonce, 5, plain, serial, len );
+
+    ThreadPool *pool = makePool( 4 );
+    ctrCryptParallel( pool, &ctx, nonce, 5, plain, parallel, len );
+    freePool( pool );
+
+    TestCase( memcmp( serial, parallel, len ) == 0 );
+
+    free( plain );
+    free( serial );
+    free( parallel );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM with test case 2 from the GCM spec: zero key, zero IV and
+  // one zero block.
+
+  {
+    byte key[ BLOCK_SIZE ] = { 0 };
+    byte iv[ GCM_IV_SIZE ] = { 0 };
+    byte expected[ BLOCK_SIZE ] = {
+      0x03, 0x88, 0xDA, 0xCE, 0x60, 0xB6, 0xA3, 0x92,
+      0xF3, 0x28, 0xC2, 0xB9, 0x71, 0xB2, 0xFE, 0x78 };
+    byte expectedTag[ GCM_TAG_SIZE ] = {
+      0xAB, 0x6E, 0x47, 0xD4, 0x2C, 0xEC, 0x13, 0xBD,
+      0xF5, 0x3A, 0x67, 0xB2, 0x12, 0x57, 0xBD, 0xDF };
+
+    AesContext zero;
+    aesInit( &zero, key );
+    ThreadPool *pool = makePool( 1 );
+
+    Gcm gcm;
+    gcmInit( &gcm, &zero, iv );
+    byte data[ BLOCK_SIZE ] = { 0 };
+    byte tag[ GCM_TAG_SIZE ];
+    gcmEncrypt( &gcm, pool, data, data, BLOCK_SIZE );
+    gcmTag( &gcm, tag );
+
+    TestCase( memcmp( data, expected, BLOCK_SIZE ) == 0 );
+    TestCase( memcmp( tag, expectedTag, GCM_TAG_SIZE ) == 0 );
+
+    freePool( pool );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM with test case 3, then with its last block cut short.
+
+  {
+    byte expectedTag[ GCM_TAG_SIZE ] = {
+      0x4D, 0x5C, 0x2A, 0xF3, 0x27, 0xCD, 0x64, 0xA6,
+      0x2C, 0xF3, 0x5A, 0xBD, 0x2B, 0xA6, 0xFA, 0xB4 };
+
+    // Tag for the first 60 bytes, from OpenSSL
+    byte shortTag[ GCM_TAG_SIZE ] = {
+      0xCC, 0x15, 0xAB, 0xCC, 0x19, 0x11, 0x61, 0x50,
+      0x1A, 0xAB, 0xAB, 0x46, 0xB8, 0xFB, 0xAC, 0x85 };
+
+    AesContext key;
+    aesInit( &key, gcmKey );
+    ThreadPool *pool = makePool( 1 );
+
+    Gcm gcm;
+    gcmInit( &gcm, &key, gcmIv );
+    byte data[ sizeof( gcmPlain ) ];
+    byte tag[ GCM_TAG_SIZE ];
+    gcmEncrypt( &gcm, pool, gcmPlain, data, sizeof( data ) );
+    gcmTag( &gcm, tag );
+
+    TestCase( memcmp( data, gcmCipher, sizeof( data ) ) == 0 );
+    TestCase( memcmp( tag, expectedTag, GCM_TAG_SIZE ) == 0 );
+
+    // Split in two, with a partial block at the end
+    gcmInit( &gcm, &key, gcmIv );
+    gcmEncrypt( &gcm, pool, gcmPlain, data, BLOCK_SIZE );
+    gcmEncrypt( &gcm, pool, gcmPlain + BLOCK_SIZE, data + BLOCK_SIZE, 44 );
+    gcmTag( &gcm, tag );
+
+    TestCase( memcmp( data, gcmCipher, 60 ) == 0 );
+    TestCase( memcmp( tag, shortTag, GCM_TAG_SIZE ) == 0 );
+
+    freePool( pool );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test GCM decryption of test case 3, and that changing one bit of
+  // the ciphertext makes the tag fail.
+
+  {
+    byte expectedTag[ GCM_TAG_SIZE ] = {
+      0x4D, 0x5C, 0x2A, 0xF3, 0x27, 0xCD, 0x64, 0xA6,
+      0x2C, 0xF3, 0x5A, 0xBD, 0x2B, 0xA6, 0xFA, 0xB4 };
+
+    AesContext key;
+    aesInit( &key, gcmKey );
+    ThreadPool *pool = makePool( 1 );
+
+    Gcm gcm;
+    gcmInit( &gcm, &key, gcmIv );
+    gcmAuthenticate( &gcm, pool, gcmCipher, sizeof( gcmCipher ) );
+    TestCase( gcmCheckTag( &gcm, expectedTag ) );
+
+    byte data[ sizeof( gcmCipher ) ];
+    gcmDecrypt( &gcm, pool, 0, gcmCipher, data, sizeof( data ) );
+    TestCase( memcmp( data, gcmPlain, sizeof( data ) ) == 0 );
+
+    memcpy( data, gcmCipher, sizeof( data ) );
+    data[ 37 ] ^= 0x10;
+    gcmInit( &gcm, &key, gcmIv );
+    gcmAuthenticate( &gcm, pool, data, sizeof( data ) );
+    TestCase( !gcmCheckTag( &gcm, expectedTag ) );
+
+    freePool( pool );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test both fast versions of GHASH against the reference multiply,
+  // on a length that isn't a multiple of the carry-less multiply's lanes.
+
+  {
+    byte h[ GHASH_SIZE ];
+    byte data[ GHASH_SIZE * 11 + 5 ];
+    for ( int i = 0; i < GHASH_SIZE; i++ )
+      h[ i ] = i * 73 + 19;
+    for ( int i = 0; i < sizeof( data ); i++ )
+      data[ i ] = i * 29 + ( i >> 3 );
+
+    GhashKey key;
+    ghashInit( &key, h );
+
+    // Reference: add each block and multiply by H
+    byte reference[ GHASH_SIZE ] = { 0 };
+    for ( int i = 0; i < sizeof( data ); i += GHASH_SIZE ) {
+      for ( int j = 0; j < GHASH_SIZE && i + j < sizeof( data ); j++ )
+        reference[ j ] ^= data[ i + j ];
+      ghashMul( reference, h );
+    }
+
+    byte table[ GHASH_SIZE ] = { 0 };
+    ghashTableUpdate( &key, table, data, sizeof( data ) );
+    TestCase( memcmp( table, reference, GHASH_SIZE ) == 0 );
+
+    byte clmul[ GHASH_SIZE ] = { 0 };
+    if ( clmulSupported() )
+      ghashClmulUpdate( &key, clmul, data, sizeof( data ) );
+    else
+      memcpy( clmul, reference, GHASH_SIZE );
+    TestCase( memcmp( clmul, reference, GHASH_SIZE ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that GCM on a pool, fed in pieces, matches a single thread fed
+  // everything at once.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 7;
+    size_t first = 1024 * 1024 + 48;
+    byte *plain = malloc( len );
+    byte *serial = malloc( len );
+    byte *parallel = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      plain[ i ] = i * 31 + ( i >> 9 );
+
+    byte serialTag[ GCM_TAG_SIZE ];
+    byte parallelTag[ GCM_TAG_SIZE ];
+    Gcm gcm;
+
+    ThreadPool *pool = makePool( 1 );
+    gcmInit( &gcm, &ctx, gcmIv );
+    gcmEncrypt( &gcm, pool, plain, serial, len );
+    gcmTag( &gcm, serialTag );
+    freePool( pool );
+
+    pool = makePool( 4 );
+    gcmInit( &gcm, &ctx, gcmIv );
+    gcmEncrypt( &gcm, pool, plain, parallel, first );
+    gcmEncrypt( &gcm, pool, plain + first, parallel + first, len - first );
+    gcmTag( &gcm, parallelTag );
+    freePool( pool );
+
+    TestCase( memcmp( serial, parallel, len ) == 0 );
+    TestCase( memcmp( serialTag, parallelTag, GCM_TAG_SIZE ) == 0 );
+
+    free( plain );
+    free( serial );
+    free( parallel );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test cbcEncrypt() and cbcDecrypt() with the F.2.1 example, and with
+  // the stream split between calls.
+
+  {
+    byte iv[ CBC_IV_SIZE ] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+
+    byte expected[ BLOCK_SIZE * 4 ] = {
+      0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46,
+      0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+      0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE,
+      0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+      0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B,
+      0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+      0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09,
+      0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7 };
+
+    byte data[ sizeof( nistPlain ) ];
+    byte chain[ BLOCK_SIZE ];
+    memcpy( chain, iv, BLOCK_SIZE );
+    cbcEncrypt( &ctx, chain, nistPlain, data, BLOCK_SIZE );
+    cbcEncrypt( &ctx, chain, nistPlain + BLOCK_SIZE, data + BLOCK_SIZE, BLOCK_SIZE * 3 );
+    TestCase( memcmp( data, expected, sizeof( data ) ) == 0 );
+    TestCase( memcmp( chain, expected + BLOCK_SIZE * 3, BLOCK_SIZE ) == 0 );
+
+    // Decrypting in place, from part way into the stream
+    cbcDecrypt( &ctx, iv, data, data, BLOCK_SIZE * 2 );
+    cbcDecrypt( &ctx, expected + BLOCK_SIZE, data + BLOCK_SIZE * 2, data + BLOCK_SIZE * 2,
+                BLOCK_SIZE * 2 );
+    TestCase( memcmp( data, nistPlain, sizeof( data ) ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test cbcDecryptParallel() in place, in two pieces, against the plaintext,
+  // and the ECB functions on a pool against a single call into the backend.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 48;
+    size_t first = 1024 * 1024 + 16;
+    byte *plain = malloc( len );
+    byte *data = malloc( len );
+    byte *serial = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      plain[ i ] = i * 31 + ( i >> 9 );
+
+    byte iv[ CBC_IV_SIZE ] = { 0x0A, 0x0B, 0x0C };
+    byte chain[ BLOCK_SIZE ];
+    memcpy( chain, iv, BLOCK_SIZE );
+    cbcEncrypt( &ctx, chain, plain, data, len );
+
+    ThreadPool *pool = makePool( 4 );
+    byte last[ BLOCK_SIZE ];
+    memcpy( last, chain, BLOCK_SIZE );
+    memcpy( chain, iv, BLOCK_SIZE );
+    cbcDecryptParallel( pool, &ctx, chain, data, data, first );
+    cbcDecryptParallel( pool, &ctx, chain, data + first, data + first, len - first );
+    TestCase( memcmp( data, plain, len ) == 0 );
+    TestCase( memcmp( chain, last, BLOCK_SIZE ) == 0 );
+
+    aesEncryptBlocks( &ctx, plain, serial, len / BLOCK_SIZE );
+    ecbEncryptParallel( pool, &ctx, plain, data, len );
+    bool encrypted = memcmp( data, serial, len ) == 0;
+    ecbDecryptParallel( pool, &ctx, data, data, len );
+    TestCase( encrypted && memcmp( data, plain, len ) == 0 );
+    freePool( pool );
+
+    free( plain );
+    free( data );
+    free( serial );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the multi-buffer scheduler against ctrCrypt() on messages of many
+  // lengths, each under its own key, with a partly filled group at the end.
+
+  {
+    int njobs = 21;
+    size_t total = 0;
+    byte keys[ 21 ][ BLOCK_SIZE ];
+    byte nonces[ 21 ][ NONCE_SIZE ];
+    MbJob jobs[ 21 ];
+    for ( int j = 0; j < njobs; j++ )
+      total += j * 13 + ( j % 3 ) * 40;
+
+    byte *plain = malloc( total );
+    byte *data = malloc( total );
+    byte *expected = malloc( total );
+    for ( size_t i = 0; i < total; i++ )
+      plain[ i ] = i * 31 + ( i >> 5 );
+    memcpy( data, plain, total );
+
+    size_t offset = 0;
+    for ( int j = 0; j < njobs; j++ ) {
+      for ( int i = 0; i < BLOCK_SIZE; i++ ) {
+        keys[ j ][ i ] = j * 17 + i * 5;
+        nonces[ j ][ i ] = j + i * 3;
+      }
+      nonces[ j ][ BLOCK_SIZE - 1 ] = 0xFE;
+
+      jobs[ j ] = ( MbJob ) { keys[ j ], nonces[ j ], data + offset, j * 13 + ( j % 3 ) * 40 };
+
+      AesContext key;
+      aesInit( &key, keys[ j ] );
+      ctrCrypt( &key, nonces[ j ], 0, plain + offset, expected + offset, jobs[ j ].len );
+      offset += jobs[ j ].len;
+    }
+
+    // Once with the interleaved lanes, if they're here, and once one job at a time
+    AesBackend backend = aesGetBackend();
+    bool grouped = true;
+    bool matched = true;
+    for ( int pass = 0; pass < 2; pass++ ) {
+      if ( pass == 1 )
+        aesSetBackend( BACKEND_TABLE );
+
+      memcpy( data, plain, total );
+      MultiBuffer mb;
+      initMultiBuffer( &mb );
+      for ( int j = 0; j < njobs; j++ )
+        grouped = grouped && mbSubmit( &mb, &jobs[ j ] ) == ( j % MB_LANES == MB_LANES - 1 );
+      mbFlush( &mb );
+      matched = matched && memcmp( data, expected, total ) == 0;
+    }
+    aesSetBackend( backend );
+
+    TestCase( grouped );
+    TestCase( matched );
+
+    free( plain );
+    free( data );
+    free( expected );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test ocbEncrypt() with the RFC 7253 examples that have no associated
+  // data, then authenticate and decrypt the longest one, and tamper with it.
+
+  {
+    byte key[ BLOCK_SIZE ];
+    byte plain[ BLOCK_SIZE * 2 ];
+    for ( int i = 0; i < (int) sizeof( plain ); i++ )
+      plain[ i ] = i;
+    memcpy( key, plain, BLOCK_SIZE );
+
+    AesContext ocbKey;
+    aesInit( &ocbKey, key );
+
+    byte nonce[ OCB_NONCE_SIZE ] = {
+      0xBB, 0xAA, 0x99, 0x88, 0x77, 0x66, 0x55, 0x44,
+      0x33, 0x22, 0x11, 0x00 };
+
+    // Plaintext lengths of the examples, and the last nonce byte of each
+    size_t lens[] = { 0, 8, 16, 24 };
+    byte last[] = { 0x00, 0x03, 0x06, 0x09 };
+
+    // Ciphertext followed by the tag, for each example
+    byte const expected[ 4 ][ 40 ] = {
+      { 0x78, 0x54, 0x07, 0xBF, 0xFF, 0xC8, 0xAD, 0x9E,
+        0xDC, 0xC5, 0x52, 0x0A, 0xC9, 0x11, 0x1E, 0xE6 },
+      { 0x45, 0xDD, 0x69, 0xF8, 0xF5, 0xAA, 0xE7, 0x24,
+        0x14, 0x05, 0x4C, 0xD1, 0xF3, 0x5D, 0x82, 0x76,
+        0x0B, 0x2C, 0xD0, 0x0D, 0x2F, 0x99, 0xBF, 0xA9 },
+      { 0x5C, 0xE8, 0x8E, 0xC2, 0xE0, 0x69, 0x27, 0x06,
+        0xA9, 0x15, 0xC0, 0x0A, 0xEB, 0x8B, 0x23, 0x96,
+        0xF4, 0x0E, 0x1C, 0x74, 0x3F, 0x52, 0x43, 0x6B,
+        0xDF, 0x06, 0xD8, 0xFA, 0x1E, 0xCA, 0x34, 0x3D },
+      { 0x22, 0x1B, 0xD0, 0xDE, 0x7F, 0xA6, 0xFE, 0x99,
+        0x3E, 0xCC, 0xD7, 0x69, 0x46, 0x0A, 0x0A, 0xF2,
+        0xD6, 0xCD, 0xED, 0x0C, 0x39, 0x5B, 0x1C, 0x3C,
+        0xE7, 0x25, 0xF3, 0x24, 0x94, 0xB9, 0xF9, 0x14,
+        0xD8, 0x5C, 0x0B, 0x1E, 0xB3, 0x83, 0x57, 0xFF } };
+
+    ThreadPool *pool = makePool( 1 );
+    Ocb ocb;
+    byte data[ 40 ];
+
+    for ( int t = 0; t < 4; t++ ) {
+      nonce[ OCB_NONCE_SIZE - 1 ] = last[ t ];
+      ocbInit( &ocb, &ocbKey, nonce );
+      ocbEncrypt( &ocb, pool, plain, data, lens[ t ] );
+      ocbTag( &ocb, data + lens[ t ] );
+      TestCase( memcmp( data, expected[ t ], lens[ t ] + OCB_TAG_SIZE ) == 0 );
+    }
+
+    // The last example is one full block and one partial block
+    ocbInit( &ocb, &ocbKey, nonce );
+    ocbAuthenticate( &ocb, pool, expected[ 3 ], NULL, 24 );
+    TestCase( ocbCheckTag( &ocb, expected[ 3 ] + 24 ) );
+
+    ocbDecrypt( &ocb, pool, 0, expected[ 3 ], data, 24 );
+    TestCase( memcmp( data, plain, 24 ) == 0 );
+
+    // Authenticating can keep the plaintext too, decrypting in place
+    memcpy( data, expected[ 3 ], 24 );
+    ocbInit( &ocb, &ocbKey, nonce );
+    ocbAuthenticate( &ocb, pool, data, data, 24 );
+    TestCase( ocbCheckTag( &ocb, expected[ 3 ] + 24 ) && memcmp( data, plain, 24 ) == 0 );
+
+    memcpy( data, expected[ 3 ], 24 );
+    data[ 20 ] ^= 0x01;
+    ocbInit( &ocb, &ocbKey, nonce );
+    ocbAuthenticate( &ocb, pool, data, NULL, 24 );
+    TestCase( !ocbCheckTag( &ocb, expected[ 3 ] + 24 ) );
+    freePool( pool );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that OCB on a pool, fed in pieces, matches a single thread fed
+  // everything at once, and that decrypting from part way in gets back
+  // the plaintext.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 7;
+    size_t first = 1024 * 1024 + 48;
+    byte *plain = malloc( len );
+    byte *serial = malloc( len );
+    byte *parallel = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      plain[ i ] = i * 31 + ( i >> 9 );
+
+    byte nonce[ OCB_NONCE_SIZE ] = { 0x01, 0x02, 0x03, 0x3F };
+    byte serialTag[ OCB_TAG_SIZE ];
+    byte parallelTag[ OCB_TAG_SIZE ];
+    Ocb ocb;
+
+    ThreadPool *pool = makePool( 1 );
+    ocbInit( &ocb, &ctx, nonce );
+    ocbEncrypt( &ocb, pool, plain, serial, len );
+    ocbTag( &ocb, serialTag );
+    freePool( pool );
+
+    pool = makePool( 4 );
+    ocbInit( &ocb, &ctx, nonce );
+    ocbEncrypt( &ocb, pool, plain, parallel, first );
+    ocbEncrypt( &ocb, pool, plain + first, parallel + first, len - first );
+    ocbTag( &ocb, parallelTag );
+
+    TestCase( memcmp( serial, parallel, len ) == 0 &&
+              memcmp( serialTag, parallelTag, OCB_TAG_SIZE ) == 0 );
+
+    ocbInit( &ocb, &ctx, nonce );
+    ocbAuthenticate( &ocb, pool, parallel, NULL, first );
+    ocbAuthenticate( &ocb, pool, parallel + first, NULL, len - first );
+    bool authentic = ocbCheckTag( &ocb, serialTag );
+    ocbDecrypt( &ocb, pool, first, parallel + first, parallel + first, len - first );
+    ocbDecrypt( &ocb, pool, 0, parallel, parallel, first );
+    TestCase( authentic && memcmp( parallel, plain, len ) == 0 );
+    freePool( pool );
+
+    free( plain );
+    free( serial );
+    free( parallel );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test xtsEncrypt() with IEEE 1619 vectors 1 and 2, and with vectors 15
+  // and 16, whose data units end in a partial block, then decrypt them.
+
+  {
+    byte zeroKey[ BLOCK_SIZE ] = { 0 };
+    byte key1[ BLOCK_SIZE ], key2[ BLOCK_SIZE ];
+    byte stealKey1[ BLOCK_SIZE ], stealKey2[ BLOCK_SIZE ];
+    for ( int i = 0; i < BLOCK_SIZE; i++ ) {
+      key1[ i ] = 0x11;
+      key2[ i ] = 0x22;
+      stealKey1[ i ] = 0xFF - i;
+      stealKey2[ i ] = 0xBF - i;
+    }
+
+    byte const expected1[ BLOCK_SIZE * 2 ] = {
+      0x91, 0x7C, 0xF6, 0x9E, 0xBD, 0x68, 0xB2, 0xEC,
+      0x9B, 0x9F, 0xE9, 0xA3, 0xEA, 0xDD, 0xA6, 0x92,
+      0xCD, 0x43, 0xD2, 0xF5, 0x95, 0x98, 0xED, 0x85,
+      0x8C, 0x02, 0xC2, 0x65, 0x2F, 0xBF, 0x92, 0x2E };
+
+    byte const expected2[ BLOCK_SIZE * 2 ] = {
+      0xC4, 0x54, 0x18, 0x5E, 0x6A, 0x16, 0x93, 0x6E,
+      0x39, 0x33, 0x40, 0x38, 0xAC, 0xEF, 0x83, 0x8B,
+      0xFB, 0x18, 0x6F, 0xFF, 0x74, 0x80, 0xAD, 0xC4,
+      0x28, 0x93, 0x82, 0xEC, 0xD6, 0xD3, 0x94, 0xF0 };
+
+    byte const expected15[ 17 ] = {
+      0x6C, 0x16, 0x25, 0xDB, 0x46, 0x71, 0x52, 0x2D,
+      0x3D, 0x75, 0x99, 0x60, 0x1D, 0xE7, 0xCA, 0x09,
+      0xED };
+
+    byte const expected16[ 18 ] = {
+      0xD0, 0x69, 0x44, 0x4B, 0x7A, 0x7E, 0x0C, 0xAB,
+      0x09, 0xE2, 0x44, 0x47, 0xD2, 0x4D, 0xEB, 0x1F,
+      0xED, 0xBF };
+
+    ThreadPool *pool = makePool( 1 );
+    AesContext data;
+    Xts xts;
+    byte plain[ BLOCK_SIZE * 2 ];
+    byte out[ BLOCK_SIZE * 2 ];
+
+    // Vector 1 is sector 0, with all-zero keys and plaintext
+    memset( plain, 0, sizeof( plain ) );
+    aesInit( &data, zeroKey );
+    xtsInit( &xts, &data, zeroKey, sizeof( plain ) );
+    xtsEncrypt( &xts, pool, 0, plain, out, sizeof( plain ) );
+    TestCase( memcmp( out, expected1, sizeof( out ) ) == 0 );
+
+    // Vector 2 is sector 0x3333333333
+    memset( plain, 0x44, sizeof( plain ) );
+    aesInit( &data, key1 );
+    xtsInit( &xts, &data, key2, sizeof( plain ) );
+    xtsEncrypt( &xts, pool, 0x3333333333ULL * sizeof( plain ), plain, out, sizeof( plain ) );
+    TestCase( memcmp( out, expected2, sizeof( out ) ) == 0 );
+
+    // Vectors 15 and 16 are sector 0x123456789A, with 17 and 18 bytes
+    for ( int i = 0; i < (int) sizeof( plain ); i++ )
+      plain[ i ] = i;
+    uint64_t offset = 0x123456789AULL * XTS_SECTOR_SIZE;
+    aesInit( &data, stealKey1 );
+    xtsInit( &xts, &data, stealKey2, XTS_SECTOR_SIZE );
+    xtsEncrypt( &xts, pool, offset, plain, out, sizeof( expected15 ) );
+    TestCase( memcmp( out, expected15, sizeof( expected15 ) ) == 0 );
+
+    xtsDecrypt( &xts, pool, offset, out, out, sizeof( expected15 ) );
+    TestCase( memcmp( out, plain, sizeof( expected15 ) ) == 0 );
+
+    xtsEncrypt( &xts, pool, offset, plain, out, sizeof( expected16 ) );
+    bool encrypted = memcmp( out, expected16, sizeof( expected16 ) ) == 0;
+    xtsDecrypt( &xts, pool, offset, out, out, sizeof( expected16 ) );
+    TestCase( encrypted && memcmp( out, plain, sizeof( expected16 ) ) == 0 );
+    freePool( pool );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that XTS on a pool matches one sector at a time on a single
+  // thread, with 4096-byte sectors and a short last sector.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 4096 * 5 + 100;
+    byte *plain = malloc( len );
+    byte *serial = malloc( len );
+    byte *parallel = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      plain[ i ] = i * 31 + ( i >> 9 );
+
+    byte tweakKey[ BLOCK_SIZE ] = { 0x0F, 0x1E, 0x2D, 0x3C };
+    Xts xts;
+    xtsInit( &xts, &ctx, tweakKey, XTS_LARGE_SECTOR );
+
+    ThreadPool *pool = makePool( 1 );
+    for ( size_t off = 0; off < len; off += XTS_LARGE_SECTOR ) {
+      size_t n = len - off < XTS_LARGE_SECTOR ? len - off : XTS_LARGE_SECTOR;
+      xtsEncrypt( &xts, pool, off, plain + off, serial + off, n );
+    }
+    freePool( pool );
+
+    pool = makePool( 4 );
+    xtsEncrypt( &xts, pool, 0, plain, parallel, len );
+    bool matched = memcmp( serial, parallel, len ) == 0;
+    xtsDecrypt( &xts, pool, 0, parallel, parallel, len );
+    TestCase( matched && memcmp( parallel, plain, len ) == 0 );
+    freePool( pool );
+
+    free( plain );
+    free( serial );
+    free( parallel );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test drbgGenerate() with the first AES-128 CTR_DRBG vector from the
+  // NIST CAVP set without a derivation function or prediction resistance,
+  // which throws away one 64-byte request and checks the next.
+
+  {
+    byte seed[ DRBG_SEED_SIZE ] = {
+      0xCE, 0x50, 0xF3, 0x3D, 0xA5, 0xD4, 0xC1, 0xD3,
+      0xD4, 0x00, 0x4E, 0xB3, 0x52, 0x44, 0xB7, 0xF2,
+      0xCD, 0x7F, 0x2E, 0x50, 0x76, 0xFB, 0xF6, 0x78,
+      0x0A, 0x7F, 0xF6, 0x34, 0xB2, 0x49, 0xA5, 0xFC };
+    byte expected[ BLOCK_SIZE * 4 ] = {
+      0x65, 0x45, 0xC0, 0x52, 0x9D, 0x37, 0x24, 0x43,
+      0xB3, 0x92, 0xCE, 0xB3, 0xAE, 0x3A, 0x99, 0xA3,
+      0x0F, 0x96, 0x3E, 0xAF, 0x31, 0x32, 0x80, 0xF1,
+      0xD1, 0xA1, 0xE8, 0x7F, 0x9D, 0xB3, 0x73, 0xD3,
+      0x61, 0xE7, 0x5D, 0x18, 0x01, 0x82, 0x66, 0x49,
+      0x9C, 0xCC, 0xD6, 0x4D, 0x9B, 0xBB, 0x8D, 0xE0,
+      0x18, 0x5F, 0x21, 0x33, 0x83, 0x08, 0x0F, 0xAD,
+      0xDE, 0xC4, 0x6B, 0xAE, 0x1F, 0x78, 0x4E, 0x5A };
+    byte out[ sizeof( expected ) ];
+
+    Drbg drbg;
+    drbgInit( &drbg, seed );
+    drbgGenerate( &drbg, out, sizeof( out ) );
+    drbgGenerate( &drbg, out, sizeof( out ) );
+    TestCase( memcmp( out, expected, sizeof( expected ) ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that a call longer than DRBG_MAX_REQUEST, ending in a partial
+  // block, gives the same bytes as the requests it's split into.
+
+  {
+    byte seed[ DRBG_SEED_SIZE ] = { 0x01, 0x23, 0x45, 0x67 };
+    size_t len = DRBG_MAX_REQUEST + 40;
+    byte *whole = malloc( len );
+    byte *split = malloc( len );
+
+    Drbg drbg;
+    drbgInit( &drbg, seed );
+    drbgGenerate( &drbg, whole, len );
+
+    drbgInit( &drbg, seed );
+    drbgGenerate( &drbg, split, DRBG_MAX_REQUEST );
+    drbgGenerate( &drbg, split + DRBG_MAX_REQUEST, 40 );
+    TestCase( memcmp( whole, split, len ) == 0 && drbg.sinceReseed == len );
+
+    free( whole );
+    free( split );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the Davies-Meyer checksum of "abc" and of a patterned message
+  // that ends in a partial leaf, once with the interleaved AES-NI lanes,
+  // if they're here, and once through generateSubkeys() and the tables.
+
+  {
+    byte abcSum[ DM_HASH_SIZE ] = {
+      0x8F, 0x39, 0xB7, 0x9A, 0x0C, 0x54, 0x6E, 0x3E,
+      0x83, 0xE0, 0xC3, 0xBF, 0x3D, 0xC3, 0x5E, 0x56 };
+    byte patternSum[ DM_HASH_SIZE ] = {
+      0xCF, 0x37, 0xC7, 0x34, 0xA2, 0xBE, 0x04, 0xAB,
+      0x81, 0xB7, 0xDC, 0x26, 0xDA, 0xF6, 0x3B, 0x5F };
+    size_t len = 40000;
+    byte *pattern = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      pattern[ i ] = i * 31 + ( i >> 9 );
+
+    ThreadPool *pool = makePool( 4 );
+    AesBackend backend = aesGetBackend();
+    bool matched = true;
+    for ( int pass = 0; pass < 2; pass++ ) {
+      if ( pass == 1 )
+        aesSetBackend( BACKEND_TABLE );
+
+      DmHash hash;
+      byte digest[ DM_HASH_SIZE ];
+      dmHashInit( &hash );
+      dmHashUpdate( &hash, pool, ( byte const * ) "abc", 3 );
+      dmHashFinish( &hash, digest );
+      matched = matched && memcmp( digest, abcSum, DM_HASH_SIZE ) == 0;
+
+      dmHashInit( &hash );
+      dmHashUpdate( &hash, pool, pattern, len );
+      dmHashFinish( &hash, digest );
+      matched = matched && memcmp( digest, patternSum, DM_HASH_SIZE ) == 0;
+    }
+    aesSetBackend( backend );
+    TestCase( matched );
+
+    freePool( pool );
+    free( pattern );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test that the checksum doesn't depend on how the input is split up,
+  // or on the number of threads.
+
+  {
+    size_t len = 3 * 1024 * 1024 + 777;
+    byte *data = malloc( len );
+    for ( size_t i = 0; i < len; i++ )
+      data[ i ] = i * 7 + ( i >> 13 );
+
+    ThreadPool *pool = makePool( 4 );
+    DmHash hash;
+    byte whole[ DM_HASH_SIZE ];
+    dmHashInit( &hash );
+    dmHashUpdate( &hash, pool, data, len );
+    dmHashFinish( &hash, whole );
+    freePool( pool );
+
+    // Pieces that start and end in the middle of leaves
+    pool = makePool( 1 );
+    byte pieces[ DM_HASH_SIZE ];
+    size_t step = DM_LEAF_SIZE * 5 + 1001;
+    dmHashInit( &hash );
+    for ( size_t off = 0; off < len; off += step )
+      dmHashUpdate( &hash, pool, data + off, len - off < step ? len - off : step );
+    dmHashFinish( &hash, pieces );
+    freePool( pool );
+
+    TestCase( memcmp( whole, pieces, DM_HASH_SIZE ) == 0 );
+    free( data );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test the LZ coding of a short repeat: three literals, then a match of
+  // nine bytes that overlaps the bytes it copies, then an empty last sequence.
+
+  {
+    byte const *repeat = ( byte const * ) "abcabcabcabc";
+    byte expected[] = { 0x35, 'a', 'b', 'c', 0x03, 0x00, 0x00 };
+    byte out[ 32 ];
+    byte back[ 12 ];
+
+    size_t len = lzCompress( repeat, 12, out, sizeof( out ) );
+    TestCase( len == sizeof( expected ) && memcmp( out, expected, len ) == 0 &&
+              lzDecompress( out, len, back, 12 ) && memcmp( back, repeat, 12 ) == 0 );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test a round trip through the LZ coder of data with long literal runs,
+  // long matches and matches near the edge of the window, which needs
+  // length fields continued over several bytes.
+
+  {
+    size_t len = 300000;
+    byte *data = malloc( len );
+    byte *packed = malloc( len );
+    byte *back = malloc( len );
+    Drbg drbg;
+    byte seed[ DRBG_SEED_SIZE ] = { 0x4C, 0x5A };
+    drbgInit( &drbg, seed );
+    drbgGenerate( &drbg, data, len );
+    for ( size_t i = 1000; i < len; i += 5000 )
+      memset( data + i, 'x', 1200 );
+    memcpy( data + 200000, data + 200000 - LZ_MAX_OFFSET, 3000 );
+
+    size_t packedLen = lzCompress( data, len, packed, len );
+    TestCase( packedLen > 0 && packedLen < len &&
+              lzDecompress( packed, packedLen, back, len ) &&
+              memcmp( back, data, len ) == 0 );
+
+    // Random bytes don't shrink, and damaged blocks are caught
+    bool rejected = lzCompress( data, 900, packed, 899 ) == 0;
+    rejected = rejected && !lzDecompress( packed, packedLen - 1, back, len );
+    rejected = rejected && !lzDecompress( packed, packedLen, back, len - 1 );
+    byte badOffset[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+    rejected = rejected && !lzDecompress( badOffset, sizeof( badOffset ), back, 10 );
+    TestCase( rejected );
+
+    free( data );
+    free( packed );
+    free( back );
+  }
+
+  // Report a message if some tests are still disabled.
+  if ( totalTests < EXPECTED_TOTAL )
+    printf( "** %d of %d tests currently enabled.\n", totalTests,
+            EXPECTED_TOTAL );
+    
+  // Exit successfully if all tests are enabled and they all pass.
+  if ( passedTests != EXPECTED_TOTAL )
+    return EXIT_FAILURE;
+  else
+    return EXIT_SUCCESS;
+}
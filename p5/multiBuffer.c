@@ -0,0 +1,118 @@
+/**
+ * @file multiBuffer.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Multi-buffer CTR mode. With AES-NI, a group's keys are expanded together,
+ * then the counter blocks of all of its messages are laid end to end and
+ * encrypted in batches, each block with its own message's subkeys. A short
+ * message no longer leaves the pipeline idle, since the blocks of the other
+ * messages fill it. With any other backend, the jobs run one at a time.
+ */
+
+#include <string.h>
+
+#include "multiBuffer.h"
+#include "aesNi.h"
+
+/** Number of counter blocks encrypted per call into the AES-NI backend. */
+#define MB_BATCH 32
+
+void initMultiBuffer( MultiBuffer *mb )
+{
+  mb->count = 0;
+}
+
+/**
+ * Encrypts the keystream of each job in turn, under its own fully expanded key.
+ *
+ * @param jobs the jobs to run
+ * @param count number of jobs
+*/
+static void runSerial( MbJob *const jobs[], int count )
+{
+  for (int j = 0; j < count; j++) {
+    AesContext ctx;
+    aesInit(&ctx, jobs[j]->key);
+    ctrCrypt(&ctx, jobs[j]->nonce, 0, jobs[j]->data, jobs[j]->data, jobs[j]->len);
+  }
+}
+
+/**
+ * Runs a group of jobs with their key schedules and blocks interleaved.
+ *
+ * @param jobs the jobs to run
+ * @param count number of jobs, at most MB_LANES
+*/
+static void runLanes( MbJob *const jobs[], int count )
+{
+  byte const *keys[MB_LANES] = { NULL };
+  for (int j = 0; j < count; j++) {
+    keys[j] = jobs[j]->key;
+  }
+
+  byte subkeys[MB_LANES][ROUNDS + 1][BLOCK_SIZE];
+  niExpandKeys(subkeys, keys, count);
+
+  byte stream[MB_BATCH * BLOCK_SIZE];
+  byte lane[MB_BATCH];
+  size_t index[MB_BATCH];
+
+  // Where the next counter block comes from
+  int job = 0;
+  size_t block = 0;
+
+  while (job < count) {
+    size_t nblocks = 0;
+
+    // Fill the batch with the next counter blocks, moving from one job to the next
+    while (nblocks < MB_BATCH && job < count) {
+      if (block * BLOCK_SIZE >= jobs[job]->len) {
+        job++;
+        block = 0;
+        continue;
+      }
+
+      counterBlock(stream + nblocks * BLOCK_SIZE, jobs[job]->nonce, block);
+      lane[nblocks] = job;
+      index[nblocks] = block;
+      nblocks++;
+      block++;
+    }
+
+    niEncryptLanes(subkeys, lane, stream, stream, nblocks);
+
+    for (size_t i = 0; i < nblocks; i++) {
+      MbJob *target = jobs[lane[i]];
+      size_t start = index[i] * BLOCK_SIZE;
+      size_t len = target->len - start < BLOCK_SIZE ? target->len - start : BLOCK_SIZE;
+
+      for (size_t b = 0; b < len; b++) {
+        target->data[start + b] ^= stream[i * BLOCK_SIZE + b];
+      }
+    }
+  }
+}
+
+bool mbSubmit( MultiBuffer *mb, MbJob *job )
+{
+  mb->jobs[mb->count++] = job;
+
+  if (mb->count < MB_LANES) {
+    return false;
+  }
+
+  mbFlush(mb);
+  return true;
+}
+
+void mbFlush( MultiBuffer *mb )
+{
+  if (niSelected()) {
+    runLanes(mb->jobs, mb->count);
+  }
+  else {
+    runSerial(mb->jobs, mb->count);
+  }
+
+  mb->count = 0;
+}
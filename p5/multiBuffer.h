@@ -0,0 +1,73 @@
+/**
+ * @file multiBuffer.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting many short, independent messages,
+ * each under its own key, in CTR mode. Jobs are collected into groups of
+ * MB_LANES, and each group is run together: the key schedules of the group
+ * are interleaved, and so are the blocks of all of its messages, which keeps
+ * the AES pipeline full even when every message is a block or two long.
+ */
+
+#ifndef _MULTI_BUFFER_H_
+#define _MULTI_BUFFER_H_
+
+#include <stdbool.h>
+#include "aes.h"
+#include "ctr.h"
+
+/** Number of jobs run together as a group. */
+#define MB_LANES 8
+
+/** One message to encrypt or decrypt. */
+typedef struct {
+  /** The 16-byte key for this message. */
+  byte const *key;
+
+  /** Initial counter block for this message. */
+  byte const *nonce;
+
+  /** The message, which is replaced by its ciphertext. */
+  byte *data;
+
+  /** Number of bytes in the message. */
+  size_t len;
+} MbJob;
+
+/** Jobs waiting to be run as a group. */
+typedef struct {
+  /** Jobs submitted since the last group was run. */
+  MbJob *jobs[ MB_LANES ];
+
+  /** Number of jobs waiting. */
+  int count;
+} MultiBuffer;
+
+/**
+ * Sets up an empty scheduler.
+ *
+ * @param mb the scheduler to set up
+*/
+void initMultiBuffer( MultiBuffer *mb );
+
+/**
+ * Adds a job to the current group, running the group once it's full. The
+ * job is only held by pointer, so it and its buffers must stay valid until
+ * it has been run. Since CTR mode encrypts and decrypts the same way, this
+ * also decrypts.
+ *
+ * @param mb the scheduler
+ * @param job the job to add
+ * @return true if a group was run, completing every job submitted so far
+*/
+bool mbSubmit( MultiBuffer *mb, MbJob *job );
+
+/**
+ * Runs the jobs waiting in a partly filled group, so every job submitted
+ * so far is complete.
+ *
+ * @param mb the scheduler
+*/
+void mbFlush( MultiBuffer *mb );
+
+#endif
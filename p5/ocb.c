@@ -0,0 +1,309 @@
+/**
+ * @file ocb.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Offset codebook mode with a 96-bit nonce, a 128-bit tag and no additional
+ * data. Block i is encrypted as E(P_i xor Offset_i) xor Offset_i, where each
+ * offset is the one before it xored with L_ntz(i). The tag is the encryption
+ * of the xor of all the plaintext blocks, masked with the last offset.
+ *
+ * Unrolling the offset chain gives Offset_i = Offset_0 xor the L_k for every
+ * bit k set in the Gray code of i, so a thread can start at any block without
+ * the ones before it. The checksum is a plain xor, so each slice keeps its
+ * own and the order they're combined in doesn't matter.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ocb.h"
+#include "io.h"
+
+/** Size of each slice handed to a thread, in bytes. A multiple of BLOCK_SIZE. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+/** Number of blocks handed to the AES backend at a time. */
+#define BATCH_BLOCKS 64
+
+/** Byte xored into the last byte of a block that has its top bit set, when doubling it. */
+#define DOUBLE_REDUCE 0x87
+
+/** Bit marking the end of a partial last block, in the checksum. */
+#define PAD_BIT 0x80
+
+/** Bits of the nonce block used to pick how far to shift the stretched key. */
+#define BOTTOM_MASK 0x3F
+
+void makeOcbNonce( byte nonce[ OCB_NONCE_SIZE ] )
+{
+  randomBytes(nonce, OCB_NONCE_SIZE);
+}
+
+/**
+ * Xors one block into another.
+ *
+ * @param dest the block to change
+ * @param src the block to xor into it
+*/
+static void xorBlock( byte dest[ BLOCK_SIZE ], byte const src[ BLOCK_SIZE ] )
+{
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    dest[i] ^= src[i];
+  }
+}
+
+/**
+ * Multiplies a block by x in GF(2^128), with OCB's big-endian bit order.
+ *
+ * @param dest filled in with the doubled block
+ * @param src the block to double
+*/
+static void doubleBlock( byte dest[ BLOCK_SIZE ], byte const src[ BLOCK_SIZE ] )
+{
+  byte carry = src[0] >> ( BBITS - 1 );
+
+  for (int i = 0; i < BLOCK_SIZE - 1; i++) {
+    dest[i] = ( src[i] << 1 ) | ( src[i + 1] >> ( BBITS - 1 ) );
+  }
+  dest[BLOCK_SIZE - 1] = ( src[BLOCK_SIZE - 1] << 1 ) ^ ( carry ? DOUBLE_REDUCE : 0 );
+}
+
+/**
+ * Computes the offset after the given number of blocks, straight from Offset_0.
+ *
+ * @param ocb the state of the stream
+ * @param blocks number of blocks before the offset
+ * @param offset filled in with the offset
+*/
+static void offsetAt( Ocb const *ocb, uint64_t blocks, byte offset[ BLOCK_SIZE ] )
+{
+  memcpy(offset, ocb->start, BLOCK_SIZE);
+
+  uint64_t gray = blocks ^ ( blocks >> 1 );
+  for (int k = 0; gray != 0; k++, gray >>= 1) {
+    if (gray & 1) {
+      xorBlock(offset, ocb->l[k]);
+    }
+  }
+}
+
+void ocbInit( Ocb *ocb, AesContext const *ctx, byte const nonce[ OCB_NONCE_SIZE ] )
+{
+  ocb->ctx = ctx;
+
+  byte zero[BLOCK_SIZE] = { 0 };
+  aesEncryptBlocks(ctx, zero, ocb->lStar, 1);
+  doubleBlock(ocb->lDollar, ocb->lStar);
+  doubleBlock(ocb->l[0], ocb->lDollar);
+  for (int k = 1; k < OCB_LEVELS; k++) {
+    doubleBlock(ocb->l[k], ocb->l[k - 1]);
+  }
+
+  // The nonce block is the tag length mod 128 (0), zeros, a 1 bit, then the nonce
+  byte block[BLOCK_SIZE] = { 0 };
+  block[BLOCK_SIZE - OCB_NONCE_SIZE - 1] = 0x01;
+  memcpy(block + BLOCK_SIZE - OCB_NONCE_SIZE, nonce, OCB_NONCE_SIZE);
+
+  int bottom = block[BLOCK_SIZE - 1] & BOTTOM_MASK;
+  block[BLOCK_SIZE - 1] &= ~BOTTOM_MASK;
+
+  // Stretch the encrypted nonce block to 192 bits, then take 128 of them starting at bit bottom
+  byte stretch[BLOCK_SIZE + BLOCK_SIZE / 2];
+  aesEncryptBlocks(ctx, block, stretch, 1);
+  for (int i = 0; i < BLOCK_SIZE / 2; i++) {
+    stretch[BLOCK_SIZE + i] = stretch[i] ^ stretch[i + 1];
+  }
+
+  int shift = bottom / BBITS;
+  int bits = bottom % BBITS;
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    ocb->start[i] = stretch[i + shift] << bits;
+    if (bits != 0) {
+      ocb->start[i] |= stretch[i + shift + 1] >> ( BBITS - bits );
+    }
+  }
+
+  memset(ocb->checksum, 0, BLOCK_SIZE);
+  ocb->processed = 0;
+}
+
+/** Everything a thread needs to process its slices of an OCB job. */
+typedef struct {
+  /** State of the stream. */
+  Ocb const *ocb;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+
+  /** Stream position of the first input byte. */
+  uint64_t position;
+
+  /** Input bytes. */
+  byte const *in;
+
+  /** Where to store the results, or NULL to only compute the checksum. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+
+  /** Checksum of each slice on its own, or NULL if it isn't needed. */
+  byte (*sums)[ BLOCK_SIZE ];
+} OcbJob;
+
+/**
+ * Processes one slice of an OCB job, a batch of blocks at a time, keeping the
+ * offset of each block so it can be added back after the block cipher.
+ *
+ * @param arg the OcbJob being worked on
+ * @param index number of the slice to process
+*/
+static void ocbSlice( void *arg, size_t index )
+{
+  OcbJob *job = arg;
+  Ocb const *ocb = job->ocb;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+  byte const *in = job->in + start;
+  byte *out = job->out ? job->out + start : NULL;
+
+  uint64_t block = ( job->position + start ) / BLOCK_SIZE;
+  byte offset[BLOCK_SIZE];
+  offsetAt(ocb, block, offset);
+
+  byte sum[BLOCK_SIZE] = { 0 };
+  byte offsets[BATCH_BLOCKS][BLOCK_SIZE];
+  byte work[BATCH_BLOCKS * BLOCK_SIZE];
+  size_t full = len / BLOCK_SIZE;
+
+  for (size_t done = 0; done < full; ) {
+    size_t n = full - done < BATCH_BLOCKS ? full - done : BATCH_BLOCKS;
+    byte const *src = in + done * BLOCK_SIZE;
+
+    for (size_t b = 0; b < n; b++) {
+      block++;
+      xorBlock(offset, ocb->l[__builtin_ctzll(block)]);
+      memcpy(offsets[b], offset, BLOCK_SIZE);
+
+      for (int i = 0; i < BLOCK_SIZE; i++) {
+        work[b * BLOCK_SIZE + i] = src[b * BLOCK_SIZE + i] ^ offset[i];
+      }
+      if (job->encrypt) {
+        xorBlock(sum, src + b * BLOCK_SIZE);
+      }
+    }
+
+    if (job->encrypt) {
+      aesEncryptBlocks(ocb->ctx, work, work, n);
+    }
+    else {
+      aesDecryptBlocks(ocb->ctx, work, work, n);
+    }
+
+    for (size_t b = 0; b < n; b++) {
+      byte *result = work + b * BLOCK_SIZE;
+      xorBlock(result, offsets[b]);
+      if (!job->encrypt) {
+        xorBlock(sum, result);
+      }
+      if (out) {
+        memcpy(out + ( done + b ) * BLOCK_SIZE, result, BLOCK_SIZE);
+      }
+    }
+
+    done += n;
+  }
+
+  // A partial last block is xored with a pad made from its offset, in both directions
+  size_t tail = len % BLOCK_SIZE;
+  if (tail > 0) {
+    byte pad[BLOCK_SIZE];
+    memcpy(pad, offset, BLOCK_SIZE);
+    xorBlock(pad, ocb->lStar);
+    aesEncryptBlocks(ocb->ctx, pad, pad, 1);
+
+    byte const *src = in + full * BLOCK_SIZE;
+    for (size_t i = 0; i < tail; i++) {
+      byte result = src[i] ^ pad[i];
+      sum[i] ^= job->encrypt ? src[i] : result;
+      if (out) {
+        out[full * BLOCK_SIZE + i] = result;
+      }
+    }
+    sum[tail] ^= PAD_BIT;
+  }
+
+  if (job->sums) {
+    memcpy(job->sums[index], sum, BLOCK_SIZE);
+  }
+}
+
+/**
+ * Runs an OCB job on the pool, then adds the checksum of each slice to the running checksum.
+ *
+ * @param ocb the state of the stream
+ * @param pool the pool to run on
+ * @param encrypt true to encrypt, false to decrypt
+ * @param in the input bytes
+ * @param out where to store the results, or NULL to only compute the checksum
+ * @param len number of bytes to process
+*/
+static void ocbRun( Ocb *ocb, ThreadPool *pool, bool encrypt, byte const *in, byte *out,
+                    size_t len )
+{
+  size_t nslices = (len + SLICE_SIZE - 1) / SLICE_SIZE;
+  OcbJob job = { ocb, encrypt, ocb->processed, in, out, len, malloc(nslices * BLOCK_SIZE) };
+  runPool(pool, ocbSlice, &job, nslices);
+
+  for (size_t i = 0; i < nslices; i++) {
+    xorBlock(ocb->checksum, job.sums[i]);
+  }
+
+  free(job.sums);
+  ocb->processed += len;
+}
+
+void ocbEncrypt( Ocb *ocb, ThreadPool *pool, byte const *in, byte *out, size_t len )
+{
+  ocbRun(ocb, pool, true, in, out, len);
+}
+
+void ocbAuthenticate( Ocb *ocb, ThreadPool *pool, byte const *in, byte *out, size_t len )
+{
+  ocbRun(ocb, pool, false, in, out, len);
+}
+
+void ocbDecrypt( Ocb const *ocb, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len )
+{
+  OcbJob job = { ocb, false, offset, in, out, len, NULL };
+  runPool(pool, ocbSlice, &job, (len + SLICE_SIZE - 1) / SLICE_SIZE);
+}
+
+void ocbTag( Ocb const *ocb, byte tag[ OCB_TAG_SIZE ] )
+{
+  // Checksum xor the last offset xor L_$, where a partial block has its own offset
+  offsetAt(ocb, ocb->processed / BLOCK_SIZE, tag);
+  if (ocb->processed % BLOCK_SIZE != 0) {
+    xorBlock(tag, ocb->lStar);
+  }
+  xorBlock(tag, ocb->checksum);
+  xorBlock(tag, ocb->lDollar);
+
+  // With no additional data, its hash is zero and there's nothing more to add
+  aesEncryptBlocks(ocb->ctx, tag, tag, 1);
+}
+
+bool ocbCheckTag( Ocb const *ocb, byte const tag[ OCB_TAG_SIZE ] )
+{
+  byte expected[OCB_TAG_SIZE];
+  ocbTag(ocb, expected);
+
+  // Accumulate the differences rather than stopping at the first one
+  byte diff = 0;
+  for (int i = 0; i < OCB_TAG_SIZE; i++) {
+    diff |= expected[i] ^ tag[i];
+  }
+
+  return diff == 0;
+}
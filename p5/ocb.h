@@ -0,0 +1,127 @@
+/**
+ * @file ocb.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for offset codebook mode (OCB3, as in RFC 7253),
+ * which encrypts and authenticates with one block cipher call per block,
+ * and lets every block be processed independently of the others.
+ */
+
+#ifndef _OCB_H_
+#define _OCB_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aes.h"
+#include "pool.h"
+
+/** Number of bytes in the nonce header at the start of an OCB file. */
+#define OCB_NONCE_SIZE 12
+
+/** Number of bytes in the authentication tag at the end of an OCB file. */
+#define OCB_TAG_SIZE BLOCK_SIZE
+
+/** Number of L values kept, one for each possible number of trailing zeros in a block index. */
+#define OCB_LEVELS 64
+
+/** State of one OCB stream. */
+typedef struct {
+  /** The expanded key. */
+  AesContext const *ctx;
+
+  /** Offset added for a partial last block, the encryption of the zero block. */
+  byte lStar[ BLOCK_SIZE ];
+
+  /** Offset added for the tag. */
+  byte lDollar[ BLOCK_SIZE ];
+
+  /** Offset added for block i when i has k trailing zero bits, indexed by k. */
+  byte l[ OCB_LEVELS ][ BLOCK_SIZE ];
+
+  /** Offset before the first block, derived from the nonce. */
+  byte start[ BLOCK_SIZE ];
+
+  /** XOR of all of the plaintext so far. */
+  byte checksum[ BLOCK_SIZE ];
+
+  /** Number of bytes of plaintext in the checksum so far. */
+  uint64_t processed;
+} Ocb;
+
+/**
+ * Fills in a new random nonce.
+ *
+ * @param nonce the nonce to fill
+*/
+void makeOcbNonce( byte nonce[ OCB_NONCE_SIZE ] );
+
+/**
+ * Sets up the state for a new stream with the given nonce.
+ *
+ * @param ocb the state to set up
+ * @param ctx the expanded key, which must outlive the state
+ * @param nonce the nonce of the stream
+*/
+void ocbInit( Ocb *ocb, AesContext const *ctx, byte const nonce[ OCB_NONCE_SIZE ] );
+
+/**
+ * Encrypts the next part of the stream and adds its plaintext to the checksum.
+ * Every part but the last must be a multiple of BLOCK_SIZE. The work is split
+ * into slices that run in parallel on the pool, and the checksum of each slice
+ * is added in at the end.
+ *
+ * @param ocb the state of the stream
+ * @param pool the pool to run on
+ * @param in the plaintext
+ * @param out where to store the ciphertext, which may be the same as in
+ * @param len number of bytes to encrypt
+*/
+void ocbEncrypt( Ocb *ocb, ThreadPool *pool, byte const *in, byte *out, size_t len );
+
+/**
+ * Decrypts the next part of the ciphertext and adds its plaintext to the
+ * checksum, in one pass. The plaintext can be kept, to be released once
+ * ocbCheckTag() passes, or thrown away. Every part but the last must be a
+ * multiple of BLOCK_SIZE.
+ *
+ * @param ocb the state of the stream
+ * @param pool the pool to run on
+ * @param in the ciphertext
+ * @param out where to store the plaintext, which may be the same as in, or NULL to not keep it
+ * @param len number of bytes to authenticate
+*/
+void ocbAuthenticate( Ocb *ocb, ThreadPool *pool, byte const *in, byte *out, size_t len );
+
+/**
+ * Decrypts part of the stream without adding it to the checksum. This should
+ * only be used once the whole ciphertext has been authenticated.
+ *
+ * @param ocb the state of the stream
+ * @param pool the pool to run on
+ * @param offset position of in[ 0 ] within the stream, a multiple of BLOCK_SIZE
+ * @param in the ciphertext
+ * @param out where to store the plaintext, which may be the same as in
+ * @param len number of bytes to decrypt
+*/
+void ocbDecrypt( Ocb const *ocb, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len );
+
+/**
+ * Computes the tag for everything in the checksum so far.
+ *
+ * @param ocb the state of the stream
+ * @param tag filled in with the tag
+*/
+void ocbTag( Ocb const *ocb, byte tag[ OCB_TAG_SIZE ] );
+
+/**
+ * Compares the given tag with the tag for everything in the checksum so far,
+ * taking the same time however many bytes match.
+ *
+ * @param ocb the state of the stream
+ * @param tag the tag to check
+ * @return true if the tag is correct
+*/
+bool ocbCheckTag( Ocb const *ocb, byte const tag[ OCB_TAG_SIZE ] );
+
+#endif
@@ -0,0 +1,414 @@
+/**
+ * @file options.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Parses the command-line options shared by the
+ * encrypt, decrypt and transcrypt programs, and the
+ * pieces of them the other tools take as well.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "options.h"
+#include "aes.h"
+#include "pool.h"
+#include "asyncIo.h"
+#include "kernelAes.h"
+
+/** Number of file arguments after the options */
+#define NUM_FILES 3
+
+/** Number of file arguments to transcrypt, which takes a second key */
+#define TRANSCRYPT_FILES 4
+
+/** Largest number of threads that can be requested */
+#define MAX_THREADS 1024
+
+/** Prefix of the option that sets the container chunk size */
+#define CONTAINER_OPTION "--container="
+
+/** Prefix of the option that sets the XTS sector size */
+#define SECTOR_OPTION "--sector="
+
+/** Prefix of the option that selects a backend */
+#define BACKEND_OPTION "--backend="
+
+/** Name of the backend that hands the work to the kernel's crypto API */
+#define KERNEL_BACKEND "kernel"
+
+void usageError( char const *usage )
+{
+  fprintf(stderr, "%s\n", usage);
+  exit(EXIT_FAILURE);
+}
+
+void selectAesBackend( char const *name )
+{
+  AesBackend backend;
+
+  if (!aesBackendFromName(name, &backend)) {
+    fprintf(stderr, "Unknown backend: %s\n", name);
+    exit(EXIT_FAILURE);
+  }
+
+  if (!aesSetBackend(backend)) {
+    fprintf(stderr, "Backend not supported on this machine: %s\n", name);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Selects the backend with the given name, terminating the
+ * program if there is no such backend or it can't run here
+ * 
+ * @param name name of the backend
+ * @param opts the settings, for the kernel backend
+*/
+static void selectBackend( char const *name, Options *opts )
+{
+  // The kernel takes over whole modes, so it isn't one of the AES backends
+  if (strcmp(name, KERNEL_BACKEND) == 0) {
+    if (!kernelSupported()) {
+      fprintf(stderr, "Backend not supported on this machine: %s\n", name);
+      exit(EXIT_FAILURE);
+    }
+    opts->kernel = true;
+    return;
+  }
+
+  selectAesBackend(name);
+}
+
+/**
+ * Returns the mode with the given name, terminating the program if there isn't one
+ * 
+ * @param name name of the mode
+ * @return the matching mode
+*/
+static Mode parseMode( char const *name )
+{
+  // Names of the modes, indexed by Mode
+  static char const *names[] = { "ecb", "ctr", "gcm", "cbc", "ocb", "xts" };
+
+  for (int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+
+  fprintf(stderr, "Unknown mode: %s\n", name);
+  exit(EXIT_FAILURE);
+}
+
+int parseThreads( char const *str )
+{
+  char *end;
+  long threads = strtol(str, &end, 10);
+
+  if (*end != '\0' || threads < 1 || threads > MAX_THREADS) {
+    fprintf(stderr, "Bad thread count: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  return threads;
+}
+
+/**
+ * Parses a container chunk size, terminating the program if it isn't
+ * a positive multiple of BLOCK_SIZE up to CONTAINER_MAX_CHUNK
+ * 
+ * @param str the chunk size as a string
+ * @return the chunk size
+*/
+static size_t parseChunkSize( char const *str )
+{
+  char *end;
+  unsigned long size = strtoul(str, &end, 10);
+
+  if (*end != '\0' || size == 0 || size % BLOCK_SIZE != 0 || size > CONTAINER_MAX_CHUNK) {
+    fprintf(stderr, "Bad chunk size: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  return size;
+}
+
+/**
+ * Parses an XTS sector size, terminating the program if it isn't
+ * XTS_SECTOR_SIZE or XTS_LARGE_SECTOR
+ * 
+ * @param str the sector size as a string
+ * @return the sector size
+*/
+static size_t parseSectorSize( char const *str )
+{
+  char *end;
+  unsigned long size = strtoul(str, &end, 10);
+
+  if (*end != '\0' || ( size != XTS_SECTOR_SIZE && size != XTS_LARGE_SECTOR )) {
+    fprintf(stderr, "Bad sector size: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  return size;
+}
+
+/**
+ * Parses an offset into an image, terminating the program if it isn't a number
+ * 
+ * @param str the offset as a string
+ * @return the offset
+*/
+static uint64_t parseOffset( char const *str )
+{
+  char *end;
+  uint64_t offset = strtoull(str, &end, 10);
+
+  if (end == str || *end != '\0' || str[0] == '-') {
+    fprintf(stderr, "Bad offset: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  return offset;
+}
+
+/**
+ * Parses a range of the form off:len, or off: for everything from off to the
+ * end, terminating the program if it isn't one
+ * 
+ * @param str the range as a string
+ * @param opts filled in with the range
+*/
+static void parseRange( char const *str, Options *opts )
+{
+  char *end;
+  opts->rangeOffset = strtoull(str, &end, 10);
+
+  if (end == str || *end != ':' || str[0] == '-') {
+    fprintf(stderr, "Bad range: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+
+  char const *len = end + 1;
+  if (*len == '\0') {
+    opts->rangeLength = RANGE_TO_END;
+    return;
+  }
+
+  opts->rangeLength = strtoull(len, &end, 10);
+  if (*end != '\0' || len[0] == '-') {
+    fprintf(stderr, "Bad range: %s\n", str);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Parses the options into opts and collects the file names in order,
+ * printing the usage message and terminating the program if there are
+ * more than TRANSCRYPT_FILES of them or an option is invalid.
+ * 
+ * @param argc number of arguments
+ * @param argv array of char pointers for each argument
+ * @param usage usage message to print if the arguments are invalid
+ * @param opts the settings to fill in
+ * @param files filled in with the file names
+ * @return number of file names
+*/
+static int parseArguments( int argc, char const *argv[], char const *usage, Options *opts,
+                           char const *files[ TRANSCRYPT_FILES ] )
+{
+  int nfiles = 0;
+  bool sectorSet = false;
+
+  opts->verbose = false;
+  opts->inPlace = false;
+  opts->async = false;
+  opts->asyncThreads = false;
+  opts->container = false;
+  opts->chunkSize = CONTAINER_CHUNK_SIZE;
+  opts->incremental = false;
+  opts->ranged = false;
+  opts->rangeOffset = 0;
+  opts->rangeLength = RANGE_TO_END;
+  opts->sectorSize = XTS_SECTOR_SIZE;
+  opts->updating = false;
+  opts->updateOffset = 0;
+  opts->batchFile = NULL;
+  opts->checksum = false;
+  opts->compress = false;
+  opts->newKeyFile = NULL;
+  opts->kernel = false;
+  opts->mode = MODE_ECB;
+  opts->threads = processorCount();
+
+  for (int i = 1; i < argc; i++) {
+    char const *arg = argv[i];
+
+    if (strcmp(arg, "-v") == 0) {
+      opts->verbose = true;
+    }
+    else if (strcmp(arg, "--in-place") == 0) {
+      opts->inPlace = true;
+    }
+    else if (strcmp(arg, "--async") == 0) {
+      opts->async = true;
+    }
+    else if (strcmp(arg, "--async=threads") == 0) {
+      opts->async = true;
+      opts->asyncThreads = true;
+    }
+    else if (strcmp(arg, "--container") == 0) {
+      opts->container = true;
+    }
+    else if (strncmp(arg, CONTAINER_OPTION, strlen(CONTAINER_OPTION)) == 0) {
+      opts->container = true;
+      opts->chunkSize = parseChunkSize(arg + strlen(CONTAINER_OPTION));
+    }
+    else if (strcmp(arg, "--incremental") == 0) {
+      opts->container = true;
+      opts->incremental = true;
+    }
+    else if (strcmp(arg, "--range") == 0 && i + 1 < argc) {
+      opts->ranged = true;
+      parseRange(argv[++i], opts);
+    }
+    else if (strncmp(arg, SECTOR_OPTION, strlen(SECTOR_OPTION)) == 0) {
+      opts->sectorSize = parseSectorSize(arg + strlen(SECTOR_OPTION));
+      sectorSet = true;
+    }
+    else if (strcmp(arg, "--at") == 0 && i + 1 < argc) {
+      opts->updating = true;
+      opts->updateOffset = parseOffset(argv[++i]);
+    }
+    else if (strncmp(arg, BACKEND_OPTION, strlen(BACKEND_OPTION)) == 0) {
+      selectBackend(arg + strlen(BACKEND_OPTION), opts);
+    }
+    else if (strcmp(arg, "-m") == 0 && i + 1 < argc) {
+      opts->mode = parseMode(argv[++i]);
+    }
+    else if (strcmp(arg, "-j") == 0 && i + 1 < argc) {
+      opts->threads = parseThreads(argv[++i]);
+    }
+    else if (strcmp(arg, "--batch") == 0 && i + 1 < argc) {
+      opts->batchFile = argv[++i];
+    }
+    else if (strcmp(arg, "--checksum") == 0) {
+      opts->checksum = true;
+    }
+    else if (strcmp(arg, "--compress") == 0) {
+      opts->compress = true;
+    }
+    else if (arg[0] == '-') {
+      usageError(usage);
+    }
+    else {
+      // Too many file names
+      if (nfiles == TRANSCRYPT_FILES) {
+        usageError(usage);
+      }
+      files[nfiles++] = arg;
+    }
+  }
+
+  // Only containers and XTS images can be decrypted a piece at a time
+  if (opts->ranged && opts->mode != MODE_XTS) {
+    opts->container = true;
+  }
+
+  // XTS images are read and written in place, sector by sector, and only
+  // they can be, so the chunked formats and the options for them don't mix
+  if (opts->mode == MODE_XTS) {
+    if (opts->batchFile || opts->container) {
+      usageError(usage);
+    }
+    if (( opts->updating || opts->ranged ) && ( opts->inPlace || opts->async )) {
+      usageError(usage);
+    }
+  }
+  else if (sectorSet || opts->updating) {
+    usageError(usage);
+  }
+
+  // The checksum is taken as the cipher goes through the plaintext, which
+  // containers, batches and sector updates don't do through the cipher
+  if (opts->checksum && ( opts->container || opts->updating || opts->batchFile )) {
+    usageError(usage);
+  }
+
+  // Compressed plaintext has no fixed size, so it can only be streamed, and
+  // not into XTS images, whose sectors have to stay where they are
+  if (opts->compress && ( opts->inPlace || opts->async || opts->container || opts->updating
+                          || opts->batchFile || opts->mode == MODE_XTS )) {
+    usageError(usage);
+  }
+
+  // The kernel only does ECB and CTR, and containers always use GCM
+  if (opts->kernel) {
+    if (opts->batchFile || opts->container) {
+      usageError(usage);
+    }
+    if (opts->mode != MODE_ECB && opts->mode != MODE_CTR) {
+      fprintf(stderr, "Kernel backend only supports ecb and ctr mode\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return nfiles;
+}
+
+void parseOptions( int argc, char const *argv[], char const *usage, Options *opts )
+{
+  char const *files[TRANSCRYPT_FILES];
+  int nfiles = parseArguments(argc, argv, usage, opts, files);
+
+  // A batch takes its file names from the manifest, and streams every file
+  if (opts->batchFile) {
+    if (nfiles != 0 || opts->inPlace || opts->async || opts->container) {
+      usageError(usage);
+    }
+    opts->keyFile = opts->inputFile = opts->outputFile = NULL;
+    return;
+  }
+
+  // Check for the right number of file names, and only one way of doing the I/O
+  if (nfiles != NUM_FILES || opts->inPlace + opts->async + opts->container > 1) {
+    usageError(usage);
+  }
+
+  opts->keyFile = files[0];
+  opts->inputFile = files[1];
+  opts->outputFile = files[2];
+}
+
+void parseTranscryptOptions( int argc, char const *argv[], char const *usage, Options *opts )
+{
+  char const *files[TRANSCRYPT_FILES];
+  int nfiles = parseArguments(argc, argv, usage, opts, files);
+
+  // Transcrypt only streams, one file at a time
+  if (nfiles != TRANSCRYPT_FILES || opts->batchFile || opts->inPlace || opts->async
+      || opts->container || opts->ranged || opts->updating || opts->checksum
+      || opts->compress) {
+    usageError(usage);
+  }
+
+  opts->keyFile = files[0];
+  opts->newKeyFile = files[1];
+  opts->inputFile = files[2];
+  opts->outputFile = files[3];
+}
+
+void reportOptions( Options const *opts )
+{
+  if (opts->verbose) {
+    fprintf(stderr, "AES backend: %s\n",
+            opts->kernel ? KERNEL_BACKEND : aesBackendName(aesGetBackend()));
+    fprintf(stderr, "Threads: %d\n", opts->threads);
+    if (opts->async) {
+      fprintf(stderr, "I/O backend: %s\n",
+              uringSupported() && !opts->asyncThreads ? "io_uring" : "threads");
+    }
+  }
+}
@@ -0,0 +1,172 @@
+/**
+ * @file options.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for parsing the command-line
+ * options shared by the encrypt, decrypt and transcrypt programs
+ */
+
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+#include <stdbool.h>
+#include "cipher.h"
+#include "container.h"
+
+/** Settings chosen on the command line. */
+typedef struct {
+  /** Mode of operation. */
+  Mode mode;
+
+  /** Number of threads to use. */
+  int threads;
+
+  /** True if details such as the active backend should be reported. */
+  bool verbose;
+
+  /** True if the kernel's crypto API should do the work, through --backend=kernel. */
+  bool kernel;
+
+  /** True if the files should be processed through memory mappings. */
+  bool inPlace;
+
+  /** True if reads and writes should run in the background while the cipher works. */
+  bool async;
+
+  /** True if background I/O should use a helper thread even where io_uring is available. */
+  bool asyncThreads;
+
+  /** Name of the key file. */
+  char const *keyFile;
+
+  /** Name of the key file to encrypt with, for transcrypt, or NULL. */
+  char const *newKeyFile;
+
+  /** Name of the input file. */
+  char const *inputFile;
+
+  /** Name of the output file. */
+  char const *outputFile;
+
+  /** True if the files are in the chunked container format. */
+  bool container;
+
+  /** Plaintext bytes in each chunk of a new container. */
+  size_t chunkSize;
+
+  /** True if only the changed chunks of an existing container should be written. */
+  bool incremental;
+
+  /** True if only part of a container should be decrypted. */
+  bool ranged;
+
+  /** Where the part to decrypt starts in the plaintext. */
+  uint64_t rangeOffset;
+
+  /** Length of the part to decrypt, or RANGE_TO_END. */
+  uint64_t rangeLength;
+
+  /** Number of bytes in each sector, in XTS mode. */
+  size_t sectorSize;
+
+  /** True if the input should be written into part of an existing XTS image. */
+  bool updating;
+
+  /** Where the input goes in the image's plaintext. */
+  uint64_t updateOffset;
+
+  /** True if the checksum of the plaintext should be printed, for encrypt. */
+  bool checksum;
+
+  /** True if the plaintext should be compressed before it's encrypted, for encrypt. */
+  bool compress;
+
+  /** Name of the batch manifest, or NULL to process a single file. */
+  char const *batchFile;
+} Options;
+
+/**
+ * Parses the given command-line arguments into opts. Options can appear
+ * anywhere, and the remaining arguments are the key, input and output files.
+ * In batch mode, the files all come from the manifest instead. Prints the usage message and terminates the program if they're invalid.
+ * 
+ * Supported options:
+ *   -v                 report the active AES backend on standard error
+ *   --backend=<name>   use the named AES backend instead of the fastest one;
+ *                      kernel hands ECB and CTR mode to the kernel's crypto API
+ *   -m <mode>          mode of operation, ecb (the default), ctr, gcm, cbc, ocb
+ *                      or xts, which takes a 32-byte key file
+ *   -j <threads>       number of threads, by default one per processor
+ *   --in-place         work directly on memory-mapped pages of the files
+ *   --async            overlap reads and writes with the cipher, through io_uring
+ *                      if the kernel has it and a helper thread if not
+ *   --async=threads    overlap reads and writes using the helper thread
+ *   --container        use the chunked container format, with GCM chunks of 1 MiB
+ *   --container=<size> use the chunked container format with the given chunk size
+ *   --incremental      keep a container up to date, writing only the chunks
+ *                      whose hash changed since the last run
+ *   --range <off:len>  decrypt only len bytes of a container or XTS image,
+ *                      starting at off; with no len, decrypt to the end
+ *   --sector=<size>    sector size of an XTS image, 512 (the default) or 4096
+ *   --at <off>         write the input into an existing XTS image at offset off,
+ *                      encrypting only the sectors it touches
+ *   --batch <manifest> process every "key input output" line of the manifest,
+ *                      with -j files at a time
+ *   --checksum         print the checksum of the plaintext on standard output,
+ *                      as the checksum program would, taken as it's encrypted
+ *   --compress         compress the plaintext before encrypting it, marking it
+ *                      in a format header so decrypt expands it again
+ * 
+ * @param argc number of arguments
+ * @param argv array of char pointers for each argument
+ * @param usage usage message to print if the arguments are invalid
+ * @param opts the settings to fill in
+*/
+void parseOptions( int argc, char const *argv[], char const *usage, Options *opts );
+
+/**
+ * Parses the arguments of the transcrypt program into opts, with the same options
+ * as parseOptions(). The remaining arguments are the old key, the new key, and the
+ * input and output files. Only -v, --backend, -m and -j make sense here, so the
+ * options for other ways of doing the I/O are rejected. Prints the usage message
+ * and terminates the program if the arguments are invalid.
+ * 
+ * @param argc number of arguments
+ * @param argv array of char pointers for each argument
+ * @param usage usage message to print if the arguments are invalid
+ * @param opts the settings to fill in
+*/
+void parseTranscryptOptions( int argc, char const *argv[], char const *usage, Options *opts );
+
+/**
+ * Reports the settings in use on standard error, if verbose output was requested.
+ * 
+ * @param opts the settings to report
+*/
+void reportOptions( Options const *opts );
+
+/**
+ * Prints the usage message and terminates the program
+ * 
+ * @param usage the usage message to print
+*/
+void usageError( char const *usage );
+
+/**
+ * Parses a thread count, terminating the program if it isn't a positive number
+ * 
+ * @param str the thread count as a string
+ * @return the thread count
+*/
+int parseThreads( char const *str );
+
+/**
+ * Selects the AES backend with the given name, terminating the
+ * program if there is no such backend or it can't run here.
+ * The kernel backend isn't one of them, since it takes over whole modes.
+ * 
+ * @param name name of the backend
+*/
+void selectAesBackend( char const *name );
+
+#endif
@@ -0,0 +1,381 @@
+/**
+ * @file pipeline.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Encrypts and decrypts with a few chunk buffers in rotation. While the
+ * cipher works on chunk i, the read of chunk i + 1 and the write of chunk
+ * i - 1 are already in flight, and each buffer starts its next read as soon
+ * as its write has finished. On a fast disk, the time per chunk comes down
+ * to the time the cipher takes, instead of that plus a read and a write.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "pipeline.h"
+#include "asyncIo.h"
+#include "stream.h"
+#include "io.h"
+
+/** Function applied to each chunk as it comes through the pipeline. */
+typedef void (*ChunkFunction)( Cipher *cipher, byte *data, size_t len, void *state );
+
+/** One pass of chunks through the pipeline, from one file to another. */
+typedef struct {
+  /** The file to read from. */
+  int in;
+
+  /** Where the chunks start in the input file. */
+  uint64_t inOffset;
+
+  /** Number of bytes to read from the input file. */
+  uint64_t readLen;
+
+  /** Number of bytes to process, which is more than readLen if the end is padded. */
+  uint64_t len;
+
+  /** The file to write to, or -1 if the chunks aren't written. */
+  int out;
+
+  /** Where the chunks go in the output file. */
+  uint64_t outOffset;
+
+  /** Name of the output file, for error messages. */
+  char const *outputFile;
+} Pass;
+
+/**
+ * Prints an error about the given file and terminates the program.
+ *
+ * @param message what went wrong
+ * @param filename the file it went wrong with
+*/
+static void pipeError( char const *message, char const *filename )
+{
+  fprintf(stderr, "%s: %s\n", message, filename);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Returns the number of bytes to hand to the cipher at a time, so each
+ * thread gets about as much work as with the streaming functions.
+ *
+ * @param cipher the cipher that will do the work
+ * @return the chunk size, a multiple of BLOCK_SIZE
+*/
+static size_t chunkSize( Cipher const *cipher )
+{
+  return (size_t) CHUNK_SIZE * poolThreads(cipher->pool);
+}
+
+/**
+ * Works out how long chunk i of a pass is, and how much of it comes from the input.
+ *
+ * @param pass the pass the chunk belongs to
+ * @param step the chunk size
+ * @param i which chunk it is
+ * @param want filled in with the number of bytes to read for it
+ * @return length of the chunk
+*/
+static size_t chunkLength( Pass const *pass, size_t step, uint64_t i, size_t *want )
+{
+  uint64_t off = i * step;
+  size_t len = pass->len - off < step ? pass->len - off : step;
+
+  *want = 0;
+  if (off < pass->readLen) {
+    *want = pass->readLen - off < len ? pass->readLen - off : len;
+  }
+
+  return len;
+}
+
+/**
+ * Starts reading chunk i into its buffer. The end of the last chunk is
+ * padded with zeros right away, since nothing is read there.
+ *
+ * @param io the buffers
+ * @param pass the pass the chunk belongs to
+ * @param step the chunk size
+ * @param i which chunk to read
+*/
+static void startRead( AsyncIo *io, Pass const *pass, size_t step, uint64_t i )
+{
+  int slot = i % PIPELINE_DEPTH;
+  size_t want;
+  size_t len = chunkLength(pass, step, i, &want);
+
+  memset(asyncBuffer(io, slot) + want, 0x00, len - want);
+  asyncRead(io, slot, pass->in, pass->inOffset + i * step, want);
+}
+
+/**
+ * Sends every chunk of a pass through the pipeline, applying fn to each in order.
+ *
+ * @param io the buffers, PIPELINE_DEPTH of them
+ * @param pass the files and ranges to work on
+ * @param cipher the cipher to pass to fn
+ * @param fn the function to apply to each chunk, or NULL to copy them unchanged
+ * @param state extra state to pass to fn
+*/
+static void runPass( AsyncIo *io, Pass const *pass, Cipher *cipher, ChunkFunction fn, void *state )
+{
+  size_t step = chunkSize(cipher);
+  uint64_t chunks = ( pass->len + step - 1 ) / step;
+
+  for (uint64_t i = 0; i < chunks && i < PIPELINE_DEPTH; i++) {
+    startRead(io, pass, step, i);
+  }
+
+  for (uint64_t i = 0; i < chunks; i++) {
+    int slot = i % PIPELINE_DEPTH;
+    size_t want;
+    size_t len = chunkLength(pass, step, i, &want);
+
+    // The input was checked up front, so a short read means it shrank since then
+    if (asyncWait(io, slot) != (ssize_t) want) {
+      fprintf(stderr, "Can't read input file\n");
+      exit(EXIT_FAILURE);
+    }
+
+    if (fn) {
+      fn(cipher, asyncBuffer(io, slot), len, state);
+    }
+
+    if (pass->out >= 0) {
+      asyncWrite(io, slot, pass->out, pass->outOffset + i * step, len);
+    }
+
+    // Once the previous chunk is written, its buffer can take the next read
+    if (i > 0) {
+      uint64_t prev = i - 1;
+      if (pass->out >= 0 && asyncWait(io, prev % PIPELINE_DEPTH) < 0) {
+        pipeError("Can't write file", pass->outputFile);
+      }
+      if (prev + PIPELINE_DEPTH < chunks) {
+        startRead(io, pass, step, prev + PIPELINE_DEPTH);
+      }
+    }
+  }
+
+  if (chunks > 0 && pass->out >= 0 && asyncWait(io, ( chunks - 1 ) % PIPELINE_DEPTH) < 0) {
+    pipeError("Can't write file", pass->outputFile);
+  }
+}
+
+/**
+ * Opens the output file and sets its size. An existing output isn't
+ * truncated to zero first: on ext4, emptying a file that way makes the kernel
+ * flush the new data when the file is closed, so the program would wait for
+ * the disk anyway. An existing output that's longer than size is shrunk only
+ * by the ftruncate() to size, and every byte up to size is written afterward.
+ * The output is checked against the input first, since writing over the input
+ * while it's still being read would corrupt both.
+ *
+ * @param in the input file
+ * @param outputFile name of the output file
+ * @param size size to give the output file
+ * @return the open file descriptor
+*/
+static int openOutput( FILE *in, char const *outputFile, uint64_t size )
+{
+  int fd = open(outputFile, O_WRONLY | O_CREAT, 0666);
+  if (fd < 0) {
+    pipeError("Can't open file", outputFile);
+  }
+
+  struct stat inInfo, outInfo;
+  if (fstat(fileno(in), &inInfo) == 0 && fstat(fd, &outInfo) == 0
+      && inInfo.st_dev == outInfo.st_dev && inInfo.st_ino == outInfo.st_ino) {
+    pipeError("Input and output are the same file", outputFile);
+  }
+
+  if (ftruncate(fd, size) != 0) {
+    pipeError("Can't write file", outputFile);
+  }
+
+  return fd;
+}
+
+/**
+ * Writes all of the given bytes at the given offset.
+ *
+ * @param fd the file to write to
+ * @param data the bytes to write
+ * @param len number of bytes to write
+ * @param offset where in the file to write them
+ * @param outputFile name of the file, for error messages
+*/
+static void writeAt( int fd, byte const *data, size_t len, uint64_t offset, char const *outputFile )
+{
+  if (len > 0 && pwrite(fd, data, len, offset) != (ssize_t) len) {
+    pipeError("Can't write file", outputFile);
+  }
+}
+
+/**
+ * Reads all of the given bytes from the given offset, terminating
+ * the program if they can't all be read.
+ *
+ * @param fd the file to read from
+ * @param data where to store the bytes
+ * @param len number of bytes to read
+ * @param offset where in the file to read them from
+*/
+static void readAt( int fd, byte *data, size_t len, uint64_t offset )
+{
+  if (len > 0 && pread(fd, data, len, offset) != (ssize_t) len) {
+    fprintf(stderr, "Can't read input file\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Encrypts one chunk in place, after adding it to the checksum.
+ *
+ * @param cipher the cipher to use
+ * @param data the chunk
+ * @param len length of the chunk
+ * @param state size of the plaintext, so padding isn't added to the checksum
+*/
+static void encryptStep( Cipher *cipher, byte *data, size_t len, void *state )
+{
+  uint64_t const *size = state;
+  uint64_t left = *size - cipher->position;
+
+  checksumChunk(cipher, data, left < len ? left : len);
+  encryptChunk(cipher, data, data, len);
+}
+
+/**
+ * Decrypts one chunk in place, keeping track of where the last nonzero
+ * plaintext byte is so padding can be removed at the end.
+ *
+ * @param cipher the cipher to use
+ * @param data the chunk
+ * @param len length of the chunk
+ * @param state the end of the plaintext so far, not counting trailing zeros
+*/
+static void decryptStep( Cipher *cipher, byte *data, size_t len, void *state )
+{
+  uint64_t *end = state;
+  uint64_t start = cipher->position;
+
+  decryptChunk(cipher, data, data, len);
+
+  size_t last = len;
+  while (last > 0 && data[last - 1] == 0x00) {
+    last--;
+  }
+  if (last > 0) {
+    *end = start + last;
+  }
+}
+
+/**
+ * Adds one chunk of ciphertext to the authentication and decrypts it in
+ * place. Modes with a trailer have no padding, so there's nothing to trim.
+ *
+ * @param cipher the cipher to use
+ * @param data the chunk
+ * @param len length of the chunk
+ * @param state the end of the plaintext so far, as in decryptStep()
+*/
+static void openStep( Cipher *cipher, byte *data, size_t len, void *state )
+{
+  uint64_t *end = state;
+  openChunk(cipher, data, data, len);
+  *end = cipher->position;
+}
+
+void encryptPipelined( Cipher *cipher, FILE *in, char const *outputFile, bool useThreads )
+{
+  uint64_t size = 0;
+  fileSize(in, &size);
+
+  size_t header = headerSize(cipher->mode);
+  size_t trailer = trailerSize(cipher->mode);
+  uint64_t body = modePadded(cipher->mode) && size % BLOCK_SIZE != 0
+                  ? size + BLOCK_SIZE - size % BLOCK_SIZE : size;
+
+  int out = openOutput(in, outputFile, header + body + trailer);
+  AsyncIo *io = makeAsyncIo(PIPELINE_DEPTH, chunkSize(cipher), useThreads);
+
+  byte head[MAX_HEADER_SIZE];
+  makeHeader(cipher, head);
+  writeAt(out, head, header, 0, outputFile);
+
+  Pass pass = { fileno(in), 0, size, body, out, header, outputFile };
+  runPass(io, &pass, cipher, encryptStep, &size);
+
+  byte tail[MAX_TRAILER_SIZE];
+  makeTrailer(cipher, tail);
+  writeAt(out, tail, trailer, header + body, outputFile);
+
+  freeAsyncIo(io);
+  close(out);
+}
+
+DecryptResult decryptPipelined( Cipher *cipher, FILE *in, char const *outputFile, bool useThreads )
+{
+  uint64_t size = 0;
+  fileSize(in, &size);
+
+  size_t header = headerSize(cipher->mode);
+  size_t trailer = trailerSize(cipher->mode);
+  if (size < header + trailer || (modePadded(cipher->mode) && size % BLOCK_SIZE != 0)) {
+    return DECRYPT_BAD_LENGTH;
+  }
+
+  int fd = fileno(in);
+  uint64_t len = size - header - trailer;
+
+  byte head[MAX_HEADER_SIZE];
+  readAt(fd, head, header, 0);
+  readHeader(cipher, head);
+
+  AsyncIo *io = makeAsyncIo(PIPELINE_DEPTH, chunkSize(cipher), useThreads);
+
+  int out;
+  uint64_t end = 0;
+
+  if (trailer > 0) {
+    // Read the input only once, so what's decrypted is what was authenticated,
+    // and hold the plaintext back, next to the output, until the tag checks out
+    FILE *spool = makeSpool(outputFile);
+    Pass check = { fd, header, len, len, fileno(spool), 0, "temporary file" };
+    runPass(io, &check, cipher, openStep, &end);
+
+    byte tail[MAX_TRAILER_SIZE];
+    readAt(fd, tail, trailer, header + len);
+    if (!checkTrailer(cipher, tail)) {
+      fclose(spool);
+      freeAsyncIo(io);
+      return DECRYPT_BAD_TAG;
+    }
+
+    out = openOutput(in, outputFile, len);
+    Pass copy = { fileno(spool), 0, len, len, out, 0, outputFile };
+    runPass(io, &copy, cipher, NULL, NULL);
+    fclose(spool);
+  }
+  else {
+    out = openOutput(in, outputFile, len);
+    Pass pass = { fd, header, len, len, out, 0, outputFile };
+    runPass(io, &pass, cipher, decryptStep, &end);
+  }
+
+  // Remove the padding at the end by shrinking the file
+  if (modePadded(cipher->mode) && end != len && ftruncate(out, end) != 0) {
+    pipeError("Can't write file", outputFile);
+  }
+
+  freeAsyncIo(io);
+  close(out);
+  return DECRYPT_OK;
+}
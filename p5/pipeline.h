@@ -0,0 +1,47 @@
+/**
+ * @file pipeline.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting and decrypting files with the reads
+ * and writes running in the background, so the next chunk is read and the
+ * last one written while the cipher works on the current one
+ */
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "cipher.h"
+
+/** Number of chunks in flight at once: being read, worked on or written. */
+#define PIPELINE_DEPTH 4
+
+/**
+ * Encrypts a regular file into the output file, with the same output as
+ * encryptStream(). Terminates the program if the output can't be created
+ * or either file can't be read or written.
+ *
+ * @param cipher a newly initialized cipher
+ * @param in the plaintext file, which must be a regular file
+ * @param outputFile name of the file to write the ciphertext to
+ * @param useThreads true to do the I/O on a helper thread even if io_uring is available
+*/
+void encryptPipelined( Cipher *cipher, FILE *in, char const *outputFile, bool useThreads );
+
+/**
+ * Decrypts a regular file into the output file, with the same output as
+ * decryptStream(). In modes with a trailer, the whole input is read once,
+ * authenticated and decrypted into a temporary file next to the output, and
+ * the output is only created from that once the tag checks out. Terminates the program if the
+ * output can't be created or either file can't be read or written.
+ *
+ * @param cipher a newly initialized cipher
+ * @param in the ciphertext file, which must be a regular file
+ * @param outputFile name of the file to write the plaintext to
+ * @param useThreads true to do the I/O on a helper thread even if io_uring is available
+ * @return DECRYPT_OK, or what's wrong with the input
+*/
+DecryptResult decryptPipelined( Cipher *cipher, FILE *in, char const *outputFile, bool useThreads );
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @file pool.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Fixed-size pool of worker threads. A batch of numbered tasks is handed
+ * out one at a time from a shared counter, so faster threads take more of
+ * them, and the caller works on the batch too until it's finished.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/** Representation of a pool of worker threads. */
+struct ThreadPoolStruct {
+  /** Number of threads, including the caller of runPool(). */
+  int threads;
+
+  /** The worker threads, one fewer than threads. */
+  pthread_t *workers;
+
+  /** Protects all the fields below. */
+  pthread_mutex_t lock;
+
+  /** Signalled when a new batch starts or the pool is shutting down. */
+  pthread_cond_t start;
+
+  /** Signalled when the last task of a batch finishes. */
+  pthread_cond_t done;
+
+  /** Function for the current batch. */
+  TaskFunction task;
+
+  /** Argument for the current batch. */
+  void *arg;
+
+  /** Number of tasks in the current batch. */
+  size_t ntasks;
+
+  /** Next task to hand out. */
+  size_t next;
+
+  /** Number of tasks that haven't finished yet. */
+  size_t remaining;
+
+  /** Incremented for each batch, so workers can tell a new one has started. */
+  unsigned long batch;
+
+  /** True when the workers should exit. */
+  bool stop;
+};
+
+/**
+ * Runs tasks from the current batch until there are none left to hand out.
+ * Called with the lock held, and returns with it held.
+ * 
+ * @param pool the pool to take tasks from
+*/
+static void workOnBatch( ThreadPool *pool )
+{
+  while (pool->next < pool->ntasks) {
+    size_t index = pool->next++;
+
+    pthread_mutex_unlock(&pool->lock);
+    pool->task(pool->arg, index);
+    pthread_mutex_lock(&pool->lock);
+
+    if (--pool->remaining == 0) {
+      pthread_cond_broadcast(&pool->done);
+    }
+  }
+}
+
+/**
+ * Main function for each worker thread.
+ * 
+ * @param arg the pool the thread belongs to
+ * @return always NULL
+*/
+static void *workerMain( void *arg )
+{
+  ThreadPool *pool = arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (true) {
+    // Wait for a batch we haven't worked on yet
+    while (!pool->stop && pool->batch == seen) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+
+    if (pool->stop) {
+      break;
+    }
+
+    seen = pool->batch;
+    workOnBatch(pool);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+ThreadPool *makePool( int threads )
+{
+  ThreadPool *pool = malloc(sizeof(ThreadPool));
+
+  pool->threads = threads < 1 ? 1 : threads;
+  pool->workers = malloc(sizeof(pthread_t) * pool->threads);
+  pool->ntasks = pool->next = pool->remaining = 0;
+  pool->batch = 0;
+  pool->stop = false;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  for (int i = 0; i < pool->threads - 1; i++) {
+    if (pthread_create(&pool->workers[i], NULL, workerMain, pool) != 0) {
+      fprintf(stderr, "Can't create worker thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return pool;
+}
+
+int poolThreads( ThreadPool const *pool )
+{
+  return pool->threads;
+}
+
+void runPool( ThreadPool *pool, TaskFunction task, void *arg, size_t ntasks )
+{
+  if (ntasks == 0) {
+    return;
+  }
+
+  // With no workers, or only one task, just run it here
+  if (pool->threads == 1 || ntasks == 1) {
+    for (size_t i = 0; i < ntasks; i++) {
+      task(arg, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+
+  pool->task = task;
+  pool->arg = arg;
+  pool->ntasks = ntasks;
+  pool->next = 0;
+  pool->remaining = ntasks;
+  pool->batch++;
+  pthread_cond_broadcast(&pool->start);
+
+  // Help out, then wait for the workers to finish their last tasks
+  workOnBatch(pool);
+  while (pool->remaining > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void freePool( ThreadPool *pool )
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (int i = 0; i < pool->threads - 1; i++) {
+    pthread_join(pool->workers[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->done);
+  free(pool->workers);
+  free(pool);
+}
+
+int processorCount( void )
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count < 1 ? 1 : count;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file pool.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for a fixed-size pool of worker threads
+ * that run numbered tasks in parallel.
+ */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stddef.h>
+
+/** Function run for each task. It gets the shared argument and the task's number. */
+typedef void (*TaskFunction)( void *arg, size_t index );
+
+/** Incomplete type for a pool of worker threads. */
+typedef struct ThreadPoolStruct ThreadPool;
+
+/**
+ * Makes a dynamically allocated pool with the given number of threads.
+ * The calling thread counts as one of them, so a pool of one thread
+ * runs every task directly.
+ * 
+ * @param threads number of threads to run tasks on, at least 1
+ * @return a pointer to the new pool
+*/
+ThreadPool *makePool( int threads );
+
+/**
+ * Returns the number of threads in the given pool.
+ * 
+ * @param pool the pool to check
+ * @return number of threads, including the calling thread
+*/
+int poolThreads( ThreadPool const *pool );
+
+/**
+ * Runs task( arg, i ) for every i from 0 to ntasks - 1, spread across the
+ * threads of the pool, and returns once all of them have finished.
+ * 
+ * @param pool the pool to run the tasks on
+ * @param task the function to run for each task
+ * @param arg argument passed to every task
+ * @param ntasks number of tasks to run
+*/
+void runPool( ThreadPool *pool, TaskFunction task, void *arg, size_t ntasks );
+
+/**
+ * Stops the threads of the given pool and frees its memory.
+ * 
+ * @param pool the pool to free
+*/
+void freePool( ThreadPool *pool );
+
+/**
+ * Returns the number of processors available, as a default thread count.
+ * 
+ * @return number of online processors, at least 1
+*/
+int processorCount( void );
+
+#endif
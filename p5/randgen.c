@@ -0,0 +1,211 @@
+/**
+ * @file randgen.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Main component of the randgen program. Writes the given number of random
+ * bytes to a file, or to standard output, much faster than they could be
+ * read from the operating system.
+ *
+ * A master generator is seeded once from the operating system, and seeds a
+ * generator of its own for every thread. Output is made a chunk at a time,
+ * with each thread filling its own slice of the chunk from its own stream.
+ * Between chunks, any stream that has made at least the reseed interval
+ * since it was last seeded is reseeded from the master generator, so the
+ * interval is rounded up to a whole number of slices.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "io.h"
+#include "aes.h"
+#include "drbg.h"
+#include "pool.h"
+#include "stream.h"
+#include "options.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: randgen [-j <threads>] [--reseed=<bytes>] [--backend=<name>] <bytes> [output-file]"
+
+/** Prefix of the option that sets the reseed interval */
+#define RESEED_OPTION "--reseed="
+
+/** Prefix of the option that selects a backend */
+#define BACKEND_OPTION "--backend="
+
+/** Bytes each stream makes between reseeds if --reseed isn't given */
+#define DEFAULT_RESEED ( 64 * 1024 * 1024 )
+
+/** Bytes each thread fills in a chunk */
+#define SLICE_SIZE CHUNK_SIZE
+
+/** Everything the threads need to fill one chunk. */
+typedef struct {
+  /** One generator for each slice. */
+  Drbg *streams;
+
+  /** The chunk to fill. */
+  byte *data;
+
+  /** Number of bytes in the chunk. */
+  size_t len;
+} FillJob;
+
+/**
+ * Parses a byte count, terminating the program if it isn't a whole number,
+ * or if it's zero and zero isn't allowed
+ *
+ * @param arg the argument to parse
+ * @param allowZero true if zero is a valid count
+ * @return the count
+*/
+static uint64_t parseBytes( char const *arg, bool allowZero )
+{
+  char *end;
+  unsigned long long count = strtoull(arg, &end, 10);
+
+  if (*arg < '0' || *arg > '9' || *end != '\0' || ( count == 0 && !allowZero )) {
+    fprintf(stderr, "Bad byte count: %s\n", arg);
+    exit(EXIT_FAILURE);
+  }
+
+  return count;
+}
+
+/**
+ * Fills one slice of a chunk from its own stream.
+ *
+ * @param arg the FillJob being worked on
+ * @param index number of the slice, and of its stream
+*/
+static void fillSlice( void *arg, size_t index )
+{
+  FillJob *job = arg;
+  size_t start = index * SLICE_SIZE;
+  size_t len = job->len - start < SLICE_SIZE ? job->len - start : SLICE_SIZE;
+
+  drbgGenerate(&job->streams[index], job->data + start, len);
+}
+
+/**
+ * Seeds or reseeds a stream from the master generator.
+ *
+ * @param master the master generator
+ * @param stream the stream to seed
+ * @param fresh true if the stream hasn't been seeded before
+*/
+static void seedStream( Drbg *master, Drbg *stream, bool fresh )
+{
+  byte seed[DRBG_SEED_SIZE];
+  drbgGenerate(master, seed, DRBG_SEED_SIZE);
+
+  if (fresh) {
+    drbgInit(stream, seed);
+  }
+  else {
+    drbgReseed(stream, seed);
+  }
+
+  memset(seed, 0, DRBG_SEED_SIZE);
+}
+
+/**
+ * Writes random bytes, a chunk at a time.
+ *
+ * @param out where to write the bytes
+ * @param total number of bytes to write
+ * @param threads number of threads, and of streams
+ * @param reseed bytes each stream makes between reseeds
+*/
+static void generate( FILE *out, uint64_t total, int threads, uint64_t reseed )
+{
+  byte seed[DRBG_SEED_SIZE];
+  randomBytes(seed, DRBG_SEED_SIZE);
+
+  Drbg master;
+  drbgInit(&master, seed);
+  memset(seed, 0, DRBG_SEED_SIZE);
+
+  Drbg *streams = malloc(threads * sizeof(Drbg));
+  for (int i = 0; i < threads; i++) {
+    seedStream(&master, &streams[i], true);
+  }
+
+  ThreadPool *pool = makePool(threads);
+  size_t size = (size_t) SLICE_SIZE * threads;
+  byte *data = malloc(size);
+
+  for (uint64_t done = 0; done < total; ) {
+    size_t len = total - done < size ? total - done : size;
+    FillJob job = { streams, data, len };
+    runPool(pool, fillSlice, &job, ( len + SLICE_SIZE - 1 ) / SLICE_SIZE);
+    writeChunk(out, data, len);
+    done += len;
+
+    for (int i = 0; i < threads; i++) {
+      if (streams[i].sinceReseed >= reseed) {
+        seedStream(&master, &streams[i], false);
+      }
+    }
+  }
+
+  // Nothing that could rebuild the output should be left lying around
+  memset(&master, 0, sizeof(Drbg));
+  memset(streams, 0, threads * sizeof(Drbg));
+  free(streams);
+  free(data);
+  freePool(pool);
+}
+
+/**
+ * Starts the program
+ *
+ * @param argc number of command-line arguments
+ * @param argv list of command-line arguments
+ * @return program's exit status
+*/
+int main( int argc, char const *argv[] )
+{
+  int threads = processorCount();
+  uint64_t reseed = DEFAULT_RESEED;
+  char const *args[2];
+  int nargs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = parseThreads(argv[++i]);
+    }
+    else if (strncmp(argv[i], RESEED_OPTION, strlen(RESEED_OPTION)) == 0) {
+      reseed = parseBytes(argv[i] + strlen(RESEED_OPTION), false);
+    }
+    else if (strncmp(argv[i], BACKEND_OPTION, strlen(BACKEND_OPTION)) == 0) {
+      selectAesBackend(argv[i] + strlen(BACKEND_OPTION));
+    }
+    else if (nargs < 2) {
+      args[nargs++] = argv[i];
+    }
+    else {
+      usageError(USAGE);
+    }
+  }
+
+  if (nargs < 1) {
+    usageError(USAGE);
+  }
+
+  uint64_t total = parseBytes(args[0], true);
+  bool toStdout = nargs < 2 || strcmp(args[1], "-") == 0;
+  FILE *out = toStdout ? stdout : openFile(args[1], "wb");
+
+  generate(out, total, threads, reseed);
+
+  if (fclose(out) != 0) {
+    fprintf(stderr, "Can't write file: %s\n", toStdout ? "-" : args[1]);
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,459 @@
+/**
+ * @file rs.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Main component of the rs program. Splits a file into k data shards and
+ * m parity shards, named <prefix>.0 through <prefix>.<k+m-1>, and rebuilds
+ * the file from any k of them.
+ *
+ * The file is coded one stripe at a time, so any size can be streamed
+ * through a fixed amount of memory. Each stripe gives SHARD_CHUNK_SIZE
+ * bytes to every data shard in turn, except the last, which is split
+ * evenly and padded with zeros. Every shard starts with a header giving
+ * the code, its own index and the size of the file.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "io.h"
+#include "erasure.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: rs encode [-k <data-shards>] [-m <parity-shards>] <input-file> <shard-prefix>\n" \
+              "       rs decode <shard-prefix> <output-file>"
+
+/** Data shards if -k isn't given */
+#define DEFAULT_DATA_SHARDS 4
+
+/** Parity shards if -m isn't given */
+#define DEFAULT_PARITY_SHARDS 2
+
+/** Bytes each shard gets from a full stripe */
+#define SHARD_CHUNK_SIZE ( 64 * 1024 )
+
+/** Identifies a shard file, and the version of its layout */
+#define SHARD_MAGIC "RS01"
+
+/** Number of bytes in SHARD_MAGIC */
+#define SHARD_MAGIC_SIZE 4
+
+/** Number of bytes in a shard header: the magic, k, m, the index, a reserved byte and the file size */
+#define SHARD_HEADER_SIZE 16
+
+/** Offset of the file size in a shard header */
+#define SIZE_START 8
+
+/** Room for the suffix of a shard file name, a dot and up to three digits */
+#define SUFFIX_SIZE 5
+
+/** What a shard header says. */
+typedef struct {
+  /** Number of data shards. */
+  int k;
+
+  /** Number of parity shards. */
+  int m;
+
+  /** Index of this shard, with the data shards first. */
+  int index;
+
+  /** Size of the original file, in bytes. */
+  uint64_t size;
+} ShardHeader;
+
+/**
+ * Prints the usage message and terminates the program
+*/
+static void usageError( void )
+{
+  fprintf(stderr, "%s\n", USAGE);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Prints an error for a shard file that isn't valid and terminates the program.
+ *
+ * @param name name of the shard file
+*/
+static void badShard( char const *name )
+{
+  fprintf(stderr, "Bad shard file: %s\n", name);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Parses a shard count, terminating the program if it isn't a positive number
+ *
+ * @param arg the argument to parse
+ * @return the count
+*/
+static int parseCount( char const *arg )
+{
+  char *end;
+  long count = strtol(arg, &end, 10);
+
+  if (*arg == '\0' || *end != '\0' || count < 1 || count >= MAX_SHARDS) {
+    usageError();
+  }
+
+  return count;
+}
+
+/**
+ * Makes the name of a shard file.
+ *
+ * @param prefix the prefix shared by all the shards
+ * @param index index of the shard
+ * @param name filled in with the name, with room for strlen( prefix ) + SUFFIX_SIZE characters
+*/
+static void shardName( char const *prefix, int index, char *name )
+{
+  sprintf(name, "%s.%d", prefix, index);
+}
+
+/**
+ * Returns the number of bytes each shard gets from the next stripe.
+ *
+ * @param remaining bytes of the file not yet coded
+ * @param k number of data shards
+ * @return bytes per shard, with the last stripe split evenly and rounded up
+*/
+static size_t pieceSize( uint64_t remaining, int k )
+{
+  if (remaining >= (uint64_t) k * SHARD_CHUNK_SIZE) {
+    return SHARD_CHUNK_SIZE;
+  }
+  return ( remaining + k - 1 ) / k;
+}
+
+/**
+ * Writes a shard header at the current position of a shard file.
+ *
+ * @param fp the shard file
+ * @param header what the header says
+*/
+static void writeHeader( FILE *fp, ShardHeader const *header )
+{
+  byte data[SHARD_HEADER_SIZE] = { 0 };
+  memcpy(data, SHARD_MAGIC, SHARD_MAGIC_SIZE);
+  data[SHARD_MAGIC_SIZE] = header->k;
+  data[SHARD_MAGIC_SIZE + 1] = header->m;
+  data[SHARD_MAGIC_SIZE + 2] = header->index;
+
+  // The size is big-endian, like the lengths in GCM
+  uint64_t size = header->size;
+  for (int i = SHARD_HEADER_SIZE - 1; i >= SIZE_START; i--) {
+    data[i] = size;
+    size >>= BBITS;
+  }
+
+  writeChunk(fp, data, SHARD_HEADER_SIZE);
+}
+
+/**
+ * Reads a shard header from the start of a shard file.
+ *
+ * @param fp the shard file
+ * @param header filled in with what the header says
+ * @return false if the file doesn't start with a valid header
+*/
+static bool readHeader( FILE *fp, ShardHeader *header )
+{
+  byte data[SHARD_HEADER_SIZE];
+  if (readChunk(fp, data, SHARD_HEADER_SIZE) != SHARD_HEADER_SIZE ||
+      memcmp(data, SHARD_MAGIC, SHARD_MAGIC_SIZE) != 0) {
+    return false;
+  }
+
+  header->k = data[SHARD_MAGIC_SIZE];
+  header->m = data[SHARD_MAGIC_SIZE + 1];
+  header->index = data[SHARD_MAGIC_SIZE + 2];
+  header->size = 0;
+  for (int i = SIZE_START; i < SHARD_HEADER_SIZE; i++) {
+    header->size = header->size << BBITS | data[i];
+  }
+
+  return header->k > 0 && header->m > 0 && header->k + header->m <= MAX_SHARDS &&
+         header->index < header->k + header->m;
+}
+
+/**
+ * Splits a file into shards.
+ *
+ * @param in the file to split, which can be a pipe
+ * @param prefix the prefix for the shard file names
+ * @param k number of data shards
+ * @param m number of parity shards
+*/
+static void encodeFile( FILE *in, char const *prefix, int k, int m )
+{
+  int n = k + m;
+  FILE *shards[MAX_SHARDS];
+  char *name = malloc(strlen(prefix) + SUFFIX_SIZE + 1);
+
+  // The size isn't known until the whole input has been read, so it's filled in at the end
+  for (int i = 0; i < n; i++) {
+    shardName(prefix, i, name);
+    shards[i] = openFile(name, "wb");
+    ShardHeader header = { k, m, i, 0 };
+    writeHeader(shards[i], &header);
+  }
+
+  byte *matrix = malloc(m * k);
+  parityMatrix(k, m, matrix);
+
+  byte *stripe = malloc((size_t) k * SHARD_CHUNK_SIZE);
+  byte *parity = malloc((size_t) m * SHARD_CHUNK_SIZE);
+  byte const *data[MAX_SHARDS];
+  byte *checks[MAX_SHARDS];
+  uint64_t size = 0;
+  size_t got;
+
+  do {
+    got = readChunk(in, stripe, (size_t) k * SHARD_CHUNK_SIZE);
+    if (got == 0) {
+      break;
+    }
+
+    // A short stripe is the last one, padded out to an even split
+    size_t len = pieceSize(got, k);
+    memset(stripe + got, 0, len * k - got);
+
+    for (int i = 0; i < k; i++) {
+      data[i] = stripe + i * len;
+    }
+    for (int i = 0; i < m; i++) {
+      checks[i] = parity + i * len;
+    }
+    applyMatrix(matrix, m, k, data, checks, len);
+
+    for (int i = 0; i < k; i++) {
+      writeChunk(shards[i], data[i], len);
+    }
+    for (int i = 0; i < m; i++) {
+      writeChunk(shards[k + i], checks[i], len);
+    }
+    size += got;
+  } while (got == (size_t) k * SHARD_CHUNK_SIZE);
+
+  for (int i = 0; i < n; i++) {
+    ShardHeader header = { k, m, i, size };
+    if (fseeko(shards[i], 0, SEEK_SET) != 0) {
+      shardName(prefix, i, name);
+      fprintf(stderr, "Can't write file: %s\n", name);
+      exit(EXIT_FAILURE);
+    }
+    writeHeader(shards[i], &header);
+    fclose(shards[i]);
+  }
+
+  free(stripe);
+  free(parity);
+  free(matrix);
+  free(name);
+}
+
+/**
+ * Rebuilds a file from the shards that can still be found.
+ * Doesn't create the output file unless there are enough shards.
+ *
+ * @param prefix the prefix of the shard file names
+ * @param outputFile name of the file to write
+*/
+static void decodeFile( char const *prefix, char const *outputFile )
+{
+  char *name = malloc(strlen(prefix) + SUFFIX_SIZE + 1);
+  ShardHeader first;
+  FILE *fp = NULL;
+
+  // Any shard can say how many there are
+  int i = 0;
+  for (; i < MAX_SHARDS && !fp; i++) {
+    shardName(prefix, i, name);
+    fp = fopen(name, "rb");
+  }
+  if (!fp) {
+    fprintf(stderr, "Can't find shard files: %s\n", prefix);
+    exit(EXIT_FAILURE);
+  }
+  if (!readHeader(fp, &first) || first.index != i - 1) {
+    badShard(name);
+  }
+
+  int k = first.k;
+  uint64_t stripe = (uint64_t) k * SHARD_CHUNK_SIZE;
+  uint64_t payload = first.size / stripe * SHARD_CHUNK_SIZE + pieceSize(first.size % stripe, k);
+
+  // Use the first k shards found, which are the data shards if they're all there
+  FILE *shards[MAX_SHARDS];
+  int indices[MAX_SHARDS];
+  int found = 0;
+  for (i = i - 1; i < k + first.m && found < k; i++) {
+    // The first shard is already open, with its header checked
+    if (found > 0) {
+      shardName(prefix, i, name);
+      fp = fopen(name, "rb");
+      if (!fp) {
+        continue;
+      }
+
+      ShardHeader header;
+      if (!readHeader(fp, &header) || header.k != k || header.m != first.m ||
+          header.index != i || header.size != first.size) {
+        badShard(name);
+      }
+    }
+
+    uint64_t length;
+    if (fileSize(fp, &length) && length != SHARD_HEADER_SIZE + payload) {
+      badShard(name);
+    }
+
+    shards[found] = fp;
+    indices[found] = i;
+    found++;
+  }
+
+  if (found < k) {
+    fprintf(stderr, "Not enough shards to rebuild: found %d of %d\n", found, k);
+    exit(EXIT_FAILURE);
+  }
+
+  byte *recovery = malloc(k * k);
+  if (!recoveryMatrix(k, first.m, indices, recovery)) {
+    badShard(prefix);
+  }
+
+  // Only the missing data shards need rebuilding; the rest are read as they are
+  byte *pieces = malloc(stripe);
+  byte *rebuilt = malloc(stripe);
+  byte *rows = malloc(k * k);
+  byte const *in[MAX_SHARDS];
+  byte *out[MAX_SHARDS];
+  byte const *data[MAX_SHARDS];
+  int where[MAX_SHARDS];
+  int missing = 0;
+
+  // Find where each data shard is among the ones read, or -1 if it's missing
+  for (int j = 0; j < k; j++) {
+    where[j] = -1;
+  }
+  for (int t = 0; t < k; t++) {
+    if (indices[t] < k) {
+      where[indices[t]] = t;
+    }
+  }
+
+  for (int j = 0; j < k; j++) {
+    if (where[j] < 0) {
+      memcpy(rows + missing * k, recovery + j * k, k);
+      missing++;
+    }
+  }
+
+  FILE *output = openFile(outputFile, "wb");
+  uint64_t remaining = first.size;
+
+  while (remaining > 0) {
+    size_t len = pieceSize(remaining, k);
+
+    for (int t = 0; t < k; t++) {
+      in[t] = pieces + t * len;
+      if (readChunk(shards[t], pieces + t * len, len) != len) {
+        shardName(prefix, indices[t], name);
+        badShard(name);
+      }
+    }
+
+    // Data shard j is either read directly or the next rebuilt row
+    int r = 0;
+    for (int j = 0; j < k; j++) {
+      if (where[j] >= 0) {
+        data[j] = in[where[j]];
+      }
+      else {
+        out[r] = rebuilt + r * len;
+        data[j] = out[r];
+        r++;
+      }
+    }
+    applyMatrix(rows, missing, k, in, out, len);
+
+    for (int j = 0; j < k && remaining > 0; j++) {
+      size_t n = remaining < len ? remaining : len;
+      writeChunk(output, data[j], n);
+      remaining -= n;
+    }
+  }
+
+  fclose(output);
+  for (int t = 0; t < k; t++) {
+    fclose(shards[t]);
+  }
+
+  free(pieces);
+  free(rebuilt);
+  free(rows);
+  free(recovery);
+  free(name);
+}
+
+/**
+ * Entry point of program
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main( int argc, char const *argv[] )
+{
+  if (argc < 2) {
+    usageError();
+  }
+
+  if (strcmp(argv[1], "decode") == 0) {
+    if (argc != 4) {
+      usageError();
+    }
+    decodeFile(argv[2], argv[3]);
+    return EXIT_SUCCESS;
+  }
+
+  if (strcmp(argv[1], "encode") != 0) {
+    usageError();
+  }
+
+  int k = DEFAULT_DATA_SHARDS;
+  int m = DEFAULT_PARITY_SHARDS;
+  char const *files[2];
+  int nfiles = 0;
+
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      k = parseCount(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      m = parseCount(argv[++i]);
+    }
+    else if (nfiles < 2) {
+      files[nfiles++] = argv[i];
+    }
+    else {
+      usageError();
+    }
+  }
+
+  if (nfiles != 2 || k + m > MAX_SHARDS) {
+    usageError();
+  }
+
+  FILE *input = openFile(files[0], "rb");
+  encodeFile(input, files[1], k, m);
+  fclose(input);
+
+  return EXIT_SUCCESS;
+}
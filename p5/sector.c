@@ -0,0 +1,217 @@
+/**
+ * @file sector.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Reads and writes parts of XTS images. The new plaintext is read a chunk at
+ * a time, lined up so each chunk after the first starts on a sector boundary.
+ * Only the first and last sector of a chunk can be partly covered, so those
+ * are the only ones whose old contents are read back and decrypted.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sector.h"
+#include "stream.h"
+#include "io.h"
+
+/**
+ * Reads one sector of the image and decrypts it.
+ *
+ * @param cipher the XTS cipher
+ * @param image the open image
+ * @param start where the sector starts
+ * @param len number of bytes in the sector, which may be short at the end of the image
+ * @param sector filled in with the plaintext of the sector
+*/
+static void readSector( Cipher *cipher, FILE *image, uint64_t start, size_t len, byte *sector )
+{
+  if (fseeko(image, start, SEEK_SET) != 0 || readChunk(image, sector, len) != len) {
+    fprintf(stderr, "Can't read input file\n");
+    exit(EXIT_FAILURE);
+  }
+
+  xtsDecrypt(&cipher->xts, cipher->pool, start, sector, sector, len);
+}
+
+/**
+ * Finds how much plaintext there is to write, reading it into a temporary
+ * file first if it isn't in a regular file.
+ *
+ * @param in the plaintext, replaced by the temporary file if one was needed
+ * @param data a buffer for copying
+ * @param size size of the buffer
+ * @param near name of the image, which the temporary file is made next to
+ * @return number of bytes of plaintext
+*/
+static uint64_t inputSize( FILE **in, byte *data, size_t size, char const *near )
+{
+  uint64_t len;
+  if (fileSize(*in, &len)) {
+    return len;
+  }
+
+  FILE *spool = makeSpool(near);
+  size_t n;
+  len = 0;
+  do {
+    n = readChunk(*in, data, size);
+    writeChunk(spool, data, n);
+    len += n;
+  } while (n == size);
+
+  rewind(spool);
+  *in = spool;
+  return len;
+}
+
+SectorResult updateSectors( Cipher *cipher, FILE *in, char const *imageFile, uint64_t offset )
+{
+  size_t sectorSize = cipher->xts.sectorSize;
+  size_t size = (size_t) CHUNK_SIZE * poolThreads(cipher->pool);
+  byte *data = malloc(size + sectorSize);
+  FILE *source = in;
+  uint64_t inSize = inputSize(&source, data, size, imageFile);
+
+  FILE *image = fopen(imageFile, "r+b");
+  uint64_t imageSize = 0;
+  if (image) {
+    fileSize(image, &imageSize);
+  }
+
+  // Leaving a gap would mean inventing the ciphertext of sectors nobody wrote
+  SectorResult result = SECTORS_OK;
+  if (offset > imageSize) {
+    result = SECTORS_PAST_END;
+  }
+  else {
+    // The image is checked as it is and as it will be, since its last
+    // sector is read back whenever it's only partly covered
+    uint64_t finalSize = offset + inSize > imageSize ? offset + inSize : imageSize;
+    if (!xtsLengthValid(imageSize, sectorSize) || !xtsLengthValid(finalSize, sectorSize)) {
+      result = SECTORS_SHORT;
+    }
+  }
+
+  // Nothing is created or changed unless the whole update can go ahead
+  if (result == SECTORS_OK && !image) {
+    image = openFile(imageFile, "w+b");
+  }
+  if (result != SECTORS_OK) {
+    if (image) {
+      fclose(image);
+    }
+    if (source != in) {
+      fclose(source);
+    }
+    free(data);
+    return result;
+  }
+  byte *sector = malloc(sectorSize);
+  uint64_t pos = offset;
+  size_t lead, n;
+
+  do {
+    uint64_t start = pos - pos % sectorSize;
+    lead = pos - start;
+    n = readChunk(source, data + lead, size - lead);
+    if (n == 0) {
+      break;
+    }
+
+    // The sectors of the image the chunk falls in, as far as they exist so far
+    uint64_t end = pos + n;
+    uint64_t covered = ( end + sectorSize - 1 ) / sectorSize * sectorSize;
+    uint64_t existEnd = covered < imageSize ? covered : imageSize;
+
+    // A first sector that's only partly covered keeps its old bytes around the new ones
+    if (existEnd > start && ( lead > 0 || end < start + sectorSize )) {
+      size_t len = existEnd - start < sectorSize ? existEnd - start : sectorSize;
+      readSector(cipher, image, start, len, sector);
+      memcpy(data, sector, lead);
+      if (end < start + len) {
+        memcpy(data + lead + n, sector + lead + n, start + len - end);
+      }
+    }
+
+    // So does a last sector, if it isn't the first one as well
+    uint64_t lastStart = existEnd > 0 ? ( existEnd - 1 ) / sectorSize * sectorSize : 0;
+    if (lastStart > start && end < existEnd) {
+      readSector(cipher, image, lastStart, existEnd - lastStart, sector);
+      memcpy(data + ( end - start ), sector + ( end - lastStart ), existEnd - end);
+    }
+
+    uint64_t newEnd = end > existEnd ? end : existEnd;
+    size_t total = newEnd - start;
+    xtsEncrypt(&cipher->xts, cipher->pool, start, data, data, total);
+    if (fseeko(image, start, SEEK_SET) != 0) {
+      fprintf(stderr, "Can't write file: %s\n", imageFile);
+      exit(EXIT_FAILURE);
+    }
+    writeChunk(image, data, total);
+
+    if (newEnd > imageSize) {
+      imageSize = newEnd;
+    }
+    pos = end;
+  } while (n == size - lead);
+
+  if (fclose(image) != 0) {
+    fprintf(stderr, "Can't write file: %s\n", imageFile);
+    exit(EXIT_FAILURE);
+  }
+
+  if (source != in) {
+    fclose(source);
+  }
+  free(data);
+  free(sector);
+  return SECTORS_OK;
+}
+
+DecryptResult decryptSectors( Cipher *cipher, FILE *in, FILE *out, uint64_t offset,
+                              uint64_t len )
+{
+  uint64_t imageSize;
+  if (!fileSize(in, &imageSize) || !xtsLengthValid(imageSize, cipher->xts.sectorSize)) {
+    return DECRYPT_BAD_LENGTH;
+  }
+  if (offset >= imageSize) {
+    return DECRYPT_OK;
+  }
+
+  uint64_t end = len > imageSize - offset ? imageSize : offset + len;
+
+  // Whole sectors are read, from the one the range starts in to the one it ends in
+  size_t sectorSize = cipher->xts.sectorSize;
+  uint64_t covered = ( end + sectorSize - 1 ) / sectorSize * sectorSize;
+  uint64_t stop = covered < imageSize ? covered : imageSize;
+  uint64_t start = offset - offset % sectorSize;
+  size_t size = (size_t) CHUNK_SIZE * poolThreads(cipher->pool);
+  byte *data = malloc(size);
+
+  if (fseeko(in, start, SEEK_SET) != 0) {
+    fprintf(stderr, "Can't read input file\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (uint64_t pos = start; pos < stop; pos += size) {
+    size_t n = stop - pos < size ? stop - pos : size;
+    if (readChunk(in, data, n) != n) {
+      fprintf(stderr, "Can't read input file\n");
+      exit(EXIT_FAILURE);
+    }
+
+    xtsDecrypt(&cipher->xts, cipher->pool, pos, data, data, n);
+
+    // Only the part of the sectors inside the range is written
+    size_t from = offset > pos ? offset - pos : 0;
+    size_t to = end < pos + n ? end - pos : n;
+    writeChunk(out, data + from, to - from);
+  }
+
+  free(data);
+  return DECRYPT_OK;
+}
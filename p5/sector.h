@@ -0,0 +1,62 @@
+/**
+ * @file sector.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for random access to XTS images. Every sector is
+ * encrypted on its own, at the same offset as its plaintext, so a write
+ * to part of an image only has to encrypt and write the sectors it touches,
+ * and a read only has to decrypt the sectors it overlaps.
+ */
+
+#ifndef _SECTOR_H_
+#define _SECTOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "cipher.h"
+
+/** Results of updating an XTS image. */
+typedef enum {
+  /** The plaintext was written into the image. */
+  SECTORS_OK,
+  /** The offset is past the end of the image, so nothing was written. */
+  SECTORS_PAST_END,
+  /** The image would end in a sector shorter than a block, so nothing was written. */
+  SECTORS_SHORT
+} SectorResult;
+
+/**
+ * Writes everything read from in into an XTS image, as plaintext starting at
+ * the given offset. Sectors the new data only partly covers are decrypted
+ * first so the rest of their plaintext is kept, and the image grows if the
+ * data runs past its end. An image that doesn't exist yet is created, as long
+ * as the offset is 0. Input that isn't a regular file is read into a temporary
+ * file first, since the size the image ends up with has to be checked before
+ * anything is written. Terminates the program if the image can't be written.
+ *
+ * @param cipher an XTS cipher, with its sector size set
+ * @param in the plaintext to read, which doesn't have to be seekable
+ * @param imageFile name of the image
+ * @param offset where the plaintext goes in the image
+ * @return SECTORS_OK, SECTORS_PAST_END if the offset is past the end of the image,
+ *         or SECTORS_SHORT if the image would end in a sector shorter than a block
+*/
+SectorResult updateSectors( Cipher *cipher, FILE *in, char const *imageFile, uint64_t offset );
+
+/**
+ * Decrypts part of an XTS image, reading only the sectors that overlap it.
+ * A range that runs past the end of the image stops there.
+ *
+ * @param cipher an XTS cipher, with its sector size set
+ * @param in the image, which must be a regular file
+ * @param out where to write the plaintext of the range
+ * @param offset where the range starts in the plaintext
+ * @param len length of the range, or RANGE_TO_END
+ * @return DECRYPT_OK, or DECRYPT_BAD_LENGTH if the length of the image can't be
+ *         found or ends in a sector shorter than a block
+*/
+DecryptResult decryptSectors( Cipher *cipher, FILE *in, FILE *out, uint64_t offset,
+                              uint64_t len );
+
+#endif
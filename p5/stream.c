@@ -0,0 +1,311 @@
+/**
+ * @file stream.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Encrypts and decrypts files one chunk at a time. Each chunk is read,
+ * processed in place and written out before the next one is read, so
+ * only one chunk buffer is ever needed. Authenticated modes hold back the
+ * last trailerSize() bytes read, since there's no telling where the input
+ * ends until it does, and check them as the trailer once it has. Where
+ * nothing may be written before then, what's been read waits in a
+ * temporary file next to the output.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stream.h"
+#include "io.h"
+
+/**
+ * Allocates a buffer for one chunk, sized so every thread has its own part.
+ *
+ * @param cipher the cipher that will process the chunks
+ * @param buffer the buffer to set up
+*/
+static void makeBuffer( Cipher const *cipher, StreamBuffer *buffer )
+{
+  initStreamBuffer(buffer, (size_t) CHUNK_SIZE * poolThreads(cipher->pool));
+}
+
+void initStreamBuffer( StreamBuffer *buffer, size_t size )
+{
+  // There's room after the chunk for a trailer, which isn't counted in size
+  buffer->size = size;
+  buffer->data = malloc(size + MAX_TRAILER_SIZE);
+}
+
+void freeStreamBuffer( StreamBuffer *buffer )
+{
+  free(buffer->data);
+  buffer->data = NULL;
+}
+
+void encryptStream( Cipher *cipher, FILE *in, FILE *out )
+{
+  StreamBuffer buffer;
+  makeBuffer(cipher, &buffer);
+  encryptStreamBuffered(cipher, in, out, &buffer);
+  freeStreamBuffer(&buffer);
+}
+
+void encryptStreamBuffered( Cipher *cipher, FILE *in, FILE *out, StreamBuffer const *buffer )
+{
+  byte header[MAX_HEADER_SIZE];
+  makeHeader(cipher, header);
+  writeChunk(out, header, headerSize(cipher->mode));
+
+  byte *data = buffer->data;
+  size_t size = buffer->size;
+  size_t n;
+
+  do {
+    n = readChunk(in, data, size);
+    checksumChunk(cipher, data, n);
+
+    // Only a short read, at the end of the file, can leave a partial block,
+    // and an XTS image can't end in a sector shorter than a block
+    if (cipher->mode == MODE_XTS && !xtsLengthValid(cipher->position + n, cipher->xts.sectorSize)) {
+      fprintf(stderr, "Last sector would be shorter than a block\n");
+      exit(EXIT_FAILURE);
+    }
+    if (modePadded(cipher->mode) && n % BLOCK_SIZE != 0) {
+      size_t padding = BLOCK_SIZE - n % BLOCK_SIZE;
+      memset(data + n, 0x00, padding);
+      n += padding;
+    }
+
+    encryptChunk(cipher, data, data, n);
+    writeChunk(out, data, n);
+  } while (n == size);
+
+  byte trailer[MAX_TRAILER_SIZE];
+  makeTrailer(cipher, trailer);
+  writeChunk(out, trailer, trailerSize(cipher->mode));
+}
+
+/**
+ * Reads the rest of the input once and checks the trailer at the end of it,
+ * copying it to a temporary file as it goes, so what's used afterward is
+ * exactly what was authenticated even if the input changes in the meantime.
+ * The last trailerSize() bytes read are always held back, since there's no
+ * telling where the input ends until it does.
+ *
+ * @param cipher the cipher, with its header already read
+ * @param in the ciphertext to read, just past the header
+ * @param decrypt true to decrypt each chunk before it's copied, or false to copy the ciphertext
+ * @param spool filled in with the copy, rewound, if the ciphertext is authentic
+ * @param len filled in with the length of the copy, not counting the trailer
+ * @param buffer the buffer to work in
+ * @param near name of the output, which the temporary file is made next to
+ * @return DECRYPT_OK if the ciphertext is authentic, or what's wrong with it
+*/
+static DecryptResult authenticateStream( Cipher *cipher, FILE *in, bool decrypt, FILE **spool,
+                                         uint64_t *len, StreamBuffer const *buffer,
+                                         char const *near )
+{
+  size_t trailer = trailerSize(cipher->mode);
+  FILE *copy = makeSpool(near);
+
+  byte *data = buffer->data;
+  size_t size = buffer->size;
+  size_t kept = 0;
+  size_t n;
+  *len = 0;
+
+  do {
+    n = readChunk(in, data + kept, size);
+    if (kept + n < trailer) {
+      fclose(copy);
+      return DECRYPT_BAD_LENGTH;
+    }
+
+    size_t ready = kept + n - trailer;
+    if (decrypt) {
+      openChunk(cipher, data, data, ready);
+    }
+    else {
+      authenticateChunk(cipher, data, ready);
+    }
+    writeChunk(copy, data, ready);
+    *len += ready;
+
+    memmove(data, data + ready, trailer);
+    kept = trailer;
+  } while (n == size);
+
+  if (!checkTrailer(cipher, data)) {
+    fclose(copy);
+    return DECRYPT_BAD_TAG;
+  }
+
+  rewind(copy);
+  *spool = copy;
+  return DECRYPT_OK;
+}
+
+DecryptResult decryptStream( Cipher *cipher, FILE *in, FILE *out )
+{
+  StreamBuffer buffer;
+  makeBuffer(cipher, &buffer);
+  DecryptResult result = decryptStreamBuffered(cipher, in, out, &buffer);
+  freeStreamBuffer(&buffer);
+  return result;
+}
+
+DecryptResult decryptStreamBuffered( Cipher *cipher, FILE *in, FILE *out,
+                                     StreamBuffer const *buffer )
+{
+  byte header[MAX_HEADER_SIZE];
+  size_t hsize = headerSize(cipher->mode);
+  if (readChunk(in, header, hsize) != hsize) {
+    return DECRYPT_BAD_LENGTH;
+  }
+  readHeader(cipher, header);
+
+  byte *data = buffer->data;
+  size_t size = buffer->size;
+  size_t n;
+
+  // The plaintext goes straight out as it's decrypted, and the caller drops
+  // it if the trailer held back from the end doesn't check out
+  size_t trailer = trailerSize(cipher->mode);
+  if (trailer > 0) {
+    size_t kept = 0;
+    do {
+      n = readChunk(in, data + kept, size);
+      if (kept + n < trailer) {
+        return DECRYPT_BAD_LENGTH;
+      }
+
+      size_t ready = kept + n - trailer;
+      openChunk(cipher, data, data, ready);
+      writeChunk(out, data, ready);
+
+      memmove(data, data + ready, trailer);
+      kept = trailer;
+    } while (n == size);
+
+    return checkTrailer(cipher, data) ? DECRYPT_OK : DECRYPT_BAD_TAG;
+  }
+
+  TrimWriter writer = { out, 0 };
+
+  do {
+    n = readChunk(in, data, size);
+
+    if (( modePadded(cipher->mode) && n % BLOCK_SIZE != 0 ) ||
+        ( cipher->mode == MODE_XTS && !xtsLengthValid(cipher->position + n, cipher->xts.sectorSize) )) {
+      return DECRYPT_BAD_LENGTH;
+    }
+
+    decryptChunk(cipher, data, data, n);
+
+    // Padding can only be stripped once we know where the end is,
+    // so padded output goes through the trimming writer
+    if (modePadded(cipher->mode)) {
+      writeTrimmed(&writer, data, n);
+    }
+    else {
+      writeChunk(out, data, n);
+    }
+  } while (n == size);
+
+  return DECRYPT_OK;
+}
+
+DecryptResult decryptStreamSpooled( Cipher *cipher, FILE *in, FILE *out, char const *near )
+{
+  if (trailerSize(cipher->mode) == 0) {
+    return decryptStream(cipher, in, out);
+  }
+
+  byte header[MAX_HEADER_SIZE];
+  size_t hsize = headerSize(cipher->mode);
+  if (readChunk(in, header, hsize) != hsize) {
+    return DECRYPT_BAD_LENGTH;
+  }
+  readHeader(cipher, header);
+
+  StreamBuffer buffer;
+  makeBuffer(cipher, &buffer);
+  FILE *spool;
+  uint64_t len;
+  DecryptResult result = authenticateStream(cipher, in, true, &spool, &len, &buffer, near);
+
+  // Only now that it's known to be authentic does any plaintext reach the output
+  if (result == DECRYPT_OK) {
+    size_t n;
+    while (( n = readChunk(spool, buffer.data, buffer.size) ) > 0) {
+      writeChunk(out, buffer.data, n);
+    }
+    fclose(spool);
+  }
+
+  freeStreamBuffer(&buffer);
+  return result;
+}
+
+DecryptResult transcryptStream( Cipher *from, Cipher *to, FILE *in, FILE *out, char const *near )
+{
+  byte header[MAX_HEADER_SIZE];
+  size_t hsize = headerSize(from->mode);
+  if (readChunk(in, header, hsize) != hsize) {
+    return DECRYPT_BAD_LENGTH;
+  }
+  readHeader(from, header);
+
+  StreamBuffer buffer;
+  makeBuffer(from, &buffer);
+
+  // Without a trailer there's no telling where the input ends until it does
+  FILE *source = in;
+  uint64_t len = UINT64_MAX;
+  if (trailerSize(from->mode) > 0) {
+    DecryptResult result = authenticateStream(from, in, false, &source, &len, &buffer, near);
+    if (result != DECRYPT_OK) {
+      freeStreamBuffer(&buffer);
+      return result;
+    }
+  }
+
+  makeHeader(to, header);
+  writeChunk(out, header, headerSize(to->mode));
+
+  byte *data = buffer.data;
+  size_t size = buffer.size;
+  DecryptResult result = DECRYPT_OK;
+  size_t n;
+
+  do {
+    n = readChunk(source, data, len < size ? len : size);
+
+    if (( modePadded(from->mode) && n % BLOCK_SIZE != 0 ) ||
+        ( from->mode == MODE_XTS && !xtsLengthValid(from->position + n, from->xts.sectorSize) )) {
+      result = DECRYPT_BAD_LENGTH;
+      break;
+    }
+
+    // The padding goes along unchanged, so there's nothing to trim or add
+    transcryptChunk(from, to, data, n);
+    writeChunk(out, data, n);
+
+    if (len != UINT64_MAX) {
+      len -= n;
+    }
+  } while (n == size && len > 0);
+
+  if (result == DECRYPT_OK) {
+    byte trailer[MAX_TRAILER_SIZE];
+    makeTrailer(to, trailer);
+    writeChunk(out, trailer, trailerSize(to->mode));
+  }
+
+  if (source != in) {
+    fclose(source);
+  }
+  freeStreamBuffer(&buffer);
+  return result;
+}
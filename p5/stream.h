@@ -0,0 +1,119 @@
+/**
+ * @file stream.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for encrypting and decrypting whole files
+ * in fixed-size chunks, so memory use doesn't depend on the file size
+ */
+
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "cipher.h"
+
+/** Number of bytes each thread works on per chunk. A multiple of BLOCK_SIZE. */
+#define CHUNK_SIZE ( 1024 * 1024 )
+
+/** Memory for the chunks of a stream, which can be reused from one stream to the next. */
+typedef struct {
+  /** The chunk, with room for a trailer after it. */
+  byte *data;
+
+  /** Number of bytes in a chunk, not counting the room for the trailer. */
+  size_t size;
+} StreamBuffer;
+
+/**
+ * Allocates a buffer for chunks of the given size.
+ * 
+ * @param buffer the buffer to set up
+ * @param size bytes per chunk, a multiple of BLOCK_SIZE
+*/
+void initStreamBuffer( StreamBuffer *buffer, size_t size );
+
+/**
+ * Frees the memory of a buffer.
+ * 
+ * @param buffer the buffer to free
+*/
+void freeStreamBuffer( StreamBuffer *buffer );
+
+/**
+ * Encrypts everything read from in and writes it to out, with any header and
+ * trailer the cipher's mode needs. In padded modes, only the final chunk is padded.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the plaintext to read
+ * @param out where to write the ciphertext
+*/
+void encryptStream( Cipher *cipher, FILE *in, FILE *out );
+
+/**
+ * Like encryptStream(), but works in the given buffer instead of allocating one.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the plaintext to read
+ * @param out where to write the ciphertext
+ * @param buffer the buffer to work in
+*/
+void encryptStreamBuffered( Cipher *cipher, FILE *in, FILE *out, StreamBuffer const *buffer );
+
+/**
+ * Decrypts everything read from in, including any header the cipher's mode
+ * needs, and writes the plaintext to out. In padded modes, zero padding is stripped
+ * from the end without holding more than one chunk in memory. In modes with a
+ * trailer, the plaintext is written as it's decrypted and the trailer is only
+ * checked at the end, so out has to be thrown away unless DECRYPT_OK comes back.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the ciphertext to read
+ * @param out where to write the plaintext
+ * @return DECRYPT_OK, or what turned out to be wrong with the input
+*/
+DecryptResult decryptStream( Cipher *cipher, FILE *in, FILE *out );
+
+/**
+ * Like decryptStream(), but works in the given buffer instead of allocating one.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the ciphertext to read
+ * @param out where to write the plaintext
+ * @param buffer the buffer to work in
+ * @return DECRYPT_OK, or what turned out to be wrong with the input
+*/
+DecryptResult decryptStreamBuffered( Cipher *cipher, FILE *in, FILE *out,
+                                     StreamBuffer const *buffer );
+
+/**
+ * Like decryptStream(), but in modes with a trailer nothing is written to out
+ * until the whole input has been authenticated, for outputs like the
+ * decompressor that act on the plaintext rather than just storing it. The
+ * plaintext waits in a temporary file next to the output in the meantime.
+ * 
+ * @param cipher a newly initialized cipher
+ * @param in the ciphertext to read
+ * @param out where to write the plaintext
+ * @param near name of the output file
+ * @return DECRYPT_OK, or what turned out to be wrong with the input
+*/
+DecryptResult decryptStreamSpooled( Cipher *cipher, FILE *in, FILE *out, char const *near );
+
+/**
+ * Re-encrypts a stream under a new key, reading the ciphertext made with one
+ * cipher and writing the same plaintext encrypted with another, one chunk at
+ * a time through transcryptChunk(). The plaintext is never written anywhere.
+ * In modes with a trailer, the ciphertext is copied to a temporary file next to
+ * the output as it's authenticated, and only re-encrypted from that copy.
+ * 
+ * @param from a newly initialized cipher with the old key
+ * @param to a newly initialized cipher with the new key, in the same mode
+ * @param in the ciphertext to read
+ * @param out where to write the new ciphertext
+ * @param near name of the output file
+ * @return DECRYPT_OK, or what turned out to be wrong with the input
+*/
+DecryptResult transcryptStream( Cipher *from, Cipher *to, FILE *in, FILE *out, char const *near );
+
+#endif
@@ -139,6 +139,689 @@ testDecrypt() {
   return 0
 }
 
+# Encrypt then decrypt a file with the same options, and make sure
+# we get back the original plaintext.
+testRoundTrip() {
+  TESTNAME="$1"
+
+  echo "Round-trip Test $TESTNAME"
+  rm -f output.dat roundtrip.dat stderr.txt
+
+  echo "   ./encrypt ${opts[@]} ${args[@]} roundtrip.dat 2> stderr.txt"
+  ./encrypt ${opts[@]} ${args[@]} roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "   ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt"
+  ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "${args[1]}" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  echo "Round-trip Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file in an authenticated mode, change one bit of the
+# ciphertext, and make sure decrypt rejects it without writing plaintext,
+# leaving an earlier output file just as it was.
+testTampered() {
+  TESTNAME="$1"
+
+  echo "Tamper Test $TESTNAME"
+  rm -f output.dat roundtrip.dat stderr.txt earlier.dat
+
+  echo "   ./encrypt ${opts[@]} ${args[@]} roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[@]} roundtrip.dat
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  # Flip the low bit of one byte just past the header
+  OLD=$(od -An -tu1 -j 20 -N 1 roundtrip.dat)
+  printf "\\x$(printf %02x $(( OLD ^ 1 )))" | dd of=roundtrip.dat bs=1 seek=20 conv=notrunc status=none
+
+  echo "earlier output" > earlier.dat
+  cp earlier.dat output.dat
+
+  echo "   ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2> stderr.txt"
+  ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 1 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if ! cmp -s earlier.dat output.dat || ls .output.dat.* > /dev/null 2>&1; then
+      fail "FAILED - plaintext was written for a tampered file"
+      return 1
+  fi
+
+  if ! grep -q "Authentication failed" stderr.txt; then
+      fail "FAILED - decrypt didn't report the failed authentication"
+      return 1
+  fi
+
+  echo "Tamper Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file into a container, decrypt one range of it, and make
+# sure we get just those bytes of the original plaintext.
+testRange() {
+  TESTNAME="$1"
+  RANGE="$2"
+  OFFSET="${RANGE%%:*}"
+  LENGTH="${RANGE#*:}"
+
+  echo "Range Test $TESTNAME"
+  rm -f output.dat roundtrip.dat expected.dat stderr.txt
+
+  echo "   ./encrypt ${opts[@]} ${args[@]} roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[@]} roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  # The bytes of the plaintext the range covers
+  if [ -z "$LENGTH" ]; then
+      tail -c +$(( OFFSET + 1 )) "${args[1]}" > expected.dat
+  else
+      tail -c +$(( OFFSET + 1 )) "${args[1]}" | head -c "$LENGTH" > expected.dat
+  fi
+
+  echo "   ./decrypt ${opts[@]} --range $RANGE ${args[0]} roundtrip.dat output.dat 2>> stderr.txt"
+  ./decrypt ${opts[@]} --range "$RANGE" ${args[0]} roundtrip.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "expected.dat" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f expected.dat
+  echo "Range Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file into an incremental container, change one byte of the
+# plaintext, and make sure the update rewrites just one chunk and the
+# container still decrypts to the new plaintext. Then make sure a manifest
+# that no longer matches the container doesn't keep any of its chunks.
+testIncremental() {
+  TESTNAME="$1"
+
+  echo "Incremental Test $TESTNAME"
+  rm -f output.dat roundtrip.dat roundtrip.dat.hashes expected.dat stderr.txt
+  cp "${args[1]}" expected.dat
+
+  echo "   ./encrypt --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat"
+  ./encrypt --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  # Change one byte in the middle and update the container
+  printf 'X' | dd of=expected.dat bs=1 seek=1000 conv=notrunc 2> /dev/null
+  echo "   ./encrypt -v --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat"
+  ./encrypt -v --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+  if ! grep -q "^Chunks written: 1$" stderr.txt; then
+      fail "FAILED - update should have written exactly one chunk"
+      return 1
+  fi
+
+  echo "   ./decrypt --container ${args[0]} roundtrip.dat output.dat 2> stderr.txt"
+  ./decrypt --container ${args[0]} roundtrip.dat output.dat 2> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "expected.dat" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  # Write other plaintext over it without --incremental, then put the old
+  # manifest back. The next update can't keep any of the other chunks.
+  cp roundtrip.dat.hashes saved.hashes
+  tr '\000-\377' '\001-\377\000' < expected.dat > other.dat
+  echo "   ./encrypt ${opts[@]} ${args[0]} other.dat roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[0]} other.dat roundtrip.dat
+  if [ -e roundtrip.dat.hashes ]; then
+      fail "FAILED - the manifest was left behind by a plain container run"
+      return 1
+  fi
+  cp saved.hashes roundtrip.dat.hashes
+
+  echo "   ./encrypt --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat"
+  ./encrypt --incremental ${opts[@]} ${args[0]} expected.dat roundtrip.dat
+  ./decrypt --container ${args[0]} roundtrip.dat output.dat 2> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext after a stale manifest" "expected.dat" "output.dat"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f expected.dat other.dat saved.hashes roundtrip.dat.hashes
+  echo "Incremental Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file as an XTS image, write a patch into it at an offset with
+# --at, and make sure only the sectors the patch lands in changed and the
+# image decrypts to the patched plaintext. With USTATUS of 1 the update has
+# to fail and leave the image just as it was.
+testSectorUpdate() {
+  TESTNAME="$1"
+  OFFSET="$2"
+  LENGTH="$3"
+  USTATUS="$4"
+  SECTOR=512
+
+  echo "Sector Update Test $TESTNAME"
+  rm -f output.dat roundtrip.dat expected.dat patch.dat image.dat stderr.txt
+
+  echo "   ./encrypt ${opts[@]} ${args[@]} roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[@]} roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+  cp roundtrip.dat image.dat
+
+  # The plaintext with the patch written over it at the offset
+  head -c "$LENGTH" plain-ec-01.dat > patch.dat
+  head -c "$OFFSET" "${args[1]}" > expected.dat
+  cat patch.dat >> expected.dat
+  tail -c +$(( OFFSET + LENGTH + 1 )) "${args[1]}" >> expected.dat
+
+  echo "   ./encrypt ${opts[@]} --at $OFFSET ${args[0]} patch.dat roundtrip.dat 2> stderr.txt"
+  ./encrypt ${opts[@]} --at "$OFFSET" ${args[0]} patch.dat roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus "$USTATUS" "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$USTATUS" -ne 0 ]; then
+      if ! checkFile "Untouched image" "image.dat" "roundtrip.dat"; then
+          FAIL=1
+          return 1
+      fi
+      rm -f expected.dat patch.dat image.dat
+      echo "Sector Update Test $TESTNAME PASS"
+      return 0
+  fi
+
+  # Only the sectors the patch lands in may have changed
+  FIRST=$(( OFFSET / SECTOR * SECTOR ))
+  LAST=$(( ( OFFSET + LENGTH + SECTOR - 1 ) / SECTOR * SECTOR ))
+  CHANGED=$(cmp -l image.dat roundtrip.dat 2> /dev/null |
+            awk -v first="$FIRST" -v last="$LAST" '$1 <= first || $1 > last' | wc -l)
+  if [ "$CHANGED" -ne 0 ]; then
+      fail "FAILED - bytes outside the sectors from $FIRST to $LAST changed"
+      return 1
+  fi
+
+  echo "   ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt"
+  ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "expected.dat" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f expected.dat patch.dat image.dat
+  echo "Sector Update Test $TESTNAME PASS"
+  return 0
+}
+
+# Make sure a 520-byte file, whose last 512-byte sector would be shorter
+# than a block, is refused as XTS plaintext, whether it's a regular file or
+# comes through a pipe, as a new image written with --at, and as an XTS
+# image to decrypt, without any output.
+testShortSector() {
+  echo "Short Sector Test"
+  rm -f output.dat short.dat stderr.txt
+  head -c 520 plain-06.dat > short.dat
+
+  for cmd in "./encrypt -m xts xts-key.dat short.dat output.dat" \
+             "./encrypt -m xts xts-key.dat /dev/stdin output.dat" \
+             "./encrypt -m xts --at 0 xts-key.dat /dev/stdin output.dat" \
+             "./decrypt -m xts xts-key.dat short.dat output.dat"; do
+      echo "   cat short.dat | $cmd 2> stderr.txt"
+      cat short.dat | $cmd 2> stderr.txt
+      ASTATUS=$?
+      if ! checkStatus 1 "$ASTATUS"; then
+          FAIL=1
+          return 1
+      fi
+      if [ -e output.dat ] || ! [ -s stderr.txt ]; then
+          fail "FAILED - expected an error and no output"
+          return 1
+      fi
+      if ls .output.dat.* > /dev/null 2>&1; then
+          fail "FAILED - a temporary output file was left behind"
+          return 1
+      fi
+  done
+
+  rm -f short.dat
+  echo "Short Sector Test PASS"
+  return 0
+}
+
+# Encrypt and decrypt a list of files with one run of each program in
+# batch mode, and make sure every file comes back the same.
+testBatch() {
+  TESTNAME="$1"
+
+  echo "Batch Test $TESTNAME"
+  rm -f manifest.txt batch-*.dat stderr.txt
+
+  # Encrypt every test file under its own key, then decrypt them all
+  echo "# key input output" > manifest.txt
+  for n in 01 02 03 04 05 06 ec-01; do
+      echo "key-$n.dat plain-$n.dat batch-$n.dat" >> manifest.txt
+  done
+
+  echo "   ./encrypt ${opts[@]} --batch manifest.txt 2> stderr.txt"
+  ./encrypt ${opts[@]} --batch manifest.txt > /dev/null 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "# key input output" > manifest.txt
+  for n in 01 02 03 04 05 06 ec-01; do
+      echo "key-$n.dat batch-$n.dat batch-out-$n.dat" >> manifest.txt
+  done
+
+  echo "   ./decrypt ${opts[@]} --batch manifest.txt 2>> stderr.txt"
+  ./decrypt ${opts[@]} --batch manifest.txt > /dev/null 2>> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  for n in 01 02 03 04 05 06 ec-01; do
+      if ! checkFile "Plaintext output" "plain-$n.dat" "batch-out-$n.dat"; then
+          FAIL=1
+          return 1
+      fi
+  done
+
+  echo "Batch Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file under one key, transcrypt it to another, and make sure
+# the new ciphertext decrypts to the original plaintext under the new key.
+# With ESTATUS of 1, the ciphertext is tampered with first, and transcrypt
+# has to reject it without writing anything.
+testTranscrypt() {
+  TESTNAME="$1"
+  ESTATUS="$2"
+
+  echo "Transcrypt Test $TESTNAME"
+  rm -f output.dat roundtrip.dat transcrypt-out.dat stderr.txt
+
+  echo "   ./encrypt ${opts[@]} ${args[0]} ${args[2]} roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[0]} ${args[2]} roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$ESTATUS" -ne 0 ]; then
+      OLD=$(od -An -tu1 -j 20 -N 1 roundtrip.dat)
+      printf "\\x$(printf %02x $(( OLD ^ 1 )))" | dd of=roundtrip.dat bs=1 seek=20 conv=notrunc status=none
+  fi
+
+  echo "   ./transcrypt ${opts[@]} ${args[0]} ${args[1]} roundtrip.dat transcrypt-out.dat"
+  ./transcrypt ${opts[@]} ${args[0]} ${args[1]} roundtrip.dat transcrypt-out.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if [ "$ESTATUS" -ne 0 ]; then
+      if ! checkStatus 1 "$ASTATUS"; then
+          FAIL=1
+          return 1
+      fi
+      if [ -e transcrypt-out.dat ]; then
+          fail "FAILED - output was left behind for a tampered file"
+          return 1
+      fi
+      if ! grep -q "Authentication failed" stderr.txt; then
+          fail "FAILED - transcrypt didn't report the failed authentication"
+          return 1
+      fi
+      echo "Transcrypt Test $TESTNAME PASS"
+      return 0
+  fi
+
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "   ./decrypt ${opts[@]} ${args[1]} transcrypt-out.dat output.dat"
+  ./decrypt ${opts[@]} ${args[1]} transcrypt-out.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "${args[2]}" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f transcrypt-out.dat
+  echo "Transcrypt Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file under one key, then transcrypt it to another with the
+# ciphertext as both input and output. With ESTATUS of 0 it has to decrypt
+# under the new key afterward; with ESTATUS of 1 the ciphertext is tampered
+# with first, and has to be left as it was.
+testRotate() {
+  TESTNAME="$1"
+  ESTATUS="$2"
+
+  echo "Rotate Test $TESTNAME"
+  rm -f output.dat roundtrip.dat before.dat stderr.txt
+
+  echo "   ./encrypt ${opts[@]} ${args[0]} ${args[2]} roundtrip.dat"
+  ./encrypt ${opts[@]} ${args[0]} ${args[2]} roundtrip.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$ESTATUS" -ne 0 ]; then
+      OLD=$(od -An -tu1 -j 20 -N 1 roundtrip.dat)
+      printf "\\x$(printf %02x $(( OLD ^ 1 )))" | dd of=roundtrip.dat bs=1 seek=20 conv=notrunc status=none
+  fi
+  cp roundtrip.dat before.dat
+
+  echo "   ./transcrypt ${opts[@]} ${args[0]} ${args[1]} roundtrip.dat roundtrip.dat"
+  ./transcrypt ${opts[@]} ${args[0]} ${args[1]} roundtrip.dat roundtrip.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus "$ESTATUS" "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$ESTATUS" -ne 0 ]; then
+      if ! checkFile "Tampered ciphertext" "before.dat" "roundtrip.dat"; then
+          FAIL=1
+          return 1
+      fi
+      rm -f before.dat
+      echo "Rotate Test $TESTNAME PASS"
+      return 0
+  fi
+
+  echo "   ./decrypt ${opts[@]} ${args[1]} roundtrip.dat output.dat"
+  ./decrypt ${opts[@]} ${args[1]} roundtrip.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Plaintext output" "${args[2]}" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  rm -f before.dat
+  echo "Rotate Test $TESTNAME PASS"
+  return 0
+}
+
+# Encrypt a file with --checksum and make sure the checksum it prints is the
+# one the checksum program gives for the input, and for the decrypted output.
+testChecksum() {
+  TESTNAME="$1"
+
+  echo "Checksum Test $TESTNAME"
+  rm -f output.dat output.txt expected.dat roundtrip.dat stderr.txt
+
+  echo "   ./encrypt --checksum ${opts[@]} ${args[@]} roundtrip.dat > output.txt 2> stderr.txt"
+  ./encrypt --checksum ${opts[@]} ${args[@]} roundtrip.dat > output.txt 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "   ./checksum ${args[1]} > expected.dat"
+  ./checksum "${args[1]}" > expected.dat
+  if ! checkFile "Checksum output" "expected.dat" "output.txt"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "   ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt"
+  ./decrypt ${opts[@]} ${args[0]} roundtrip.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  # The same checksum, under the name of the decrypted file
+  ./checksum -j 2 < output.dat | sed "s|  -$|  ${args[1]}|" > output.txt
+  if ! checkFile "Decrypted checksum" "expected.dat" "output.txt"; then
+      FAIL=1
+      return 1
+  fi
+
+  echo "Checksum Test $TESTNAME PASS"
+  return 0
+}
+
+# Same-file test: runs encrypt and decrypt with the options in opts and an
+# output that's a hard link to the input, and makes sure both refuse
+# without touching the input.
+testSameFile() {
+  TESTNAME="$1"
+
+  echo "Same File Test $TESTNAME"
+  rm -f same.dat same-link.dat stderr.txt
+  cp plain-05.dat same.dat
+  ln same.dat same-link.dat
+
+  for prog in encrypt decrypt; do
+    echo "   ./$prog ${opts[@]} key-05.dat same.dat same-link.dat 2> stderr.txt"
+    ./$prog ${opts[@]} key-05.dat same.dat same-link.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" ||
+       ! grep -q "Input and output are the same file: same-link.dat" stderr.txt ||
+       ! checkFile "Input" "plain-05.dat" "same.dat"
+    then
+        FAIL=1
+        return 1
+    fi
+  done
+
+  rm -f same.dat same-link.dat
+  echo "Same File Test $TESTNAME PASS"
+  return 0
+}
+
+# Compression test: encrypts args[1] with --compress and the options in
+# opts, then decrypts it with the options in dopts, which should expand
+# it back to exactly args[1]. With a second argument of "smaller", the
+# ciphertext also has to be smaller than the plaintext.
+testCompress() {
+  TESTNAME="$1"
+
+  echo "Compress Test $TESTNAME"
+  rm -f output.dat stderr.txt compress-out.dat
+
+  echo "   ./encrypt --compress ${opts[@]} ${args[@]} compress-out.dat 2> stderr.txt"
+  ./encrypt --compress ${opts[@]} ${args[@]} compress-out.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$2" == "smaller" ] &&
+     [ "$(wc -c < compress-out.dat)" -ge "$(wc -c < "${args[1]}")" ]; then
+      echo "**** Test FAILED - compress-out.dat isn't smaller than ${args[1]}"
+      FAIL=1
+      return 1
+  fi
+
+  echo "   ./decrypt ${dopts[@]} ${args[0]} compress-out.dat output.dat 2>> stderr.txt"
+  ./decrypt ${dopts[@]} ${args[0]} compress-out.dat output.dat 2>> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS" ||
+     ! checkFile "Decrypted output" "${args[1]}" "output.dat" ||
+     ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  echo "Compress Test $TESTNAME PASS"
+  return 0
+}
+
+# Generate random bytes with randgen, to a file or to standard output, and
+# make sure exactly the requested number come out, different every run.
+testRandom() {
+  TESTNAME="$1"
+  COUNT="$2"
+  OUTPUT="$3"
+
+  echo "Random Test $TESTNAME"
+  rm -f random-a.dat random-b.dat stderr.txt
+
+  for f in random-a.dat random-b.dat; do
+      if [ "$OUTPUT" = "-" ]; then
+          echo "   ./randgen ${opts[@]} $COUNT > $f 2> stderr.txt"
+          ./randgen ${opts[@]} "$COUNT" > $f 2> stderr.txt
+      else
+          echo "   ./randgen ${opts[@]} $COUNT $f 2> stderr.txt"
+          ./randgen ${opts[@]} "$COUNT" $f 2> stderr.txt
+      fi
+      ASTATUS=$?
+      if ! checkStatus 0 "$ASTATUS" ||
+         ! checkEmpty "Stderr output" "stderr.txt"
+      then
+          FAIL=1
+          return 1
+      fi
+  done
+
+  SIZE=$(wc -c < random-a.dat)
+  if [ "$SIZE" -ne "$COUNT" ]; then
+      fail "FAILED - randgen wrote $SIZE bytes instead of $COUNT"
+      return 1
+  fi
+
+  if [ "$COUNT" -gt 0 ] && cmp -s random-a.dat random-b.dat; then
+      fail "FAILED - two runs of randgen gave the same bytes"
+      return 1
+  fi
+
+  echo "Random Test $TESTNAME PASS"
+  return 0
+}
+
+# Split a file into shards with rs, remove some of them, and make sure
+# the rest rebuild the original. ESTATUS is 1 if too many are removed.
+testShards() {
+  TESTNAME="$1"
+  INPUT="$2"
+  EXPECT="$3"
+  shift 3
+
+  echo "Shard Test $TESTNAME"
+  rm -f output.dat stderr.txt shard.*
+
+  echo "   ./rs encode ${opts[@]} $INPUT shard"
+  ./rs encode ${opts[@]} "$INPUT" shard
+  ASTATUS=$?
+  if ! checkStatus 0 "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  for i in "$@"; do
+      rm -f shard.$i
+  done
+
+  echo "   ./rs decode shard output.dat 2> stderr.txt (without shards $*)"
+  ./rs decode shard output.dat 2> stderr.txt
+  ASTATUS=$?
+  if ! checkStatus "$EXPECT" "$ASTATUS"; then
+      FAIL=1
+      return 1
+  fi
+
+  if [ "$EXPECT" -ne 0 ]; then
+      if [ -e output.dat ] || ! grep -q "Not enough shards" stderr.txt; then
+          fail "FAILED - rs didn't report the missing shards"
+          return 1
+      fi
+  elif ! checkFile "Rebuilt output" "$INPUT" "output.dat" ||
+       ! checkEmpty "Stderr output" "stderr.txt"
+  then
+      FAIL=1
+      return 1
+  fi
+
+  echo "Shard Test $TESTNAME PASS"
+  return 0
+}
+
 # Get a clean build of the project.
 make clean
 
@@ -177,6 +860,40 @@ else
     FAIL=1
 fi
 
+# Run unit tests for the modes of operation.
+echo
+echo "Running modeTest unit tests"
+make modeTest
+
+if [ -x modeTest ]; then
+    ./modeTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the modeTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the modeTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
+# Run unit tests for erasure coding.
+echo
+echo "Running erasureTest unit tests"
+make erasureTest
+
+if [ -x erasureTest ]; then
+    ./erasureTest
+    
+    if [ $? -ne 0 ]; then
+	echo "**** Your program didn't pass all the erasureTest unit tests."
+	FAIL=1
+    fi
+else
+    echo "**** We couldn't build the erasureTest program with your implementation, so we couldn't run these unit tests."
+    FAIL=1
+fi
+
 # Tests for the encrypt program.
 echo
 echo "Running encrypt tests"
@@ -241,6 +958,568 @@ else
     fail "Since your decrypt program didn't compile, it couldn't be tested"
 fi
 
+# Round-trip tests for the other modes of operation.
+echo
+echo "Running round-trip tests"
+
+if [ -x encrypt ] && [ -x decrypt ]; then
+    opts=(-m ctr)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip ctr-05
+
+    opts=(-m ctr -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip ctr-ec-01
+
+    opts=(--in-place)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip in-place-ec-01
+
+    opts=(--in-place -m ctr)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip in-place-ctr-06
+
+    opts=(-m gcm)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip gcm-05
+
+    opts=(-m gcm -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip gcm-ec-01
+
+    opts=(--in-place -m gcm)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip in-place-gcm-06
+
+    opts=(-m cbc)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip cbc-05
+
+    opts=(-m cbc -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip cbc-ec-01
+
+    opts=(--in-place -m cbc)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip in-place-cbc-06
+
+    opts=(-m ocb)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip ocb-05
+
+    opts=(-m ocb -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip ocb-ec-01
+
+    opts=(--in-place -m ocb)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip in-place-ocb-06
+
+    # XTS takes a data key and a tweak key
+    cat key-05.dat key-06.dat > xts-key.dat
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testRoundTrip xts-06
+
+    opts=(-m xts --sector=4096 -j 3)
+    args=(xts-key.dat plain-ec-01.dat)
+    testRoundTrip xts-ec-01
+
+    opts=(--in-place -m xts)
+    args=(xts-key.dat plain-05.dat)
+    testRoundTrip in-place-xts-05
+
+    opts=(--async -m xts)
+    args=(xts-key.dat plain-07.dat)
+    testRoundTrip async-xts-07
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testRange xts-middle 700:900
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-ec-01.dat)
+    testRange xts-tail 140:
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testSectorUpdate inside 700 50 0
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testSectorUpdate straddle 1000 100 0
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testSectorUpdate append 2048 146 0
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-ec-01.dat)
+    testSectorUpdate short-sector 20 30 0
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testSectorUpdate past-end 3000 10 1
+
+    opts=(-m xts)
+    args=(xts-key.dat plain-06.dat)
+    testSectorUpdate short-tail 2048 8 1
+
+    testShortSector
+    rm -f xts-key.dat
+
+    opts=(--async)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip async-ec-01
+
+    opts=(--async -m ctr -j 3)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip async-ctr-06
+
+    opts=(--async -m gcm)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip async-gcm-ec-01
+
+    opts=(--async -m cbc)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip async-cbc-05
+
+    opts=(--async -m ocb)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip async-ocb-06
+
+    opts=(--async=threads)
+    args=(key-06.dat plain-06.dat)
+    testRoundTrip async-threads-06
+
+    opts=(--async=threads -m gcm -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip async-threads-gcm-ec-01
+
+    opts=(-m gcm)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testTampered gcm-ec-01
+
+    opts=(--async -m gcm)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testTampered async-gcm-ec-01
+
+    opts=(--in-place -m gcm)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testTampered in-place-gcm-ec-01
+
+    opts=(-m ocb)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testTampered ocb-ec-01
+
+    opts=(--async -m ocb)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testTampered async-ocb-ec-01
+
+    opts=(--container)
+    args=(key-05.dat plain-05.dat)
+    testRoundTrip container-05
+
+    opts=(--container=64 -j 3)
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testRoundTrip container-ec-01
+
+    opts=(--container=64)
+    args=(key-06.dat plain-06.dat)
+    testRange middle 100:300
+
+    opts=(--container=64)
+    args=(key-06.dat plain-06.dat)
+    testRange chunk 128:64
+
+    opts=(--container=64)
+    args=(key-06.dat plain-06.dat)
+    testRange tail 1000:
+
+    opts=(--container)
+    args=(key-06.dat plain-06.dat)
+    testRange past-end 5:100000
+
+    opts=(--container=64)
+    args=(key-06.dat plain-06.dat)
+    testIncremental 06
+
+    # The kernel backend only works where AF_ALG sockets are allowed
+    if ./encrypt --backend=kernel key-01.dat plain-01.dat roundtrip.dat 2> stderr.txt; then
+        opts=(--backend=kernel)
+        args=(key-05.dat plain-05.dat)
+        testRoundTrip kernel-ecb-05
+
+        opts=(--backend=kernel -m ctr)
+        args=(key-ec-01.dat plain-ec-01.dat)
+        testRoundTrip kernel-ctr-ec-01
+
+        # The kernel's ciphertext has to match the user-space backends'
+        rm -f output.dat
+        echo "   ./decrypt key-01.dat roundtrip.dat output.dat"
+        ./decrypt key-01.dat roundtrip.dat output.dat
+        if ! checkFile "Plaintext output" "plain-01.dat" "output.dat"; then
+            FAIL=1
+        fi
+    else
+        # Say so plainly, so a run without them isn't mistaken for one that passed them
+        echo "Kernel Tests SKIPPED - $(cat stderr.txt)"
+    fi
+
+    opts=()
+    testBatch ecb
+
+    opts=(-m gcm -j 3)
+    testBatch gcm
+
+    opts=()
+    testSameFile ecb
+
+    opts=(-m gcm)
+    testSameFile gcm
+
+    opts=(--in-place)
+    testSameFile in-place-ecb
+
+    opts=(--async -m ctr)
+    testSameFile async-ctr
+
+    opts=(--async -m gcm)
+    testSameFile async-gcm
+
+    # A manifest entry that writes over its own input fails on its own
+    cp plain-05.dat same.dat
+    echo "key-05.dat same.dat same.dat" > manifest.txt
+    echo "   ./encrypt --batch manifest.txt > /dev/null 2> stderr.txt"
+    ./encrypt --batch manifest.txt > /dev/null 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || ! checkFile "Input" "plain-05.dat" "same.dat"; then
+        fail "FAILED - a batch entry wrote over its own input"
+    fi
+    rm -f same.dat manifest.txt
+else
+    fail "Since your encrypt or decrypt program didn't compile, round trips couldn't be tested"
+fi
+
+# Re-encryption tests for the transcrypt program.
+echo
+echo "Running transcrypt tests"
+
+if [ -x encrypt ] && [ -x decrypt ] && [ -x transcrypt ]; then
+    opts=()
+    args=(key-05.dat key-06.dat plain-05.dat)
+    testTranscrypt ecb-05 0
+
+    opts=(-m ctr -j 3)
+    args=(key-01.dat key-02.dat plain-ec-01.dat)
+    testTranscrypt ctr-ec-01 0
+
+    opts=(-m gcm)
+    args=(key-06.dat key-05.dat plain-06.dat)
+    testTranscrypt gcm-06 0
+
+    opts=(-m cbc -j 3)
+    args=(key-ec-01.dat key-01.dat plain-ec-01.dat)
+    testTranscrypt cbc-ec-01 0
+
+    opts=(-m gcm)
+    args=(key-05.dat key-06.dat plain-05.dat)
+    testTranscrypt tampered-gcm-05 1
+
+    opts=(-m ocb)
+    args=(key-06.dat key-05.dat plain-06.dat)
+    testTranscrypt ocb-06 0
+
+    cat key-05.dat key-06.dat > xts-key.dat
+    cat key-01.dat key-02.dat > xts-new.dat
+    opts=(-m xts --sector=4096)
+    args=(xts-key.dat xts-new.dat plain-06.dat)
+    testTranscrypt xts-06 0
+    rm -f xts-key.dat xts-new.dat
+
+    # Large enough to take more than one slice per thread
+    rm -f transcrypt-in.dat
+    for i in $(seq 300); do cat plain-06.dat; done > transcrypt-in.dat
+    cat plain-ec-01.dat >> transcrypt-in.dat
+
+    opts=(-j 2)
+    args=(key-01.dat key-02.dat transcrypt-in.dat)
+    testTranscrypt slices-ecb 0
+
+    opts=(-m ctr -j 2)
+    args=(key-01.dat key-02.dat transcrypt-in.dat)
+    testTranscrypt slices-ctr 0
+
+    opts=(-m ocb -j 2)
+    args=(key-01.dat key-02.dat transcrypt-in.dat)
+    testTranscrypt slices-ocb 0
+    rm -f transcrypt-in.dat
+
+    # Rotating a key in place replaces the ciphertext only once it's done,
+    # and leaves a tampered file just as it was
+    opts=(-m gcm)
+    args=(key-05.dat key-06.dat plain-05.dat)
+    testRotate gcm-05 0
+    testRotate tampered-gcm-05 1
+
+    opts=(-m ctr)
+    testRotate ctr-05 0
+else
+    fail "Since your transcrypt program didn't compile, it couldn't be tested"
+fi
+
+# Erasure coding tests for the rs program.
+echo
+echo "Running shard tests"
+
+if [ -x rs ]; then
+    opts=()
+    testShards ec-01 plain-ec-01.dat 0 1 4
+
+    opts=(-k 3 -m 3)
+    testShards 06 plain-06.dat 0 0 1 2
+
+    opts=(-k 3 -m 3)
+    testShards 05 plain-05.dat 1 0 2 4 5
+
+    # Large enough to take more than one stripe
+    rm -f roundtrip.dat
+    for i in $(seq 100); do cat plain-06.dat; done > roundtrip.dat
+    cat plain-ec-01.dat >> roundtrip.dat
+    opts=(-k 2 -m 2)
+    testShards stripes roundtrip.dat 0 0 3
+else
+    fail "Since your rs program didn't compile, it couldn't be tested"
+fi
+
+# Checksum tests for encrypt --checksum and the checksum program.
+echo
+echo "Running checksum tests"
+
+if [ -x encrypt ] && [ -x decrypt ] && [ -x checksum ]; then
+    # Padded, with a partial last block
+    opts=()
+    args=(key-ec-01.dat plain-ec-01.dat)
+    testChecksum ecb-ec-01
+
+    # Many leaves, spread over more than one chunk per thread
+    rm -f checksum-in.dat
+    for i in $(seq 700); do cat plain-06.dat; done > checksum-in.dat
+    cat plain-ec-01.dat >> checksum-in.dat
+
+    opts=(-m ctr -j 3)
+    args=(key-05.dat checksum-in.dat)
+    testChecksum ctr-leaves
+
+    opts=(--in-place -m cbc)
+    args=(key-06.dat checksum-in.dat)
+    testChecksum in-place-cbc-leaves
+
+    opts=(--async -m gcm)
+    args=(key-05.dat checksum-in.dat)
+    testChecksum async-gcm-leaves
+
+    opts=(--backend=table -m ocb)
+    args=(key-06.dat checksum-in.dat)
+    testChecksum table-ocb-leaves
+
+    # Different files shouldn't share a checksum
+    echo "   ./checksum plain-05.dat plain-06.dat > output.txt"
+    ./checksum plain-05.dat plain-06.dat > output.txt
+    ASTATUS=$?
+    if ! checkStatus 0 "$ASTATUS" || [ "$(cut -c1-32 output.txt | sort -u | wc -l)" -ne 2 ]; then
+        fail "FAILED - plain-05.dat and plain-06.dat got the same checksum"
+    fi
+
+    echo "   ./checksum missing.dat > output.txt 2> stderr.txt"
+    ./checksum missing.dat > output.txt 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || ! grep -q "Can't open file: missing.dat" stderr.txt; then
+        fail "FAILED - checksum didn't report the missing file"
+    fi
+
+    echo "   ./decrypt --checksum key-05.dat cipher-05.dat output.dat"
+    ./decrypt --checksum key-05.dat cipher-05.dat output.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS"; then
+        fail "FAILED - decrypt accepted --checksum"
+    fi
+    rm -f checksum-in.dat
+else
+    fail "Since your checksum program didn't compile, it couldn't be tested"
+fi
+
+# Compression tests for encrypt --compress, and decrypt expanding what it made.
+echo
+echo "Running compression tests"
+
+if [ -x encrypt ] && [ -x decrypt ]; then
+    # Repetitive, spread over several frames per thread
+    rm -f compress-in.dat
+    for i in $(seq 700); do cat plain-06.dat; done > compress-in.dat
+    cat plain-ec-01.dat >> compress-in.dat
+
+    # Padded, where the end marker has to survive the padding being stripped
+    opts=()
+    dopts=()
+    args=(key-05.dat compress-in.dat)
+    testCompress ecb smaller
+
+    opts=(-m cbc -j 3)
+    dopts=(-m cbc -j 2)
+    args=(key-06.dat compress-in.dat)
+    testCompress cbc-threads smaller
+
+    opts=(-m ctr)
+    dopts=(-m ctr --async)
+    args=(key-05.dat compress-in.dat)
+    testCompress ctr-async smaller
+
+    opts=(-m gcm -j 2)
+    dopts=(-m gcm --in-place)
+    args=(key-06.dat compress-in.dat)
+    testCompress gcm-in-place smaller
+
+    opts=(-m ocb --backend=table)
+    dopts=(-m ocb)
+    args=(key-05.dat compress-in.dat)
+    testCompress table-ocb smaller
+
+    # Frames that don't shrink are stored as they are
+    ./randgen 300000 compress-in.dat
+    opts=(-m ctr)
+    dopts=(-m ctr)
+    args=(key-05.dat compress-in.dat)
+    testCompress random
+
+    : > compress-in.dat
+    opts=(-m gcm)
+    dopts=(-m gcm)
+    args=(key-05.dat compress-in.dat)
+    testCompress empty
+
+    # The checksum is still of the plaintext
+    echo "   ./encrypt --compress --checksum -m ctr key-05.dat plain-06.dat compress-out.dat > output.txt"
+    ./encrypt --compress --checksum -m ctr key-05.dat plain-06.dat compress-out.dat > output.txt
+    ./checksum plain-06.dat > expected.dat
+    if ! checkFile "Checksum output" "expected.dat" "output.txt"; then
+        fail "FAILED - encrypt --compress took the checksum of the compressed plaintext"
+    fi
+
+    # A compressed stream that's been cut short is caught
+    ./encrypt --compress -m ctr key-05.dat plain-06.dat compress-out.dat
+    head -c -1 compress-out.dat > compress-in.dat
+    echo "   ./decrypt -m ctr key-05.dat compress-in.dat output.dat 2> stderr.txt"
+    ./decrypt -m ctr key-05.dat compress-in.dat output.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || ! grep -q "Bad compressed data: compress-in.dat" stderr.txt; then
+        fail "FAILED - decrypt didn't report the truncated compressed data"
+    fi
+
+    # Plaintext that only looks like a compressed stream comes back as it is
+    printf 'P5LZ\000\020\000\000' > magic-in.dat
+    cat plain-06.dat >> magic-in.dat
+    opts=(-m ctr)
+    args=(key-05.dat magic-in.dat)
+    testRoundTrip magic-ctr
+
+    opts=(--in-place -m gcm)
+    args=(key-06.dat magic-in.dat)
+    testRoundTrip magic-in-place-gcm
+
+    # Through a pipe, the first bytes of ciphertext without a format header
+    # are read again, and a compressed one is still expanded
+    for flag in "" "--compress"; do
+        ./encrypt $flag -m cbc key-05.dat magic-in.dat compress-out.dat
+        echo "   cat compress-out.dat | ./decrypt -m cbc key-05.dat /dev/stdin output.dat 2> stderr.txt"
+        cat compress-out.dat | ./decrypt -m cbc key-05.dat /dev/stdin output.dat 2> stderr.txt
+        ASTATUS=$?
+        if ! checkStatus 0 "$ASTATUS" ||
+           ! checkFile "Decrypted output" "magic-in.dat" "output.dat" ||
+           ! checkEmpty "Stderr output" "stderr.txt"
+        then
+            fail "FAILED - piped decrypt of ${flag:-uncompressed} ciphertext"
+        fi
+    done
+
+    # A compressed file that fails authentication is reported as such, and
+    # leaves no output behind
+    rm -f output.dat
+    ./encrypt --compress -m gcm key-05.dat plain-06.dat compress-out.dat
+    printf '\377' | dd of=compress-out.dat bs=1 seek=100 conv=notrunc 2> /dev/null
+    echo "   ./decrypt -m gcm key-05.dat compress-out.dat output.dat 2> stderr.txt"
+    ./decrypt -m gcm key-05.dat compress-out.dat output.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || [ -e output.dat ] ||
+       [ "$(cat stderr.txt)" != "Authentication failed: compress-out.dat" ]; then
+        fail "FAILED - decrypt didn't reject the tampered compressed file cleanly"
+    fi
+
+    # Batch decrypt can't expand, so it refuses a compressed file
+    ./encrypt --compress key-05.dat plain-06.dat compress-out.dat
+    echo "key-05.dat compress-out.dat output.dat" > manifest.txt
+    echo "   ./decrypt --batch manifest.txt 2> stderr.txt"
+    ./decrypt --batch manifest.txt > /dev/null 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || [ -e output.dat ] ||
+       ! grep -q "Can't decrypt compressed file in a batch: compress-out.dat" stderr.txt; then
+        fail "FAILED - batch decrypt didn't refuse the compressed file"
+    fi
+    rm -f magic-in.dat manifest.txt
+
+    for bad in "--in-place" "--async" "--container" "-m xts"; do
+        echo "   ./encrypt --compress $bad key-05.dat plain-06.dat output.dat"
+        ./encrypt --compress $bad key-05.dat plain-06.dat output.dat 2> stderr.txt
+        ASTATUS=$?
+        if ! checkStatus 1 "$ASTATUS"; then
+            fail "FAILED - encrypt accepted --compress with $bad"
+        fi
+    done
+
+    echo "   ./decrypt --compress key-05.dat cipher-05.dat output.dat"
+    ./decrypt --compress key-05.dat cipher-05.dat output.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS"; then
+        fail "FAILED - decrypt accepted --compress"
+    fi
+    rm -f compress-in.dat compress-out.dat
+else
+    fail "Since your encrypt or decrypt program didn't compile, compression couldn't be tested"
+fi
+
+# Random byte tests for the randgen program.
+echo
+echo "Running random tests"
+
+if [ -x randgen ]; then
+    opts=()
+    testRandom file 5000000 file
+
+    opts=(-j 3)
+    testRandom stdout 3000001 -
+
+    # Reseeding after every slice, with a partial last block
+    opts=(-j 2 --reseed=1)
+    testRandom reseed 4194311 file
+
+    opts=(--backend=table)
+    testRandom table 100000 -
+
+    opts=()
+    testRandom empty 0 -
+
+    echo "   ./randgen --reseed=0 16 > output.dat 2> stderr.txt"
+    ./randgen --reseed=0 16 > output.dat 2> stderr.txt
+    ASTATUS=$?
+    if ! checkStatus 1 "$ASTATUS" || ! grep -q "Bad byte count" stderr.txt; then
+        fail "FAILED - randgen accepted a reseed interval of 0"
+    fi
+    rm -f random-a.dat random-b.dat
+else
+    fail "Since your randgen program didn't compile, it couldn't be tested"
+fi
+
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
   exit 13
@@ -0,0 +1,132 @@
+/**
+ * @file transcrypt.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * Main component of the transcrypt program.
+ * Reads a ciphertext file made with one key and writes the
+ * same plaintext encrypted with another, without the plaintext
+ * ever being written out.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "io.h"
+#include "aes.h"
+#include "options.h"
+#include "cipher.h"
+#include "stream.h"
+#include "pool.h"
+
+/** Message printed when the arguments are invalid */
+#define USAGE "usage: transcrypt <old-key-file> <new-key-file> <input-file> <output-file>"
+
+/**
+ * Prints an error about the given file and terminates the program.
+ *
+ * @param message what's wrong with the file
+ * @param opts the command-line settings, for the file names
+*/
+static void failTranscrypt(char const *message, Options const *opts)
+{
+  fprintf(stderr, "%s: %s\n", message, opts->inputFile);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Reads the key from the given file.
+ * Terminates the program if it isn't exactly 16 bytes, or 32 in XTS mode.
+ *
+ * @param keyFile name of the key file
+ * @param mode the mode of operation
+ * @return the key, which the caller must free
+*/
+static byte *readKey(char const *keyFile, Mode mode)
+{
+  size_t keysize = 0;
+  byte *key = readBinaryFile(keyFile, &keysize);
+
+  if (keysize != keySize(mode)) {
+    fprintf(stderr, "Bad key file: %s\n", keyFile);
+    exit(EXIT_FAILURE);
+  }
+
+  return key;
+}
+
+/**
+ * Entry point of program
+ *
+ * @param argc number of command-line args
+ * @param argv array of command-line args
+ * @return exit status code
+ */
+int main(int argc, char const *argv[])
+{
+  Options opts;
+  parseTranscryptOptions(argc, argv, USAGE, &opts);
+  reportOptions(&opts);
+
+  // Read both keys and open the data
+  byte *oldKey = readKey(opts.keyFile, opts.mode);
+  byte *newKey = readKey(opts.newKeyFile, opts.mode);
+  FILE *input = openFile(opts.inputFile, "rb");
+
+  // A regular file can be checked before anything is written
+  uint64_t datasize;
+  if (fileSize(input, &datasize)) {
+    size_t extra = headerSize(opts.mode) + trailerSize(opts.mode);
+
+    if (datasize < extra || (modePadded(opts.mode) && datasize % BLOCK_SIZE != 0) ||
+        (opts.mode == MODE_XTS && !xtsLengthValid(datasize, opts.sectorSize))) {
+      fprintf(stderr, "Bad ciphertext file length: %s\n", opts.inputFile);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Both keys stay expanded for the whole file, sharing one pool
+  ThreadPool *pool = makePool(opts.threads);
+  Cipher from, to;
+  initCipher(&from, opts.mode, oldKey, pool);
+  initCipher(&to, opts.mode, newKey, pool);
+  setSectorSize(&from, opts.sectorSize);
+  setSectorSize(&to, opts.sectorSize);
+  if (opts.kernel && (!useKernel(&from) || !useKernel(&to))) {
+    fprintf(stderr, "Backend not supported on this machine: kernel\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The new ciphertext only replaces the output once it's complete, so a
+  // failed run leaves any earlier file alone, and a key can be rotated in
+  // place by naming the input as the output
+  Replacement output;
+  if (!openReplacement(&output, opts.outputFile)) {
+    fprintf(stderr, "Can't open file: %s\n", opts.outputFile);
+    exit(EXIT_FAILURE);
+  }
+  DecryptResult result = transcryptStream(&from, &to, input, output.fp, opts.outputFile);
+
+  if (result != DECRYPT_OK) {
+    discardReplacement(&output);
+  }
+  else if (!commitReplacement(&output)) {
+    fprintf(stderr, "Can't write file: %s\n", opts.outputFile);
+    exit(EXIT_FAILURE);
+  }
+
+  if (result == DECRYPT_BAD_LENGTH) {
+    failTranscrypt("Bad ciphertext file length", &opts);
+  }
+  if (result == DECRYPT_BAD_TAG) {
+    failTranscrypt("Authentication failed", &opts);
+  }
+
+  fclose(input);
+  releaseCipher(&from);
+  releaseCipher(&to);
+  freePool(pool);
+  free(oldKey);
+  free(newKey);
+
+  return EXIT_SUCCESS;
+}
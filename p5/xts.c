@@ -0,0 +1,245 @@
+/**
+ * @file xts.c
+ * @author Canaan Matias (ctmatias)
+ *
+ * XTS mode, as in IEEE 1619 with a 128-bit data key. Block j of sector n is
+ * encrypted as E(P xor T) xor T, where T is the encryption of n under the
+ * tweak key, multiplied by x j times in GF(2^128). Each thread takes a
+ * group of whole sectors, encrypts all of their tweaks in one call, then
+ * works through each sector a batch of blocks at a time.
+ */
+
+#include <string.h>
+
+#include "xts.h"
+
+/** Bytes of sectors handed to a thread at a time. A multiple of every sector size. */
+#define SLICE_SIZE ( 256 * 1024 )
+
+/** Number of blocks or tweaks handed to the AES backend at a time. */
+#define BATCH_BLOCKS 64
+
+/** Byte xored into the first byte of a tweak whose top bit was set, when doubling it. */
+#define DOUBLE_REDUCE 0x87
+
+void xtsInit( Xts *xts, AesContext const *ctx, byte const tweakKey[ BLOCK_SIZE ],
+              size_t sectorSize )
+{
+  xts->ctx = ctx;
+  aesInit(&xts->tweakCtx, tweakKey);
+  xts->sectorSize = sectorSize;
+}
+
+/**
+ * Multiplies a tweak by x in GF(2^128), in place. XTS stores the tweak
+ * little-endian, so the bits move from each byte into the one after it.
+ *
+ * @param tweak the tweak to double
+*/
+static void doubleTweak( byte tweak[ BLOCK_SIZE ] )
+{
+  byte carry = tweak[BLOCK_SIZE - 1] >> ( BBITS - 1 );
+
+  for (int i = BLOCK_SIZE - 1; i > 0; i--) {
+    tweak[i] = ( tweak[i] << 1 ) | ( tweak[i - 1] >> ( BBITS - 1 ) );
+  }
+  tweak[0] = ( tweak[0] << 1 ) ^ ( carry ? DOUBLE_REDUCE : 0 );
+}
+
+/**
+ * Encrypts or decrypts one block with the given tweak.
+ *
+ * @param ctx the expanded data key
+ * @param encrypt true to encrypt, false to decrypt
+ * @param tweak the tweak of the block
+ * @param in the input block
+ * @param out where to store the result, which may be the same as in
+*/
+static void cryptBlock( AesContext const *ctx, bool encrypt, byte const tweak[ BLOCK_SIZE ],
+                        byte const in[ BLOCK_SIZE ], byte out[ BLOCK_SIZE ] )
+{
+  byte work[BLOCK_SIZE];
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    work[i] = in[i] ^ tweak[i];
+  }
+
+  if (encrypt) {
+    aesEncryptBlocks(ctx, work, work, 1);
+  }
+  else {
+    aesDecryptBlocks(ctx, work, work, 1);
+  }
+
+  for (int i = 0; i < BLOCK_SIZE; i++) {
+    out[i] = work[i] ^ tweak[i];
+  }
+}
+
+bool xtsLengthValid( uint64_t len, size_t sectorSize )
+{
+  return len % sectorSize == 0 || len % sectorSize >= BLOCK_SIZE;
+}
+
+/**
+ * Encrypts or decrypts one sector.
+ *
+ * @param ctx the expanded data key
+ * @param encrypt true to encrypt, false to decrypt
+ * @param tweak the encrypted tweak of the sector, which is used up
+ * @param in the input bytes
+ * @param out where to store the results, which may be the same as in
+ * @param len number of bytes in the sector, at least BLOCK_SIZE
+*/
+static void cryptSector( AesContext const *ctx, bool encrypt, byte tweak[ BLOCK_SIZE ],
+                         byte const *in, byte *out, size_t len )
+{
+  // With a partial block at the end, the last full block is left for the stealing
+  size_t tail = len % BLOCK_SIZE;
+  size_t full = len / BLOCK_SIZE - ( tail ? 1 : 0 );
+  byte tweaks[BATCH_BLOCKS][BLOCK_SIZE];
+  byte work[BATCH_BLOCKS * BLOCK_SIZE];
+
+  for (size_t done = 0; done < full; ) {
+    size_t n = full - done < BATCH_BLOCKS ? full - done : BATCH_BLOCKS;
+    byte const *src = in + done * BLOCK_SIZE;
+
+    for (size_t b = 0; b < n; b++) {
+      memcpy(tweaks[b], tweak, BLOCK_SIZE);
+      for (int i = 0; i < BLOCK_SIZE; i++) {
+        work[b * BLOCK_SIZE + i] = src[b * BLOCK_SIZE + i] ^ tweak[i];
+      }
+      doubleTweak(tweak);
+    }
+
+    if (encrypt) {
+      aesEncryptBlocks(ctx, work, work, n);
+    }
+    else {
+      aesDecryptBlocks(ctx, work, work, n);
+    }
+
+    byte *dst = out + done * BLOCK_SIZE;
+    for (size_t b = 0; b < n; b++) {
+      for (int i = 0; i < BLOCK_SIZE; i++) {
+        dst[b * BLOCK_SIZE + i] = work[b * BLOCK_SIZE + i] ^ tweaks[b][i];
+      }
+    }
+
+    done += n;
+  }
+
+  if (tail == 0) {
+    return;
+  }
+
+  // Ciphertext stealing: the partial block borrows the end of the last full one.
+  // Decryption undoes the last block first, so it needs the two tweaks the other way round.
+  byte const *last = in + full * BLOCK_SIZE;
+  byte next[BLOCK_SIZE];
+  memcpy(next, tweak, BLOCK_SIZE);
+  doubleTweak(next);
+
+  byte stolen[BLOCK_SIZE];
+  byte partial[BLOCK_SIZE];
+  memcpy(partial, last + BLOCK_SIZE, tail);
+  cryptBlock(ctx, encrypt, encrypt ? tweak : next, last, stolen);
+
+  memcpy(partial + tail, stolen + tail, BLOCK_SIZE - tail);
+  memcpy(out + full * BLOCK_SIZE + BLOCK_SIZE, stolen, tail);
+  cryptBlock(ctx, encrypt, encrypt ? next : tweak, partial, out + full * BLOCK_SIZE);
+}
+
+/** Everything a thread needs to process its groups of sectors. */
+typedef struct {
+  /** State of the image. */
+  Xts const *xts;
+
+  /** True to encrypt, false to decrypt. */
+  bool encrypt;
+
+  /** Number of the first sector. */
+  uint64_t firstSector;
+
+  /** Input bytes. */
+  byte const *in;
+
+  /** Where to store the results. */
+  byte *out;
+
+  /** Total number of bytes to process. */
+  size_t len;
+} XtsJob;
+
+/**
+ * Processes one slice of an XTS job, encrypting the tweaks of a batch of
+ * sectors together before working through the sectors themselves.
+ *
+ * @param arg the XtsJob being worked on
+ * @param index number of the slice to process
+*/
+static void xtsSlice( void *arg, size_t index )
+{
+  XtsJob *job = arg;
+  Xts const *xts = job->xts;
+  size_t sectorSize = xts->sectorSize;
+  size_t start = index * SLICE_SIZE;
+  size_t end = job->len - start < SLICE_SIZE ? job->len : start + SLICE_SIZE;
+  uint64_t sector = job->firstSector + start / sectorSize;
+
+  byte tweaks[BATCH_BLOCKS][BLOCK_SIZE];
+  size_t off = start;
+
+  while (off < end) {
+    size_t count = ( end - off + sectorSize - 1 ) / sectorSize;
+    if (count > BATCH_BLOCKS) {
+      count = BATCH_BLOCKS;
+    }
+
+    // Each tweak is the sector number, little-endian, under the tweak key
+    memset(tweaks, 0, count * BLOCK_SIZE);
+    for (size_t s = 0; s < count; s++) {
+      for (int i = 0; i < (int) sizeof(uint64_t); i++) {
+        tweaks[s][i] = ( sector + s ) >> ( i * BBITS );
+      }
+    }
+    aesEncryptBlocks(&xts->tweakCtx, tweaks[0], tweaks[0], count);
+
+    for (size_t s = 0; s < count; s++) {
+      size_t len = end - off < sectorSize ? end - off : sectorSize;
+      cryptSector(xts->ctx, job->encrypt, tweaks[s], job->in + off, job->out + off, len);
+      off += len;
+    }
+
+    sector += count;
+  }
+}
+
+/**
+ * Runs an XTS job on the pool.
+ *
+ * @param xts the state of the image
+ * @param pool the pool to run on
+ * @param encrypt true to encrypt, false to decrypt
+ * @param offset position of in[ 0 ] within the image
+ * @param in the input bytes
+ * @param out where to store the results
+ * @param len number of bytes to process
+*/
+static void xtsRun( Xts const *xts, ThreadPool *pool, bool encrypt, uint64_t offset,
+                    byte const *in, byte *out, size_t len )
+{
+  XtsJob job = { xts, encrypt, offset / xts->sectorSize, in, out, len };
+  runPool(pool, xtsSlice, &job, (len + SLICE_SIZE - 1) / SLICE_SIZE);
+}
+
+void xtsEncrypt( Xts const *xts, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len )
+{
+  xtsRun(xts, pool, true, offset, in, out, len);
+}
+
+void xtsDecrypt( Xts const *xts, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len )
+{
+  xtsRun(xts, pool, false, offset, in, out, len);
+}
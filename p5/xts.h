@@ -0,0 +1,92 @@
+/**
+ * @file xts.h
+ * @author Canaan Matias (ctmatias)
+ *
+ * Provides an interface for XTS mode (IEEE 1619), which encrypts a disk
+ * image one sector at a time. Each sector's tweak is its number encrypted
+ * under a second key, so any sector can be encrypted or decrypted without
+ * the ones around it, and the ciphertext is the same size as the plaintext.
+ */
+
+#ifndef _XTS_H_
+#define _XTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "aes.h"
+#include "pool.h"
+
+/** Number of bytes in an XTS key: the data key, then the tweak key. */
+#define XTS_KEY_SIZE ( 2 * BLOCK_SIZE )
+
+/** Default number of bytes in a sector. */
+#define XTS_SECTOR_SIZE 512
+
+/** Sector size used by disks with 4K sectors. */
+#define XTS_LARGE_SECTOR 4096
+
+/** State of one XTS image. */
+typedef struct {
+  /** The expanded data key. */
+  AesContext const *ctx;
+
+  /** The expanded tweak key. */
+  AesContext tweakCtx;
+
+  /** Number of bytes in each sector, a multiple of BLOCK_SIZE. */
+  size_t sectorSize;
+} Xts;
+
+/**
+ * Sets up the state for an image.
+ *
+ * @param xts the state to set up
+ * @param ctx the expanded data key, which must outlive the state
+ * @param tweakKey the tweak key, which is expanded into the state
+ * @param sectorSize number of bytes in each sector, a multiple of BLOCK_SIZE
+*/
+void xtsInit( Xts *xts, AesContext const *ctx, byte const tweakKey[ BLOCK_SIZE ],
+              size_t sectorSize );
+
+/**
+ * Encrypts whole sectors, with groups of sectors running in parallel on
+ * the pool. Every sector but the last must be full. A last sector that
+ * isn't a whole number of blocks uses ciphertext stealing, so it must be at
+ * least a block long; see xtsLengthValid().
+ *
+ * @param xts the state of the image
+ * @param pool the pool to run on
+ * @param offset position of in[ 0 ] within the image, a multiple of the sector size
+ * @param in the plaintext
+ * @param out where to store the ciphertext, which may be the same as in
+ * @param len number of bytes to encrypt
+*/
+void xtsEncrypt( Xts const *xts, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len );
+
+/**
+ * Checks whether an image of the given length can be encrypted. A last
+ * sector shorter than a block has no block to steal ciphertext from, and
+ * masking it with something made from its tweak alone would reuse the
+ * same mask every time the sector is written, so such images are refused.
+ *
+ * @param len number of bytes in the image
+ * @param sectorSize number of bytes in each sector
+ * @return false if the last sector would be 1 to BLOCK_SIZE - 1 bytes long
+*/
+bool xtsLengthValid( uint64_t len, size_t sectorSize );
+
+/**
+ * Decrypts whole sectors, with the same restrictions as xtsEncrypt().
+ *
+ * @param xts the state of the image
+ * @param pool the pool to run on
+ * @param offset position of in[ 0 ] within the image, a multiple of the sector size
+ * @param in the ciphertext
+ * @param out where to store the plaintext, which may be the same as in
+ * @param len number of bytes to decrypt
+*/
+void xtsDecrypt( Xts const *xts, ThreadPool *pool, uint64_t offset,
+                 byte const *in, byte *out, size_t len );
+
+#endif